@@ -321,7 +321,8 @@ EXPORT_SYMBOL_GPL(device_bind_driver);
 #else
 #define TIME_LOG_START()
 #define TIME_LOG_END()
-#define bootprof_probe(ts, dev, drv, probe)
+#define bootprof_probe(ts, dev, drv, probe, ret)
+#define bootprof_async_probe(drv) false
 #endif
 
 static atomic_t probe_count = ATOMIC_INIT(0);
@@ -384,14 +385,15 @@ re_probe:
 		TIME_LOG_START();
 		ret = dev->bus->probe(dev);
 		TIME_LOG_END();
-		bootprof_probe(ts, dev, drv, (unsigned long)dev->bus->probe);
+		bootprof_probe(ts, dev, drv, (unsigned long)dev->bus->probe,
+			       ret);
 		if (ret)
 			goto probe_failed;
 	} else if (drv->probe) {
 		TIME_LOG_START();
 		ret = drv->probe(dev);
 		TIME_LOG_END();
-		bootprof_probe(ts, dev, drv, (unsigned long)drv->probe);
+		bootprof_probe(ts, dev, drv, (unsigned long)drv->probe, ret);
 		if (ret)
 			goto probe_failed;
 	}
@@ -549,6 +551,9 @@ bool driver_allows_async_probing(struct device_driver *drv)
 		if (module_requested_async_probing(drv->owner))
 			return true;
 
+		if (bootprof_async_probe(drv))
+			return true;
+
 		return false;
 	}
 }
@@ -524,6 +524,7 @@ wait:
 
 	policy->transition_ongoing = true;
 	policy->transition_task = current;
+	policy->transition_start = ktime_get_ns();
 
 	spin_unlock(&policy->transition_lock);
 
@@ -543,6 +544,10 @@ void cpufreq_freq_transition_end(struct cpufreq_policy *policy,
 	if (unlikely(WARN_ON(!policy->transition_ongoing)))
 		return;
 
+	if (!transition_failed)
+		cpufreq_stats_record_latency(policy, freqs->new,
+				ktime_get_ns() - policy->transition_start);
+
 	cpufreq_notify_post_transition(policy, freqs, transition_failed);
 
 	policy->transition_ongoing = false;
@@ -17,6 +17,13 @@
 
 static DEFINE_SPINLOCK(cpufreq_stats_lock);
 
+/*
+ * Transition latency histogram: bucket 0 is below LAT_UNIT_US, each further
+ * bucket doubles the upper bound, the last one catches everything above.
+ */
+#define CPUFREQ_STATS_LAT_BUCKETS	8
+#define CPUFREQ_STATS_LAT_UNIT_US	25
+
 struct cpufreq_stats {
 	unsigned int total_trans;
 	unsigned long long last_time;
@@ -27,6 +34,8 @@ struct cpufreq_stats {
 	unsigned int *freq_table;
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
+	unsigned int *lat_hist;
+	unsigned int *lat_max_us;
 #endif
 };
 
@@ -109,6 +118,47 @@ static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 	return len;
 }
 cpufreq_freq_attr_ro(trans_table);
+
+static ssize_t show_trans_latency(struct cpufreq_policy *policy, char *buf)
+{
+	struct cpufreq_stats *stats = policy->stats;
+	unsigned int *hist;
+	ssize_t len = 0;
+	int i, j, k;
+
+	if (policy->fast_switch_enabled)
+		return 0;
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "   From        To:");
+	for (k = 0; k < CPUFREQ_STATS_LAT_BUCKETS - 1; k++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, " <%6uus",
+				CPUFREQ_STATS_LAT_UNIT_US << k);
+	len += scnprintf(buf + len, PAGE_SIZE - len, " >=%5uus   max_us\n",
+			CPUFREQ_STATS_LAT_UNIT_US <<
+			(CPUFREQ_STATS_LAT_BUCKETS - 2));
+
+	for (i = 0; i < stats->state_num; i++) {
+		for (j = 0; j < stats->state_num; j++) {
+			/* only pairs that actually happened */
+			if (!stats->trans_table[i * stats->max_state + j])
+				continue;
+
+			hist = &stats->lat_hist[(i * stats->max_state + j) *
+						CPUFREQ_STATS_LAT_BUCKETS];
+
+			len += scnprintf(buf + len, PAGE_SIZE - len, "%9u %9u:",
+					stats->freq_table[i],
+					stats->freq_table[j]);
+			for (k = 0; k < CPUFREQ_STATS_LAT_BUCKETS; k++)
+				len += scnprintf(buf + len, PAGE_SIZE - len,
+						" %8u", hist[k]);
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %8u\n",
+				stats->lat_max_us[i * stats->max_state + j]);
+		}
+	}
+	return len;
+}
+cpufreq_freq_attr_ro(trans_latency);
 #endif
 
 cpufreq_freq_attr_ro(total_trans);
@@ -119,6 +169,7 @@ static struct attribute *default_attrs[] = {
 	&time_in_state.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&trans_table.attr,
+	&trans_latency.attr,
 #endif
 	NULL
 };
@@ -180,6 +231,8 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy)
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	alloc_size += count * count * sizeof(int);
+	alloc_size += count * count * CPUFREQ_STATS_LAT_BUCKETS * sizeof(int);
+	alloc_size += count * count * sizeof(int);
 #endif
 
 	/* Allocate memory for time_in_state/freq_table/trans_table in one go */
@@ -191,6 +244,9 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy)
 
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	stats->trans_table = stats->freq_table + count;
+	stats->lat_hist = stats->trans_table + count * count;
+	stats->lat_max_us = stats->lat_hist +
+			    count * count * CPUFREQ_STATS_LAT_BUCKETS;
 #endif
 
 	stats->max_state = count;
@@ -242,3 +298,32 @@ void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 #endif
 	stats->total_trans++;
 }
+
+void cpufreq_stats_record_latency(struct cpufreq_policy *policy,
+				  unsigned int new_freq, u64 latency_ns)
+{
+#ifdef CONFIG_CPU_FREQ_STAT_DETAILS
+	struct cpufreq_stats *stats = policy->stats;
+	int old_index, new_index, pair, bucket;
+	unsigned int us;
+
+	if (!stats)
+		return;
+
+	/* called before the POSTCHANGE notification moves last_index */
+	old_index = stats->last_index;
+	new_index = freq_table_get_index(stats, new_freq);
+
+	if (old_index == -1 || new_index == -1 || old_index == new_index)
+		return;
+
+	us = min_t(u64, div_u64(latency_ns, NSEC_PER_USEC), UINT_MAX);
+	bucket = min(fls(us / CPUFREQ_STATS_LAT_UNIT_US),
+		     CPUFREQ_STATS_LAT_BUCKETS - 1);
+	pair = old_index * stats->max_state + new_index;
+
+	stats->lat_hist[pair * CPUFREQ_STATS_LAT_BUCKETS + bucket]++;
+	if (us > stats->lat_max_us[pair])
+		stats->lat_max_us[pair] = us;
+#endif
+}
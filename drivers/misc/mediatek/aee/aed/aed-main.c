@@ -2183,6 +2183,8 @@ static int aed_proc_init(void)
 
 	aed_proc_debug_init(aed_proc_dir);
 
+	hang_stall_proc_init(aed_proc_dir);
+
 	return 0;
 }
 
@@ -2193,6 +2195,8 @@ static int aed_proc_done(void)
 
 	aed_proc_debug_done(aed_proc_dir);
 
+	hang_stall_proc_done(aed_proc_dir);
+
 	remove_proc_entry("aed", NULL);
 	return 0;
 }
@@ -228,6 +228,22 @@ void aee_rr_proc_done(struct proc_dir_entry *aed_proc_dir);
 void dram_console_init(struct proc_dir_entry *aed_proc_dir);
 void dram_console_done(struct proc_dir_entry *aed_proc_dir);
 
+#ifdef CONFIG_MTK_AEE_HANG_STALL
+int hang_stall_init(void);
+void hang_stall_dump(void);
+void hang_stall_proc_init(struct proc_dir_entry *aed_proc_dir);
+void hang_stall_proc_done(struct proc_dir_entry *aed_proc_dir);
+#else
+static inline int hang_stall_init(void) { return 0; }
+static inline void hang_stall_dump(void) { }
+static inline void hang_stall_proc_init(struct proc_dir_entry *aed_proc_dir)
+{
+}
+static inline void hang_stall_proc_done(struct proc_dir_entry *aed_proc_dir)
+{
+}
+#endif
+
 struct aee_oops *ipanic_oops_copy(void);
 void ipanic_oops_free(struct aee_oops *oops, int erase);
 extern struct atomic_notifier_head panic_notifier_list;
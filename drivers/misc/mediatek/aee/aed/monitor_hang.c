@@ -318,6 +318,7 @@ static int __init monitor_hang_init(void)
 		return err;
 	}
 	hang_detect_init();
+	hang_stall_init();
 	/* bleow code is added by QHQ  for hang detect */
 	/* end */
 #ifdef CONFIG_MTK_ENG_BUILD
@@ -1589,6 +1590,7 @@ static void ShowStatus(int flag)
 #endif
 		}
 
+		hang_stall_dump();
 		/* debug_locks = 1; */
 		debug_show_all_locks();
 		show_free_areas(0);
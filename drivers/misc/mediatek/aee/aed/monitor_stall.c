@@ -0,0 +1,603 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * hang stall monitor
+ *
+ * hang_detect only looks every HD_INTER seconds and only reports once
+ * things are already stuck. This keeps a continuous, cheap view of where
+ * threads wait: every stall_period_ms one pass over the thread list
+ * (under RCU only, into a snapshot) picks up
+ *   D episodes: TASK_UNINTERRUPTIBLE (not TASK_NOLOAD), one episode per
+ *               context switch count, start from schedstats block_start
+ *               when it is valid, else from the pass that first saw it
+ *   R episodes: runnable but waiting on a runqueue, start from
+ *               sched_info.last_queued
+ * The snapshot is then merged into the tables under stall_lock, so
+ * neither the walk nor the stack unwinding for the wait channel is done
+ * with the lock held.
+ * An episode ends on the first pass that does not see it any more. D
+ * episodes go into a log2(ms) histogram per wait channel, R episodes into
+ * a single one, and the threads with the longest episodes are kept as top
+ * offenders.
+ *
+ * /proc/aed/hang-stall       struct hang_stall_hdr_t, nr_wchan
+ *                            struct hang_stall_wchan_t, nr_top
+ *                            struct hang_stall_top_t
+ * /proc/aed/hang-stall-stat  the same as text, write 0 to reset
+ */
+
+#include <linux/hashtable.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
+#include <linux/proc_fs.h>
+#include <linux/rcupdate.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include "aed.h"
+
+#define HANG_STALL_MAGIC	0x4c415453	/* "STAL" */
+#define HANG_STALL_VERSION	1
+
+#define STALL_HIST_BUCKETS	16	/* [2^i, 2^(i+1)) ms, last open */
+#define STALL_WCHAN_MAX		128
+#define STALL_TOP_MAX		32
+#define STALL_TRACK_MAX		256
+#define STALL_HASH_BITS		7
+
+enum {
+	STALL_NONE,
+	STALL_D,
+	STALL_R,
+};
+
+struct hang_stall_hdr_t {
+	u32 magic;
+	u16 version;
+	u16 hist_buckets;
+	u32 period_ms;
+	u32 nr_wchan;
+	u32 nr_top;
+	u32 track_drop;
+	u64 samples;
+	u64 sample_ns;		/* time spent in passes */
+	u32 r_hist[STALL_HIST_BUCKETS];
+};
+
+struct hang_stall_wchan_t {
+	u64 wchan;		/* 0: table was full */
+	u64 total_ns;
+	u64 max_ns;
+	u32 count;
+	u32 hist[STALL_HIST_BUCKETS];
+};
+
+struct hang_stall_top_t {
+	u64 wchan;		/* of the longest D episode */
+	u64 d_max_ns;
+	u64 d_total_ns;		/* ended episodes only */
+	u64 r_max_ns;
+	u64 r_total_ns;
+	u32 d_count;
+	u32 r_count;
+	s32 pid;
+	s32 tgid;
+	char comm[TASK_COMM_LEN];
+};
+
+/* one candidate seen by the walk */
+struct stall_snap_t {
+	u64 key;
+	u64 since;
+	unsigned long wchan;
+	pid_t pid;
+	pid_t tgid;
+	u8 type;
+	char comm[TASK_COMM_LEN];
+};
+
+struct stall_track_t {
+	struct hlist_node node;
+	u64 since;
+	u64 last;
+	u64 key;		/* switch count (D) or last_queued (R) */
+	unsigned long wchan;
+	pid_t pid;
+	u32 gen;
+	u8 type;
+};
+
+static unsigned int stall_period_ms = 1000;
+static bool stall_ready;
+
+static DEFINE_SPINLOCK(stall_lock);
+static DEFINE_HASHTABLE(stall_hash, STALL_HASH_BITS);
+static struct stall_track_t stall_track[STALL_TRACK_MAX];
+/* only used by the work item, which never runs concurrently */
+static struct stall_snap_t stall_snap[STALL_TRACK_MAX];
+static struct hang_stall_wchan_t stall_wchan[STALL_WCHAN_MAX];
+static struct hang_stall_top_t stall_top[STALL_TOP_MAX];
+static unsigned int stall_nr_wchan;
+static unsigned int stall_nr_top;
+static u32 stall_r_hist[STALL_HIST_BUCKETS];
+static u32 stall_gen;
+static u32 stall_track_drop;
+static u64 stall_samples;
+static u64 stall_sample_ns;
+
+static void hang_stall_work_fn(struct work_struct *work);
+static DECLARE_DEFERRABLE_WORK(hang_stall_work, hang_stall_work_fn);
+
+static int stall_period_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_uint(val, kp);
+
+	if (!ret && stall_ready && stall_period_ms)
+		mod_delayed_work(system_power_efficient_wq, &hang_stall_work, 0);
+	return ret;
+}
+
+static const struct kernel_param_ops stall_period_ops = {
+	.set = stall_period_set,
+	.get = param_get_uint,
+};
+module_param_cb(stall_period_ms, &stall_period_ops, &stall_period_ms, 0644);
+
+static inline unsigned int stall_bucket(u64 ns)
+{
+	u64 ms = div_u64(ns, NSEC_PER_MSEC);
+
+	if (ms >= (1ULL << (STALL_HIST_BUCKETS - 1)))
+		return STALL_HIST_BUCKETS - 1;
+	return ms ? ilog2((u32)ms) : 0;
+}
+
+static void stall_wchan_add(unsigned long wchan, u64 dur)
+{
+	struct hang_stall_wchan_t *w = NULL;
+	unsigned int i;
+
+	for (i = 0; i < stall_nr_wchan; i++) {
+		if (stall_wchan[i].wchan == wchan) {
+			w = &stall_wchan[i];
+			break;
+		}
+	}
+	if (!w) {
+		/* the last slot collects everything once the table is full */
+		if (stall_nr_wchan < STALL_WCHAN_MAX - 1) {
+			w = &stall_wchan[stall_nr_wchan++];
+			w->wchan = wchan;
+		} else {
+			w = &stall_wchan[STALL_WCHAN_MAX - 1];
+			stall_nr_wchan = STALL_WCHAN_MAX;
+			w->wchan = 0;
+		}
+	}
+
+	w->count++;
+	w->total_ns += dur;
+	if (dur > w->max_ns)
+		w->max_ns = dur;
+	w->hist[stall_bucket(dur)]++;
+}
+
+static inline u64 stall_top_score(const struct hang_stall_top_t *t)
+{
+	return max(t->d_max_ns, t->r_max_ns);
+}
+
+static struct hang_stall_top_t *stall_top_find(pid_t pid)
+{
+	unsigned int i;
+
+	for (i = 0; i < stall_nr_top; i++)
+		if (stall_top[i].pid == pid)
+			return &stall_top[i];
+	return NULL;
+}
+
+/* called on every pass that sees an episode, with its length so far */
+static void stall_top_observe(struct stall_snap_t *c,
+			      struct stall_track_t *s, u64 dur)
+{
+	struct hang_stall_top_t *t = stall_top_find(s->pid);
+	unsigned int i, low = 0;
+
+	if (!t) {
+		if (stall_nr_top < STALL_TOP_MAX) {
+			t = &stall_top[stall_nr_top++];
+		} else {
+			for (i = 1; i < STALL_TOP_MAX; i++)
+				if (stall_top_score(&stall_top[i]) <
+				    stall_top_score(&stall_top[low]))
+					low = i;
+			if (stall_top_score(&stall_top[low]) >= dur)
+				return;
+			t = &stall_top[low];
+		}
+		memset(t, 0, sizeof(*t));
+		t->pid = s->pid;
+		t->tgid = c->tgid;
+		memcpy(t->comm, c->comm, TASK_COMM_LEN);
+	}
+
+	if (s->type == STALL_D && dur > t->d_max_ns) {
+		t->d_max_ns = dur;
+		t->wchan = s->wchan;
+	} else if (s->type == STALL_R && dur > t->r_max_ns) {
+		t->r_max_ns = dur;
+	}
+}
+
+static void stall_track_end(struct stall_track_t *s)
+{
+	struct hang_stall_top_t *t = stall_top_find(s->pid);
+	u64 dur = s->last - s->since;
+
+	if (s->type == STALL_D) {
+		stall_wchan_add(s->wchan, dur);
+		if (t) {
+			t->d_count++;
+			t->d_total_ns += dur;
+		}
+	} else {
+		stall_r_hist[stall_bucket(dur)]++;
+		if (t) {
+			t->r_count++;
+			t->r_total_ns += dur;
+		}
+	}
+
+	hash_del(&s->node);
+	s->type = STALL_NONE;
+}
+
+static struct stall_track_t *stall_track_get(pid_t pid)
+{
+	struct stall_track_t *s;
+	unsigned int i;
+
+	hash_for_each_possible(stall_hash, s, node, pid)
+		if (s->pid == pid)
+			return s;
+
+	for (i = 0; i < STALL_TRACK_MAX; i++) {
+		s = &stall_track[i];
+		if (s->type == STALL_NONE) {
+			s->pid = pid;
+			hash_add(stall_hash, &s->node, pid);
+			return s;
+		}
+	}
+
+	stall_track_drop++;
+	return NULL;
+}
+
+static void stall_track_see(struct stall_snap_t *c, u64 now)
+{
+	struct stall_track_t *s = stall_track_get(c->pid);
+
+	if (!s)
+		return;
+
+	if (s->type != STALL_NONE && (s->type != c->type || s->key != c->key)) {
+		/* the old episode ended between two passes */
+		stall_track_end(s);
+		hash_add(stall_hash, &s->node, c->pid);
+	}
+
+	if (s->type == STALL_NONE) {
+		s->type = c->type;
+		s->key = c->key;
+		s->since = min(c->since, now);
+		/* the wait channel cannot move within one D episode */
+		s->wchan = c->wchan;
+	}
+	s->last = now;
+	s->gen = stall_gen;
+
+	stall_top_observe(c, s, now - s->since);
+}
+
+/*
+ * block_start is written at dequeue only while schedstats are on, so a
+ * stale one (from before they were turned off) predates the last time
+ * the task got a CPU.
+ */
+static u64 stall_d_since(struct task_struct *p, u64 now)
+{
+#ifdef CONFIG_SCHEDSTATS
+	u64 block = p->se.statistics.block_start;
+
+	if (block && block >= p->sched_info.last_arrival)
+		return block;
+#endif
+	return now;
+}
+
+/* called under rcu_read_lock(), returns the number of candidates */
+static unsigned int stall_snapshot(u64 now, u32 *drop)
+{
+	struct task_struct *g, *p;
+	struct stall_snap_t *c;
+	unsigned int n = 0;
+	long state;
+	u64 queued;
+
+	do_each_thread(g, p) {
+		if (p == current)
+			continue;
+
+		state = READ_ONCE(p->state);
+		if ((state & TASK_UNINTERRUPTIBLE) && !(state & TASK_NOLOAD)) {
+			if (n == STALL_TRACK_MAX) {
+				(*drop)++;
+				continue;
+			}
+			c = &stall_snap[n++];
+			c->type = STALL_D;
+			c->key = p->nvcsw + p->nivcsw;
+			c->since = stall_d_since(p, now);
+			c->wchan = get_wchan(p);
+		} else if (state == TASK_RUNNING) {
+			queued = READ_ONCE(p->sched_info.last_queued);
+			if (!queued || task_curr(p))
+				continue;
+			if (n == STALL_TRACK_MAX) {
+				(*drop)++;
+				continue;
+			}
+			c = &stall_snap[n++];
+			c->type = STALL_R;
+			c->key = queued;
+			c->since = queued;
+			c->wchan = 0;
+		} else {
+			continue;
+		}
+		c->pid = p->pid;
+		c->tgid = p->tgid;
+		memcpy(c->comm, p->comm, TASK_COMM_LEN);
+	} while_each_thread(g, p);
+
+	return n;
+}
+
+static void hang_stall_sample(void)
+{
+	unsigned int i, n;
+	u32 drop = 0;
+	u64 now;
+
+	now = local_clock();
+	rcu_read_lock();
+	n = stall_snapshot(now, &drop);
+	rcu_read_unlock();
+
+	spin_lock(&stall_lock);
+	stall_gen++;
+	stall_track_drop += drop;
+	for (i = 0; i < n; i++)
+		stall_track_see(&stall_snap[i], now);
+
+	for (i = 0; i < STALL_TRACK_MAX; i++)
+		if (stall_track[i].type != STALL_NONE &&
+		    stall_track[i].gen != stall_gen)
+			stall_track_end(&stall_track[i]);
+
+	stall_samples++;
+	stall_sample_ns += local_clock() - now;
+	spin_unlock(&stall_lock);
+}
+
+static void hang_stall_work_fn(struct work_struct *work)
+{
+	unsigned int period = READ_ONCE(stall_period_ms);
+
+	if (!period)
+		return;
+
+	hang_stall_sample();
+	queue_delayed_work(system_power_efficient_wq, &hang_stall_work,
+			   msecs_to_jiffies(period));
+}
+
+static void hang_stall_reset(void)
+{
+	unsigned int i;
+
+	spin_lock(&stall_lock);
+	for (i = 0; i < STALL_TRACK_MAX; i++)
+		if (stall_track[i].type != STALL_NONE) {
+			hash_del(&stall_track[i].node);
+			stall_track[i].type = STALL_NONE;
+		}
+	memset(stall_wchan, 0, sizeof(stall_wchan));
+	memset(stall_top, 0, sizeof(stall_top));
+	memset(stall_r_hist, 0, sizeof(stall_r_hist));
+	stall_nr_wchan = 0;
+	stall_nr_top = 0;
+	stall_track_drop = 0;
+	stall_samples = 0;
+	stall_sample_ns = 0;
+	spin_unlock(&stall_lock);
+}
+
+/* printed with the last hang_detect dump */
+void hang_stall_dump(void)
+{
+	struct hang_stall_top_t *t;
+	unsigned int i;
+
+	spin_lock(&stall_lock);
+	pr_notice("[Hang_Detect] stall top, %llu passes (unit: ms)\n",
+		  stall_samples);
+	for (i = 0; i < stall_nr_top; i++) {
+		t = &stall_top[i];
+		pr_notice("[Hang_Detect] %5d:%5d %-16s D %6llu R %6llu %pS\n",
+			  t->tgid, t->pid, t->comm,
+			  div_u64(t->d_max_ns, NSEC_PER_MSEC),
+			  div_u64(t->r_max_ns, NSEC_PER_MSEC),
+			  (void *)(unsigned long)t->wchan);
+	}
+	spin_unlock(&stall_lock);
+}
+
+static int proc_hang_stall_show(struct seq_file *m, void *v)
+{
+	struct hang_stall_hdr_t hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = HANG_STALL_MAGIC;
+	hdr.version = HANG_STALL_VERSION;
+	hdr.hist_buckets = STALL_HIST_BUCKETS;
+	hdr.period_ms = READ_ONCE(stall_period_ms);
+
+	spin_lock(&stall_lock);
+	hdr.nr_wchan = stall_nr_wchan;
+	hdr.nr_top = stall_nr_top;
+	hdr.track_drop = stall_track_drop;
+	hdr.samples = stall_samples;
+	hdr.sample_ns = stall_sample_ns;
+	memcpy(hdr.r_hist, stall_r_hist, sizeof(hdr.r_hist));
+
+	seq_write(m, &hdr, sizeof(hdr));
+	seq_write(m, stall_wchan, stall_nr_wchan * sizeof(stall_wchan[0]));
+	seq_write(m, stall_top, stall_nr_top * sizeof(stall_top[0]));
+	spin_unlock(&stall_lock);
+
+	return 0;
+}
+
+static int proc_hang_stall_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, proc_hang_stall_show, NULL,
+				sizeof(struct hang_stall_hdr_t) +
+				sizeof(stall_wchan) + sizeof(stall_top));
+}
+
+static const struct file_operations proc_hang_stall_fops = {
+	.open = proc_hang_stall_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void stall_hist_print(struct seq_file *m, const u32 *hist)
+{
+	unsigned int i;
+
+	for (i = 0; i < STALL_HIST_BUCKETS; i++)
+		seq_printf(m, " %u", hist[i]);
+	seq_puts(m, "\n");
+}
+
+static int proc_hang_stall_stat_show(struct seq_file *m, void *v)
+{
+	struct hang_stall_wchan_t *w;
+	struct hang_stall_top_t *t;
+	unsigned int i;
+
+	spin_lock(&stall_lock);
+	seq_printf(m, "period %ums, %llu passes, %llu us sampling, %u dropped\n",
+		   READ_ONCE(stall_period_ms), stall_samples,
+		   div_u64(stall_sample_ns, NSEC_PER_USEC), stall_track_drop);
+	seq_puts(m, "histograms: log2(ms) buckets from <2ms\n");
+	seq_puts(m, "runnable:");
+	stall_hist_print(m, stall_r_hist);
+
+	seq_printf(m, "\n%8s %10s %8s %-40s hist\n",
+		   "count", "total_ms", "max_ms", "wchan");
+	for (i = 0; i < stall_nr_wchan; i++) {
+		w = &stall_wchan[i];
+		seq_printf(m, "%8u %10llu %8llu %-40pS", w->count,
+			   div_u64(w->total_ns, NSEC_PER_MSEC),
+			   div_u64(w->max_ns, NSEC_PER_MSEC),
+			   (void *)(unsigned long)w->wchan);
+		stall_hist_print(m, w->hist);
+	}
+
+	seq_printf(m, "\n%5s %5s %-16s %8s %10s %6s %8s %10s %6s %s\n",
+		   "tgid", "pid", "comm", "D_max", "D_total", "D_cnt",
+		   "R_max", "R_total", "R_cnt", "wchan");
+	for (i = 0; i < stall_nr_top; i++) {
+		t = &stall_top[i];
+		seq_printf(m, "%5d %5d %-16s %8llu %10llu %6u %8llu %10llu %6u %pS\n",
+			   t->tgid, t->pid, t->comm,
+			   div_u64(t->d_max_ns, NSEC_PER_MSEC),
+			   div_u64(t->d_total_ns, NSEC_PER_MSEC), t->d_count,
+			   div_u64(t->r_max_ns, NSEC_PER_MSEC),
+			   div_u64(t->r_total_ns, NSEC_PER_MSEC), t->r_count,
+			   (void *)(unsigned long)t->wchan);
+	}
+	spin_unlock(&stall_lock);
+
+	return 0;
+}
+
+static int proc_hang_stall_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_hang_stall_stat_show, NULL);
+}
+
+static ssize_t proc_hang_stall_stat_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *pos)
+{
+	char val;
+
+	if (!count)
+		return 0;
+	if (get_user(val, buf))
+		return -EFAULT;
+	if (val != '0')
+		return -EINVAL;
+
+	hang_stall_reset();
+	return count;
+}
+
+static const struct file_operations proc_hang_stall_stat_fops = {
+	.open = proc_hang_stall_stat_open,
+	.read = seq_read,
+	.write = proc_hang_stall_stat_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void hang_stall_proc_init(struct proc_dir_entry *aed_proc_dir)
+{
+	AED_PROC_ENTRY(hang-stall, hang_stall, 0400);
+	AED_PROC_ENTRY(hang-stall-stat, hang_stall_stat, 0600);
+}
+
+void hang_stall_proc_done(struct proc_dir_entry *aed_proc_dir)
+{
+	remove_proc_entry("hang-stall", aed_proc_dir);
+	remove_proc_entry("hang-stall-stat", aed_proc_dir);
+}
+
+int hang_stall_init(void)
+{
+	stall_ready = true;
+	if (stall_period_ms)
+		queue_delayed_work(system_power_efficient_wq, &hang_stall_work,
+				   msecs_to_jiffies(stall_period_ms));
+	return 0;
+}
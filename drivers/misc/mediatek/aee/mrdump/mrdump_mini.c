@@ -36,6 +36,7 @@
 #include <linux/of_reserved_mem.h>
 #include <linux/uaccess.h>
 #include <linux/highmem.h>
+#include <linux/lz4.h>
 #include "../../../../kernel/sched/sched.h"
 #include "mrdump_mini.h"
 #include "mrdump_private.h"
@@ -69,6 +70,10 @@ static struct mrdump_mini_elf_header *mrdump_mini_ehdr;
 
 static bool dump_all_cpus;
 
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+static bool compress = true;
+#endif
+
 __weak void get_android_log_buffer(unsigned long *addr, unsigned long *size,
 		unsigned long *start, int type)
 {
@@ -886,6 +891,117 @@ static void mrdump_mini_add_loads(void)
 	}
 }
 
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+/*
+ * Nothing can be allocated at panic time: the LZ4 work memory and a
+ * staging buffer for one compressed block are set up at init. The staging
+ * buffer is written out in whole 512 byte units as the raw path did.
+ */
+static void *mini_lz4_wrkmem;
+static char *mini_lz4_stage;
+static size_t mini_lz4_stage_size;
+
+struct mini_lz4_stream {
+	mrdump_write write;
+	loff_t base;	/* sd_offset of the dump */
+	loff_t pos;	/* dump offset of mini_lz4_stage[0] */
+	size_t len;	/* bytes pending in mini_lz4_stage */
+};
+
+static void mini_lz4_init(void)
+{
+	mini_lz4_stage_size = SZ_512 + sizeof(struct mrdump_mini_lz4_seg) +
+		sizeof(struct mrdump_mini_lz4_blk) +
+		lz4_compressbound(MRDUMP_MINI_LZ4_BLOCK);
+	mini_lz4_wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	mini_lz4_stage = kmalloc(mini_lz4_stage_size, GFP_KERNEL);
+	if (!mini_lz4_wrkmem || !mini_lz4_stage) {
+		LOGE("mrdump: lz4 buffer fail, dump uncompressed\n");
+		kfree(mini_lz4_wrkmem);
+		kfree(mini_lz4_stage);
+		mini_lz4_wrkmem = NULL;
+		mini_lz4_stage = NULL;
+	}
+}
+
+/* write whole 512 byte units, zero padding the tail when final */
+static void mini_lz4_flush(struct mini_lz4_stream *s, bool final)
+{
+	size_t out;
+	int errno;
+
+	if (final)
+		out = ALIGN(s->len, SZ_512);
+	else
+		out = round_down(s->len, SZ_512);
+	if (!out)
+		return;
+
+	if (out > s->len)
+		memset(mini_lz4_stage + s->len, 0, out - s->len);
+	errno = s->write(mini_lz4_stage, s->base + s->pos, out, 1);
+	if (IS_ERR(ERR_PTR(errno)))
+		LOGD("mirdump: write fail");
+
+	s->pos += out;
+	s->len = (out > s->len) ? 0 : s->len - out;
+	if (s->len)
+		memmove(mini_lz4_stage, mini_lz4_stage + out, s->len);
+}
+
+/* worst case on disk: every block stored, plus headers and padding */
+static size_t mini_lz4_seg_bound(size_t raw)
+{
+	return ALIGN(sizeof(struct mrdump_mini_lz4_seg) +
+		     DIV_ROUND_UP(raw, MRDUMP_MINI_LZ4_BLOCK) *
+		     sizeof(struct mrdump_mini_lz4_blk) + raw, SZ_512);
+}
+
+static void mini_lz4_dump_seg(struct mini_lz4_stream *s,
+			      struct elf_phdr *phdr)
+{
+	const unsigned char *src =
+		(const unsigned char *)(unsigned long)phdr->p_vaddr;
+	struct mrdump_mini_lz4_seg seg;
+	struct mrdump_mini_lz4_blk blk;
+	size_t left = phdr->p_filesz;
+	size_t comp;
+	unsigned char *out;
+
+	seg.magic = MRDUMP_MINI_LZ4_MAGIC;
+	seg.raw_size = phdr->p_filesz;
+	seg.block_size = MRDUMP_MINI_LZ4_BLOCK;
+	seg.reserved = 0;
+	phdr->p_offset = s->pos;
+	memcpy(mini_lz4_stage, &seg, sizeof(seg));
+	s->len = sizeof(seg);
+
+	while (left) {
+		blk.raw_len = min_t(size_t, left, MRDUMP_MINI_LZ4_BLOCK);
+		if (s->len + sizeof(blk) + lz4_compressbound(blk.raw_len) >
+		    mini_lz4_stage_size)
+			mini_lz4_flush(s, false);
+
+		out = (unsigned char *)mini_lz4_stage + s->len + sizeof(blk);
+		comp = 0;
+		if (lz4_compress(src, blk.raw_len, out, &comp,
+				 mini_lz4_wrkmem) || comp >= blk.raw_len) {
+			memcpy(out, src, blk.raw_len);
+			comp = blk.raw_len;
+		}
+		blk.comp_len = comp;
+		memcpy(mini_lz4_stage + s->len, &blk, sizeof(blk));
+		s->len += sizeof(blk) + comp;
+
+		src += blk.raw_len;
+		left -= blk.raw_len;
+	}
+
+	mini_lz4_flush(s, true);
+	phdr->p_flags |= MRDUMP_MINI_PF_LZ4;
+}
+#endif
+
 static void mrdump_mini_dump_loads(loff_t offset, mrdump_write write)
 {
 	int errno;
@@ -893,15 +1009,34 @@ static void mrdump_mini_dump_loads(loff_t offset, mrdump_write write)
 	int i;
 	struct elf_phdr *phdr;
 	loff_t pos = MRDUMP_MINI_HEADER_SIZE;
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+	struct mini_lz4_stream s = { .write = write, .base = offset };
+#endif
 
 	for (i = 0; i < MRDUMP_MINI_NR_SECTION; i++) {
 		phdr = &mrdump_mini_ehdr->phdrs[i];
 		if (phdr->p_type == PT_NULL)
 			break;
 		if (phdr->p_type == PT_LOAD) {
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+			phdr->p_flags &= ~MRDUMP_MINI_PF_LZ4;
+			if (compress && mini_lz4_stage &&
+			    pos + mini_lz4_seg_bound(phdr->p_filesz) <=
+			    MRDUMP_MINI_BUF_SIZE) {
+				s.pos = pos;
+				mini_lz4_dump_seg(&s, phdr);
+				pos = s.pos;
+				continue;
+			}
+#endif
 			/* mrdump_mini_dump_phdr(phdr, &pos); */
 			start = phdr->p_vaddr;
 			size = ALIGN(phdr->p_filesz, SZ_512);
+			if (pos + size > MRDUMP_MINI_BUF_SIZE) {
+				LOGE("mrdump: no room for load %d\n", i);
+				phdr->p_filesz = 0;
+				continue;
+			}
 			phdr->p_offset = pos;
 			errno = write((void *)start, pos + offset, size, 1);
 			pos += size;
@@ -996,6 +1131,9 @@ int mrdump_mini_init(void)
 	}
 
 	mrdump_mini_elf_header_init();
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+	mini_lz4_init();
+#endif
 
 	fill_psinfo(&mrdump_mini_ehdr->psinfo.data);
 	fill_note_S(&mrdump_mini_ehdr->psinfo.note, "vmlinux", NT_PRPSINFO,
@@ -1076,3 +1214,6 @@ RESERVEDMEM_OF_DECLARE(reserve_memory_minirdump, "mediatek,minirdump",
 
 /* 0644: S_IRUGO | S_IWUSR */
 module_param(dump_all_cpus, bool, 0644);
+#ifdef CONFIG_MTK_AEE_MRDUMP_MINI_LZ4
+module_param(compress, bool, 0644);
+#endif
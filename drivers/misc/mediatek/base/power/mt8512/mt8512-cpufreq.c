@@ -16,9 +16,11 @@
 #include <linux/regulator/consumer.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
+#include <trace/events/power.h>
 #include "mtk_power_throttle.h"
 #include "mtk_static_power.h"
 #include "mt8512-cpufreq.h"
+#include "mtk_svs.h"
 #if defined(CONFIG_MTK_UNIFY_POWER)
 #include "mtk_upower.h"
 #endif
@@ -28,6 +30,23 @@
 #define MAX_VOLT_LIMIT		(1025000)
 #define MIN_VOLT_LIMIT		(800000)
 #define VOLT_TOL		(6250)
+#define MAX_VOLT_STEPS		(8)
+
+/*
+ * One step of a Vsram/Vproc tracking sequence. When scaling up, Vsram is
+ * programmed before Vproc; when scaling down, Vproc goes first.
+ */
+struct mtk_volt_step {
+	int vsram;
+	int vproc;
+	bool vsram_exact;
+};
+
+struct mtk_volt_seq {
+	int nr_steps;
+	bool up;
+	struct mtk_volt_step step[MAX_VOLT_STEPS];
+};
 
 /*
  * The struct mtk_cpu_dvfs_info holds necessary information for doing CPU DVFS
@@ -56,6 +75,16 @@ struct mtk_cpu_dvfs_info {
 	int opp_cpu;
 	int max_volt_uv;
 	unsigned long opp_freq;
+
+	/* last programmed voltages, valid while volt_cached is set */
+	bool volt_cached;
+	int cur_vproc;
+	int cur_vsram;
+
+	/* per-OPP Vproc and precomputed nr_opp x nr_opp step sequences */
+	int nr_opp;
+	int *opp_volt;
+	struct mtk_volt_seq *volt_seq_tbl;
 };
 
 static LIST_HEAD(dvfs_info_list);
@@ -88,18 +117,23 @@ static struct mtk_cpu_dvfs_info *mtk_cpu_dvfs_info_lookup(int cpu)
 	return NULL;
 }
 
-static int mtk_cpufreq_voltage_tracking(struct mtk_cpu_dvfs_info *info,
-					int new_vproc)
+/*
+ * Build the Vsram/Vproc step sequence needed to move from (vproc, vsram) to
+ * new_vproc while honouring the 100mV < Vsram - Vproc < 200mV constraint.
+ * This is a pure function of the start and end voltages, so the sequences
+ * between any two OPPs can be computed once and replayed at transition time
+ * without reading the regulators back.
+ */
+static int mtk_cpufreq_build_volt_seq(struct mtk_volt_seq *seq,
+				      int old_vproc, int old_vsram,
+				      int new_vproc)
 {
-	struct regulator *proc_reg = info->proc_reg;
-	struct regulator *sram_reg = info->sram_reg;
-	int old_vproc, old_vsram, new_vsram, vsram, vproc, ret;
+	struct mtk_volt_step *st;
+	int new_vsram, vsram, vproc;
+
+	seq->nr_steps = 0;
+	seq->up = old_vproc < new_vproc;
 
-	old_vproc = regulator_get_voltage(proc_reg);
-	if (old_vproc < 0) {
-		pr_err("%s: invalid Vproc value: %d\n", __func__, old_vproc);
-		return old_vproc;
-	}
 	/* Vsram should not exceed the maximum allowed voltage of SoC. */
 	new_vsram = min(new_vproc + MIN_VOLT_SHIFT, MAX_VOLT_LIMIT);
 	/* Vsram should exceed the minimum allowed voltage of SoC */
@@ -113,69 +147,37 @@ static int mtk_cpufreq_voltage_tracking(struct mtk_cpu_dvfs_info *info,
 		 * Keep doing it until Vsram and Vproc hit target voltages.
 		 */
 		do {
-			old_vsram = regulator_get_voltage(sram_reg);
-			if (old_vsram < 0) {
-				pr_err("%s: invalid Vsram value: %d\n",
-				       __func__, old_vsram);
-				return old_vsram;
-			}
-			old_vproc = regulator_get_voltage(proc_reg);
-			if (old_vproc < 0) {
-				pr_err("%s: invalid Vproc value: %d\n",
-				       __func__, old_vproc);
-				return old_vproc;
-			}
+			if (seq->nr_steps >= MAX_VOLT_STEPS)
+				return -E2BIG;
+			st = &seq->step[seq->nr_steps++];
 
 			vsram = min(new_vsram, old_vproc + MAX_VOLT_SHIFT);
 
 			if (vsram + VOLT_TOL >= MAX_VOLT_LIMIT) {
-				vsram = MAX_VOLT_LIMIT;
-
 				/*
 				 * If the target Vsram hits the maximum voltage,
 				 * try to set the exact voltage value first.
 				 */
-				ret = regulator_set_voltage(sram_reg, vsram,
-							    vsram);
-				if (ret)
-					ret = regulator_set_voltage(sram_reg,
-							vsram - VOLT_TOL,
-							vsram);
-
+				vsram = MAX_VOLT_LIMIT;
+				st->vsram_exact = true;
 				vproc = new_vproc;
-
 			} else if (vsram <= MIN_VOLT_LIMIT) {
-				vsram = MIN_VOLT_LIMIT;
-
 				/*
 				 * If the target Vsram hits the minimum voltage,
 				 * try to set the exact voltage value first.
 				 */
-				ret = regulator_set_voltage(sram_reg, vsram,
-							    vsram);
-				if (ret)
-					ret = regulator_set_voltage(sram_reg,
-							vsram - VOLT_TOL,
-							vsram);
-
+				vsram = MIN_VOLT_LIMIT;
+				st->vsram_exact = true;
 				vproc = new_vproc;
-
 			} else {
-				ret = regulator_set_voltage(sram_reg, vsram,
-							    vsram + VOLT_TOL);
-
+				st->vsram_exact = false;
 				vproc = vsram - MIN_VOLT_SHIFT;
 			}
-			if (ret)
-				return ret;
 
-			ret = regulator_set_voltage(proc_reg, vproc,
-						    vproc + VOLT_TOL);
-			if (ret) {
-				regulator_set_voltage(sram_reg, old_vsram,
-						      old_vsram);
-				return ret;
-			}
+			st->vsram = vsram;
+			st->vproc = vproc;
+			old_vproc = vproc;
+			old_vsram = vsram;
 		} while (vproc < new_vproc || vsram < new_vsram);
 	} else if (old_vproc > new_vproc) {
 		/*
@@ -185,24 +187,11 @@ static int mtk_cpufreq_voltage_tracking(struct mtk_cpu_dvfs_info *info,
 		 * Keep doing it until Vsram and Vproc hit target voltages.
 		 */
 		do {
-			old_vproc = regulator_get_voltage(proc_reg);
-			if (old_vproc < 0) {
-				pr_err("%s: invalid Vproc value: %d\n",
-				       __func__, old_vproc);
-				return old_vproc;
-			}
-			old_vsram = regulator_get_voltage(sram_reg);
-			if (old_vsram < 0) {
-				pr_err("%s: invalid Vsram value: %d\n",
-				       __func__, old_vsram);
-				return old_vsram;
-			}
+			if (seq->nr_steps >= MAX_VOLT_STEPS)
+				return -E2BIG;
+			st = &seq->step[seq->nr_steps++];
 
 			vproc = max(new_vproc, old_vsram - MAX_VOLT_SHIFT);
-			ret = regulator_set_voltage(proc_reg, vproc,
-						    vproc + VOLT_TOL);
-			if (ret)
-				return ret;
 
 			if (vproc == new_vproc)
 				vsram = new_vsram;
@@ -210,42 +199,221 @@ static int mtk_cpufreq_voltage_tracking(struct mtk_cpu_dvfs_info *info,
 				vsram = max(new_vsram, vproc + MIN_VOLT_SHIFT);
 
 			if (vsram + VOLT_TOL >= MAX_VOLT_LIMIT) {
-				vsram = MAX_VOLT_LIMIT;
-
 				/*
 				 * If the target Vsram hits the maximum voltage,
 				 * try to set the exact voltage value first.
 				 */
-				ret = regulator_set_voltage(sram_reg, vsram,
-							    vsram);
-				if (ret)
-					ret = regulator_set_voltage(sram_reg,
-							vsram - VOLT_TOL,
-							vsram);
+				vsram = MAX_VOLT_LIMIT;
+				st->vsram_exact = true;
 			} else {
-				ret = regulator_set_voltage(sram_reg, vsram,
-							    vsram + VOLT_TOL);
+				st->vsram_exact = false;
+			}
+
+			st->vsram = vsram;
+			st->vproc = vproc;
+			old_vproc = vproc;
+			old_vsram = vsram;
+		} while (vproc > new_vproc + VOLT_TOL ||
+			 vsram > new_vsram + VOLT_TOL);
+	}
+
+	return 0;
+}
+
+/* Vsram level the tracking sequence settles at for a given Vproc. */
+static int mtk_cpufreq_steady_vsram(int vproc)
+{
+	return clamp(vproc + MIN_VOLT_SHIFT, MIN_VOLT_LIMIT, MAX_VOLT_LIMIT);
+}
+
+/* Re-read the regulators, e.g. at init or after a failed transition. */
+static int mtk_cpufreq_sync_volt(struct mtk_cpu_dvfs_info *info)
+{
+	int vproc, vsram = 0;
+
+	vproc = regulator_get_voltage(info->proc_reg);
+	if (vproc < 0) {
+		pr_err("%s: invalid Vproc value: %d\n", __func__, vproc);
+		info->volt_cached = false;
+		return vproc;
+	}
+
+	if (info->need_voltage_tracking) {
+		vsram = regulator_get_voltage(info->sram_reg);
+		if (vsram < 0) {
+			pr_err("%s: invalid Vsram value: %d\n",
+			       __func__, vsram);
+			info->volt_cached = false;
+			return vsram;
+		}
+	}
+
+	info->cur_vproc = vproc;
+	info->cur_vsram = vsram;
+	info->volt_cached = true;
+
+	return 0;
+}
+
+static int mtk_cpufreq_set_vsram(struct mtk_cpu_dvfs_info *info,
+				 const struct mtk_volt_step *st)
+{
+	int ret;
+
+	if (!st->vsram_exact)
+		return regulator_set_voltage(info->sram_reg, st->vsram,
+					     st->vsram + VOLT_TOL);
+
+	ret = regulator_set_voltage(info->sram_reg, st->vsram, st->vsram);
+	if (ret)
+		ret = regulator_set_voltage(info->sram_reg,
+					    st->vsram - VOLT_TOL, st->vsram);
+
+	return ret;
+}
+
+static int mtk_cpufreq_apply_volt_seq(struct mtk_cpu_dvfs_info *info,
+				      const struct mtk_volt_seq *seq)
+{
+	const struct mtk_volt_step *st;
+	int i, ret;
+
+	for (i = 0; i < seq->nr_steps; i++) {
+		st = &seq->step[i];
+
+		if (seq->up) {
+			ret = mtk_cpufreq_set_vsram(info, st);
+			if (ret)
+				return ret;
+
+			ret = regulator_set_voltage(info->proc_reg, st->vproc,
+						    st->vproc + VOLT_TOL);
+			if (ret) {
+				regulator_set_voltage(info->sram_reg,
+						      info->cur_vsram,
+						      info->cur_vsram);
+				return ret;
 			}
+		} else {
+			ret = regulator_set_voltage(info->proc_reg, st->vproc,
+						    st->vproc + VOLT_TOL);
+			if (ret)
+				return ret;
 
+			ret = mtk_cpufreq_set_vsram(info, st);
 			if (ret) {
-				regulator_set_voltage(proc_reg, old_vproc,
-						      old_vproc);
+				regulator_set_voltage(info->proc_reg,
+						      info->cur_vproc,
+						      info->cur_vproc);
 				return ret;
 			}
-		} while (vproc > new_vproc + VOLT_TOL ||
-			 vsram > new_vsram + VOLT_TOL);
+		}
+
+		info->cur_vproc = st->vproc;
+		info->cur_vsram = st->vsram;
 	}
 
 	return 0;
 }
 
+static int mtk_cpufreq_find_opp_by_volt(struct mtk_cpu_dvfs_info *info,
+					int vproc)
+{
+	int i;
+
+	for (i = 0; i < info->nr_opp; i++)
+		if (info->opp_volt[i] == vproc)
+			return i;
+
+	return -1;
+}
+
+/*
+ * Precompute the tracking sequence for every OPP pair. Must be called with
+ * info->lock held once the OPP voltages are known, and again whenever one of
+ * them is adjusted (e.g. by SVS).
+ */
+static void mtk_cpufreq_build_volt_seq_tbl(struct mtk_cpu_dvfs_info *info)
+{
+	struct mtk_volt_seq *seq;
+	int from, to, vproc;
+
+	if (!info->volt_seq_tbl)
+		return;
+
+	for (from = 0; from < info->nr_opp; from++) {
+		vproc = info->opp_volt[from];
+
+		for (to = 0; to < info->nr_opp; to++) {
+			seq = &info->volt_seq_tbl[from * info->nr_opp + to];
+			if (mtk_cpufreq_build_volt_seq(seq, vproc,
+					mtk_cpufreq_steady_vsram(vproc),
+					info->opp_volt[to]))
+				seq->nr_steps = -1;
+		}
+	}
+}
+
+static int mtk_cpufreq_voltage_tracking(struct mtk_cpu_dvfs_info *info,
+					int new_vproc)
+{
+	struct mtk_volt_seq seq;
+	const struct mtk_volt_seq *pseq = NULL;
+	int from, to, ret;
+
+	/*
+	 * Replay a precomputed sequence when both ends are known OPP levels,
+	 * otherwise derive one from the cached voltages.
+	 */
+	if (info->cur_vsram == mtk_cpufreq_steady_vsram(info->cur_vproc)) {
+		from = mtk_cpufreq_find_opp_by_volt(info, info->cur_vproc);
+		to = mtk_cpufreq_find_opp_by_volt(info, new_vproc);
+		if (from >= 0 && to >= 0 && info->volt_seq_tbl)
+			pseq = &info->volt_seq_tbl[from * info->nr_opp + to];
+	}
+
+	if (!pseq || pseq->nr_steps < 0) {
+		ret = mtk_cpufreq_build_volt_seq(&seq, info->cur_vproc,
+						 info->cur_vsram, new_vproc);
+		if (ret) {
+			pr_err("%s: no Vsram/Vproc sequence %d -> %d\n",
+			       __func__, info->cur_vproc, new_vproc);
+			return ret;
+		}
+		pseq = &seq;
+	}
+
+	return mtk_cpufreq_apply_volt_seq(info, pseq);
+}
+
 static int mtk_cpufreq_set_voltage(struct mtk_cpu_dvfs_info *info, int vproc)
 {
-	if (info->need_voltage_tracking)
-		return mtk_cpufreq_voltage_tracking(info, vproc);
-	else
-		return regulator_set_voltage(info->proc_reg, vproc,
-					     vproc + VOLT_TOL);
+	int ret;
+
+	if (!info->volt_cached) {
+		ret = mtk_cpufreq_sync_volt(info);
+		if (ret)
+			return ret;
+	}
+
+	/* Frequency-only transition: no regulator traffic at all. */
+	if (info->cur_vproc == vproc)
+		return 0;
+
+	if (info->need_voltage_tracking) {
+		ret = mtk_cpufreq_voltage_tracking(info, vproc);
+	} else {
+		ret = regulator_set_voltage(info->proc_reg, vproc,
+					    vproc + VOLT_TOL);
+		if (!ret)
+			info->cur_vproc = vproc;
+	}
+
+	/* The regulators may be anywhere now, re-read them next time. */
+	if (ret)
+		info->volt_cached = false;
+
+	return ret;
 }
 
 static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
@@ -259,37 +427,47 @@ static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
 	struct dev_pm_opp *opp;
 	long freq_hz, old_freq_hz;
 	int vproc, old_vproc, inter_vproc, target_vproc, ret;
+	ktime_t t_start, t_volt_up, t_clk;
 
 	struct mtk_cpu_dvfs *p = id_to_cpu_dvfs(MT_CPU_DVFS_L);
 
 	inter_vproc = info->intermediate_voltage;
 
-	old_freq_hz = clk_get_rate(cpu_clk);
-	old_vproc = regulator_get_voltage(info->proc_reg);
-	if (old_vproc < 0) {
-		pr_err("%s: invalid Vproc value: %d\n", __func__, old_vproc);
-		return old_vproc;
-	}
-
+	old_freq_hz = info->opp_freq;
 	freq_hz = freq_table[index].frequency * 1000;
 
-	rcu_read_lock();
-	opp = dev_pm_opp_find_freq_ceil(cpu_dev, &freq_hz);
-	if (IS_ERR(opp)) {
-		rcu_read_unlock();
-		pr_err("cpu%d: failed to find OPP for %ld\n",
-		       policy->cpu, freq_hz);
-		return PTR_ERR(opp);
+	mutex_lock(&info->lock);
+
+	if (!info->volt_cached) {
+		ret = mtk_cpufreq_sync_volt(info);
+		if (ret) {
+			mutex_unlock(&info->lock);
+			return ret;
+		}
 	}
-	vproc = dev_pm_opp_get_voltage(opp);
-	rcu_read_unlock();
+	old_vproc = info->cur_vproc;
 
-	mutex_lock(&info->lock);
+	if (index < info->nr_opp) {
+		vproc = info->opp_volt[index];
+	} else {
+		rcu_read_lock();
+		opp = dev_pm_opp_find_freq_ceil(cpu_dev, &freq_hz);
+		if (IS_ERR(opp)) {
+			rcu_read_unlock();
+			mutex_unlock(&info->lock);
+			pr_err("cpu%d: failed to find OPP for %ld\n",
+			       policy->cpu, freq_hz);
+			return PTR_ERR(opp);
+		}
+		vproc = dev_pm_opp_get_voltage(opp);
+		rcu_read_unlock();
+	}
 
 	/*
 	 * If the new voltage or the intermediate voltage is higher than the
 	 * current voltage, scale up voltage first.
 	 */
+	t_start = ktime_get();
 	target_vproc = (inter_vproc > vproc) ? inter_vproc : vproc;
 	if (old_vproc < target_vproc) {
 		ret = mtk_cpufreq_set_voltage(info, target_vproc);
@@ -302,6 +480,8 @@ static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
 		}
 	}
 
+	t_volt_up = ktime_get();
+
 	/* Reparent the CPU clock to intermediate clock. */
 	ret = clk_prepare_enable(info->inter_clk);
 	if (ret) {
@@ -340,6 +520,8 @@ static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
 		goto out_free_inter_clk;
 	}
 
+	t_clk = ktime_get();
+
 	/*
 	 * If the new voltage is lower than the intermediate voltage or the
 	 * original voltage, scale down to the new voltage.
@@ -356,6 +538,12 @@ static int mtk_cpufreq_set_target(struct cpufreq_policy *policy,
 		}
 	}
 
+	trace_cpu_frequency_transition(policy->cpu, old_freq_hz / 1000,
+		freq_hz / 1000,
+		ktime_to_ns(ktime_sub(t_volt_up, t_start)),
+		ktime_to_ns(ktime_sub(t_clk, t_volt_up)),
+		ktime_to_ns(ktime_sub(ktime_get(), t_clk)));
+
 	info->opp_freq = freq_hz;
 	p->idx_opp_tbl = index;
 
@@ -370,6 +558,36 @@ out_free_inter_clk:
 	return ret;
 }
 
+static void mtk_cpufreq_update_opp_volt(struct mtk_cpu_dvfs_info *info,
+					unsigned long freq, unsigned long volt)
+{
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *pos;
+	int idx;
+
+	if (!info->opp_volt)
+		return;
+
+	policy = cpufreq_cpu_get_raw(info->opp_cpu);
+	if (!policy || !policy->freq_table)
+		return;
+
+	cpufreq_for_each_valid_entry(pos, policy->freq_table) {
+		idx = pos - policy->freq_table;
+		if (idx >= info->nr_opp)
+			break;
+		if ((unsigned long)pos->frequency * 1000 != freq)
+			continue;
+		if (info->opp_volt[idx] != volt) {
+			info->opp_volt[idx] = volt;
+			mtk_cpufreq_build_volt_seq_tbl(info);
+			dev_dbg(info->cpu_dev, "opp %lu: %lu uV, svs margin %d uV\n",
+				freq, volt, mtk_svs_get_cpu_margin(freq));
+		}
+		break;
+	}
+}
+
 static int mtk_cpufreq_opp_notifier(struct notifier_block *nb,
 unsigned long event, void *data)
 {
@@ -386,11 +604,13 @@ unsigned long event, void *data)
 		freq = dev_pm_opp_get_freq(opp);
 		rcu_read_unlock();
 
+		rcu_read_lock();
+		volt = dev_pm_opp_get_voltage(opp);
+		rcu_read_unlock();
+
 		mutex_lock(&info->lock);
+		mtk_cpufreq_update_opp_volt(info, freq, volt);
 		if (info->opp_freq == freq) {
-			rcu_read_lock();
-			volt = dev_pm_opp_get_voltage(opp);
-			rcu_read_unlock();
 			ret = mtk_cpufreq_set_voltage(info, volt);
 			if (ret)
 				dev_err(info->cpu_dev,
@@ -609,6 +829,9 @@ static int mtk_cpu_dvfs_info_init(struct mtk_cpu_dvfs_info *info, int cpu)
 	 */
 	info->need_voltage_tracking = !IS_ERR(sram_reg);
 
+	/* Seed the voltage cache; set_target re-reads it if this fails. */
+	mtk_cpufreq_sync_volt(info);
+
 	clk_disable_unprepare(inter_clk);
 
 	return 0;
@@ -688,6 +911,32 @@ int __attribute__ ((weak)) setup_power_table_tk(void)
 	return 0;
 }
 
+static int mtk_cpufreq_init_volt_seq_tbl(struct mtk_cpu_dvfs_info *info,
+					 int nr_opp)
+{
+	int i;
+
+	info->opp_volt = kcalloc(nr_opp, sizeof(*info->opp_volt), GFP_KERNEL);
+	if (!info->opp_volt)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_opp; i++)
+		info->opp_volt[i] = opp_tbl_default[i].cpufreq_volt;
+
+	/* The sequence table is only an optimisation, live without it. */
+	if (info->need_voltage_tracking)
+		info->volt_seq_tbl = kcalloc(nr_opp * nr_opp,
+					     sizeof(*info->volt_seq_tbl),
+					     GFP_KERNEL);
+
+	mutex_lock(&info->lock);
+	info->nr_opp = nr_opp;
+	mtk_cpufreq_build_volt_seq_tbl(info);
+	mutex_unlock(&info->lock);
+
+	return 0;
+}
+
 static int mtk_cpufreq_init(struct cpufreq_policy *policy)
 {
 	struct mtk_cpu_dvfs_info *info;
@@ -745,6 +994,10 @@ static int mtk_cpufreq_init(struct cpufreq_policy *policy)
 	p->opp_tbl = opp_tbl_default;
 	p->nr_opp_tbl = dev_pm_opp_get_opp_count(info->cpu_dev);
 
+	ret = mtk_cpufreq_init_volt_seq_tbl(info, opp_idx);
+	if (ret)
+		goto out_free_cpufreq_table;
+
 #if defined(CONFIG_MTK_UNIFY_POWER)
 	upower_get_tbl_ref();
 #endif
@@ -767,6 +1020,14 @@ static int mtk_cpufreq_exit(struct cpufreq_policy *policy)
 {
 	struct mtk_cpu_dvfs_info *info = policy->driver_data;
 
+	mutex_lock(&info->lock);
+	kfree(info->volt_seq_tbl);
+	kfree(info->opp_volt);
+	info->volt_seq_tbl = NULL;
+	info->opp_volt = NULL;
+	info->nr_opp = 0;
+	mutex_unlock(&info->lock);
+
 	cpufreq_cooling_unregister(info->cdev);
 	dev_pm_opp_free_cpufreq_table(info->cpu_dev, &policy->freq_table);
 
@@ -11,6 +11,8 @@
  * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
  */
 
+#include <linux/cpu_pm.h>
+#include <linux/cpuidle.h>
 #include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/kobject.h>
@@ -18,13 +20,17 @@
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/platform_device.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
 #include <linux/syscore_ops.h>
 #include <linux/sysfs.h>
 #include <linux/uaccess.h>
 #include <mt-plat/mtk_secure_api.h>
+#include <mt-plat/mtk_wake_acct.h>
 #include <mt-plat/upmu_common.h>
 #include <mtk_clkbuf_ctl.h>
+#include <trace/events/power.h>
 #include "mtk_sloa_fs.h"
 
 static void __iomem *scpsys_base;	/* 0x10006000 */
@@ -1713,6 +1719,202 @@ int sloa_26m_on(bool on)
 EXPORT_SYMBOL(sloa_26m_on);
 
 
+/*
+ * Idle residency statistics and deep idle predictor.
+ *
+ * A "system idle" window starts when the last online CPU enters a CPU PM
+ * (power-down) idle state and ends when the first one leaves it; only then
+ * can SPM run its dpidle/SODI flow, and it only does when every CPU went
+ * to the deepest cpuidle state. Such a window is attributed to the SPM
+ * wake source latched in r12 and accounted in a per-source residency
+ * histogram; other windows leave r12 untouched and are only counted.
+ * Like the menu governor, a decaying average of the observed residency
+ * per wake source predicts the next one; when the source that just woke
+ * us is expected to come back before the deepest cpuidle state breaks
+ * even, that state is disabled for a short hold-off period.
+ */
+#define IDLE_HIST_BUCKETS	10	/* log2 buckets, first one < 64us */
+#define IDLE_HIST_UNIT_US	64
+#define IDLE_NR_WAKE_SRC	33	/* r12 bits + "none" */
+#define IDLE_WAKE_SRC_NONE	32
+#define IDLE_PREDICT_MIN_SAMPLES	8
+#define IDLE_PREDICT_HOLD_NS	(500 * NSEC_PER_MSEC)
+
+struct idle_src_stat {
+	u32 count;
+	u32 mispredict;		/* deep idle shorter than break-even */
+	u32 avg_us;		/* decaying average residency */
+	u32 max_us;
+	u32 hist[IDLE_HIST_BUCKETS];
+};
+
+static struct idle_src_stat idle_src_stats[IDLE_NR_WAKE_SRC];
+static u32 idle_blocked_hist[IDLE_HIST_BUCKETS];
+static u32 idle_block_cnt;
+static u32 idle_nospm_cnt;
+static DEFINE_SPINLOCK(idle_stat_lock);
+static DEFINE_PER_CPU(int, idle_state_idx);
+static struct cpumask idle_pm_cpus;
+static struct cpumask idle_spm_cpus;
+static u64 idle_sys_enter_ns;
+static bool idle_sys_spm;
+static u64 idle_block_until_ns;
+static bool idle_deep_blocked;
+static struct cpumask idle_deep_forced;
+static bool idle_predict_en;
+static int idle_deep_idx = -1;
+static u32 idle_break_even_us;
+
+static int idle_hist_bucket(u32 us)
+{
+	return min(fls(us / IDLE_HIST_UNIT_US), IDLE_HIST_BUCKETS - 1);
+}
+
+/*
+ * The disable flag belongs to the cpuidle sysfs stateN/disable knob.
+ * Only CPUs where it was clear are set, and only those are cleared
+ * again, so a state someone else disabled stays disabled.
+ */
+static void sloa_idle_set_deep_disable(bool disable)
+{
+	struct cpuidle_state_usage *su;
+	struct cpuidle_device *dev;
+	int cpu;
+
+	if (idle_deep_idx < 0)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		dev = per_cpu(cpuidle_devices, cpu);
+		if (!dev)
+			continue;
+		su = &dev->states_usage[idle_deep_idx];
+		if (disable && !su->disable) {
+			su->disable = true;
+			cpumask_set_cpu(cpu, &idle_deep_forced);
+		} else if (!disable &&
+			   cpumask_test_and_clear_cpu(cpu, &idle_deep_forced)) {
+			su->disable = false;
+		}
+	}
+
+	idle_deep_blocked = disable;
+}
+
+/* called with idle_stat_lock held, from the first CPU leaving idle */
+static void sloa_idle_account(u64 now, u32 us, bool spm)
+{
+	struct idle_src_stat *st;
+	u32 r12;
+	int src;
+
+	if (idle_deep_blocked) {
+		/* SPM did not run, r12 is stale */
+		idle_blocked_hist[idle_hist_bucket(us)]++;
+		if (now >= idle_block_until_ns || !idle_predict_en)
+			sloa_idle_set_deep_disable(false);
+		return;
+	}
+
+	if (!spm) {
+		/* some CPU stayed in a shallower state, r12 is stale */
+		idle_nospm_cnt++;
+		return;
+	}
+
+	r12 = readl(SPM_SW_RSV_0);
+	src = r12 ? __ffs(r12) : IDLE_WAKE_SRC_NONE;
+	st = &idle_src_stats[src];
+	mtk_wake_acct_spm(r12, false);
+
+	st->count++;
+	st->hist[idle_hist_bucket(us)]++;
+	st->max_us = max(st->max_us, us);
+	st->avg_us = (st->count == 1) ? us : (st->avg_us * 7 + us) / 8;
+	if (us < idle_break_even_us)
+		st->mispredict++;
+
+	if (!idle_predict_en || src == IDLE_WAKE_SRC_NONE)
+		return;
+
+	/* the source that just fired is expected to fire again as usual */
+	if (st->count >= IDLE_PREDICT_MIN_SAMPLES &&
+	    st->avg_us < idle_break_even_us) {
+		idle_block_until_ns = now + IDLE_PREDICT_HOLD_NS;
+		idle_block_cnt++;
+		sloa_idle_set_deep_disable(true);
+	}
+}
+
+static int sloa_idle_pm_notifier(struct notifier_block *nb,
+				 unsigned long cmd, void *v)
+{
+	int cpu = smp_processor_id();
+	u64 now;
+
+	switch (cmd) {
+	case CPU_PM_ENTER:
+		spin_lock(&idle_stat_lock);
+		cpumask_set_cpu(cpu, &idle_pm_cpus);
+		if (idle_deep_idx >= 0 &&
+		    __this_cpu_read(idle_state_idx) == idle_deep_idx)
+			cpumask_set_cpu(cpu, &idle_spm_cpus);
+		if (cpumask_subset(cpu_online_mask, &idle_pm_cpus)) {
+			idle_sys_enter_ns = ktime_get_ns();
+			idle_sys_spm = cpumask_subset(cpu_online_mask,
+						      &idle_spm_cpus);
+		}
+		spin_unlock(&idle_stat_lock);
+		break;
+	case CPU_PM_ENTER_FAILED:
+	case CPU_PM_EXIT:
+		spin_lock(&idle_stat_lock);
+		if (idle_sys_enter_ns) {
+			now = ktime_get_ns();
+			sloa_idle_account(now,
+				min_t(u64, div_u64(now - idle_sys_enter_ns,
+						   NSEC_PER_USEC), U32_MAX),
+				idle_sys_spm && cmd == CPU_PM_EXIT);
+			idle_sys_enter_ns = 0;
+		}
+		cpumask_clear_cpu(cpu, &idle_pm_cpus);
+		cpumask_clear_cpu(cpu, &idle_spm_cpus);
+		spin_unlock(&idle_stat_lock);
+		break;
+	default:
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block sloa_idle_pm_nb = {
+	.notifier_call = sloa_idle_pm_notifier,
+};
+
+/* cpuidle traces the state index right before CPU_PM_ENTER */
+static void sloa_idle_trace_cpu_idle(void *data, unsigned int state,
+				     unsigned int cpu)
+{
+	if (state != PWR_EVENT_EXIT)
+		__this_cpu_write(idle_state_idx, state);
+}
+
+static void sloa_idle_predict_init(void)
+{
+	struct cpuidle_driver *drv;
+
+	drv = cpuidle_get_cpu_driver(per_cpu(cpuidle_devices, 0));
+	if (drv && drv->state_count > 1) {
+		idle_deep_idx = drv->state_count - 1;
+		idle_break_even_us = drv->states[idle_deep_idx].target_residency;
+	}
+
+	if (register_trace_cpu_idle(sloa_idle_trace_cpu_idle, NULL))
+		pr_notice("sloa: no cpu_idle tracepoint, no SPM windows\n");
+	cpu_pm_register_notifier(&sloa_idle_pm_nb);
+}
+
 static int sloa_syscore_suspend(void)
 {
 	u32 sec, wakesrc, pcm_flags, pcm_flags1, req = 0;
@@ -1809,6 +2011,8 @@ static void sloa_syscore_resume(void)
 	spm_get_wakeup_status(&spm_wakesta);
 	spm_clean_after_wakeup();
 	spm_output_wake_reason(&spm_wakesta);
+	if (!spm_wakesta.assert_pc)
+		mtk_wake_acct_spm(spm_wakesta.r12, true);
 }
 
 static struct syscore_ops sloa_syscore_ops = {
@@ -1861,6 +2065,8 @@ static ssize_t idle_state_read(struct file *filp, char __user *userbuf,
 			"dpidle: cat %s/dpidle_state\n", d);
 	len += snprintf(buf + len, BUF_SIZE - len,
 			"soidle: cat %s/soidle_state\n", d);
+	len += snprintf(buf + len, BUF_SIZE - len,
+			"predict: cat %s/idle_predict\n", d);
 
 	return simple_read_from_buffer(userbuf, count, f_pos, buf, len);
 }
@@ -2215,6 +2421,109 @@ static const struct file_operations soidle_state_fops = {
 	.release = single_release,
 };
 
+/*
+ * idle_predict
+ */
+static int idle_predict_show(struct seq_file *m, void *v)
+{
+	static const char *d = "/sys/kernel/debug/cpuidle/idle_predict";
+	struct idle_src_stat *st;
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&idle_stat_lock, flags);
+
+	seq_printf(m, "predict = %d, deep_idx = %d, break_even = %uus, blocked = %d (%u times)\n",
+		   idle_predict_en, idle_deep_idx, idle_break_even_us,
+		   idle_deep_blocked, idle_block_cnt);
+
+	seq_puts(m, "\nwake_src                         count  short  avg_us  max_us |");
+	for (i = 0; i < IDLE_HIST_BUCKETS - 1; i++)
+		seq_printf(m, " <%u", IDLE_HIST_UNIT_US << i);
+	seq_puts(m, " more\n");
+
+	for (i = 0; i < IDLE_NR_WAKE_SRC; i++) {
+		st = &idle_src_stats[i];
+		if (!st->count)
+			continue;
+		seq_printf(m, "%-30s %7u %6u %7u %7u |",
+			   i == IDLE_WAKE_SRC_NONE ? "NONE" :
+			   (wakeup_src_str[i] ? wakeup_src_str[i] : "?"),
+			   st->count, st->mispredict, st->avg_us, st->max_us);
+		for (j = 0; j < IDLE_HIST_BUCKETS; j++)
+			seq_printf(m, " %u", st->hist[j]);
+		seq_puts(m, "\n");
+	}
+
+	seq_puts(m, "\nblocked windows:");
+	for (j = 0; j < IDLE_HIST_BUCKETS; j++)
+		seq_printf(m, " %u", idle_blocked_hist[j]);
+	seq_printf(m, "\nwindows without SPM: %u\n", idle_nospm_cnt);
+
+	spin_unlock_irqrestore(&idle_stat_lock, flags);
+
+	seq_puts(m, "\n*********** idle_predict command help ************\n");
+	seq_printf(m, "predictor on/off: echo predict 1/0 > %s\n", d);
+	seq_printf(m, "break-even time: echo break_even <us> > %s\n", d);
+	seq_printf(m, "clear statistics: echo reset 1 > %s\n", d);
+
+	return 0;
+}
+
+static int idle_predict_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, idle_predict_show, inode->i_private);
+}
+
+static ssize_t idle_predict_write(struct file *filp,
+				  const char __user *userbuf,
+				  size_t count, loff_t *f_pos)
+{
+	char cmd[32], buf[64] = { 0 };
+	unsigned long flags;
+	ssize_t ret = count;
+	int param;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%31s %d", cmd, &param) != 2 || param < 0)
+		return -EINVAL;
+
+	spin_lock_irqsave(&idle_stat_lock, flags);
+	if (!strcmp(cmd, "predict")) {
+		idle_predict_en = !!param;
+		if (!idle_predict_en && idle_deep_blocked)
+			sloa_idle_set_deep_disable(false);
+	} else if (!strcmp(cmd, "break_even")) {
+		idle_break_even_us = param;
+	} else if (!strcmp(cmd, "reset")) {
+		memset(idle_src_stats, 0, sizeof(idle_src_stats));
+		memset(idle_blocked_hist, 0, sizeof(idle_blocked_hist));
+		idle_block_cnt = 0;
+		idle_nospm_cnt = 0;
+	} else {
+		ret = -EINVAL;
+	}
+	spin_unlock_irqrestore(&idle_stat_lock, flags);
+
+	return ret;
+}
+
+static const struct file_operations idle_predict_fops = {
+	.owner = THIS_MODULE,
+	.open = idle_predict_open,
+	.read = seq_read,
+	.write = idle_predict_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int sloa_fs_init(void)
 {
 	struct dentry *root_entry, *file_entry;
@@ -2261,7 +2570,14 @@ int sloa_fs_init(void)
 		pr_notice("Can not create %s/soidle_state: %ld\n",
 			  d, PTR_ERR(file_entry));
 
+	file_entry  = debugfs_create_file("idle_predict", 0644,
+					  root_entry, NULL, &idle_predict_fops);
+	if (IS_ERR(file_entry))
+		pr_notice("Can not create %s/idle_predict: %ld\n",
+			  d, PTR_ERR(file_entry));
+
 	register_syscore_ops(&sloa_syscore_ops);
+	sloa_idle_predict_init();
 
 	return ret;
 }
@@ -20,6 +20,8 @@ enum SRC_REQ {
 	DDREN_REQ,
 };
 
+extern const char *wakeup_src_str[32];
+
 void sloa_suspend_infra_power(bool on);
 int sloa_vcore_req(bool on);
 int sloa_suspend_src_req(enum SRC_REQ req, unsigned int val);
@@ -8,12 +8,14 @@
 //#include "mtk_picachu.h"
 #include <linux/clk.h>
 #include <linux/completion.h>
+#include <linux/crc32.h>
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/kthread.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/nvmem-consumer.h>
+#include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_irq.h>
 #include <linux/platform_device.h>
@@ -23,10 +25,13 @@
 #include <linux/pm_runtime.h>
 #include <linux/proc_fs.h>
 #include <linux/regulator/consumer.h>
+#include <linux/sched.h>
 #include <linux/spinlock.h>
 #include <linux/slab.h>
 #include <linux/thermal.h>
 #include <linux/uaccess.h>
+#include <linux/workqueue.h>
+#include "mtk_svs.h"
 
 #define SVS_INIT01_VOLT_IGNORE		1
 #define SVS_INIT01_VOLT_INC_ONLY	2
@@ -41,6 +46,31 @@
 #define SVS_CCI				3
 #define SVS_GPU				4
 
+/* how much of the calibration was taken from the cache */
+#define SVS_CALI_NONE			0
+#define SVS_CALI_OFFSETS		1	/* init01 skipped */
+#define SVS_CALI_VOLTS			2	/* init01 and init02 skipped */
+#define SVS_CALI_CARRIED		3	/* init01 of another band, not cached */
+
+/*
+ * Calibration cache. init01/init02 results only depend on the chip
+ * (efuse) and the temperature they ran at, so they are kept per
+ * temperature band. The blob is handed over by the bootloader in
+ * "atag,svs_cache" and saved by userspace through /proc/svs/svs_cache.
+ */
+#define SVS_CACHE_MAGIC			0x53565343	/* "SVSC" */
+#define SVS_CACHE_VERSION		1
+#define SVS_CACHE_BANK_MAX		4
+#define SVS_CACHE_OPP_MAX		16
+#define SVS_TEMP_BAND_NUM		3
+#define SVS_TEMP_BAND_LOW		25000
+#define SVS_TEMP_BAND_HIGH		60000
+
+/* background recalibration */
+#define SVS_RECALI_PERIOD_MS		60000
+#define SVS_RECALI_RETRY_MS		5000
+#define SVS_RECALI_DRIFT		5000
+
 #define proc_fops_rw(name) \
 	static int name ## _proc_open(struct inode *inode,	\
 		struct file *file)				\
@@ -75,8 +105,26 @@
 #define proc_entry(name)	{__stringify(name), &name ## _proc_fops}
 
 static DEFINE_SPINLOCK(mtk_svs_lock);
+static DEFINE_MUTEX(svs_cache_lock);
 struct mtk_svs;
 
+struct svs_cache_entry {
+	u32 valid;
+	u32 dc_voffset_in;
+	u32 age_voffset_in;
+	u32 init02_volts[SVS_CACHE_OPP_MAX];
+};
+
+struct svs_cache {
+	u32 magic;
+	u32 version;
+	u32 chip_key;
+	struct svs_cache_entry entry[SVS_CACHE_BANK_MAX][SVS_TEMP_BAND_NUM];
+	u32 crc;
+};
+
+static struct svs_cache svs_cache;
+
 enum reg_index {
 	TEMPMONCTL0 = 0,
 	TEMPMONCTL1,
@@ -349,6 +397,8 @@ struct svs_bank {
 	u32 *opp_volts;
 	u32 *init02_volts;
 	u32 *volts;
+	u32 *margins;
+	u32 *prev_init02_volts;
 	u32 reg_data[3][reg_num];
 	u32 freq_base;
 	u32 vboot;
@@ -389,6 +439,14 @@ struct svs_bank {
 	u32 sw_id;
 	u32 hw_id;
 	u32 ctl0;
+	u32 cali_restored;
+	int cali_band;
+	int cali_temp;
+	u32 prev_phase;
+	u32 prev_dc_voffset_in;
+	u32 prev_age_voffset_in;
+	int prev_cali_band;
+	int prev_cali_temp;
 	u8 *of_compatible;
 	u8 *name;
 	u8 *zone_name;
@@ -413,10 +471,14 @@ struct mtk_svs {
 	struct device *dev;
 	void __iomem *base;
 	struct clk *main_clk;
+	struct delayed_work recali_work;
 	u32 *efuse;
 	u32 *thermal_efuse;
+	u32 chip_key;
 };
 
+static struct mtk_svs *svs_active;
+
 static unsigned long claim_mtk_svs_lock(void)
 {
 	unsigned long flags;
@@ -544,6 +606,7 @@ static int svs_set_volts(struct svs_bank *svsb, bool force_update)
 		}
 
 		opp_volt = min(opp_volt, svsb->opp_volts[i]);
+		svsb->margins[i] = svsb->opp_volts[i] - opp_volt;
 		ret = dev_pm_opp_adjust_voltage(svsb->dev, svsb->opp_freqs[i],
 						opp_volt);
 		if (ret) {
@@ -921,7 +984,8 @@ static int svs_init02(struct mtk_svs *svs)
 		svsb = &svsp->banks[idx];
 		svs->bank = svsb;
 
-		if (!svsb->init02_support)
+		if (!svsb->init02_support ||
+		    svsb->cali_restored == SVS_CALI_VOLTS)
 			continue;
 
 		reinit_completion(&svsb->init_completion);
@@ -960,9 +1024,12 @@ static int svs_init01(struct mtk_svs *svs)
 		svsb = &svsp->banks[idx];
 		search_done = false;
 
-		if (!svsb->init01_support)
+		if (!svsb->init01_support || svsb->cali_restored)
 			continue;
 
+		/* init01 runs with the system clock enabled */
+		svsb->coresel |= svsb->systemclk_en;
+
 		ret = regulator_set_mode(svsb->buck, REGULATOR_MODE_FAST);
 		if (ret)
 			pr_notice("%s: fail to set fast mode: %d\n",
@@ -1023,7 +1090,7 @@ static int svs_init01(struct mtk_svs *svs)
 		svsb = &svsp->banks[idx];
 		svs->bank = svsb;
 
-		if (!svsb->init01_support)
+		if (!svsb->init01_support || svsb->cali_restored)
 			continue;
 
 		opp_vboot = svs_volt_to_opp_volt(svsb->vboot,
@@ -1056,7 +1123,7 @@ err_init:
 	for (idx = 0; idx < svsp->bank_num; idx++) {
 		svsb = &svsp->banks[idx];
 
-		if (!svsb->init01_support)
+		if (!svsb->init01_support || svsb->cali_restored)
 			continue;
 
 		for (i = 0; i < svsb->opp_count; i++)
@@ -1083,23 +1150,305 @@ err_init:
 	return ret;
 }
 
+static int svs_temp_band(int zone_temp)
+{
+	if (zone_temp <= SVS_TEMP_BAND_LOW)
+		return 0;
+	else if (zone_temp <= SVS_TEMP_BAND_HIGH)
+		return 1;
+
+	return 2;
+}
+
+static u32 svs_cache_crc(const struct svs_cache *cache)
+{
+	return crc32_le(~0, (const u8 *)cache,
+			offsetof(struct svs_cache, crc));
+}
+
+static bool svs_cache_valid(struct mtk_svs *svs, const struct svs_cache *cache)
+{
+	return cache->magic == SVS_CACHE_MAGIC &&
+	       cache->version == SVS_CACHE_VERSION &&
+	       cache->chip_key == svs->chip_key &&
+	       cache->crc == svs_cache_crc(cache);
+}
+
+static void svs_cache_load(struct mtk_svs *svs)
+{
+	const struct svs_cache *cache;
+	struct device_node *np;
+	int len = 0;
+
+	svs->chip_key = crc32_le(~0, (const u8 *)svs->efuse,
+				 svs->platform->efuse_num * 4);
+
+	mutex_lock(&svs_cache_lock);
+	memset(&svs_cache, 0, sizeof(svs_cache));
+	svs_cache.magic = SVS_CACHE_MAGIC;
+	svs_cache.version = SVS_CACHE_VERSION;
+	svs_cache.chip_key = svs->chip_key;
+
+	np = of_find_node_by_path("/chosen");
+	if (np) {
+		cache = of_get_property(np, "atag,svs_cache", &len);
+		if (cache && len == sizeof(*cache) &&
+		    svs_cache_valid(svs, cache)) {
+			memcpy(&svs_cache, cache, sizeof(svs_cache));
+			pr_notice("calibration cache loaded\n");
+		} else if (cache) {
+			pr_notice("calibration cache mismatch, ignored\n");
+		}
+		of_node_put(np);
+	}
+	mutex_unlock(&svs_cache_lock);
+}
+
+/*
+ * Take the calibration of each bank from the cache entry matching its
+ * current temperature band. With volts, the init02 voltages are applied
+ * right away as well; otherwise only init01 is skipped. Returns the
+ * number of banks which still need init01.
+ */
+static u32 svs_cache_restore(struct mtk_svs *svs, bool volts)
+{
+	const struct svs_platform *svsp = svs->platform;
+	struct svs_cache_entry *entry;
+	struct svs_bank *svsb;
+	int zone_temp;
+	u32 idx, pending = 0;
+
+	mutex_lock(&svs_cache_lock);
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+
+		if (!svsb->init01_support)
+			continue;
+
+		svsb->cali_restored = SVS_CALI_NONE;
+		svsb->cali_band = -1;
+
+		if (!svs_get_zone_temperature(svsb, &zone_temp)) {
+			svsb->cali_band = svs_temp_band(zone_temp);
+			svsb->cali_temp = zone_temp;
+		}
+
+		if (svsb->cali_band < 0 || idx >= SVS_CACHE_BANK_MAX ||
+		    svsb->opp_count > SVS_CACHE_OPP_MAX ||
+		    !svs_cache.entry[idx][svsb->cali_band].valid) {
+			pending++;
+			continue;
+		}
+
+		entry = &svs_cache.entry[idx][svsb->cali_band];
+		svsb->dc_voffset_in = entry->dc_voffset_in;
+		svsb->age_voffset_in = entry->age_voffset_in;
+		svsb->coresel &= ~svsb->systemclk_en;
+		svsb->phase = SVS_PHASE_INIT01;
+		svsb->cali_restored = SVS_CALI_OFFSETS;
+
+		if (volts && svsb->init02_support) {
+			memcpy(svsb->init02_volts, entry->init02_volts,
+			       4 * svsb->opp_count);
+			svsb->phase = SVS_PHASE_INIT02;
+			svsb->cali_restored = SVS_CALI_VOLTS;
+		}
+
+		pr_notice("%s: calibration restored for band %d (%d)\n",
+			  svsb->name, svsb->cali_band, zone_temp);
+	}
+	mutex_unlock(&svs_cache_lock);
+
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+		if (svsb->cali_restored == SVS_CALI_VOLTS)
+			svs_set_volts(svsb, true);
+	}
+
+	return pending;
+}
+
+static void svs_cache_store(struct mtk_svs *svs)
+{
+	const struct svs_platform *svsp = svs->platform;
+	struct svs_cache_entry *entry;
+	struct svs_bank *svsb;
+	bool carried;
+	u32 idx;
+
+	mutex_lock(&svs_cache_lock);
+	for (idx = 0; idx < svsp->bank_num && idx < SVS_CACHE_BANK_MAX; idx++) {
+		svsb = &svsp->banks[idx];
+		carried = svsb->cali_restored == SVS_CALI_CARRIED;
+		svsb->cali_restored = SVS_CALI_NONE;
+
+		if (carried || !svsb->init02_support || svsb->cali_band < 0 ||
+		    svsb->opp_count > SVS_CACHE_OPP_MAX ||
+		    (svsb->phase != SVS_PHASE_INIT02 &&
+		     svsb->phase != SVS_PHASE_MON))
+			continue;
+
+		entry = &svs_cache.entry[idx][svsb->cali_band];
+		entry->valid = 1;
+		entry->dc_voffset_in = svsb->dc_voffset_in;
+		entry->age_voffset_in = svsb->age_voffset_in;
+		memcpy(entry->init02_volts, svsb->init02_volts,
+		       4 * svsb->opp_count);
+	}
+	svs_cache.crc = svs_cache_crc(&svs_cache);
+	mutex_unlock(&svs_cache_lock);
+}
+
 static int svs_start(struct mtk_svs *svs)
 {
 	int ret;
 
-	ret = svs_init01(svs);
-	if (ret)
-		return ret;
+	if (svs_cache_restore(svs, true)) {
+		ret = svs_init01(svs);
+		if (ret)
+			return ret;
+	}
 
 	ret = svs_init02(svs);
 	if (ret)
 		return ret;
 
+	svs_cache_store(svs);
 	svs_mon_mode(svs);
 
 	return ret;
 }
 
+static void svs_cali_save(struct svs_bank *svsb)
+{
+	svsb->prev_phase = svsb->phase;
+	svsb->prev_dc_voffset_in = svsb->dc_voffset_in;
+	svsb->prev_age_voffset_in = svsb->age_voffset_in;
+	svsb->prev_cali_band = svsb->cali_band;
+	svsb->prev_cali_temp = svsb->cali_temp;
+	memcpy(svsb->prev_init02_volts, svsb->init02_volts,
+	       4 * svsb->opp_count);
+}
+
+static void svs_cali_revert(struct svs_bank *svsb)
+{
+	/* like suspend, fall back to init02 volts until mon mode reports */
+	svsb->phase = svsb->prev_phase == SVS_PHASE_MON ?
+		      SVS_PHASE_INIT02 : svsb->prev_phase;
+	svsb->dc_voffset_in = svsb->prev_dc_voffset_in;
+	svsb->age_voffset_in = svsb->prev_age_voffset_in;
+	svsb->cali_band = svsb->prev_cali_band;
+	svsb->cali_temp = svsb->prev_cali_temp;
+	svsb->cali_restored = SVS_CALI_NONE;
+	memcpy(svsb->init02_volts, svsb->prev_init02_volts,
+	       4 * svsb->opp_count);
+}
+
+/*
+ * Runtime recalibration only re-runs init02. init01 needs the bank at
+ * vboot with DVFS frozen, which cannot be guaranteed here, so a band
+ * without a cache entry keeps the init01 offsets it already has and its
+ * result is not cached. On failure every bank goes back to its previous
+ * calibration.
+ */
+static void svs_recalibrate(struct mtk_svs *svs)
+{
+	const struct svs_platform *svsp = svs->platform;
+	struct svs_bank *svsb;
+	unsigned long flags;
+	u32 idx;
+	int ret;
+
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+		if (svsb->init01_support)
+			svs_cali_save(svsb);
+	}
+
+	/* Stop the running banks the same way suspend does. */
+	flags = claim_mtk_svs_lock();
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+		if (!svsb->init01_support)
+			continue;
+		svs->bank = svsb;
+		svs_switch_bank(svs);
+		svs_writel(svs, 0x0, SVSEN);
+		svs_writel(svs, 0x00ffffff, INTSTS);
+	}
+	release_mtk_svs_lock(flags);
+
+	svs_cache_restore(svs, false);
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+		if (svsb->init01_support &&
+		    svsb->cali_restored == SVS_CALI_NONE)
+			svsb->cali_restored = SVS_CALI_CARRIED;
+	}
+
+	ret = svs_init02(svs);
+	if (ret) {
+		pr_err("recalibration failed: %d, keep previous calibration\n",
+		       ret);
+		for (idx = 0; idx < svsp->bank_num; idx++) {
+			svsb = &svsp->banks[idx];
+			if (!svsb->init01_support)
+				continue;
+			svs_cali_revert(svsb);
+			svs_set_volts(svsb, true);
+		}
+		svs_mon_mode(svs);
+		return;
+	}
+
+	svs_cache_store(svs);
+	svs_mon_mode(svs);
+}
+
+/*
+ * Recalibrate once a bank's temperature has left the band it was
+ * calibrated in, but only while the system is idle so the detectors do
+ * not run against a busy CPU.
+ */
+static void svs_recali_work_fn(struct work_struct *work)
+{
+	struct mtk_svs *svs = container_of(to_delayed_work(work),
+					   struct mtk_svs, recali_work);
+	const struct svs_platform *svsp = svs->platform;
+	struct svs_bank *svsb;
+	unsigned long delay = msecs_to_jiffies(SVS_RECALI_PERIOD_MS);
+	bool drift = false;
+	int zone_temp;
+	u32 idx;
+
+	for (idx = 0; idx < svsp->bank_num; idx++) {
+		svsb = &svsp->banks[idx];
+
+		if (!svsb->init02_support || svsb->suspended ||
+		    (svsb->phase != SVS_PHASE_INIT02 &&
+		     svsb->phase != SVS_PHASE_MON))
+			continue;
+
+		if (svs_get_zone_temperature(svsb, &zone_temp))
+			continue;
+
+		if (svsb->cali_band < 0 ||
+		    (svs_temp_band(zone_temp) != svsb->cali_band &&
+		     abs(zone_temp - svsb->cali_temp) >= SVS_RECALI_DRIFT))
+			drift = true;
+	}
+
+	if (drift) {
+		if (nr_running() > 1)
+			delay = msecs_to_jiffies(SVS_RECALI_RETRY_MS);
+		else
+			svs_recalibrate(svs);
+	}
+
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &svs->recali_work, delay);
+}
+
 static int svs_mt8512_efuse_parsing(struct mtk_svs *svs)
 {
 	const struct svs_platform *svsp = svs->platform;
@@ -1281,6 +1630,7 @@ static int svs_resource_setup(struct mtk_svs *svs)
 		}
 
 		mutex_init(&svsb->lock);
+		init_completion(&svsb->init_completion);
 
 		svsb->buck = devm_regulator_get_optional(svsb->dev,
 							 svsb->buck_name);
@@ -1310,6 +1660,14 @@ static int svs_resource_setup(struct mtk_svs *svs)
 		if (!svsb->volts)
 			return -ENOMEM;
 
+		svsb->margins = kzalloc(opp_size, GFP_KERNEL);
+		if (!svsb->margins)
+			return -ENOMEM;
+
+		svsb->prev_init02_volts = kmalloc(opp_size, GFP_KERNEL);
+		if (!svsb->prev_init02_volts)
+			return -ENOMEM;
+
 		svsb->opp_freqs = kmalloc(opp_size, GFP_KERNEL);
 		if (!svsb->opp_freqs)
 			return -ENOMEM;
@@ -1344,6 +1702,8 @@ static int svs_suspend(struct device *dev)
 	unsigned long flags;
 	u32 idx;
 
+	cancel_delayed_work_sync(&svs->recali_work);
+
 	/* Wait if there is processing svs_isr(). Suspend all banks. */
 	flags = claim_mtk_svs_lock();
 	for (idx = 0; idx < svsp->bank_num; idx++) {
@@ -1392,9 +1752,39 @@ static int svs_resume(struct device *dev)
 
 	svs_mon_mode(svs);
 
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &svs->recali_work,
+			   msecs_to_jiffies(SVS_RECALI_PERIOD_MS));
+
 	return 0;
 }
 
+int mtk_svs_get_cpu_margin(unsigned long freq)
+{
+	struct mtk_svs *svs = READ_ONCE(svs_active);
+	struct svs_bank *svsb;
+	u32 idx, i;
+
+	if (!svs)
+		return -ENODEV;
+
+	for (idx = 0; idx < svs->platform->bank_num; idx++) {
+		svsb = &svs->platform->banks[idx];
+
+		if (!svsb->init01_support ||
+		    (svsb->sw_id != SVS_CPU_LITTLE &&
+		     svsb->sw_id != SVS_CPU_BIG))
+			continue;
+
+		for (i = 0; i < svsb->opp_count; i++)
+			if (svsb->opp_freqs[i] == freq)
+				return READ_ONCE(svsb->margins[i]);
+	}
+
+	return -EINVAL;
+}
+EXPORT_SYMBOL(mtk_svs_get_cpu_margin);
+
 static int svs_debug_proc_show(struct seq_file *m, void *v)
 {
 	struct svs_bank *svsb = (struct svs_bank *)m->private;
@@ -1530,6 +1920,9 @@ static int svs_status_proc_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%s: temperature = %d\n", svsb->name, zone_temp);
 
+	seq_printf(m, "%s: calibrated at %d (band %d)\n",
+		   svsb->name, svsb->cali_temp, svsb->cali_band);
+
 	for (i = 0, freq = (u32)-1; i < svsb->opp_count; i++, freq--) {
 		opp = dev_pm_opp_find_freq_floor(svsb->dev, &freq);
 		if (IS_ERR(opp)) {
@@ -1540,8 +1933,9 @@ static int svs_status_proc_show(struct seq_file *m, void *v)
 
 		seq_printf(m, "opp_freqs[%02u]: %lu, volts[%02u]: %lu, ",
 			   i, freq, i, dev_pm_opp_get_voltage(opp));
-		seq_printf(m, "svsb_volts[%02u]: 0x%x, freqs_pct[%02u]: %u\n",
+		seq_printf(m, "svsb_volts[%02u]: 0x%x, freqs_pct[%02u]: %u, ",
 			   i, svsb->volts[i], i, svsb->freqs_pct[i]);
+		seq_printf(m, "margin[%02u]: %u\n", i, svsb->margins[i]);
 	}
 
 	return 0;
@@ -1549,6 +1943,62 @@ static int svs_status_proc_show(struct seq_file *m, void *v)
 
 proc_fops_ro(svs_status);
 
+static int svs_margin_proc_show(struct seq_file *m, void *v)
+{
+	struct svs_bank *svsb = (struct svs_bank *)m->private;
+	u32 i, margin;
+
+	seq_puts(m, "freq_hz signed_off_uv applied_uv margin_uv\n");
+	for (i = 0; i < svsb->opp_count; i++) {
+		margin = READ_ONCE(svsb->margins[i]);
+		seq_printf(m, "%u %u %u %u\n", svsb->opp_freqs[i],
+			   svsb->opp_volts[i], svsb->opp_volts[i] - margin,
+			   margin);
+	}
+
+	return 0;
+}
+
+proc_fops_ro(svs_margin);
+
+static int svs_cache_proc_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&svs_cache_lock);
+	seq_write(m, &svs_cache, sizeof(svs_cache));
+	mutex_unlock(&svs_cache_lock);
+
+	return 0;
+}
+
+static ssize_t svs_cache_proc_write(struct file *file,
+				    const char __user *buffer,
+				    size_t count, loff_t *pos)
+{
+	struct mtk_svs *svs = (struct mtk_svs *)PDE_DATA(file_inode(file));
+	struct svs_cache *cache;
+
+	if (count != sizeof(*cache))
+		return -EINVAL;
+
+	cache = memdup_user(buffer, count);
+	if (IS_ERR(cache))
+		return PTR_ERR(cache);
+
+	if (!svs_cache_valid(svs, cache)) {
+		kfree(cache);
+		return -EINVAL;
+	}
+
+	mutex_lock(&svs_cache_lock);
+	memcpy(&svs_cache, cache, sizeof(svs_cache));
+	mutex_unlock(&svs_cache_lock);
+	kfree(cache);
+
+	return count;
+}
+
+proc_fops_rw(svs_cache);
+
 static int svs_volt_offset_proc_show(struct seq_file *m, void *v)
 {
 	struct svs_bank *svsb = (struct svs_bank *)m->private;
@@ -1607,11 +2057,13 @@ static int svs_create_svs_procfs(struct mtk_svs *svs)
 
 	struct pentry svs_entries[] = {
 		proc_entry(svs_dump),
+		proc_entry(svs_cache),
 	};
 
 	struct pentry bank_entries[] = {
 		proc_entry(svs_debug),
 		proc_entry(svs_status),
+		proc_entry(svs_margin),
 		proc_entry(svs_volt_offset),
 	};
 
@@ -1844,6 +2296,8 @@ static int svs_probe(struct platform_device *pdev)
 	if (ret)
 		goto svs_probe_fail;
 
+	svs_cache_load(svs);
+
 	ret = svs_start(svs);
 	if (ret)
 		goto svs_probe_fail;
@@ -1852,6 +2306,12 @@ static int svs_probe(struct platform_device *pdev)
 	if (ret)
 		goto svs_probe_fail;
 
+	svs_active = svs;
+	INIT_DELAYED_WORK(&svs->recali_work, svs_recali_work_fn);
+	queue_delayed_work(system_freezable_power_efficient_wq,
+			   &svs->recali_work,
+			   msecs_to_jiffies(SVS_RECALI_PERIOD_MS));
+
 	return 0;
 
 svs_probe_fail:
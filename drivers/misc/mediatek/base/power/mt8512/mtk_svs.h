@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Copyright (c) 2019 MediaTek Inc.
+ */
+
+#ifndef __MTK_SVS_H__
+#define __MTK_SVS_H__
+
+/*
+ * Voltage margin (uV) SVS currently takes off the signed-off voltage of
+ * the CPU OPP at freq (Hz), or a negative errno if SVS is not running.
+ */
+int mtk_svs_get_cpu_margin(unsigned long freq);
+
+#endif	/* __MTK_SVS_H__ */
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Copyright (c) 2019 MediaTek Inc.
+ */
+
+/*
+ * SPM wake source accounting and wakeup coalescing.
+ *
+ * Every SPM wakeup (system suspend or dpidle/SODI) is counted against the
+ * r12 wake source bit that caused it. After a suspend, the first wakeup IRQ
+ * reported by the IRQ core is attached to that source, so "R12_EINT_EVENT_B"
+ * can be told apart per EINT user. Drivers with periodic wakeups register a
+ * struct mtk_wake_client; each fire is counted, and a fire shortly after an
+ * SPM wakeup is attributed to the source that woke the system.
+ *
+ * Registered clients also get their timers placed by a coalescing policy,
+ * off until chosen through debugfs:
+ *   0 - off:   expiries are left untouched
+ *   1 - slack: timers are rounded to a whole second and hrtimers get the
+ *              client slack as range, both only within slack_ms
+ *   2 - align: expiries are pushed onto a shared period_ms grid so that
+ *              clients fire together, again only within slack_ms
+ */
+
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
+#include <linux/timer.h>
+#include <linux/uaccess.h>
+#include <mt-plat/mtk_wake_acct.h>
+#include "mtk_sloa_fs.h"
+
+#define WAKE_NR_SRC		32
+#define WAKE_NR_IRQ_SLOT	4
+#define WAKE_ATTR_WINDOW_NS	(20 * NSEC_PER_MSEC)
+
+enum wake_policy {
+	WAKE_POLICY_OFF = 0,
+	WAKE_POLICY_SLACK,
+	WAKE_POLICY_ALIGN,
+	NR_WAKE_POLICY,
+};
+
+struct wake_irq_slot {
+	unsigned int irq;
+	u32 count;
+};
+
+struct wake_src_acct {
+	u32 count;
+	u32 suspend_count;
+	u64 last_ns;
+	struct wake_irq_slot irqs[WAKE_NR_IRQ_SLOT];
+	const char *last_client;
+};
+
+static struct wake_src_acct wake_src[WAKE_NR_SRC];
+static LIST_HEAD(wake_clients);
+static DEFINE_SPINLOCK(wake_acct_lock);
+
+/* last SPM wakeup still waiting for an IRQ / client to be attached */
+static int wake_pending_src = -1;
+static bool wake_pending_suspend;
+static u64 wake_pending_ns;
+
+static unsigned int wake_policy = WAKE_POLICY_OFF;
+static unsigned int wake_period_ms = 1000;
+
+void mtk_wake_acct_spm(u32 r12, bool suspend)
+{
+	struct wake_src_acct *ws;
+	unsigned long flags;
+	int src;
+
+	if (!r12)
+		return;
+
+	src = __ffs(r12);
+	ws = &wake_src[src];
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+	ws->count++;
+	if (suspend)
+		ws->suspend_count++;
+	ws->last_ns = ktime_get_ns();
+
+	wake_pending_src = src;
+	wake_pending_suspend = suspend;
+	wake_pending_ns = ws->last_ns;
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+}
+
+static void wake_acct_attach_irq(struct wake_src_acct *ws, unsigned int irq)
+{
+	struct wake_irq_slot *slot, *victim = &ws->irqs[0];
+	int i;
+
+	for (i = 0; i < WAKE_NR_IRQ_SLOT; i++) {
+		slot = &ws->irqs[i];
+		if (slot->count && slot->irq == irq) {
+			slot->count++;
+			return;
+		}
+		if (slot->count < victim->count)
+			victim = slot;
+	}
+
+	/* replace the least seen IRQ */
+	victim->irq = irq;
+	victim->count = 1;
+}
+
+static int wake_acct_pm_event(struct notifier_block *nb,
+			      unsigned long event, void *unused)
+{
+	unsigned long flags;
+
+	if (event != PM_POST_SUSPEND)
+		return NOTIFY_DONE;
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+	if (wake_pending_src >= 0 && wake_pending_suspend && pm_wakeup_irq)
+		wake_acct_attach_irq(&wake_src[wake_pending_src],
+				     pm_wakeup_irq);
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block wake_acct_pm_nb = {
+	.notifier_call = wake_acct_pm_event,
+};
+
+int mtk_wake_acct_register(struct mtk_wake_client *c)
+{
+	unsigned long flags;
+
+	if (!c || !c->name)
+		return -EINVAL;
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+	c->count = 0;
+	c->spm_count = 0;
+	c->last_ns = 0;
+	list_add_tail(&c->list, &wake_clients);
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL(mtk_wake_acct_register);
+
+void mtk_wake_acct_unregister(struct mtk_wake_client *c)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+	list_del_init(&c->list);
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+}
+EXPORT_SYMBOL(mtk_wake_acct_unregister);
+
+void mtk_wake_acct_client_fire(struct mtk_wake_client *c)
+{
+	unsigned long flags;
+	u64 now = ktime_get_ns();
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+	c->count++;
+	c->last_ns = now;
+
+	/* the first client to run right after an SPM wakeup owns it */
+	if (wake_pending_src >= 0 &&
+	    now - wake_pending_ns < WAKE_ATTR_WINDOW_NS) {
+		c->spm_count++;
+		wake_src[wake_pending_src].last_client = c->name;
+		wake_pending_src = -1;
+	}
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+}
+EXPORT_SYMBOL(mtk_wake_acct_client_fire);
+
+unsigned long mtk_wake_acct_round_jiffies(struct mtk_wake_client *c,
+					  unsigned long j)
+{
+	unsigned long slack = msecs_to_jiffies(c->slack_ms);
+	unsigned long period, aligned;
+
+	switch (READ_ONCE(wake_policy)) {
+	case WAKE_POLICY_SLACK:
+		aligned = round_jiffies_up(j);
+		break;
+	case WAKE_POLICY_ALIGN:
+		period = msecs_to_jiffies(READ_ONCE(wake_period_ms));
+		if (!period)
+			return j;
+		aligned = roundup(j, period);
+		break;
+	default:
+		return j;
+	}
+
+	return time_before_eq(aligned, j + slack) ? aligned : j;
+}
+EXPORT_SYMBOL(mtk_wake_acct_round_jiffies);
+
+u64 mtk_wake_acct_slack_ns(struct mtk_wake_client *c)
+{
+	if (READ_ONCE(wake_policy) == WAKE_POLICY_OFF)
+		return 0;
+
+	return (u64)c->slack_ms * NSEC_PER_MSEC;
+}
+EXPORT_SYMBOL(mtk_wake_acct_slack_ns);
+
+/*
+ * wake_acct
+ */
+static int wake_acct_show(struct seq_file *m, void *v)
+{
+	static const char *d = "/sys/kernel/debug/wake_acct";
+	struct mtk_wake_client *c;
+	struct wake_src_acct *ws;
+	struct irq_desc *desc;
+	unsigned long flags;
+	int i, j;
+
+	spin_lock_irqsave(&wake_acct_lock, flags);
+
+	seq_printf(m, "policy = %u, period_ms = %u\n\n",
+		   wake_policy, wake_period_ms);
+
+	seq_puts(m, "wake_src                         count suspend      last_ms  last_client  irqs\n");
+	for (i = 0; i < WAKE_NR_SRC; i++) {
+		ws = &wake_src[i];
+		if (!ws->count)
+			continue;
+
+		seq_printf(m, "%-30s %7u %7u %12llu  %-12s",
+			   wakeup_src_str[i] ? wakeup_src_str[i] : "?",
+			   ws->count, ws->suspend_count,
+			   div_u64(ws->last_ns, NSEC_PER_MSEC),
+			   ws->last_client ? ws->last_client : "-");
+
+		for (j = 0; j < WAKE_NR_IRQ_SLOT; j++) {
+			if (!ws->irqs[j].count)
+				continue;
+			desc = irq_to_desc(ws->irqs[j].irq);
+			seq_printf(m, " %u(%s):%u", ws->irqs[j].irq,
+				   desc && desc->action && desc->action->name ?
+				   desc->action->name : "?",
+				   ws->irqs[j].count);
+		}
+		seq_puts(m, "\n");
+	}
+
+	seq_puts(m, "\nclient             count  after_spm slack_ms      last_ms\n");
+	list_for_each_entry(c, &wake_clients, list)
+		seq_printf(m, "%-16s %7u %10u %8u %12llu\n",
+			   c->name, c->count, c->spm_count, c->slack_ms,
+			   div_u64(c->last_ns, NSEC_PER_MSEC));
+
+	spin_unlock_irqrestore(&wake_acct_lock, flags);
+
+	seq_puts(m, "\n*********** wake_acct command help ************\n");
+	seq_printf(m, "policy off/slack/align: echo policy 0/1/2 > %s\n", d);
+	seq_printf(m, "align period: echo period_ms <ms> > %s\n", d);
+	seq_printf(m, "clear statistics: echo reset 1 > %s\n", d);
+
+	return 0;
+}
+
+static int wake_acct_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, wake_acct_show, inode->i_private);
+}
+
+static ssize_t wake_acct_write(struct file *filp, const char __user *userbuf,
+			       size_t count, loff_t *f_pos)
+{
+	struct mtk_wake_client *c;
+	char cmd[32], buf[64] = { 0 };
+	unsigned long flags;
+	unsigned int param;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+
+	if (copy_from_user(buf, userbuf, count))
+		return -EFAULT;
+
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%31s %u", cmd, &param) != 2)
+		return -EINVAL;
+
+	if (!strcmp(cmd, "policy")) {
+		if (param >= NR_WAKE_POLICY)
+			return -EINVAL;
+		WRITE_ONCE(wake_policy, param);
+	} else if (!strcmp(cmd, "period_ms")) {
+		WRITE_ONCE(wake_period_ms, param);
+	} else if (!strcmp(cmd, "reset")) {
+		spin_lock_irqsave(&wake_acct_lock, flags);
+		memset(wake_src, 0, sizeof(wake_src));
+		wake_pending_src = -1;
+		list_for_each_entry(c, &wake_clients, list) {
+			c->count = 0;
+			c->spm_count = 0;
+		}
+		spin_unlock_irqrestore(&wake_acct_lock, flags);
+	} else {
+		return -EINVAL;
+	}
+
+	return count;
+}
+
+static const struct file_operations wake_acct_fops = {
+	.owner = THIS_MODULE,
+	.open = wake_acct_open,
+	.read = seq_read,
+	.write = wake_acct_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init mtk_wake_acct_init(void)
+{
+	struct dentry *file_entry;
+
+	file_entry = debugfs_create_file("wake_acct", 0644, NULL, NULL,
+					 &wake_acct_fops);
+	if (IS_ERR_OR_NULL(file_entry))
+		pr_notice("Can not create /sys/kernel/debug/wake_acct\n");
+
+	return register_pm_notifier(&wake_acct_pm_nb);
+}
+late_initcall(mtk_wake_acct_init);
@@ -152,6 +152,10 @@ static int emi_probe(struct platform_device *pdev)
 	bw_timer_init();
 #endif
 
+#if ENABLE_BWS
+	bw_sample_init(&emi_ctrl);
+#endif
+
 	return 0;
 }
 
@@ -33,6 +33,7 @@ extern void mpu_init(
 extern void elm_init(
 	struct platform_driver *emi_ctrl, struct platform_device *pdev);
 extern void bw_timer_init(void);
+extern void bw_sample_init(struct platform_driver *emi_ctrl);
 
 extern unsigned int get_dram_type(void);
 extern unsigned int get_dram_mr(unsigned int index);
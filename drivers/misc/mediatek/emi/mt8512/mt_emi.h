@@ -20,6 +20,7 @@
 #define ENABLE_ELM	0
 #define ENABLE_MBW	0
 #define ENABLE_BWG	0
+#define ENABLE_BWS	1
 /* #define DECS_ON_SSPM */
 /* #define ENABLE_MPU_SLVERR */
 #define DBG_INFO_READY	0
@@ -58,6 +59,16 @@
 #define LAST_EMI_MBW_BUF_L	(LAST_EMI_BASE + 0x10)
 #define LAST_EMI_MBW_BUF_H	(LAST_EMI_BASE + 0x14)
 
+/* macro for bandwidth sampling, see bw_sample.h */
+#define EMI_BWS_UNIT_BYTES	8
+#define EMI_BWS_MASTER_NAMES \
+	{ "mcu", "mm0", "dsp", "peri", "mm1", "mfg0", "mfg1", "m7" }
+/* AFE, MSDC and USB all come in through the PERI port */
+#define EMI_BWS_GRP_MASTERS	{ BIT(0), BIT(2), BIT(3) }
+#define EMI_BWS_GRP_NAMES	{ "cpu", "dsp", "peri" }
+#define EMI_BWS_DSP_MASTER	2
+#define EMI_BWS_PERI_GRP	2
+
 #include <mt_emi_api.h>
 #include <bwl_v1.h>
 #include <elm_v1.h>
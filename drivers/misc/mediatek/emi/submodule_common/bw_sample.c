@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * EMI bandwidth sampling
+ *
+ * Every emi_bw.period_us the bus monitor is paused, its byte, TTYPE and
+ * cycle counters are stored as one struct emi_bw_sample in a ring and
+ * the monitor is restarted from zero. The three monitor groups are set
+ * to EMI_BWS_GRP_MASTERS. While MET has the monitor registered nothing
+ * is sampled.
+ *
+ * /proc/emi_bw                        struct emi_bw_sample_hdr + ring
+ * /sys/bus/platform/drivers/emi_ctrl/emi_bw  last second as text
+ * emi_bw_sample_last()                for in-kernel users
+ *
+ * A window is flagged EMI_BWS_F_CONTENTION when the PERI group moves at
+ * least emi_bw.gov_peri_mbps and DSP transactions take on average at
+ * least emi_bw.gov_dsp_lat cycles (0: bandwidth only). With BWL built
+ * in and emi_bw.gov_scn set, gov_windows flagged windows in a row turn
+ * that BWL scenario on, and four times as many clean ones turn it off.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/device.h>
+#include <linux/platform_device.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#include <mt_emi.h>
+#include "bw_timer.h"
+#include "bw_sample.h"
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "emi_bw."
+
+#define EMI_BWS_RING		512
+#define EMI_BWS_MIN_PERIOD	1000	/* us */
+#define EMI_BWS_SHOW_WINDOWS	100
+
+static void __iomem *CEN_EMI_BASE;
+
+static struct emi_bw_sample bws_ring[EMI_BWS_RING];
+static unsigned int bws_head;
+static DEFINE_SPINLOCK(bws_lock);
+static struct hrtimer bws_timer;
+static ktime_t bws_period;
+static u64 bws_last;
+static bool bws_owned;
+static bool bws_ready;
+
+static const u32 grp_masters[EMI_BWS_GRP_NUM] = EMI_BWS_GRP_MASTERS;
+static const char * const grp_names[EMI_BWS_GRP_NUM] = EMI_BWS_GRP_NAMES;
+static const char * const master_names[EMI_BWS_MASTER_NUM] =
+	EMI_BWS_MASTER_NAMES;
+
+static bool bws_enable;
+static unsigned int period_us = 10000;
+module_param(period_us, uint, 0644);
+
+static unsigned int gov_peri_mbps = 1000;
+module_param(gov_peri_mbps, uint, 0644);
+static unsigned int gov_dsp_lat;
+module_param(gov_dsp_lat, uint, 0644);
+
+#if ENABLE_BWL
+static int gov_scn = -1;
+module_param(gov_scn, int, 0644);
+static unsigned int gov_windows = 5;
+module_param(gov_windows, uint, 0644);
+
+static unsigned int gov_hit, gov_miss;
+static bool gov_on;
+static int gov_applied = -1;
+
+static void bws_gov_work_fn(struct work_struct *work);
+static DECLARE_WORK(bws_gov_work, bws_gov_work_fn);
+#endif
+
+static void bws_start(void)
+{
+	unsigned int us = max_t(unsigned int, READ_ONCE(period_us),
+				EMI_BWS_MIN_PERIOD);
+
+	bws_period = ns_to_ktime((u64)us * NSEC_PER_USEC);
+	bws_owned = false;
+	hrtimer_start(&bws_timer, bws_period, HRTIMER_MODE_REL);
+}
+
+static int bws_enable_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_bool(val, kp);
+
+	if (ret || !bws_ready)
+		return ret;
+
+	hrtimer_cancel(&bws_timer);
+	if (bws_enable)
+		bws_start();
+	return 0;
+}
+
+static const struct kernel_param_ops bws_enable_ops = {
+	.set = bws_enable_set,
+	.get = param_get_bool,
+};
+module_param_cb(enable, &bws_enable_ops, &bws_enable, 0644);
+
+static void bws_mon_setup(void)
+{
+	unsigned int msel, msel2;
+
+	msel = readl(EMI_MSEL) & ~0x00ff00ffU;
+	msel |= grp_masters[0] | (grp_masters[1] << 16);
+	msel2 = readl(EMI_MSEL2) & ~0xffU;
+	msel2 |= grp_masters[2];
+
+	writel(msel, EMI_MSEL);
+	writel(msel2, EMI_MSEL2);
+	emi_mon_start();
+}
+
+static void bws_read(struct emi_bw_sample *s)
+{
+	unsigned int i;
+
+	s->total = readl(EMI_WSCT);
+	s->grp[0] = readl(EMI_WSCT2);
+	s->grp[1] = readl(EMI_WSCT3);
+	s->grp[2] = readl(EMI_WSCT4);
+
+	for (i = 0; i < EMI_BWS_MASTER_NUM; i++) {
+		s->trans[i] = readl(EMI_TTYPE1 + i * 8);
+		s->lat[i] = readl(EMI_TTYPE1 +
+					(i + EMI_BWS_MASTER_NUM) * 8);
+	}
+
+	s->bact = readl(EMI_BACT);
+	if (!(BC_OVERRUN & readl(EMI_BMEN)))
+		s->bcnt = readl(EMI_BCNT);
+	else
+		s->bcnt = 0x0FFFFFFF;
+}
+
+static inline u32 bws_mbps(u32 cnt, u32 window_us)
+{
+	return window_us ?
+		div_u64((u64)cnt * EMI_BWS_UNIT_BYTES, window_us) : 0;
+}
+
+static bool bws_contention(const struct emi_bw_sample *s)
+{
+	const unsigned int m = EMI_BWS_DSP_MASTER;
+	unsigned int lat = READ_ONCE(gov_dsp_lat);
+
+	if (bws_mbps(s->grp[EMI_BWS_PERI_GRP], s->window_us) <
+	    READ_ONCE(gov_peri_mbps))
+		return false;
+	if (!lat)
+		return true;
+
+	return s->trans[m] && s->lat[m] / s->trans[m] >= lat;
+}
+
+#if ENABLE_BWL
+static void bws_gov_work_fn(struct work_struct *work)
+{
+	int scn = READ_ONCE(gov_scn);
+	bool on = READ_ONCE(gov_on);
+
+	if (gov_applied >= 0 && (!on || gov_applied != scn)) {
+		bwl_ctrl(gov_applied, 0);
+		gov_applied = -1;
+	}
+	if (on && scn >= 0 && scn < BWL_SCN_MAX && gov_applied < 0) {
+		if (!bwl_ctrl(scn, 1))
+			gov_applied = scn;
+	}
+}
+
+/* hrtimer context: only decide, bwl_ctrl() sleeps */
+static void bws_gov_update(const struct emi_bw_sample *s)
+{
+	bool hit = s->flags & EMI_BWS_F_CONTENTION;
+
+	if (READ_ONCE(gov_scn) < 0) {
+		if (gov_on || gov_applied >= 0) {
+			gov_on = false;
+			schedule_work(&bws_gov_work);
+		}
+		return;
+	}
+
+	if (hit) {
+		gov_miss = 0;
+		if (!gov_on && ++gov_hit >= gov_windows) {
+			gov_on = true;
+			schedule_work(&bws_gov_work);
+		}
+	} else {
+		gov_hit = 0;
+		if (gov_on && ++gov_miss >= gov_windows * 4) {
+			gov_on = false;
+			schedule_work(&bws_gov_work);
+		}
+	}
+}
+
+static inline u8 bws_gov_scn(void)
+{
+	int scn = READ_ONCE(gov_applied);
+
+	return scn >= 0 ? scn : 0xff;
+}
+#else
+static inline void bws_gov_update(const struct emi_bw_sample *s)
+{
+}
+
+static inline u8 bws_gov_scn(void)
+{
+	return 0xff;
+}
+#endif
+
+static enum hrtimer_restart bws_timer_fn(struct hrtimer *timer)
+{
+	struct emi_bw_sample *s;
+	u64 now = sched_clock();
+
+	hrtimer_forward_now(timer, bws_period);
+
+	/* MET reprograms the monitor, leave it alone while registered */
+	if (!emi_is_bwmon_available()) {
+		bws_owned = false;
+		return HRTIMER_RESTART;
+	}
+	if (!bws_owned) {
+		bws_mon_setup();
+		bws_owned = true;
+		bws_last = now;
+		return HRTIMER_RESTART;
+	}
+
+	spin_lock(&bws_lock);
+	s = &bws_ring[bws_head % EMI_BWS_RING];
+	emi_mon_stop();
+	bws_read(s);
+	emi_mon_restart();
+
+	s->ts = now;
+	s->window_us = div_u64(now - bws_last, NSEC_PER_USEC);
+	s->data_rate = emi_get_data_rate();
+	s->flags = bws_contention(s) ? EMI_BWS_F_CONTENTION : 0;
+	bws_gov_update(s);
+	s->scn = bws_gov_scn();
+	bws_last = now;
+	bws_head++;
+	spin_unlock(&bws_lock);
+
+	return HRTIMER_RESTART;
+}
+
+int emi_bw_sample_last(struct emi_bw_sample *s)
+{
+	unsigned long flags;
+	int ret = -ENODATA;
+
+	spin_lock_irqsave(&bws_lock, flags);
+	if (bws_head) {
+		*s = bws_ring[(bws_head - 1) % EMI_BWS_RING];
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&bws_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(emi_bw_sample_last);
+
+static int emi_bw_proc_show(struct seq_file *m, void *v)
+{
+	struct emi_bw_sample_hdr hdr;
+	unsigned long flags;
+	unsigned int i, first;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = EMI_BWS_MAGIC;
+	hdr.version = EMI_BWS_VERSION;
+	hdr.rec_size = sizeof(struct emi_bw_sample);
+	hdr.period_us = ktime_to_us(bws_period);
+	hdr.unit_bytes = EMI_BWS_UNIT_BYTES;
+	for (i = 0; i < EMI_BWS_GRP_NUM; i++)
+		hdr.grp_masters[i] = grp_masters[i];
+
+	spin_lock_irqsave(&bws_lock, flags);
+	hdr.nr = min_t(unsigned int, bws_head, EMI_BWS_RING);
+	first = bws_head - hdr.nr;
+	seq_write(m, &hdr, sizeof(hdr));
+	for (i = first; i != bws_head; i++)
+		seq_write(m, &bws_ring[i % EMI_BWS_RING],
+			  sizeof(struct emi_bw_sample));
+	spin_unlock_irqrestore(&bws_lock, flags);
+
+	return 0;
+}
+
+static int emi_bw_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, emi_bw_proc_show, NULL,
+				sizeof(struct emi_bw_sample_hdr) +
+				sizeof(bws_ring));
+}
+
+static const struct file_operations emi_bw_proc_fops = {
+	.open = emi_bw_proc_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static ssize_t emi_bw_show(struct device_driver *driver, char *buf)
+{
+	u64 grp[EMI_BWS_GRP_NUM] = { 0 };
+	u64 grp_max[EMI_BWS_GRP_NUM] = { 0 };
+	u64 trans[EMI_BWS_MASTER_NUM] = { 0 };
+	u64 lat[EMI_BWS_MASTER_NUM] = { 0 };
+	u64 total = 0, us = 0;
+	struct emi_bw_sample *s;
+	unsigned int i, j, n, hit = 0;
+	unsigned long flags;
+	ssize_t ret = 0;
+	u32 mbps;
+
+	spin_lock_irqsave(&bws_lock, flags);
+	n = min_t(unsigned int, bws_head, EMI_BWS_SHOW_WINDOWS);
+	for (i = bws_head - n; i != bws_head; i++) {
+		s = &bws_ring[i % EMI_BWS_RING];
+		total += s->total;
+		us += s->window_us;
+		for (j = 0; j < EMI_BWS_GRP_NUM; j++) {
+			grp[j] += s->grp[j];
+			mbps = bws_mbps(s->grp[j], s->window_us);
+			if (mbps > grp_max[j])
+				grp_max[j] = mbps;
+		}
+		for (j = 0; j < EMI_BWS_MASTER_NUM; j++) {
+			trans[j] += s->trans[j];
+			lat[j] += s->lat[j];
+		}
+		if (s->flags & EMI_BWS_F_CONTENTION)
+			hit++;
+	}
+	spin_unlock_irqrestore(&bws_lock, flags);
+
+	ret += snprintf(buf + ret, PAGE_SIZE - ret,
+			"enable: %d, %u windows, %llu us, scn: %u\n",
+			bws_enable, n, us, bws_gov_scn());
+	if (!us)
+		return ret;
+
+	ret += snprintf(buf + ret, PAGE_SIZE - ret, "total: %llu MB/s\n",
+			div64_u64(total * EMI_BWS_UNIT_BYTES, us));
+	for (j = 0; j < EMI_BWS_GRP_NUM; j++)
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"%s: %llu MB/s, max %llu MB/s\n", grp_names[j],
+				div64_u64(grp[j] * EMI_BWS_UNIT_BYTES, us),
+				grp_max[j]);
+	for (j = 0; j < EMI_BWS_MASTER_NUM; j++)
+		ret += snprintf(buf + ret, PAGE_SIZE - ret,
+				"%s: %llu trans, %llu cycles/trans\n",
+				master_names[j], trans[j],
+				trans[j] ? div64_u64(lat[j], trans[j]) : 0);
+	ret += snprintf(buf + ret, PAGE_SIZE - ret,
+			"contention: %u windows\n", hit);
+
+	return ret;
+}
+
+static DRIVER_ATTR_RO(emi_bw);
+
+void bw_sample_init(struct platform_driver *emi_ctrl)
+{
+	int ret;
+
+	CEN_EMI_BASE = mt_cen_emi_base_get();
+	emi_bwmon_init();
+
+	hrtimer_init(&bws_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	bws_timer.function = bws_timer_fn;
+	bws_ready = true;
+	if (bws_enable)
+		bws_start();
+
+	if (!proc_create("emi_bw", 0444, NULL, &emi_bw_proc_fops))
+		pr_err("[BWS] fail to create /proc/emi_bw\n");
+
+	ret = driver_create_file(&emi_ctrl->driver, &driver_attr_emi_bw);
+	if (ret)
+		pr_err("[BWS] fail to create emi_bw\n");
+}
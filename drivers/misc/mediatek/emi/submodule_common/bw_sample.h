@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __BW_SAMPLE_H__
+#define __BW_SAMPLE_H__
+
+#include <linux/types.h>
+
+#define EMI_BWS_MAGIC		0x53574245	/* "EBWS" */
+#define EMI_BWS_VERSION		1
+
+#define EMI_BWS_GRP_NUM		3	/* WSCT2..WSCT4 */
+#define EMI_BWS_MASTER_NUM	8	/* EMI master ports */
+
+/*
+ * One bus monitor window. Byte counters are in EMI_BWS_UNIT_BYTES, so
+ * count * EMI_BWS_UNIT_BYTES / window_us is MB/s. trans[] and lat[]
+ * are TTYPE1..8 and TTYPE9..16: transactions per master port and their
+ * summed latency in EMI cycles.
+ */
+struct emi_bw_sample {
+	u64 ts;			/* sched_clock() at the end of the window */
+	u32 window_us;
+	u32 total;		/* WSCT, all masters */
+	u32 grp[EMI_BWS_GRP_NUM];
+	u32 trans[EMI_BWS_MASTER_NUM];
+	u32 lat[EMI_BWS_MASTER_NUM];
+	u32 bact;		/* busy cycles */
+	u32 bcnt;		/* bus cycles */
+	u16 data_rate;		/* MHz */
+	u8 scn;			/* BWL scenario set by the governor, 0xff none */
+	u8 flags;
+};
+
+#define EMI_BWS_F_CONTENTION	(1 << 0)
+
+/* header of /proc/emi_bw, followed by nr struct emi_bw_sample */
+struct emi_bw_sample_hdr {
+	u32 magic;
+	u16 version;
+	u16 rec_size;
+	u32 nr;
+	u32 period_us;
+	u32 unit_bytes;
+	u32 grp_masters[EMI_BWS_GRP_NUM];
+};
+
+extern int emi_bw_sample_last(struct emi_bw_sample *s);
+
+#endif /* __BW_SAMPLE_H__ */
@@ -386,13 +386,19 @@ enum hrtimer_restart emi_bw_timer_callback(struct hrtimer *my_timer)
 	return HRTIMER_RESTART;
 }
 
-void bw_timer_init(void)
+/* also used by bw_sample when the bw timer is not enabled */
+void emi_bwmon_init(void)
 {
-	unsigned long delay_in_ms = 4000000L;
-
 	CEN_EMI_BASE = mt_cen_emi_base_get();
 	CHN_EMI_BASE[0] = mt_chn_emi_base_get(0);
 	EMI_MPU_BASE = mt_emi_mpu_base_get();
+}
+
+void bw_timer_init(void)
+{
+	unsigned long delay_in_ms = 4000000L;
+
+	emi_bwmon_init();
 
 	/* start emi bw monitor */
 	emi_mon_start();
@@ -195,6 +195,7 @@ struct regs_per_period {
 
 typedef void (*emi_update_cntr_cb) (struct emi_idx *data);
 
+extern void emi_bwmon_init(void);
 extern void emi_mon_start(void);
 extern void emi_mon_restart(void);
 extern void emi_mon_stop(void);
@@ -15,8 +15,12 @@
 
 #include <linux/io.h>
 #include <linux/genalloc.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
 
-#include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/poll.h>
 #include <linux/uaccess.h>      /* needed by copy_to_user */
 
 #ifdef CONFIG_MTK_AUDIODSP_SUPPORT
@@ -36,6 +40,7 @@
 #include <audio_messenger_ipi.h>
 
 #include <audio_ringbuf.h>
+#include <audio_ringcopy.h>
 
 
 
@@ -60,6 +65,16 @@
 #define MAX_SCP_MSG_NUM_IN_QUEUE (64)
 #define MAX_DSP_DMA_WRITE_SIZE   (0x10000)
 
+/*
+ * size classes: 128 bytes ~ 64K, power of 2. A class only buckets the
+ * recycled chunks; each chunk is allocated at pool granularity and only
+ * reused for a request of the same aligned size.
+ */
+#define NUM_DMA_SIZE_CLASS       (10)
+#define MAX_DMA_CLASS_SIZE       \
+	(ADSP_CACHE_ALIGN_BYTES << (NUM_DMA_SIZE_CLASS - 1))
+#define MAX_DMA_CLASS_CACHED     (4)
+
 
 /*
  * =============================================================================
@@ -119,6 +134,34 @@ struct audio_ipi_dma_t {
 
 
 
+struct dma_chunk_t {
+	unsigned long addr_val;
+	uint32_t size;
+};
+
+
+/* recycled chunks of one size class, up to size bytes each */
+struct dma_size_class_t {
+	uint32_t size;
+	uint32_t num_cached;
+	struct dma_chunk_t cached[MAX_DMA_CLASS_CACHED];
+
+	uint32_t num_used;
+	uint32_t hit;
+	uint32_t miss;
+};
+
+
+/* pool statistics */
+struct dma_pool_stat_t {
+	size_t used;            /* bytes handed out, cached chunks excluded */
+	size_t used_max;        /* high watermark of used */
+	size_t cached;          /* bytes kept in class and region caches */
+	uint32_t alloc_fail;
+	uint32_t flush;
+};
+
+
 /* queue */
 struct hal_dma_queue_t {
 	struct ipi_msg_t msg[MAX_SCP_MSG_NUM_IN_QUEUE];
@@ -129,10 +172,9 @@ struct hal_dma_queue_t {
 
 	spinlock_t queue_lock;
 	wait_queue_head_t queue_wq;
+	struct mutex read_lock; /* one reader copies to user at a time */
 
 	struct audio_ringbuf_t dma_data;
-	uint8_t *tmp_buf_d2k;
-	uint8_t *tmp_buf_k2h;
 };
 
 
@@ -148,6 +190,16 @@ static struct gen_pool *g_dma_pool;
 
 static uint8_t g_region_reg_flag[TASK_SCENE_SIZE];
 
+/* chunk kept by a task after free_region, reused on its next alloc_region */
+static struct aud_ptr_t g_region_cache[TASK_SCENE_SIZE][NUM_AUDIO_IPI_DMA_PATH];
+static uint32_t g_region_cache_size[TASK_SCENE_SIZE][NUM_AUDIO_IPI_DMA_PATH];
+
+static struct dma_size_class_t g_dma_class[NUM_DMA_SIZE_CLASS];
+static struct dma_pool_stat_t g_dma_stat;
+static DEFINE_SPINLOCK(g_dma_cache_lock);
+
+static struct dentry *g_dma_debugfs;
+
 static struct hal_dma_queue_t g_hal_dma_queue;
 
 
@@ -222,11 +274,99 @@ inline uint8_t *dma_vir_base(void)
 
 static int hal_dma_init_msg_queue(struct hal_dma_queue_t *msg_queue);
 static int hal_dma_deinit_msg_queue(struct hal_dma_queue_t *msg_queue);
+static void dma_cache_flush_locked(void);
+
+
+static void dma_pool_largest_free(struct gen_pool *pool,
+				  struct gen_pool_chunk *chunk,
+				  void *data)
+{
+	size_t *largest = data;
+	unsigned long nbits = 0;
+	unsigned long start = 0;
+	unsigned long end = 0;
+
+	nbits = (chunk->end_addr - chunk->start_addr + 1) >>
+		pool->min_alloc_order;
+
+	while (start < nbits) {
+		start = find_next_zero_bit(chunk->bits, nbits, start);
+		if (start >= nbits)
+			break;
+		end = find_next_bit(chunk->bits, nbits, start);
+		if (((end - start) << pool->min_alloc_order) > *largest)
+			*largest = (end - start) << pool->min_alloc_order;
+		start = end;
+	}
+}
+
+
+static int audio_ipi_dma_debug_show(struct seq_file *m, void *v)
+{
+	struct dma_size_class_t *cls = NULL;
+	struct dma_pool_stat_t stat;
+	size_t avail = 0;
+	size_t largest = 0;
+	unsigned long flags = 0;
+	int i = 0;
+	int j = 0;
+
+	if (g_dma_pool == NULL)
+		return 0;
+
+	avail = gen_pool_avail(g_dma_pool);
+	gen_pool_for_each_chunk(g_dma_pool, dma_pool_largest_free, &largest);
+
+	spin_lock_irqsave(&g_dma_cache_lock, flags);
+	stat = g_dma_stat;
+	spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
+	seq_printf(m, "pool size %zu, avail %zu, largest free %zu, frag %zu%%\n",
+		   gen_pool_size(g_dma_pool), avail, largest,
+		   avail ? 100 - (largest * 100 / avail) : 0);
+	seq_printf(m, "used %zu, used max %zu, cached %zu, alloc fail %u, flush %u\n",
+		   stat.used, stat.used_max, stat.cached,
+		   stat.alloc_fail, stat.flush);
+
+	seq_puts(m, "\nclass  up to   used cached        hit       miss\n");
+	spin_lock_irqsave(&g_dma_cache_lock, flags);
+	for (i = 0; i < NUM_DMA_SIZE_CLASS; i++) {
+		cls = &g_dma_class[i];
+		seq_printf(m, "%5d %6u %6u %6u %10u %10u\n",
+			   i, cls->size, cls->num_used, cls->num_cached,
+			   cls->hit, cls->miss);
+	}
+
+	seq_puts(m, "\nregion cache\n");
+	for (i = 0; i < TASK_SCENE_SIZE; i++)
+		for (j = 0; j < NUM_AUDIO_IPI_DMA_PATH; j++)
+			if (g_region_cache[i][j].addr_val != 0)
+				seq_printf(m, "task %d, path %d, sz 0x%x\n",
+					   i, j, g_region_cache_size[i][j]);
+	spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
+	return 0;
+}
+
+
+static int audio_ipi_dma_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, audio_ipi_dma_debug_show, inode->i_private);
+}
+
+
+static const struct file_operations audio_ipi_dma_debug_fops = {
+	.open = audio_ipi_dma_debug_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 
 
 int init_audio_ipi_dma(void)
 {
 	int ret = 0;
+	int i = 0;
 
 	uint32_t size = 0;
 
@@ -324,6 +464,12 @@ int init_audio_ipi_dma(void)
 	}
 
 
+	for (i = 0; i < NUM_DMA_SIZE_CLASS; i++)
+		g_dma_class[i].size = ADSP_CACHE_ALIGN_BYTES << i;
+
+	g_dma_debugfs = debugfs_create_file("audio_ipi_dma", 0444, NULL, NULL,
+					    &audio_ipi_dma_debug_fops);
+
 	hal_dma_init_msg_queue(&g_hal_dma_queue);
 
 
@@ -340,6 +486,7 @@ IPI_DMA_INIT_EXIT:
 
 int deinit_audio_ipi_dma(void)
 {
+	unsigned long flags = 0;
 	int i = 0;
 
 	if (g_dma == NULL)
@@ -348,7 +495,14 @@ int deinit_audio_ipi_dma(void)
 	for (i = 0 ; i < TASK_SCENE_SIZE; i++)
 		audio_ipi_dma_free_region(i);
 
+	debugfs_remove(g_dma_debugfs);
+	g_dma_debugfs = NULL;
+
 	if (g_dma_pool != NULL) {
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		dma_cache_flush_locked();
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
 		gen_pool_destroy(g_dma_pool);
 		g_dma_pool = NULL;
 	}
@@ -415,8 +569,119 @@ void *get_audio_ipi_dma_vir_addr(unsigned long phy_addr_val)
  * =============================================================================
  */
 
+static int dma_size_to_class(const uint32_t size)
+{
+	int cls_idx = 0;
+
+	if (size > MAX_DMA_CLASS_SIZE)
+		return -1;
+
+	while ((ADSP_CACHE_ALIGN_BYTES << cls_idx) < size)
+		cls_idx++;
+
+	return cls_idx;
+}
+
+
+/* give every cached chunk back to the pool, g_dma_cache_lock held */
+static void dma_cache_flush_locked(void)
+{
+	struct dma_size_class_t *cls = NULL;
+	int i = 0;
+	int j = 0;
+
+	for (i = 0; i < NUM_DMA_SIZE_CLASS; i++) {
+		cls = &g_dma_class[i];
+		while (cls->num_cached > 0) {
+			cls->num_cached--;
+			gen_pool_free(g_dma_pool,
+				      cls->cached[cls->num_cached].addr_val,
+				      cls->cached[cls->num_cached].size);
+		}
+	}
+
+	for (i = 0; i < TASK_SCENE_SIZE; i++) {
+		for (j = 0; j < NUM_AUDIO_IPI_DMA_PATH; j++) {
+			if (g_region_cache[i][j].addr_val == 0)
+				continue;
+			gen_pool_free(g_dma_pool,
+				      g_region_cache[i][j].addr_val,
+				      g_region_cache_size[i][j]);
+			g_region_cache[i][j].addr_val = 0;
+			g_region_cache_size[i][j] = 0;
+		}
+	}
+
+	g_dma_stat.cached = 0;
+	g_dma_stat.flush++;
+}
+
+
+/* bitmap search in the pool, retried once with all caches released */
+static unsigned long dma_pool_alloc(const uint32_t size)
+{
+	unsigned long phy_value = 0;
+	unsigned long flags = 0;
+
+	phy_value = gen_pool_alloc(g_dma_pool, size);
+	if (phy_value != 0)
+		return phy_value;
+
+	spin_lock_irqsave(&g_dma_cache_lock, flags);
+	if (g_dma_stat.cached != 0)
+		dma_cache_flush_locked();
+	spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
+	phy_value = gen_pool_alloc(g_dma_pool, size);
+	if (phy_value == 0) {
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		g_dma_stat.alloc_fail++;
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+	}
+
+	return phy_value;
+}
+
+
+/* g_dma_cache_lock held */
+static void dma_stat_add_used(const uint32_t size)
+{
+	g_dma_stat.used += size;
+	if (g_dma_stat.used > g_dma_stat.used_max)
+		g_dma_stat.used_max = g_dma_stat.used;
+}
+
+
+/* take a cached chunk of exactly size bytes, g_dma_cache_lock held */
+static unsigned long dma_class_take_locked(struct dma_size_class_t *cls,
+					   const uint32_t size)
+{
+	unsigned long addr_val = 0;
+	uint32_t i = 0;
+
+	for (i = 0; i < cls->num_cached; i++) {
+		if (cls->cached[i].size != size)
+			continue;
+		addr_val = cls->cached[i].addr_val;
+		cls->num_cached--;
+		/* keep the rest oldest first for eviction */
+		memmove(&cls->cached[i], &cls->cached[i + 1],
+			sizeof(cls->cached[0]) * (cls->num_cached - i));
+		g_dma_stat.cached -= size;
+		break;
+	}
+
+	return addr_val;
+}
+
+
 int audio_ipi_dma_alloc(struct aud_ptr_t *phy_addr, const uint32_t size)
 {
+	struct dma_size_class_t *cls = NULL;
+	uint32_t alloc_size = DO_BYTE_ALIGN(size, ADSP_CACHE_ALIGN_MASK);
+	unsigned long flags = 0;
+	int cls_idx = 0;
+
 	if (g_dma == NULL) {
 		pr_info("g_dma: %p", g_dma);
 		return -ENODEV;
@@ -430,21 +695,50 @@ int audio_ipi_dma_alloc(struct aud_ptr_t *phy_addr, const uint32_t size)
 		return -EINVAL;
 	}
 
-	phy_addr->addr_val = gen_pool_alloc(g_dma_pool, size);
+	phy_addr->addr_val = 0;
+
+	/* recycle a chunk of the same class without the bitmap search */
+	cls_idx = dma_size_to_class(alloc_size);
+	if (cls_idx >= 0) {
+		cls = &g_dma_class[cls_idx];
+
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		phy_addr->addr_val = dma_class_take_locked(cls, alloc_size);
+		if (phy_addr->addr_val != 0)
+			cls->hit++;
+		else
+			cls->miss++;
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+	}
+
+	if (phy_addr->addr_val == 0)
+		phy_addr->addr_val = dma_pool_alloc(alloc_size);
 	if (phy_addr->addr_val == 0) {
 		pr_notice("gen_pool_alloc(%u) fail, (%zu/%zu)",
-			  size,
+			  alloc_size,
 			  gen_pool_avail(g_dma_pool),
 			  gen_pool_size(g_dma_pool));
 		return -ENOMEM;
 	}
 
+	spin_lock_irqsave(&g_dma_cache_lock, flags);
+	if (cls != NULL)
+		cls->num_used++;
+	dma_stat_add_used(alloc_size);
+	spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
 	return 0;
 }
 
 
 int audio_ipi_dma_free(struct aud_ptr_t *phy_addr, const uint32_t size)
 {
+	struct dma_size_class_t *cls = NULL;
+	uint32_t free_size = DO_BYTE_ALIGN(size, ADSP_CACHE_ALIGN_MASK);
+	struct dma_chunk_t evict = {0};
+	unsigned long flags = 0;
+	int cls_idx = 0;
+
 	if (g_dma == NULL) {
 		pr_info("g_dma: %p", g_dma);
 		return -ENODEV;
@@ -458,8 +752,34 @@ int audio_ipi_dma_free(struct aud_ptr_t *phy_addr, const uint32_t size)
 		return -EINVAL;
 	}
 
+	cls_idx = dma_size_to_class(free_size);
+	if (cls_idx >= 0)
+		cls = &g_dma_class[cls_idx];
+
+	spin_lock_irqsave(&g_dma_cache_lock, flags);
+	g_dma_stat.used -= free_size;
+	if (cls != NULL) {
+		cls->num_used--;
+		/* a full class gives its oldest chunk back to the pool */
+		if (cls->num_cached == MAX_DMA_CLASS_CACHED) {
+			evict = cls->cached[0];
+			memmove(&cls->cached[0], &cls->cached[1],
+				sizeof(cls->cached[0]) * (cls->num_cached - 1));
+			cls->num_cached--;
+			g_dma_stat.cached -= evict.size;
+		}
+		cls->cached[cls->num_cached].addr_val = phy_addr->addr_val;
+		cls->cached[cls->num_cached].size = free_size;
+		cls->num_cached++;
+		g_dma_stat.cached += free_size;
+		phy_addr->addr_val = 0;
+	}
+	spin_unlock_irqrestore(&g_dma_cache_lock, flags);
 
-	gen_pool_free(g_dma_pool, phy_addr->addr_val, size);
+	if (evict.addr_val != 0)
+		gen_pool_free(g_dma_pool, evict.addr_val, evict.size);
+	if (phy_addr->addr_val != 0)
+		gen_pool_free(g_dma_pool, phy_addr->addr_val, free_size);
 
 	phy_addr->addr_val = 0;
 
@@ -482,6 +802,9 @@ int audio_ipi_dma_alloc_region(const uint8_t task,
 	uint32_t size[2] = {ap_to_dsp_size, dsp_to_ap_size};
 
 	unsigned long phy_value = 0;
+	struct aud_ptr_t cached;
+	uint32_t cached_size = 0;
+	unsigned long flags = 0;
 #if 0 // TODO: remove
 	struct ipi_msg_t ipi_msg;
 #endif
@@ -518,7 +841,24 @@ int audio_ipi_dma_alloc_region(const uint8_t task,
 
 		region = &g_dma->region[task][i];
 
-		phy_value = gen_pool_alloc(g_dma_pool, size[i]);
+		/* take back the chunk this task had, if it is still cached */
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		cached = g_region_cache[task][i];
+		cached_size = g_region_cache_size[task][i];
+		g_region_cache[task][i].addr_val = 0;
+		g_region_cache_size[task][i] = 0;
+		g_dma_stat.cached -= cached_size;
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
+		if (cached.addr_val != 0 && cached_size == size[i])
+			phy_value = cached.addr_val;
+		else {
+			if (cached.addr_val != 0)
+				gen_pool_free(g_dma_pool,
+					      cached.addr_val,
+					      cached_size);
+			phy_value = dma_pool_alloc(size[i]);
+		}
 		if (phy_value == 0) {
 			pr_notice("gen_pool_alloc(%u) fail, (%zu/%zu)",
 				  size[i],
@@ -533,6 +873,10 @@ int audio_ipi_dma_alloc_region(const uint8_t task,
 		region->read_idx = 0;
 		region->write_idx = 0;
 
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		dma_stat_add_used(size[i]);
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
 		pr_info("task %d, region[%d] sz 0x%x, offset 0x%x",
 			task, i, size[i], region->offset);
 	}
@@ -562,6 +906,7 @@ int audio_ipi_dma_free_region(const uint8_t task)
 	struct audio_region_t *region = NULL;
 
 	unsigned long phy_value = 0;
+	unsigned long flags = 0;
 
 #if 0 // TODO: remove
 	struct ipi_msg_t ipi_msg;
@@ -610,9 +955,19 @@ int audio_ipi_dma_free_region(const uint8_t task)
 		pr_info("task %d, region[%d] sz 0x%x, offset 0x%x",
 			task, i, region->size, region->offset);
 
-		gen_pool_free(g_dma_pool,
-			      phy_value,
-			      region->size);
+		/* keep it for the next alloc_region of this task */
+		spin_lock_irqsave(&g_dma_cache_lock, flags);
+		g_dma_stat.used -= region->size;
+		if (g_region_cache[task][i].addr_val == 0) {
+			g_region_cache[task][i].addr_val = phy_value;
+			g_region_cache_size[task][i] = region->size;
+			g_dma_stat.cached += region->size;
+			phy_value = 0;
+		}
+		spin_unlock_irqrestore(&g_dma_cache_lock, flags);
+
+		if (phy_value != 0)
+			gen_pool_free(g_dma_pool, phy_value, region->size);
 
 		region->offset = 0;
 		region->size = 0;
@@ -693,6 +1048,17 @@ static uint32_t audio_region_free_space(struct audio_region_t *region)
 }
 
 
+static inline void audio_region_pos(
+	struct audio_ring_pos_t *pos,
+	const struct audio_region_t *region,
+	const uint32_t idx)
+{
+	pos->base = (char *)dma_vir_base() + region->offset;
+	pos->size = region->size;
+	pos->off = idx;
+}
+
+
 static int audio_region_write_from_linear(
 	struct audio_region_t *region,
 	const void *linear_buf,
@@ -700,9 +1066,9 @@ static int audio_region_write_from_linear(
 {
 	uint32_t count_align = DO_BYTE_ALIGN(count, ADSP_CACHE_ALIGN_MASK);
 
+	struct audio_ring_pos_t src;
+	struct audio_ring_pos_t dst;
 	uint32_t free_space = 0;
-	uint8_t *base = NULL;
-	uint32_t w2e = 0;
 
 	if (!region || !linear_buf || !dma_vir_base())
 		return -EFAULT;
@@ -731,24 +1097,14 @@ static int audio_region_write_from_linear(
 		return -EOVERFLOW;
 	}
 
-	base = dma_vir_base() + region->offset;
+	src.base = (char *)linear_buf;
+	src.size = count;
+	src.off = 0;
+	audio_region_pos(&dst, region, region->write_idx);
+	audio_ring_copy(&dst, &src, count);
 
-	if (region->read_idx <= region->write_idx) {
-		w2e = region->size - region->write_idx;
-		if (count_align <= w2e) {
-			memcpy(base + region->write_idx, linear_buf, count);
-			region->write_idx += count_align;
-			if (region->write_idx == region->size)
-				region->write_idx = 0;
-		} else {
-			memcpy(base + region->write_idx, linear_buf, w2e);
-			memcpy(base, (uint8_t *)linear_buf + w2e, count - w2e);
-			region->write_idx = count_align - w2e;
-		}
-	} else {
-		memcpy(base + region->write_idx, linear_buf, count);
-		region->write_idx += count_align;
-	}
+	/* the padding up to count_align is skipped, not written */
+	region->write_idx = (region->write_idx + count_align) % region->size;
 
 
 	DUMP_REGION(ipi_dbg, "out", region, count);
@@ -757,18 +1113,17 @@ static int audio_region_write_from_linear(
 }
 
 
-static int audio_region_read_to_linear(
-	void *linear_buf,
+static int audio_region_read_to_pos(
+	struct audio_ring_pos_t *dst,
 	struct audio_region_t *region,
 	uint32_t count)
 {
 	uint32_t count_align = DO_BYTE_ALIGN(count, ADSP_CACHE_ALIGN_MASK);
 
+	struct audio_ring_pos_t src;
 	uint32_t available_count = 0;
-	uint8_t *base = NULL;
-	uint32_t r2e = 0;
 
-	if (!region || !linear_buf || !dma_vir_base())
+	if (!region || !dst || !dma_vir_base())
 		return -EFAULT;
 
 	if (region->size == 0) {
@@ -795,24 +1150,10 @@ static int audio_region_read_to_linear(
 		return -ENOMEM;
 	}
 
-	base = dma_vir_base() + region->offset;
+	audio_region_pos(&src, region, region->read_idx);
+	audio_ring_copy(dst, &src, count);
 
-	if (region->read_idx <= region->write_idx) {
-		memcpy(linear_buf, base + region->read_idx, count);
-		region->read_idx += count_align;
-	} else {
-		r2e = region->size - region->read_idx;
-		if (r2e >= count_align) {
-			memcpy(linear_buf, base + region->read_idx, count);
-			region->read_idx += count_align;
-			if (region->read_idx == region->size)
-				region->read_idx = 0;
-		} else {
-			memcpy(linear_buf, base + region->read_idx, r2e);
-			memcpy((uint8_t *)linear_buf + r2e, base, count - r2e);
-			region->read_idx = count_align - r2e;
-		}
-	}
+	region->read_idx = (region->read_idx + count_align) % region->size;
 
 	DUMP_REGION(ipi_dbg, "out", region, count);
 
@@ -820,6 +1161,24 @@ static int audio_region_read_to_linear(
 }
 
 
+static int audio_region_read_to_linear(
+	void *linear_buf,
+	struct audio_region_t *region,
+	uint32_t count)
+{
+	struct audio_ring_pos_t dst;
+
+	if (!linear_buf)
+		return -EFAULT;
+
+	dst.base = linear_buf;
+	dst.size = count;
+	dst.off = 0;
+
+	return audio_region_read_to_pos(&dst, region, count);
+}
+
+
 static int audio_region_drop(
 	struct audio_region_t *region,
 	uint32_t count)
@@ -913,6 +1272,27 @@ int audio_ipi_dma_write_region(const uint8_t task,
 }
 
 
+static struct audio_region_t *audio_ipi_dma_get_read_region(
+	const uint8_t task,
+	uint32_t data_size,
+	uint32_t read_idx)
+{
+	struct audio_region_t *region = NULL;
+
+	region = &g_dma->region[task][AUDIO_IPI_DMA_SCP_TO_AP];
+	DUMP_REGION(ipi_dbg, "region", region, data_size);
+
+	/* check read index */
+	if (read_idx != region->read_idx) {
+		pr_debug("read_idx 0x%x != region->read_idx 0x%x!!",
+			 read_idx, region->read_idx);
+		region->read_idx = read_idx;
+	}
+
+	return region;
+}
+
+
 int audio_ipi_dma_read_region(const uint8_t task,
 			      void *data_buf,
 			      uint32_t data_size,
@@ -935,15 +1315,7 @@ int audio_ipi_dma_read_region(const uint8_t task,
 		return -ENODATA;
 	}
 
-	region = &g_dma->region[task][AUDIO_IPI_DMA_SCP_TO_AP];
-	DUMP_REGION(ipi_dbg, "region", region, data_size);
-
-	/* check read index */
-	if (read_idx != region->read_idx) {
-		pr_debug("read_idx 0x%x != region->read_idx 0x%x!!",
-			 read_idx, region->read_idx);
-		region->read_idx = read_idx;
-	}
+	region = audio_ipi_dma_get_read_region(task, data_size, read_idx);
 
 	/* read data */
 	ret = audio_region_read_to_linear(data_buf, region, data_size);
@@ -952,6 +1324,44 @@ int audio_ipi_dma_read_region(const uint8_t task,
 }
 
 
+/* DSP -> AP region straight into a kernel ringbuf, without a bounce copy */
+static int audio_ipi_dma_read_region_to_ringbuf(const uint8_t task,
+						struct audio_ringbuf_t *rb,
+						uint32_t data_size,
+						uint32_t read_idx)
+{
+	struct audio_region_t *region = NULL;
+	struct audio_ring_pos_t dst;
+
+	int ret = 0;
+
+	if (task >= TASK_SCENE_SIZE) {
+		pr_info("task: %d", task);
+		return -EOVERFLOW;
+	}
+	if (!rb || !rb->base || !g_dma) {
+		pr_info("rb %p, dma %p NULL!!", rb, g_dma);
+		return -EFAULT;
+	}
+	if (data_size == 0) {
+		pr_info("task: %d, data_size = 0", task);
+		return -ENODATA;
+	}
+
+	region = audio_ipi_dma_get_read_region(task, data_size, read_idx);
+
+	dst.base = rb->base;
+	dst.size = rb->size;
+	dst.off = rb->write - rb->base;
+
+	ret = audio_region_read_to_pos(&dst, region, data_size);
+	if (ret == 0)
+		rb->write = rb->base + dst.off;
+
+	return ret;
+}
+
+
 int audio_ipi_dma_drop_region(const uint8_t task,
 			      uint32_t drop_size,
 			      uint32_t read_idx)
@@ -1085,9 +1495,6 @@ static int hal_dma_push(
 	uint32_t *p_idx_msg)
 {
 	int retval = 0;
-#if 0
-	uint32_t i = 0;
-#endif
 
 	if (msg_queue == NULL || p_ipi_msg == NULL || p_idx_msg == NULL) {
 		pr_info("NULL!! msg_queue: %p, p_ipi_msg: %p, p_idx_msg: %p",
@@ -1119,17 +1526,20 @@ static int hal_dma_push(
 		return -EOVERFLOW;
 	}
 
-	retval = audio_ipi_dma_read_region(
+	if (p_ipi_msg->dma_info.data_size >
+	    audio_ringbuf_free_space(&msg_queue->dma_data)) {
+		pr_notice("task: %d, msg_id: 0x%x, data_size %u > free %u, drop it",
+			  p_ipi_msg->task_scene, p_ipi_msg->msg_id,
+			  p_ipi_msg->dma_info.data_size,
+			  audio_ringbuf_free_space(&msg_queue->dma_data));
+		return -EOVERFLOW;
+	}
+
+	retval = audio_ipi_dma_read_region_to_ringbuf(
 			 p_ipi_msg->task_scene,
-			 msg_queue->tmp_buf_d2k,
+			 &msg_queue->dma_data,
 			 p_ipi_msg->dma_info.data_size,
 			 p_ipi_msg->dma_info.rw_idx);
-
-#if 0
-	for (i = 0; i < p_ipi_msg->dma_info.data_size; i++)
-		pr_info("%d", msg_queue->tmp_buf_d2k[i]);
-#endif
-
 	if (retval != 0)
 		return retval;
 
@@ -1144,10 +1554,6 @@ static int hal_dma_push(
 	memcpy((void *)&msg_queue->msg[*p_idx_msg],
 	       p_ipi_msg,
 	       sizeof(struct ipi_msg_t));
-	audio_ringbuf_copy_from_linear_impl(
-		&msg_queue->dma_data,
-		msg_queue->tmp_buf_d2k,
-		p_ipi_msg->dma_info.data_size);
 
 
 	ipi_dbg("task: %d, msg_id: 0x%x, idx_r: %u, idx_w: %u, queue(%u/%u), *p_idx_msg: %u",
@@ -1199,55 +1605,31 @@ static int hal_dma_pop(struct hal_dma_queue_t *msg_queue)
 }
 
 
-static int hal_dma_front(
+/* copy one queued message and its payload to user, without popping it */
+static int hal_dma_copy_msg_to_user(
 	struct hal_dma_queue_t *msg_queue,
-	struct ipi_msg_t **pp_ipi_msg,
-	uint32_t *p_idx_msg)
+	const struct ipi_msg_t *p_ipi_msg,
+	char __user *buf)
 {
-	uint32_t data_size = 0;
+	const struct audio_ringbuf_t *rb = &msg_queue->dma_data;
+	uint32_t data_size = p_ipi_msg->dma_info.data_size;
+	uint32_t r2e = 0;
 
-	if (msg_queue == NULL || pp_ipi_msg == NULL || p_idx_msg == NULL) {
-		pr_info("NULL!! msg_queue: %p, pp_ipi_msg: %p, p_idx_msg: %p",
-			msg_queue, pp_ipi_msg, p_idx_msg);
+	if (copy_to_user(buf, p_ipi_msg, sizeof(struct ipi_msg_t)))
 		return -EFAULT;
-	}
-
-	*pp_ipi_msg = NULL;
-	*p_idx_msg = 0xFFFFFFFF;
-
-	/* check queue empty */
-	if (hal_dma_check_queue_empty(msg_queue) == true) {
-		pr_info("queue empty, idx_r: %u, idx_w: %u",
-			msg_queue->idx_r, msg_queue->idx_w);
-		return -ENOMEM;
-	}
-
-	/* front */
-	if (hal_dma_check_idx_msg_valid(msg_queue, msg_queue->idx_r) == false) {
-		pr_info("idx_r %u is invalid!! return",
-			msg_queue->idx_r);
-		return -1;
-	}
-	*p_idx_msg = msg_queue->idx_r;
-	*pp_ipi_msg = &msg_queue->msg[*p_idx_msg];
+	buf += sizeof(struct ipi_msg_t);
 
-	data_size =  + (*pp_ipi_msg)->dma_info.data_size;
-
-	if ((data_size + sizeof(struct ipi_msg_t)) > MAX_DSP_DMA_WRITE_SIZE) {
-		pr_notice("%u + %zu > %u!!",
-			  data_size, sizeof(struct ipi_msg_t),
-			  MAX_DSP_DMA_WRITE_SIZE);
-		hal_dma_pop(msg_queue);
-		return -EOVERFLOW;
+	/* the writer only appends, so the payload at read is stable here */
+	r2e = (rb->base + rb->size) - rb->read;
+	if (data_size <= r2e) {
+		if (copy_to_user(buf, rb->read, data_size))
+			return -EFAULT;
+	} else {
+		if (copy_to_user(buf, rb->read, r2e) ||
+		    copy_to_user(buf + r2e, rb->base, data_size - r2e))
+			return -EFAULT;
 	}
 
-	memcpy(msg_queue->tmp_buf_k2h, *pp_ipi_msg, sizeof(struct ipi_msg_t));
-
-	audio_ringbuf_copy_to_linear(
-		msg_queue->tmp_buf_k2h + sizeof(struct ipi_msg_t),
-		&msg_queue->dma_data,
-		data_size);
-
 	return 0;
 }
 
@@ -1278,8 +1660,7 @@ static int hal_dma_init_msg_queue(struct hal_dma_queue_t *msg_queue)
 	msg_queue->dma_data.read = msg_queue->dma_data.base;
 	msg_queue->dma_data.write = msg_queue->dma_data.base;
 
-	msg_queue->tmp_buf_d2k = vmalloc(MAX_DSP_DMA_WRITE_SIZE);
-	msg_queue->tmp_buf_k2h = vmalloc(MAX_DSP_DMA_WRITE_SIZE);
+	mutex_init(&msg_queue->read_lock);
 
 
 	return 0;
@@ -1297,76 +1678,12 @@ static int hal_dma_deinit_msg_queue(struct hal_dma_queue_t *msg_queue)
 		msg_queue->dma_data.base = NULL;
 	}
 
-	if (msg_queue->tmp_buf_d2k != NULL) {
-		vfree(msg_queue->tmp_buf_d2k);
-		msg_queue->tmp_buf_d2k = NULL;
-	}
-	if (msg_queue->tmp_buf_k2h != NULL) {
-		vfree(msg_queue->tmp_buf_k2h);
-		msg_queue->tmp_buf_k2h = NULL;
-	}
-
 
 	return 0;
 }
 
 
 
-static int hal_dma_get_queue_msg(
-	struct hal_dma_queue_t *msg_queue,
-	struct ipi_msg_t **pp_ipi_msg,
-	uint32_t *p_idx_msg)
-{
-	bool is_empty = true;
-
-	unsigned long flags = 0;
-	int retval = 0;
-
-	uint32_t try_cnt = 0;
-	const uint32_t k_max_try_cnt = 10; /* retry 1 sec for -ERESTARTSYS */
-	const uint32_t k_restart_sleep_ms = 100; /* 100 ms */
-
-	spin_lock_irqsave(&msg_queue->queue_lock, flags);
-	is_empty = hal_dma_check_queue_empty(msg_queue);
-	spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
-
-	/* wait until message is pushed to queue */
-	if (is_empty == true) {
-		for (try_cnt = 0; try_cnt < k_max_try_cnt; try_cnt++) {
-			retval = wait_event_interruptible(
-					 msg_queue->queue_wq,
-					 !hal_dma_check_queue_empty(msg_queue));
-
-			if (hal_dma_check_queue_empty(msg_queue) == false) {
-				retval = 0;
-				break;
-			}
-			if (retval == 0) { /* got msg in queue */
-				pr_notice("wait ret 0, empty %d",
-					  hal_dma_check_queue_empty(msg_queue));
-				break;
-			}
-			if (retval == -ERESTARTSYS) {
-				pr_info("-ERESTARTSYS, #%u, sleep ms: %u",
-					try_cnt, k_restart_sleep_ms);
-				retval = -EINTR;
-				msleep(k_restart_sleep_ms);
-				continue;
-			}
-			pr_notice("retval: %d not handle!!", retval);
-		}
-	}
-
-	if (hal_dma_check_queue_empty(msg_queue) == false) {
-		spin_lock_irqsave(&msg_queue->queue_lock, flags);
-		retval = hal_dma_front(msg_queue, pp_ipi_msg, p_idx_msg);
-		spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
-	}
-
-	return retval;
-}
-
-
 int audio_ipi_dma_msg_to_hal(struct ipi_msg_t *p_ipi_msg)
 {
 	struct hal_dma_queue_t *msg_queue = &g_hal_dma_queue;
@@ -1412,63 +1729,102 @@ int audio_ipi_dma_msg_to_hal(struct ipi_msg_t *p_ipi_msg)
 }
 
 
-size_t audio_ipi_dma_msg_read(void __user *buf, size_t count)
+ssize_t audio_ipi_dma_msg_read(void __user *buf, size_t count,
+			       bool nonblock, bool batch)
 {
 	struct hal_dma_queue_t *msg_queue = &g_hal_dma_queue;
 	struct ipi_msg_t *p_ipi_msg = NULL;
-	uint32_t idx_msg = 0;
 
 	size_t copy_size = 0;
+	size_t total = 0;
 
 	unsigned long flags = 0;
 	int retval = 0;
 
-	if (buf == NULL || count == 0 || msg_queue == NULL) {
-		pr_info("arg!! %p %zu %p, return", buf, count, msg_queue);
-		msleep(500);
-		return 0;
+	if (buf == NULL || count == 0) {
+		pr_info("arg!! %p %zu, return", buf, count);
+		return -EINVAL;
 	}
 
+	if (mutex_lock_interruptible(&msg_queue->read_lock))
+		return -ERESTARTSYS;
 
 	/* wait until element pushed */
-	retval = hal_dma_get_queue_msg(msg_queue, &p_ipi_msg, &idx_msg);
-	if (retval != 0) {
-		pr_info("hal_dma_get_queue_msg retval %d", retval);
-		msleep(100);
-		return 0;
+	if (hal_dma_check_queue_empty(msg_queue) == true) {
+		if (nonblock) {
+			retval = -EAGAIN;
+			goto read_exit;
+		}
+		retval = wait_event_interruptible(
+				 msg_queue->queue_wq,
+				 !hal_dma_check_queue_empty(msg_queue));
+		if (retval != 0)
+			goto read_exit;
 	}
-	p_ipi_msg = &msg_queue->msg[idx_msg];
+
+	/* drain as many messages as fit in buf in batch mode, else one */
+	do {
+		spin_lock_irqsave(&msg_queue->queue_lock, flags);
+		if (hal_dma_check_queue_empty(msg_queue) == true) {
+			spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
+			break;
+		}
+		p_ipi_msg = &msg_queue->msg[msg_queue->idx_r];
+		spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
 
 #if 0
-	DUMP_IPI_MSG("dma kernel -> hal", p_ipi_msg);
+		DUMP_IPI_MSG("dma kernel -> hal", p_ipi_msg);
 #endif
 
-	/* copy data */
-	copy_size = sizeof(struct ipi_msg_t) +
-		    p_ipi_msg->dma_info.data_size;
-	if (count < copy_size) {
-		pr_notice("%zu < %zu + %u!! drop",
-			  count,
-			  sizeof(struct ipi_msg_t),
-			  p_ipi_msg->dma_info.data_size);
-		copy_size = 0;
-	} else {
-		retval = copy_to_user(
-				 buf,
-				 msg_queue->tmp_buf_k2h,
-				 copy_size);
-		if (retval != 0)
-			pr_info("hal_dma_get_queue_msg retval %d", retval);
-	}
+		copy_size = sizeof(struct ipi_msg_t) +
+			    p_ipi_msg->dma_info.data_size;
+		if (count - total < copy_size) {
+			if (total != 0) /* keep it for the next read */
+				break;
+			pr_notice("%zu < %zu + %u!! drop",
+				  count,
+				  sizeof(struct ipi_msg_t),
+				  p_ipi_msg->dma_info.data_size);
+			copy_size = 0;
+		} else {
+			retval = hal_dma_copy_msg_to_user(
+					 msg_queue,
+					 p_ipi_msg,
+					 (char __user *)buf + total);
+			if (retval != 0) {
+				pr_info("copy msg to user retval %d", retval);
+				break;
+			}
+		}
 
+		/* pop message and its payload from queue */
+		spin_lock_irqsave(&msg_queue->queue_lock, flags);
+		audio_ringbuf_drop_data(&msg_queue->dma_data,
+					p_ipi_msg->dma_info.data_size);
+		hal_dma_pop(msg_queue);
+		spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
 
-	/* pop message from queue */
-	spin_lock_irqsave(&msg_queue->queue_lock, flags);
-	hal_dma_pop(msg_queue);
-	spin_unlock_irqrestore(&msg_queue->queue_lock, flags);
+		total += copy_size;
+	} while (batch && copy_size != 0);
 
-	return copy_size;
+read_exit:
+	mutex_unlock(&msg_queue->read_lock);
+
+	if (total != 0)
+		return total;
+
+	return retval;
 }
 
 
+unsigned int audio_ipi_dma_msg_poll(struct file *file, poll_table *wait)
+{
+	struct hal_dma_queue_t *msg_queue = &g_hal_dma_queue;
 
+	poll_wait(file, &msg_queue->queue_wq, wait);
+
+	if (hal_dma_check_queue_empty(msg_queue) == false)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
@@ -16,6 +16,7 @@
 #define AUDUI_IPI_DMA_H
 
 #include <linux/types.h>
+#include <linux/poll.h>
 
 
 
@@ -131,7 +132,16 @@ int audio_ipi_dma_drop_region(const uint8_t task,
 
 int audio_ipi_dma_msg_to_hal(struct ipi_msg_t *p_ipi_msg);
 
-size_t audio_ipi_dma_msg_read(void __user *buf, size_t count);
+/*
+ * Copy queued DSP -> HAL messages to buf, each one as struct ipi_msg_t
+ * followed by its dma_info.data_size bytes of payload. Only one message
+ * is returned unless batch is set, in which case every message fitting
+ * in count is.
+ */
+ssize_t audio_ipi_dma_msg_read(void __user *buf, size_t count,
+			       bool nonblock, bool batch);
+
+unsigned int audio_ipi_dma_msg_poll(struct file *file, poll_table *wait);
 
 
 
@@ -97,6 +97,7 @@
 #define AUDIO_IPI_IOCTL_INIT_DSP     _IOW(AUDIO_IPI_IOC_MAGIC, 20, unsigned int)
 #define AUDIO_IPI_IOCTL_REG_DMA      _IOW(AUDIO_IPI_IOC_MAGIC, 21, unsigned int)
 #define AUDIO_IPI_IOCTL_ADSP_REG_FEA _IOW(AUDIO_IPI_IOC_MAGIC, 22, unsigned int)
+#define AUDIO_IPI_IOCTL_READ_BATCH   _IOW(AUDIO_IPI_IOC_MAGIC, 23, unsigned int)
 
 
 
@@ -106,6 +107,10 @@
  * =============================================================================
  */
 
+struct audio_ipi_file_t {
+	bool read_batch; /* read() returns all pending msgs fitting in buf */
+};
+
 #ifdef CONFIG_MTK_AUDIODSP_SUPPORT
 struct audio_ipi_reg_dma_t {
 	uint8_t task;
@@ -331,6 +336,7 @@ parsing_exit:
 static long audio_ipi_driver_ioctl(
 	struct file *file, unsigned int cmd, unsigned long arg)
 {
+	struct audio_ipi_file_t *ipi_file = file->private_data;
 #if defined(CONFIG_MTK_AUDIODSP_SUPPORT)
 	struct audio_ipi_reg_dma_t dma_reg;
 	struct audio_ipi_reg_feature_t feat_reg;
@@ -355,6 +361,11 @@ static long audio_ipi_driver_ioctl(
 				 (void __user *)arg, AUDIO_IPI_DMA);
 		break;
 	}
+	case AUDIO_IPI_IOCTL_READ_BATCH: {
+		pr_debug("AUDIO_IPI_IOCTL_READ_BATCH(%lu)", arg);
+		ipi_file->read_batch = (arg != 0);
+		break;
+	}
 	case AUDIO_IPI_IOCTL_LOAD_SCENE: {
 		pr_debug("AUDIO_IPI_IOCTL_LOAD_SCENE(%d)", (uint8_t)arg);
 		audio_load_task((uint8_t)arg);
@@ -440,11 +451,47 @@ static long audio_ipi_driver_compat_ioctl(
 #endif
 
 
+static int audio_ipi_driver_open(struct inode *inode, struct file *file)
+{
+	struct audio_ipi_file_t *ipi_file = NULL;
+
+	ipi_file = kzalloc(sizeof(struct audio_ipi_file_t), GFP_KERNEL);
+	if (ipi_file == NULL)
+		return -ENOMEM;
+
+	file->private_data = ipi_file;
+	return 0;
+}
+
+
+static int audio_ipi_driver_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	file->private_data = NULL;
+	return 0;
+}
+
+
 static ssize_t audio_ipi_driver_read(
 	struct file *file, char __user *buf, size_t count, loff_t *ppos)
 {
 #if defined(CONFIG_MTK_AUDIODSP_SUPPORT)
-	return audio_ipi_dma_msg_read(buf, count);
+	struct audio_ipi_file_t *ipi_file = file->private_data;
+
+	return audio_ipi_dma_msg_read(buf, count,
+				      (file->f_flags & O_NONBLOCK) != 0,
+				      ipi_file->read_batch);
+#else
+	return 0;
+#endif
+}
+
+
+static unsigned int audio_ipi_driver_poll(
+	struct file *file, poll_table *wait)
+{
+#if defined(CONFIG_MTK_AUDIODSP_SUPPORT)
+	return audio_ipi_dma_msg_poll(file, wait);
 #else
 	return 0;
 #endif
@@ -454,7 +501,10 @@ static ssize_t audio_ipi_driver_read(
 
 static const struct file_operations audio_ipi_driver_ops = {
 	.owner          = THIS_MODULE,
+	.open           = audio_ipi_driver_open,
+	.release        = audio_ipi_driver_release,
 	.read           = audio_ipi_driver_read,
+	.poll           = audio_ipi_driver_poll,
 	.unlocked_ioctl = audio_ipi_driver_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl   = audio_ipi_driver_compat_ioctl,
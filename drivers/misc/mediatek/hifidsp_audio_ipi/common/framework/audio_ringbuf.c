@@ -17,6 +17,7 @@
 #include <linux/vmalloc.h>
 
 #include <audio_assert.h>
+#include <audio_ringcopy.h>
 
 
 
@@ -52,6 +53,38 @@
 
 
 
+static inline void ringbuf_read_pos(
+	struct audio_ring_pos_t *pos,
+	const struct audio_ringbuf_t *rb)
+{
+	pos->base = rb->base;
+	pos->size = rb->size;
+	pos->off = rb->read - rb->base;
+}
+
+
+static inline void ringbuf_write_pos(
+	struct audio_ring_pos_t *pos,
+	const struct audio_ringbuf_t *rb)
+{
+	pos->base = rb->base;
+	pos->size = rb->size;
+	pos->off = rb->write - rb->base;
+}
+
+
+static inline void linear_pos(
+	struct audio_ring_pos_t *pos,
+	const char *linear,
+	const uint32_t count)
+{
+	pos->base = (char *)linear;
+	pos->size = count;
+	pos->off = 0;
+}
+
+
+
 uint32_t audio_ringbuf_count(const struct audio_ringbuf_t *rb)
 {
 	uint32_t count = 0;
@@ -109,8 +142,8 @@ void audio_ringbuf_copy_to_linear(
 	struct audio_ringbuf_t *rb,
 	uint32_t count)
 {
-	char *end = NULL;
-	uint32_t r2e = 0;
+	struct audio_ring_pos_t src;
+	struct audio_ring_pos_t dst;
 
 	if (!count)
 		return;
@@ -130,23 +163,10 @@ void audio_ringbuf_copy_to_linear(
 	}
 
 
-	if (rb->read <= rb->write) {
-		memcpy(linear, rb->read, count);
-		rb->read += count;
-	} else {
-		end = rb->base + rb->size;
-		r2e = end - rb->read;
-		if (count <= r2e) {
-			memcpy(linear, rb->read, count);
-			rb->read += count;
-			if (rb->read == end)
-				rb->read = rb->base;
-		} else {
-			memcpy(linear, rb->read, r2e);
-			memcpy(linear + r2e, rb->base, count - r2e);
-			rb->read = rb->base + count - r2e;
-		}
-	}
+	ringbuf_read_pos(&src, rb);
+	linear_pos(&dst, linear, count);
+	audio_ring_copy(&dst, &src, count);
+	rb->read = rb->base + src.off;
 }
 
 
@@ -155,8 +175,8 @@ void audio_ringbuf_copy_from_linear_impl(
 	const char *linear,
 	uint32_t count)
 {
-	char *end = NULL;
-	uint32_t w2e = 0;
+	struct audio_ring_pos_t src;
+	struct audio_ring_pos_t dst;
 
 	if (!count)
 		return;
@@ -176,24 +196,10 @@ void audio_ringbuf_copy_from_linear_impl(
 	}
 
 
-	end = rb->base + rb->size;
-
-	if (rb->read <= rb->write) {
-		w2e = end - rb->write;
-		if (count <= w2e) {
-			memcpy(rb->write, linear, count);
-			rb->write += count;
-			if (rb->write == end)
-				rb->write = rb->base;
-		} else {
-			memcpy(rb->write, linear, w2e);
-			memcpy(rb->base, linear + w2e, count - w2e);
-			rb->write = rb->base + count - w2e;
-		}
-	} else {
-		memcpy(rb->write, linear, count);
-		rb->write += count;
-	}
+	linear_pos(&src, linear, count);
+	ringbuf_write_pos(&dst, rb);
+	audio_ring_copy(&dst, &src, count);
+	rb->write = rb->base + dst.off;
 }
 
 
@@ -220,8 +226,8 @@ void audio_ringbuf_copy_from_ringbuf_impl(
 	struct audio_ringbuf_t *rb_src,
 	uint32_t count)
 {
-	char *end = NULL;
-	uint32_t r2e = 0;
+	struct audio_ring_pos_t src;
+	struct audio_ring_pos_t dst;
 
 	if (!count)
 		return;
@@ -234,6 +240,11 @@ void audio_ringbuf_copy_from_ringbuf_impl(
 		AUD_WARNING("no init");
 		return;
 	}
+	if (!rb_des->base || !rb_des->size) {
+		DUMP_RINGBUF(pr_notice, "no init", rb_des, count);
+		AUD_WARNING("no init");
+		return;
+	}
 	if (count > audio_ringbuf_count(rb_src)) {
 		DUMP_RINGBUF(pr_notice, "underflow", rb_src, count);
 		AUD_WARNING("underflow");
@@ -246,35 +257,12 @@ void audio_ringbuf_copy_from_ringbuf_impl(
 	}
 
 
-	if (rb_src->read <= rb_src->write) {
-		audio_ringbuf_copy_from_linear_impl(
-			rb_des,
-			rb_src->read,
-			count);
-		rb_src->read += count;
-	} else {
-		end = rb_src->base + rb_src->size;
-		r2e = end - rb_src->read;
-		if (r2e >= count) {
-			audio_ringbuf_copy_from_linear_impl(
-				rb_des,
-				rb_src->read,
-				count);
-			rb_src->read += count;
-			if (rb_src->read == end)
-				rb_src->read = rb_src->base;
-		} else {
-			audio_ringbuf_copy_from_linear_impl(
-				rb_des,
-				rb_src->read,
-				r2e);
-			audio_ringbuf_copy_from_linear_impl(
-				rb_des,
-				rb_src->base,
-				count - r2e);
-			rb_src->read = rb_src->base + count - r2e;
-		}
-	}
+	/* both wrap points in one pass, no per-segment re-validation */
+	ringbuf_read_pos(&src, rb_src);
+	ringbuf_write_pos(&dst, rb_des);
+	audio_ring_copy(&dst, &src, count);
+	rb_src->read = rb_src->base + src.off;
+	rb_des->write = rb_des->base + dst.off;
 }
 
 
@@ -325,8 +313,7 @@ void audio_ringbuf_write_value(
 	const uint8_t value,
 	const uint32_t count)
 {
-	char *end = NULL;
-	uint32_t w2e = 0;
+	struct audio_ring_pos_t dst;
 
 	if (!count)
 		return;
@@ -348,24 +335,9 @@ void audio_ringbuf_write_value(
 	}
 
 
-	end = rb->base + rb->size;
-
-	if (rb->read <= rb->write) {
-		w2e = end - rb->write;
-		if (count <= w2e) {
-			memset(rb->write, value, count);
-			rb->write += count;
-			if (rb->write == end)
-				rb->write = rb->base;
-		} else {
-			memset(rb->write, value, w2e);
-			memset(rb->base, value, count - w2e);
-			rb->write = rb->base + count - w2e;
-		}
-	} else {
-		memset(rb->write, value, count);
-		rb->write += count;
-	}
+	ringbuf_write_pos(&dst, rb);
+	audio_ring_fill(&dst, value, count);
+	rb->write = rb->base + dst.off;
 }
 
 
@@ -431,10 +403,8 @@ void audio_ringbuf_compensate_value_impl(
 	const uint8_t value,
 	const uint32_t count)
 {
-	char *end = NULL;
-
+	struct audio_ring_pos_t dst;
 	uint32_t b2r = 0;
-	uint32_t left_data = 0;
 
 	if (!count)
 		return;
@@ -454,28 +424,15 @@ void audio_ringbuf_compensate_value_impl(
 		return;
 	}
 
-	end = rb->base + rb->size;
-
-	if (rb->read <= rb->write) {
-		b2r = rb->read - rb->base;
-		if (b2r >= count) {
-			rb->read -= count;
-			memset(rb->read, value, count);
-		} else {
-			if (b2r > 0) { /* in case read == base */
-				memset(rb->base, value, b2r);
-				left_data = count - b2r;
-				rb->read = end - left_data;
-				memset(rb->read, value, left_data);
-			} else {
-				rb->read = end - count;
-				memset(rb->read, value, count);
-			}
-		}
-	} else {
+	/* move read back by count, then fill forward up to the old read */
+	b2r = rb->read - rb->base;
+	if (b2r >= count)
 		rb->read -= count;
-		memset(rb->read, value, count);
-	}
+	else
+		rb->read = rb->base + rb->size - (count - b2r);
+
+	ringbuf_read_pos(&dst, rb);
+	audio_ring_fill(&dst, value, count);
 }
 
 
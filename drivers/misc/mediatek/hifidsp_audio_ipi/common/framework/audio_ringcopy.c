@@ -0,0 +1,419 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#include <audio_ringcopy.h>
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+#include <asm/neon.h>
+#include <asm/simd.h>
+#include "audio_ringcopy_neon.h"
+#endif
+
+#include <audio_assert.h>
+
+
+
+#ifdef LOG_TAG
+#undef LOG_TAG
+#endif
+#define LOG_TAG "audio_ringcopy"
+
+
+
+/*
+ * =============================================================================
+ *                     MACRO
+ * =============================================================================
+ */
+
+/*
+ * Plain byte moves stay on memcpy()/memset(): the ARM string routines are
+ * already burst ldm/stm with preload, and entering kernel mode NEON costs a
+ * VFP context save, so NEON only pays off where the scalar code has to
+ * touch every sample (format conversion and (de)interleave).
+ */
+#define AUDIO_RING_SIMD_MIN_SAMPLES (64)
+
+
+#define DUMP_RING_POS(LOG_F, description, pos, count) \
+	do { \
+		LOG_F("%s(), %s, base %p, size %u, off %u, count %u\n", \
+		      __func__, description, \
+		      (pos)->base, (pos)->size, (pos)->off, count); \
+	} while (0)
+
+
+
+/*
+ * =============================================================================
+ *                     private
+ * =============================================================================
+ */
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+static bool audio_ring_simd = true;
+module_param_named(simd, audio_ring_simd, bool, 0644);
+#endif
+
+
+static inline bool audio_ring_use_simd(const uint32_t samples)
+{
+#ifdef CONFIG_KERNEL_MODE_NEON
+	return READ_ONCE(audio_ring_simd) &&
+	       samples >= AUDIO_RING_SIMD_MIN_SAMPLES &&
+	       may_use_simd();
+#else
+	return false;
+#endif
+}
+
+
+static bool audio_ring_pos_valid(struct audio_ring_pos_t *pos, uint32_t count)
+{
+	if (!pos || !pos->base || !pos->size) {
+		AUD_WARNING("no init");
+		return false;
+	}
+	if (count > pos->size) {
+		DUMP_RING_POS(pr_notice, "count > size", pos, count);
+		AUD_WARNING("overflow");
+		return false;
+	}
+	if (pos->off >= pos->size) {
+		DUMP_RING_POS(pr_notice, "off fail", pos, count);
+		pos->off %= pos->size;
+	}
+
+	return true;
+}
+
+
+static inline void audio_ring_advance(
+	struct audio_ring_pos_t *pos,
+	const uint32_t count)
+{
+	pos->off += count;
+	if (pos->off == pos->size)
+		pos->off = 0;
+}
+
+
+/*
+ * Sample conversion keeps the value MSB aligned: input is shifted up to
+ * full scale (lsh, 8 for S24) and down to the output width (rsh).
+ */
+static void fmt_w16to32(int32_t *dst, const int16_t *src,
+			uint32_t n, uint32_t rsh)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (int32_t)((uint32_t)src[i] << 16) >> rsh;
+}
+
+
+static void fmt_n32to16(int16_t *dst, const int32_t *src,
+			uint32_t n, uint32_t lsh)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (int32_t)((uint32_t)src[i] << lsh) >> 16;
+}
+
+
+static void fmt_c32to32(int32_t *dst, const int32_t *src,
+			uint32_t n, uint32_t lsh, uint32_t rsh)
+{
+	uint32_t i = 0;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (int32_t)((uint32_t)src[i] << lsh) >> rsh;
+}
+
+
+
+/*
+ * =============================================================================
+ *                     public
+ * =============================================================================
+ */
+
+uint32_t audio_ring_fmt_bytes(const uint8_t fmt)
+{
+	return (fmt == AUDIO_RING_FMT_S16) ? 2 : 4;
+}
+EXPORT_SYMBOL(audio_ring_fmt_bytes);
+
+
+void audio_ring_copy(
+	struct audio_ring_pos_t *dst,
+	struct audio_ring_pos_t *src,
+	uint32_t count)
+{
+	uint32_t seg = 0;
+
+	if (!count)
+		return;
+	if (!audio_ring_pos_valid(dst, count) ||
+	    !audio_ring_pos_valid(src, count))
+		return;
+
+	/* at most three segments: up to each of the two wrap points */
+	while (count) {
+		seg = min3(count,
+			   src->size - src->off,
+			   dst->size - dst->off);
+
+		memcpy(dst->base + dst->off, src->base + src->off, seg);
+
+		audio_ring_advance(src, seg);
+		audio_ring_advance(dst, seg);
+		count -= seg;
+	}
+}
+EXPORT_SYMBOL(audio_ring_copy);
+
+
+void audio_ring_fill(
+	struct audio_ring_pos_t *dst,
+	const uint8_t value,
+	uint32_t count)
+{
+	uint32_t seg = 0;
+
+	if (!count)
+		return;
+	if (!audio_ring_pos_valid(dst, count))
+		return;
+
+	while (count) {
+		seg = min(count, dst->size - dst->off);
+		memset(dst->base + dst->off, value, seg);
+		audio_ring_advance(dst, seg);
+		count -= seg;
+	}
+}
+EXPORT_SYMBOL(audio_ring_fill);
+
+
+void audio_fmt_convert(
+	void *dst, const uint8_t dst_fmt,
+	const void *src, const uint8_t src_fmt,
+	const uint32_t samples)
+{
+	uint32_t lsh = (src_fmt == AUDIO_RING_FMT_S24) ? 8 : 0;
+	uint32_t rsh = (dst_fmt == AUDIO_RING_FMT_S24) ? 8 : 0;
+	uint32_t done = 0;
+
+	if (!samples)
+		return;
+	if (!dst || !src) {
+		AUD_WARNING("null");
+		return;
+	}
+	if (dst_fmt >= NUM_AUDIO_RING_FMT || src_fmt >= NUM_AUDIO_RING_FMT) {
+		pr_notice("%s(), fmt %u -> %u fail\n",
+			  __func__, src_fmt, dst_fmt);
+		return;
+	}
+
+	if (dst_fmt == src_fmt) {
+		memcpy(dst, src, samples * audio_ring_fmt_bytes(src_fmt));
+		return;
+	}
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+	if (audio_ring_use_simd(samples)) {
+		kernel_neon_begin();
+		if (src_fmt == AUDIO_RING_FMT_S16)
+			done = audio_ringcopy_w16to32_neon(
+				       dst, src, samples, rsh);
+		else if (dst_fmt == AUDIO_RING_FMT_S16)
+			done = audio_ringcopy_n32to16_neon(
+				       dst, src, samples, lsh);
+		else
+			done = audio_ringcopy_c32to32_neon(
+				       dst, src, samples, lsh, rsh);
+		kernel_neon_end();
+	}
+#endif
+
+	/* scalar tail (or everything without NEON) */
+	if (src_fmt == AUDIO_RING_FMT_S16)
+		fmt_w16to32((int32_t *)dst + done, (const int16_t *)src + done,
+			    samples - done, rsh);
+	else if (dst_fmt == AUDIO_RING_FMT_S16)
+		fmt_n32to16((int16_t *)dst + done, (const int32_t *)src + done,
+			    samples - done, lsh);
+	else
+		fmt_c32to32((int32_t *)dst + done, (const int32_t *)src + done,
+			    samples - done, lsh, rsh);
+}
+EXPORT_SYMBOL(audio_fmt_convert);
+
+
+uint32_t audio_ring_copy_frames(
+	struct audio_ring_pos_t *dst, const uint8_t dst_fmt,
+	struct audio_ring_pos_t *src, const uint8_t src_fmt,
+	const uint32_t channels,
+	const uint32_t frames)
+{
+	uint32_t dst_bytes = audio_ring_fmt_bytes(dst_fmt);
+	uint32_t src_bytes = audio_ring_fmt_bytes(src_fmt);
+	uint32_t samples = frames * channels;
+	uint32_t seg = 0;
+
+	if (!samples)
+		return 0;
+	if (!audio_ring_pos_valid(dst, samples * dst_bytes) ||
+	    !audio_ring_pos_valid(src, samples * src_bytes))
+		return 0;
+
+	/* a sample never straddles a wrap point */
+	if ((dst->size | dst->off) % dst_bytes ||
+	    (src->size | src->off) % src_bytes) {
+		DUMP_RING_POS(pr_notice, "dst unaligned", dst, dst_bytes);
+		DUMP_RING_POS(pr_notice, "src unaligned", src, src_bytes);
+		return 0;
+	}
+
+	while (samples) {
+		seg = min3(samples,
+			   (src->size - src->off) / src_bytes,
+			   (dst->size - dst->off) / dst_bytes);
+
+		audio_fmt_convert(dst->base + dst->off, dst_fmt,
+				  src->base + src->off, src_fmt,
+				  seg);
+
+		audio_ring_advance(src, seg * src_bytes);
+		audio_ring_advance(dst, seg * dst_bytes);
+		samples -= seg;
+	}
+
+	return frames;
+}
+EXPORT_SYMBOL(audio_ring_copy_frames);
+
+
+void audio_deinterleave(
+	void *const *dst,
+	const void *src,
+	const uint32_t sample_bytes,
+	const uint32_t channels,
+	const uint32_t frames)
+{
+	uint32_t done = 0;
+	uint32_t i = 0;
+	uint32_t ch = 0;
+
+	if (!dst || !src || !channels) {
+		AUD_WARNING("null");
+		return;
+	}
+	if (sample_bytes != 2 && sample_bytes != 4) {
+		pr_notice("%s(), sample_bytes %u fail\n",
+			  __func__, sample_bytes);
+		return;
+	}
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+	if ((channels == 2 || channels == 4) &&
+	    audio_ring_use_simd(frames * channels)) {
+		kernel_neon_begin();
+		if (sample_bytes == 2)
+			done = audio_ringcopy_deinterleave16_neon(
+				       (short *const *)dst, src,
+				       channels, frames);
+		else
+			done = audio_ringcopy_deinterleave32_neon(
+				       (int *const *)dst, src,
+				       channels, frames);
+		kernel_neon_end();
+	}
+#endif
+
+	if (sample_bytes == 2) {
+		const int16_t *in = (const int16_t *)src + done * channels;
+
+		for (i = done; i < frames; i++)
+			for (ch = 0; ch < channels; ch++)
+				((int16_t *)dst[ch])[i] = *in++;
+	} else {
+		const int32_t *in = (const int32_t *)src + done * channels;
+
+		for (i = done; i < frames; i++)
+			for (ch = 0; ch < channels; ch++)
+				((int32_t *)dst[ch])[i] = *in++;
+	}
+}
+EXPORT_SYMBOL(audio_deinterleave);
+
+
+void audio_interleave(
+	void *dst,
+	const void *const *src,
+	const uint32_t sample_bytes,
+	const uint32_t channels,
+	const uint32_t frames)
+{
+	uint32_t done = 0;
+	uint32_t i = 0;
+	uint32_t ch = 0;
+
+	if (!dst || !src || !channels) {
+		AUD_WARNING("null");
+		return;
+	}
+	if (sample_bytes != 2 && sample_bytes != 4) {
+		pr_notice("%s(), sample_bytes %u fail\n",
+			  __func__, sample_bytes);
+		return;
+	}
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+	if ((channels == 2 || channels == 4) &&
+	    audio_ring_use_simd(frames * channels)) {
+		kernel_neon_begin();
+		if (sample_bytes == 2)
+			done = audio_ringcopy_interleave16_neon(
+				       dst, (const short *const *)src,
+				       channels, frames);
+		else
+			done = audio_ringcopy_interleave32_neon(
+				       dst, (const int *const *)src,
+				       channels, frames);
+		kernel_neon_end();
+	}
+#endif
+
+	if (sample_bytes == 2) {
+		int16_t *out = (int16_t *)dst + done * channels;
+
+		for (i = done; i < frames; i++)
+			for (ch = 0; ch < channels; ch++)
+				*out++ = ((const int16_t *)src[ch])[i];
+	} else {
+		int32_t *out = (int32_t *)dst + done * channels;
+
+		for (i = done; i < frames; i++)
+			for (ch = 0; ch < channels; ch++)
+				*out++ = ((const int32_t *)src[ch])[i];
+	}
+}
+EXPORT_SYMBOL(audio_interleave);
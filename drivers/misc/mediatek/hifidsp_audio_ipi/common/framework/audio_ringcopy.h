@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef AUDIO_RING_COPY_H
+#define AUDIO_RING_COPY_H
+
+#include <linux/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*
+ * =============================================================================
+ *                     struct def
+ * =============================================================================
+ */
+
+/*
+ * A cursor in a byte ring: off is always in [0, size). A linear buffer is
+ * a ring whose size is at least the number of bytes moved through it.
+ */
+struct audio_ring_pos_t {
+	char    *base;
+	uint32_t size;
+	uint32_t off;
+};
+
+
+enum { /* audio_ring_fmt_t */
+	AUDIO_RING_FMT_S16 = 0,  /* 16 bits in 16 */
+	AUDIO_RING_FMT_S24,      /* 24 bits in 32, LSB aligned */
+	AUDIO_RING_FMT_S32,      /* 32 bits in 32 */
+	NUM_AUDIO_RING_FMT
+};
+
+
+
+/*
+ * =============================================================================
+ *                     ring to ring
+ * =============================================================================
+ */
+
+/*
+ * Copy count bytes from src to dst, splitting at both wrap points, and
+ * advance both cursors. The caller checks data / free space beforehand.
+ */
+void audio_ring_copy(
+	struct audio_ring_pos_t *dst,
+	struct audio_ring_pos_t *src,
+	uint32_t count);
+
+/* fill count bytes of value at dst and advance it */
+void audio_ring_fill(
+	struct audio_ring_pos_t *dst,
+	const uint8_t value,
+	uint32_t count);
+
+/*
+ * Copy frames of channels samples from src to dst, converting the sample
+ * format on the way (only the container width / MSB alignment changes).
+ * Both ring sizes and offsets must be multiples of their sample size.
+ * Returns the number of frames copied.
+ */
+uint32_t audio_ring_copy_frames(
+	struct audio_ring_pos_t *dst, const uint8_t dst_fmt,
+	struct audio_ring_pos_t *src, const uint8_t src_fmt,
+	const uint32_t channels,
+	const uint32_t frames);
+
+
+
+/*
+ * =============================================================================
+ *                     linear
+ * =============================================================================
+ */
+
+void audio_fmt_convert(
+	void *dst, const uint8_t dst_fmt,
+	const void *src, const uint8_t src_fmt,
+	const uint32_t samples);
+
+/*
+ * Split an interleaved stream into one buffer per channel (mic array
+ * capture) and back. Samples are 2 or 4 bytes wide.
+ */
+void audio_deinterleave(
+	void *const *dst,
+	const void *src,
+	const uint32_t sample_bytes,
+	const uint32_t channels,
+	const uint32_t frames);
+
+void audio_interleave(
+	void *dst,
+	const void *const *src,
+	const uint32_t sample_bytes,
+	const uint32_t channels,
+	const uint32_t frames);
+
+
+uint32_t audio_ring_fmt_bytes(const uint8_t fmt);
+
+
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif /* end of AUDIO_RING_COPY_H */
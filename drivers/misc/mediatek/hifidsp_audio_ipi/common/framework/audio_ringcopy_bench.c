@@ -0,0 +1,377 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * Microbenchmark of audio_ringcopy. Results go to the kernel log when the
+ * module is loaded; compare scalar and NEON by flipping
+ * /sys/module/audio_ringcopy/parameters/simd and loading it again.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <linux/vmalloc.h>
+
+#include <audio_ringcopy.h>
+
+
+
+#define BENCH_RING_BYTES   (64 * 1024)
+#define BENCH_PERIOD_BYTES (4 * 1024 + 96) /* not a divisor: keeps wrapping */
+#define BENCH_MIC_CHANNELS (4)
+
+/* above the NEON threshold and not a multiple of 8: the tail runs too */
+#define CHECK_SAMPLES      (203)
+#define CHECK_FRAMES       (67)
+
+static unsigned int iterations = 2000;
+module_param(iterations, uint, 0444);
+
+
+
+struct bench_ctx_t {
+	char *ring_a;
+	char *ring_b;
+	char *lin;
+	char *ch_buf[BENCH_MIC_CHANNELS];
+};
+
+
+static void bench_report(const char *name, u64 ns, u64 bytes)
+{
+	pr_info("%-24s %8llu ns/iter %6llu MB/s\n",
+		name,
+		div_u64(ns, iterations),
+		ns ? div64_u64(bytes * 1000, ns) : 0);
+}
+
+
+static void bench_ring_copy(struct bench_ctx_t *ctx)
+{
+	struct audio_ring_pos_t dst = { ctx->ring_a, BENCH_RING_BYTES, 0 };
+	struct audio_ring_pos_t src = { ctx->ring_b, BENCH_RING_BYTES, 512 };
+	unsigned int i = 0;
+	u64 t0 = 0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < iterations; i++)
+		audio_ring_copy(&dst, &src, BENCH_PERIOD_BYTES);
+	bench_report("ring_copy", ktime_get_ns() - t0,
+		     (u64)iterations * BENCH_PERIOD_BYTES);
+}
+
+
+static void bench_ring_fill(struct bench_ctx_t *ctx)
+{
+	struct audio_ring_pos_t dst = { ctx->ring_a, BENCH_RING_BYTES, 0 };
+	unsigned int i = 0;
+	u64 t0 = 0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < iterations; i++)
+		audio_ring_fill(&dst, 0, BENCH_PERIOD_BYTES);
+	bench_report("ring_fill", ktime_get_ns() - t0,
+		     (u64)iterations * BENCH_PERIOD_BYTES);
+}
+
+
+static void bench_ring_frames(struct bench_ctx_t *ctx,
+			      const char *name,
+			      uint8_t dst_fmt, uint8_t src_fmt)
+{
+	struct audio_ring_pos_t dst = { ctx->ring_a, BENCH_RING_BYTES, 0 };
+	struct audio_ring_pos_t src = { ctx->ring_b, BENCH_RING_BYTES, 0 };
+	uint32_t frames = BENCH_PERIOD_BYTES / (4 * BENCH_MIC_CHANNELS);
+	unsigned int i = 0;
+	u64 t0 = 0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < iterations; i++)
+		audio_ring_copy_frames(&dst, dst_fmt, &src, src_fmt,
+				       BENCH_MIC_CHANNELS, frames);
+	bench_report(name, ktime_get_ns() - t0,
+		     (u64)iterations * frames * BENCH_MIC_CHANNELS *
+		     audio_ring_fmt_bytes(src_fmt));
+}
+
+
+static void bench_deinterleave(struct bench_ctx_t *ctx,
+			       const char *name,
+			       uint32_t sample_bytes)
+{
+	uint32_t frames = BENCH_PERIOD_BYTES /
+			  (sample_bytes * BENCH_MIC_CHANNELS);
+	unsigned int i = 0;
+	u64 t0 = 0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < iterations; i++)
+		audio_deinterleave((void *const *)ctx->ch_buf, ctx->lin,
+				   sample_bytes, BENCH_MIC_CHANNELS, frames);
+	bench_report(name, ktime_get_ns() - t0,
+		     (u64)iterations * frames * sample_bytes *
+		     BENCH_MIC_CHANNELS);
+}
+
+
+static uint32_t check_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return *seed;
+}
+
+
+/*
+ * scalar reference: MSB align the input, then shift to the output width;
+ * the same format is a plain copy
+ */
+static int32_t check_ref_sample(const void *src, const uint8_t src_fmt,
+				const uint8_t dst_fmt, const uint32_t i)
+{
+	uint32_t full = 0;
+
+	if (src_fmt == dst_fmt && src_fmt != AUDIO_RING_FMT_S16)
+		return ((const int32_t *)src)[i];
+
+	if (src_fmt == AUDIO_RING_FMT_S16)
+		full = (uint32_t)((const int16_t *)src)[i] << 16;
+	else if (src_fmt == AUDIO_RING_FMT_S24)
+		full = (uint32_t)((const int32_t *)src)[i] << 8;
+	else
+		full = (uint32_t)((const int32_t *)src)[i];
+
+	if (dst_fmt == AUDIO_RING_FMT_S16)
+		return (int16_t)((int32_t)full >> 16);
+	if (dst_fmt == AUDIO_RING_FMT_S24)
+		return (int32_t)full >> 8;
+	return (int32_t)full;
+}
+
+
+static int check_fmt_pair(int32_t *src, int32_t *dst,
+			  const uint8_t dst_fmt, const uint8_t src_fmt)
+{
+	int32_t out = 0;
+	int32_t ref = 0;
+	uint32_t i = 0;
+
+	memset(dst, 0x5a, CHECK_SAMPLES * sizeof(int32_t));
+	audio_fmt_convert(dst, dst_fmt, src, src_fmt, CHECK_SAMPLES);
+
+	for (i = 0; i < CHECK_SAMPLES; i++) {
+		out = (dst_fmt == AUDIO_RING_FMT_S16) ?
+		      ((int16_t *)dst)[i] : dst[i];
+		ref = check_ref_sample(src, src_fmt, dst_fmt, i);
+		if (out != ref) {
+			pr_notice("%s(), fmt %u -> %u, [%u] %d != %d\n",
+				  __func__, src_fmt, dst_fmt, i, out, ref);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+
+static int check_interleave(int32_t *lin, int32_t *back,
+			    void **ch_buf, const uint32_t sample_bytes,
+			    const uint32_t channels)
+{
+	uint32_t bytes = CHECK_FRAMES * channels * sample_bytes;
+	uint32_t ch = 0;
+	uint32_t i = 0;
+
+	audio_deinterleave(ch_buf, lin, sample_bytes, channels, CHECK_FRAMES);
+	for (i = 0; i < CHECK_FRAMES; i++) {
+		for (ch = 0; ch < channels; ch++) {
+			if (memcmp((char *)ch_buf[ch] + i * sample_bytes,
+				   (char *)lin + (i * channels + ch) *
+				   sample_bytes, sample_bytes)) {
+				pr_notice("%s(), deinterleave %uch %uB, frame %u ch %u\n",
+					  __func__, channels, sample_bytes,
+					  i, ch);
+				return -EINVAL;
+			}
+		}
+	}
+
+	memset(back, 0x5a, bytes);
+	audio_interleave(back, (const void *const *)ch_buf,
+			 sample_bytes, channels, CHECK_FRAMES);
+	if (memcmp(back, lin, bytes)) {
+		pr_notice("%s(), interleave %uch %uB mismatch\n",
+			  __func__, channels, sample_bytes);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+
+/*
+ * Compare audio_ringcopy (NEON when the simd parameter is on, which is the
+ * default) with a scalar reference, for every format pair and for
+ * (de)interleave with the channel counts which have NEON kernels.
+ */
+static int bench_check_simd(void)
+{
+	static const uint32_t channels[] = { 2, 4 };
+	int32_t *src = NULL;
+	int32_t *dst = NULL;
+	void *ch_buf[4] = { NULL };
+	uint32_t seed = 0x8512;
+	uint32_t i = 0;
+	uint8_t d = 0;
+	uint8_t f = 0;
+	int ret = -ENOMEM;
+
+	src = kmalloc_array(CHECK_FRAMES * 4, sizeof(int32_t), GFP_KERNEL);
+	dst = kmalloc_array(CHECK_FRAMES * 4, sizeof(int32_t), GFP_KERNEL);
+	for (i = 0; i < ARRAY_SIZE(ch_buf); i++)
+		ch_buf[i] = kmalloc_array(CHECK_FRAMES, sizeof(int32_t),
+					  GFP_KERNEL);
+	if (!src || !dst || !ch_buf[0] || !ch_buf[1] ||
+	    !ch_buf[2] || !ch_buf[3])
+		goto exit;
+
+	for (i = 0; i < CHECK_FRAMES * 4; i++)
+		src[i] = check_rand(&seed);
+	/* full scale values at both ends of the vector part and the tail */
+	src[0] = 0x7fffffff;
+	src[1] = (int32_t)0x80000000;
+	src[CHECK_SAMPLES - 1] = 0x7fffffff;
+	src[CHECK_SAMPLES - 2] = (int32_t)0x80000000;
+
+	for (f = 0; f < NUM_AUDIO_RING_FMT; f++) {
+		for (d = 0; d < NUM_AUDIO_RING_FMT; d++) {
+			ret = check_fmt_pair(src, dst, d, f);
+			if (ret)
+				goto exit;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(channels); i++) {
+		ret = check_interleave(src, dst, ch_buf, 2, channels[i]);
+		if (ret)
+			goto exit;
+		ret = check_interleave(src, dst, ch_buf, 4, channels[i]);
+		if (ret)
+			goto exit;
+	}
+
+exit:
+	for (i = 0; i < ARRAY_SIZE(ch_buf); i++)
+		kfree(ch_buf[i]);
+	kfree(dst);
+	kfree(src);
+
+	return ret;
+}
+
+
+static int bench_check(void)
+{
+	static const int16_t s16[9] = {
+		0, 1, -1, 0x7fff, -0x8000, 0x1234, -0x1234, 0x55, -0x55
+	};
+	int32_t s24[9], s32[9];
+	int16_t back[9];
+	unsigned int i = 0;
+
+	audio_fmt_convert(s24, AUDIO_RING_FMT_S24, s16, AUDIO_RING_FMT_S16, 9);
+	audio_fmt_convert(s32, AUDIO_RING_FMT_S32, s24, AUDIO_RING_FMT_S24, 9);
+	audio_fmt_convert(back, AUDIO_RING_FMT_S16, s32, AUDIO_RING_FMT_S32, 9);
+
+	for (i = 0; i < ARRAY_SIZE(s16); i++) {
+		if (s24[i] != (int32_t)s16[i] * 256 ||
+		    s32[i] != (int32_t)s16[i] * 65536 ||
+		    back[i] != s16[i]) {
+			pr_notice("%s(), [%u] %d -> %d -> %d -> %d mismatch\n",
+				  __func__, i, s16[i], s24[i], s32[i], back[i]);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+
+static int __init audio_ringcopy_bench_init(void)
+{
+	struct bench_ctx_t ctx;
+	int ret = 0;
+	int ch = 0;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	ret = bench_check();
+	if (ret)
+		return ret;
+
+	ret = bench_check_simd();
+	if (ret)
+		return ret;
+
+	ctx.ring_a = vzalloc(BENCH_RING_BYTES);
+	ctx.ring_b = vzalloc(BENCH_RING_BYTES);
+	ctx.lin = kzalloc(BENCH_PERIOD_BYTES, GFP_KERNEL);
+	for (ch = 0; ch < BENCH_MIC_CHANNELS; ch++)
+		ctx.ch_buf[ch] = kzalloc(BENCH_PERIOD_BYTES, GFP_KERNEL);
+
+	if (!ctx.ring_a || !ctx.ring_b || !ctx.lin) {
+		ret = -ENOMEM;
+		goto exit;
+	}
+	for (ch = 0; ch < BENCH_MIC_CHANNELS; ch++) {
+		if (!ctx.ch_buf[ch]) {
+			ret = -ENOMEM;
+			goto exit;
+		}
+	}
+
+	pr_info("audio_ringcopy bench: %u iterations of %u bytes\n",
+		iterations, BENCH_PERIOD_BYTES);
+
+	bench_ring_copy(&ctx);
+	bench_ring_fill(&ctx);
+	bench_ring_frames(&ctx, "frames_s16_to_s32",
+			  AUDIO_RING_FMT_S32, AUDIO_RING_FMT_S16);
+	bench_ring_frames(&ctx, "frames_s32_to_s16",
+			  AUDIO_RING_FMT_S16, AUDIO_RING_FMT_S32);
+	bench_ring_frames(&ctx, "frames_s24_to_s32",
+			  AUDIO_RING_FMT_S32, AUDIO_RING_FMT_S24);
+	bench_deinterleave(&ctx, "deinterleave_4ch_s16", 2);
+	bench_deinterleave(&ctx, "deinterleave_4ch_s32", 4);
+
+exit:
+	for (ch = 0; ch < BENCH_MIC_CHANNELS; ch++)
+		kfree(ctx.ch_buf[ch]);
+	kfree(ctx.lin);
+	vfree(ctx.ring_b);
+	vfree(ctx.ring_a);
+
+	return ret;
+}
+
+
+static void __exit audio_ringcopy_bench_exit(void)
+{
+}
+
+
+module_init(audio_ringcopy_bench_init);
+module_exit(audio_ringcopy_bench_exit);
+
+MODULE_DESCRIPTION("audio ring copy microbenchmark");
+MODULE_LICENSE("GPL v2");
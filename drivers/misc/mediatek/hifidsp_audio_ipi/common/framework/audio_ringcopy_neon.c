@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#include <arm_neon.h>
+
+#include "audio_ringcopy_neon.h"
+
+
+
+unsigned int audio_ringcopy_w16to32_neon(
+	int *dst, const short *src, unsigned int n, int rsh)
+{
+	const int32x4_t shift = vdupq_n_s32(-rsh);
+	unsigned int i = 0;
+	int16x8_t in;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		in = vld1q_s16(src + i);
+		vst1q_s32(dst + i,
+			  vshlq_s32(vshll_n_s16(vget_low_s16(in), 16), shift));
+		vst1q_s32(dst + i + 4,
+			  vshlq_s32(vshll_n_s16(vget_high_s16(in), 16), shift));
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_n32to16_neon(
+	short *dst, const int *src, unsigned int n, int lsh)
+{
+	const int32x4_t shift = vdupq_n_s32(lsh);
+	unsigned int i = 0;
+	int16x4_t lo, hi;
+
+	for (i = 0; i + 8 <= n; i += 8) {
+		lo = vshrn_n_s32(vshlq_s32(vld1q_s32(src + i), shift), 16);
+		hi = vshrn_n_s32(vshlq_s32(vld1q_s32(src + i + 4), shift), 16);
+		vst1q_s16(dst + i, vcombine_s16(lo, hi));
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_c32to32_neon(
+	int *dst, const int *src, unsigned int n, int lsh, int rsh)
+{
+	const int32x4_t l = vdupq_n_s32(lsh);
+	const int32x4_t r = vdupq_n_s32(-rsh);
+	unsigned int i = 0;
+	int32x4_t v;
+
+	for (i = 0; i + 4 <= n; i += 4) {
+		v = vshlq_s32(vld1q_s32(src + i), l);
+		vst1q_s32(dst + i, vshlq_s32(v, r));
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_deinterleave16_neon(
+	short *const *dst, const short *src,
+	unsigned int channels, unsigned int frames)
+{
+	unsigned int i = 0;
+	int16x8x2_t v2;
+	int16x8x4_t v4;
+
+	if (channels == 2) {
+		for (i = 0; i + 8 <= frames; i += 8) {
+			v2 = vld2q_s16(src + 2 * i);
+			vst1q_s16(dst[0] + i, v2.val[0]);
+			vst1q_s16(dst[1] + i, v2.val[1]);
+		}
+	} else if (channels == 4) {
+		for (i = 0; i + 8 <= frames; i += 8) {
+			v4 = vld4q_s16(src + 4 * i);
+			vst1q_s16(dst[0] + i, v4.val[0]);
+			vst1q_s16(dst[1] + i, v4.val[1]);
+			vst1q_s16(dst[2] + i, v4.val[2]);
+			vst1q_s16(dst[3] + i, v4.val[3]);
+		}
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_deinterleave32_neon(
+	int *const *dst, const int *src,
+	unsigned int channels, unsigned int frames)
+{
+	unsigned int i = 0;
+	int32x4x2_t v2;
+	int32x4x4_t v4;
+
+	if (channels == 2) {
+		for (i = 0; i + 4 <= frames; i += 4) {
+			v2 = vld2q_s32(src + 2 * i);
+			vst1q_s32(dst[0] + i, v2.val[0]);
+			vst1q_s32(dst[1] + i, v2.val[1]);
+		}
+	} else if (channels == 4) {
+		for (i = 0; i + 4 <= frames; i += 4) {
+			v4 = vld4q_s32(src + 4 * i);
+			vst1q_s32(dst[0] + i, v4.val[0]);
+			vst1q_s32(dst[1] + i, v4.val[1]);
+			vst1q_s32(dst[2] + i, v4.val[2]);
+			vst1q_s32(dst[3] + i, v4.val[3]);
+		}
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_interleave16_neon(
+	short *dst, const short *const *src,
+	unsigned int channels, unsigned int frames)
+{
+	unsigned int i = 0;
+	int16x8x2_t v2;
+	int16x8x4_t v4;
+
+	if (channels == 2) {
+		for (i = 0; i + 8 <= frames; i += 8) {
+			v2.val[0] = vld1q_s16(src[0] + i);
+			v2.val[1] = vld1q_s16(src[1] + i);
+			vst2q_s16(dst + 2 * i, v2);
+		}
+	} else if (channels == 4) {
+		for (i = 0; i + 8 <= frames; i += 8) {
+			v4.val[0] = vld1q_s16(src[0] + i);
+			v4.val[1] = vld1q_s16(src[1] + i);
+			v4.val[2] = vld1q_s16(src[2] + i);
+			v4.val[3] = vld1q_s16(src[3] + i);
+			vst4q_s16(dst + 4 * i, v4);
+		}
+	}
+
+	return i;
+}
+
+
+unsigned int audio_ringcopy_interleave32_neon(
+	int *dst, const int *const *src,
+	unsigned int channels, unsigned int frames)
+{
+	unsigned int i = 0;
+	int32x4x2_t v2;
+	int32x4x4_t v4;
+
+	if (channels == 2) {
+		for (i = 0; i + 4 <= frames; i += 4) {
+			v2.val[0] = vld1q_s32(src[0] + i);
+			v2.val[1] = vld1q_s32(src[1] + i);
+			vst2q_s32(dst + 2 * i, v2);
+		}
+	} else if (channels == 4) {
+		for (i = 0; i + 4 <= frames; i += 4) {
+			v4.val[0] = vld1q_s32(src[0] + i);
+			v4.val[1] = vld1q_s32(src[1] + i);
+			v4.val[2] = vld1q_s32(src[2] + i);
+			v4.val[3] = vld1q_s32(src[3] + i);
+			vst4q_s32(dst + 4 * i, v4);
+		}
+	}
+
+	return i;
+}
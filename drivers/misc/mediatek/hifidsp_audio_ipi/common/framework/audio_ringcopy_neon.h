@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef AUDIO_RING_COPY_NEON_H
+#define AUDIO_RING_COPY_NEON_H
+
+/*
+ * NEON kernels of audio_ringcopy. They are built with the NEON FPU flags
+ * and may only be called between kernel_neon_begin() / kernel_neon_end().
+ * Only plain C types here: this header is shared with a translation unit
+ * which includes <arm_neon.h> and no kernel headers.
+ *
+ * Each kernel handles the largest vector multiple of n and returns how
+ * many samples (or frames) it did; the caller finishes the tail.
+ */
+
+unsigned int audio_ringcopy_w16to32_neon(
+	int *dst, const short *src, unsigned int n, int rsh);
+
+unsigned int audio_ringcopy_n32to16_neon(
+	short *dst, const int *src, unsigned int n, int lsh);
+
+unsigned int audio_ringcopy_c32to32_neon(
+	int *dst, const int *src, unsigned int n, int lsh, int rsh);
+
+
+unsigned int audio_ringcopy_deinterleave16_neon(
+	short *const *dst, const short *src,
+	unsigned int channels, unsigned int frames);
+
+unsigned int audio_ringcopy_deinterleave32_neon(
+	int *const *dst, const int *src,
+	unsigned int channels, unsigned int frames);
+
+unsigned int audio_ringcopy_interleave16_neon(
+	short *dst, const short *const *src,
+	unsigned int channels, unsigned int frames);
+
+unsigned int audio_ringcopy_interleave32_neon(
+	int *dst, const int *const *src,
+	unsigned int channels, unsigned int frames);
+
+
+#endif /* end of AUDIO_RING_COPY_NEON_H */
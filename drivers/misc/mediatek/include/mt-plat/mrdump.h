@@ -215,6 +215,29 @@ struct mrdump_rsvmem_block {
 	(MRDUMP_MINI_NR_SECTION * MRDUMP_MINI_SECTION_SIZE)
 #define MRDUMP_MINI_BUF_SIZE (MRDUMP_MINI_HEADER_SIZE + MRDUMP_MINI_DATA_SIZE)
 
+/*
+ * LZ4 compressed PT_LOAD segment: p_flags has MRDUMP_MINI_PF_LZ4 and
+ * p_offset points to a mrdump_mini_lz4_seg followed by
+ * DIV_ROUND_UP(raw_size, block_size) blocks, each a mrdump_mini_lz4_blk
+ * and comp_len bytes. comp_len == raw_len means the block is stored.
+ * p_filesz stays the raw segment size.
+ */
+#define MRDUMP_MINI_PF_LZ4		0x00100000	/* in PF_MASKOS */
+#define MRDUMP_MINI_LZ4_MAGIC		0x345a4c4d	/* "MLZ4" */
+#define MRDUMP_MINI_LZ4_BLOCK		MRDUMP_MINI_SECTION_SIZE
+
+struct mrdump_mini_lz4_seg {
+	u32 magic;
+	u32 raw_size;
+	u32 block_size;
+	u32 reserved;
+};
+
+struct mrdump_mini_lz4_blk {
+	u32 raw_len;
+	u32 comp_len;
+};
+
 #ifdef CONFIG_MTK_RAM_CONSOLE_DRAM_ADDR
 #define MRDUMP_MINI_BUF_PADDR (CONFIG_MTK_RAM_CONSOLE_DRAM_ADDR + 0xf0000)
 #else
@@ -997,6 +997,17 @@ static inline void aee_sram_fiq_save_bin(unsigned char *buffer, size_t len)
 
 #endif /* CONFIG_MTK_RAM_CONSOLE */
 
+#ifdef CONFIG_MTK_RAM_CONSOLE_PLOG
+/* returns true if the line should be kept off the consoles */
+extern bool ram_console_plog_write(int level, const char *text, size_t len);
+#else
+static inline bool ram_console_plog_write(int level, const char *text,
+				size_t len)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_MTK_AEE_IPANIC
 extern int ipanic_kmsg_write(unsigned int part, const char *buf, size_t size);
 extern int ipanic_kmsg_get_next(int *count, u64 *id, enum pstore_type_id *type,
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef __MTK_WAKE_ACCT_H
+#define __MTK_WAKE_ACCT_H
+
+#include <linux/list.h>
+#include <linux/types.h>
+
+/*
+ * A periodic wakeup user (timer, hrtimer, polling work) registered with
+ * the wake accounting core. slack_ms is how late the client tolerates
+ * being woken up; the active coalescing policy may use all of it.
+ */
+struct mtk_wake_client {
+	const char *name;
+	unsigned int slack_ms;
+
+	/* private to mtk_wake_acct */
+	struct list_head list;
+	u32 count;
+	u32 spm_count;		/* fires right after an SPM wakeup */
+	u64 last_ns;
+};
+
+#ifdef CONFIG_MTK_WAKE_ACCT
+extern int mtk_wake_acct_register(struct mtk_wake_client *c);
+extern void mtk_wake_acct_unregister(struct mtk_wake_client *c);
+extern void mtk_wake_acct_client_fire(struct mtk_wake_client *c);
+extern unsigned long mtk_wake_acct_round_jiffies(struct mtk_wake_client *c,
+						  unsigned long j);
+extern u64 mtk_wake_acct_slack_ns(struct mtk_wake_client *c);
+extern void mtk_wake_acct_spm(u32 r12, bool suspend);
+#else
+static inline int mtk_wake_acct_register(struct mtk_wake_client *c)
+{ return 0; }
+static inline void mtk_wake_acct_unregister(struct mtk_wake_client *c) { }
+static inline void mtk_wake_acct_client_fire(struct mtk_wake_client *c) { }
+static inline unsigned long mtk_wake_acct_round_jiffies(
+		struct mtk_wake_client *c, unsigned long j) { return j; }
+static inline u64 mtk_wake_acct_slack_ns(struct mtk_wake_client *c)
+{ return 0; }
+static inline void mtk_wake_acct_spm(u32 r12, bool suspend) { }
+#endif
+
+#endif
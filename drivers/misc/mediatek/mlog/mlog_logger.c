@@ -28,6 +28,7 @@
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <mt-plat/mtk_wake_acct.h>
 
 
 #ifdef CONFIG_MTK_GPU_SUPPORT
@@ -1026,11 +1027,19 @@ void mlog_get_buffer(char **ptr, int *size)
 #endif
 }
 
+static struct mtk_wake_client mlog_wake = {
+	.name = "mlog",
+	.slack_ms = 500,
+};
+
 static void mlog_timer_handler(unsigned long data)
 {
+	mtk_wake_acct_client_fire(&mlog_wake);
+
 	mlog(MLOG_TRIGGER_TIMER);
 
-	mod_timer(&mlog_timer, round_jiffies(jiffies + timer_intval));
+	mod_timer(&mlog_timer, mtk_wake_acct_round_jiffies(&mlog_wake,
+				round_jiffies(jiffies + timer_intval)));
 }
 
 static void mlog_init_logger(void)
@@ -1039,6 +1048,7 @@ static void mlog_init_logger(void)
 	mlog_reset_format();
 	mlog_reset_buffer();
 
+	mtk_wake_acct_register(&mlog_wake);
 	setup_timer(&mlog_timer, mlog_timer_handler, 0);
 	mlog_timer.expires = jiffies + timer_intval;
 
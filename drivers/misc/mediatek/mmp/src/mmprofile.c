@@ -38,6 +38,8 @@
 #include <linux/hardirq.h>
 #include <linux/sched.h>
 #include <linux/debugfs.h>
+#include <linux/percpu.h>
+#include <linux/log2.h>
 
 #include <linux/ftrace.h>
 #include <linux/trace_events.h>
@@ -99,8 +101,27 @@ static unsigned int mmprofile_meta_datacookie = 1;
 static DEFINE_MUTEX(mmprofile_buffer_init_mutex);
 static DEFINE_MUTEX(mmprofile_regtable_mutex);
 static DEFINE_MUTEX(mmprofile_meta_buffer_mutex);
+static DEFINE_MUTEX(mmprofile_merge_mutex);
 static struct mmprofile_event_t *p_mmprofile_ring_buffer;
 static unsigned char *p_mmprofile_meta_buffer;
+
+/*
+ * Events are logged into per-CPU power-of-two rings carved from
+ * p_mmprofile_cpu_buffer, so loggers on different CPUs never share a
+ * cache line. p_mmprofile_ring_buffer keeps the layout the tools expect
+ * (one ring, write_pointer) and is rebuilt from the per-CPU rings,
+ * merged by timestamp, whenever it is dumped or mapped.
+ */
+struct mmprofile_cpu_ring_t {
+	struct mmprofile_event_t *p_event;
+	unsigned int head;
+};
+static DEFINE_PER_CPU(struct mmprofile_cpu_ring_t, mmprofile_cpu_ring);
+static struct mmprofile_event_t *p_mmprofile_cpu_buffer;
+static unsigned int mmprofile_cpu_ring_size;
+
+/* "MMP:parent:...:event" systrace marker, built once per event */
+static char *mmprofile_trace_name[MMPROFILE_MAX_EVENT_COUNT];
 static struct mmprofile_global_t mmprofile_globals
 __aligned(PAGE_SIZE) = {
 	.buffer_size_record = MMPROFILE_DEFAULT_BUFFER_SIZE,
@@ -132,6 +153,8 @@ static int mmprofile_register_static_events(int sync);
 
 static void mmprofile_force_start(int start);
 
+static void mmprofile_merge_cpu_rings(void);
+
 unsigned int mmprofile_get_dump_size(void)
 {
 	unsigned int size;
@@ -188,6 +211,8 @@ void mmprofile_get_dump_buffer(unsigned int start, unsigned long *p_addr,
 		*p_size = 0;
 		return;
 	}
+	if (start == 0)
+		mmprofile_merge_cpu_rings();
 	if (total_pos < (region_base + sizeof(struct mmprofile_global_t))) {
 		/* Global structure */
 		region_pos = total_pos;
@@ -290,6 +315,131 @@ void mmprofile_get_dump_buffer(unsigned int start, unsigned long *p_addr,
 	*p_size = block_pos;
 }
 
+static void mmprofile_reset_cpu_rings(void)
+{
+	struct mmprofile_cpu_ring_t *p_ring;
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		p_ring = per_cpu_ptr(&mmprofile_cpu_ring, cpu);
+		WRITE_ONCE(p_ring->head, 0);
+	}
+	memset((void *)p_mmprofile_cpu_buffer, 0,
+	       sizeof(struct mmprofile_event_t) * mmprofile_cpu_ring_size *
+	       num_possible_cpus());
+}
+
+/* Called with mmprofile_buffer_init_mutex held. */
+static void mmprofile_alloc_cpu_rings(void)
+{
+	struct mmprofile_cpu_ring_t *p_ring;
+	unsigned int ring_size;
+	unsigned int cpu;
+	unsigned int i = 0;
+
+	if (p_mmprofile_cpu_buffer) {
+		mmprofile_cpu_ring_size = 0;
+		vfree(p_mmprofile_cpu_buffer);
+		p_mmprofile_cpu_buffer = NULL;
+	}
+
+	/* all per-CPU rings together fit in the export ring */
+	ring_size = mmprofile_globals.buffer_size_record / num_possible_cpus();
+	if (ring_size == 0)
+		return;
+	ring_size = rounddown_pow_of_two(ring_size);
+
+	p_mmprofile_cpu_buffer =
+		vmalloc(sizeof(struct mmprofile_event_t) * ring_size *
+			num_possible_cpus());
+	if (!p_mmprofile_cpu_buffer)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		p_ring = per_cpu_ptr(&mmprofile_cpu_ring, cpu);
+		p_ring->p_event = p_mmprofile_cpu_buffer + ring_size * i++;
+	}
+	mmprofile_cpu_ring_size = ring_size;
+	mmprofile_reset_cpu_rings();
+
+	MMP_LOG(ANDROID_LOG_DEBUG, "cpu ring %u records x %u",
+		ring_size, num_possible_cpus());
+}
+
+static u64 mmprofile_event_time(const struct mmprofile_event_t *p_event)
+{
+	return ((u64)p_event->time_high << 32) | p_event->time_low;
+}
+
+/*
+ * Rebuild the export ring from the per-CPU rings, oldest first, and set
+ * write_pointer so that the record it points at is the oldest one.
+ * Per-CPU sched_clock() is monotonic, so each ring is already sorted and
+ * a k-way merge over the CPUs is enough. The dump and mmap paths both
+ * merge, so the cursors and the export ring are under
+ * mmprofile_merge_mutex.
+ */
+static void mmprofile_merge_cpu_rings(void)
+{
+	static unsigned int pos[NR_CPUS];
+	static unsigned int end[NR_CPUS];
+	struct mmprofile_cpu_ring_t *p_ring;
+	struct mmprofile_event_t *p_event;
+	unsigned int mask = mmprofile_cpu_ring_size - 1;
+	unsigned int out = 0;
+	unsigned int best;
+	unsigned int cpu;
+	u64 best_time = 0;
+	u64 time;
+
+	if (!bmmprofile_init_buffer || !p_mmprofile_cpu_buffer)
+		return;
+
+	mutex_lock(&mmprofile_merge_mutex);
+	for_each_possible_cpu(cpu) {
+		p_ring = per_cpu_ptr(&mmprofile_cpu_ring, cpu);
+		end[cpu] = READ_ONCE(p_ring->head);
+		pos[cpu] = (end[cpu] > mmprofile_cpu_ring_size) ?
+			   end[cpu] - mmprofile_cpu_ring_size : 0;
+	}
+
+	while (out < mmprofile_globals.buffer_size_record) {
+		best = nr_cpu_ids;
+		for_each_possible_cpu(cpu) {
+			p_ring = per_cpu_ptr(&mmprofile_cpu_ring, cpu);
+			/* skip records still being written */
+			while (pos[cpu] != end[cpu] &&
+			       p_ring->p_event[pos[cpu] & mask].id == 0)
+				pos[cpu]++;
+			if (pos[cpu] == end[cpu])
+				continue;
+
+			time = mmprofile_event_time(
+				&p_ring->p_event[pos[cpu] & mask]);
+			if (best == nr_cpu_ids || time < best_time) {
+				best = cpu;
+				best_time = time;
+			}
+		}
+		if (best == nr_cpu_ids)
+			break;
+
+		p_ring = per_cpu_ptr(&mmprofile_cpu_ring, best);
+		p_event = &p_ring->p_event[pos[best] & mask];
+		p_mmprofile_ring_buffer[out] = *p_event;
+		p_mmprofile_ring_buffer[out].lock = 0;
+		pos[best]++;
+		out++;
+	}
+
+	if (out < mmprofile_globals.buffer_size_record)
+		memset((void *)&p_mmprofile_ring_buffer[out], 0,
+		       sizeof(struct mmprofile_event_t) *
+		       (mmprofile_globals.buffer_size_record - out));
+	mmprofile_globals.write_pointer = out;
+	mutex_unlock(&mmprofile_merge_mutex);
+}
+
 static void mmprofile_init_buffer(void)
 {
 	unsigned int b_reset_ring_buffer = 0;
@@ -345,6 +495,9 @@ static void mmprofile_init_buffer(void)
 	MMP_LOG(ANDROID_LOG_DEBUG, "p_mmprofile_ring_buffer=0x%08lx",
 		(unsigned long)p_mmprofile_ring_buffer);
 
+	if (b_reset_ring_buffer || !p_mmprofile_cpu_buffer)
+		mmprofile_alloc_cpu_rings();
+
 	if (!p_mmprofile_meta_buffer) {
 		mmprofile_globals.meta_buffer_size =
 			mmprofile_globals.new_meta_buffer_size;
@@ -371,11 +524,16 @@ static void mmprofile_init_buffer(void)
 		"p_mmprofile_meta_buffer=0x%08lx",
 		(unsigned long)p_mmprofile_meta_buffer);
 
-	if ((!p_mmprofile_ring_buffer) || (!p_mmprofile_meta_buffer)) {
+	if ((!p_mmprofile_ring_buffer) || (!p_mmprofile_meta_buffer) ||
+	    (!p_mmprofile_cpu_buffer)) {
 		if (p_mmprofile_ring_buffer) {
 			vfree(p_mmprofile_ring_buffer);
 			p_mmprofile_ring_buffer = NULL;
 		}
+		if (p_mmprofile_cpu_buffer) {
+			vfree(p_mmprofile_cpu_buffer);
+			p_mmprofile_cpu_buffer = NULL;
+		}
 		if (p_mmprofile_meta_buffer) {
 			vfree(p_mmprofile_meta_buffer);
 			p_mmprofile_meta_buffer = NULL;
@@ -417,6 +575,7 @@ static void mmprofile_reset_buffer(void)
 		memset((void *)(p_mmprofile_ring_buffer), 0,
 			mmprofile_globals.buffer_size_bytes);
 		mmprofile_globals.write_pointer = 0;
+		mmprofile_reset_cpu_rings();
 		mutex_lock(&mmprofile_meta_buffer_mutex);
 		mmprofile_meta_datacookie = 1;
 		memset((void *)(p_mmprofile_meta_buffer), 0,
@@ -674,7 +833,7 @@ static inline void __mt_update_tracing_mark_write_addr(void)
 			kallsyms_lookup_name("tracing_mark_write");
 }
 
-static inline void mmp_kernel_trace_begin(char *name)
+static inline void mmp_kernel_trace_begin(const char *name)
 {
 	if (mmp_trace_log_on) {
 		__mt_update_tracing_mark_write_addr();
@@ -683,7 +842,7 @@ static inline void mmp_kernel_trace_begin(char *name)
 	}
 }
 
-static inline void mmp_kernel_trace_counter(char *name, int count)
+static inline void mmp_kernel_trace_counter(const char *name, int count)
 {
 	if (mmp_trace_log_on) {
 		__mt_update_tracing_mark_write_addr();
@@ -701,7 +860,7 @@ static inline void mmp_kernel_trace_end(void)
 	}
 }
 #else
-static inline void mmp_kernel_trace_begin(char *name)
+static inline void mmp_kernel_trace_begin(const char *name)
 {
 }
 
@@ -709,7 +868,7 @@ static inline void mmp_kernel_trace_end(void)
 {
 }
 
-static inline void mmp_kernel_trace_counter(char *name, int count)
+static inline void mmp_kernel_trace_counter(const char *name, int count)
 {
 }
 #endif
@@ -735,16 +894,44 @@ static bool is_mmp_valid(mmp_event event)
 	return true;
 }
 
+/*
+ * Build the systrace marker of an event once and keep it; event names
+ * never change after registration. Not for interrupt context.
+ */
+static const char *mmprofile_get_trace_name(mmp_event event)
+{
+	char name[256] = "MMP:";
+	size_t prefix_len = strlen(name);
+	size_t size = sizeof(name) - prefix_len;
+	char *p_name;
+
+	p_name = READ_ONCE(mmprofile_trace_name[event]);
+	if (likely(p_name))
+		return p_name;
+
+	if (mmprofile_get_event_name(event, &name[prefix_len], &size) <= 0)
+		return NULL;
+
+	p_name = kstrdup(name, GFP_ATOMIC);
+	if (!p_name)
+		return NULL;
+
+	if (cmpxchg(&mmprofile_trace_name[event], NULL, p_name)) {
+		kfree(p_name);
+		p_name = READ_ONCE(mmprofile_trace_name[event]);
+	}
+
+	return p_name;
+}
+
 static void mmprofile_log_int(mmp_event event, enum mmp_log_type type,
 	unsigned long data1, unsigned long data2,
 	unsigned int meta_data_cookie)
 {
-	char name[256];
-	size_t prefix_len;
-	size_t size;
-	struct mmprofile_event_t *p_event = NULL;
+	struct mmprofile_cpu_ring_t *p_ring;
+	struct mmprofile_event_t *p_event;
+	const char *name;
 	unsigned int index;
-	unsigned int lock;
 
 	if (!mmprofile_globals.enable)
 		return;
@@ -760,46 +947,25 @@ static void mmprofile_log_int(mmp_event event, enum mmp_log_type type,
 	 */
 	if (unlikely(event < 2))
 		return;
-	index = (atomic_inc_return((atomic_t *)
-			&(mmprofile_globals.write_pointer)) - 1)
-	    % (mmprofile_globals.buffer_size_record);
-	lock = atomic_inc_return((atomic_t *)
-		&(p_mmprofile_ring_buffer[index].lock));
-	if (unlikely(lock > 1)) {
-		/* Do not reduce lock count since it need
-		 * to be marked as invalid.
-		 */
-		while (1) {
-			index =
-				(atomic_inc_return((atomic_t *)
-				&(mmprofile_globals.write_pointer)) - 1) %
-				(mmprofile_globals.buffer_size_record);
-			lock =
-			    atomic_inc_return((atomic_t *) &
-					(p_mmprofile_ring_buffer[index].lock));
-			/* Do not reduce lock count since it need to be
-			 * marked as invalid.
-			 */
-			if (likely(lock == 1))
-				break;
-		}
-	}
-	p_event = (struct mmprofile_event_t *)
-		&(p_mmprofile_ring_buffer[index]);
+
+	/*
+	 * The slot is claimed with one IRQ safe per-CPU increment: a nested
+	 * IRQ logging on this CPU takes the next slot, nothing spins.
+	 */
+	p_ring = get_cpu_ptr(&mmprofile_cpu_ring);
+	index = (this_cpu_inc_return(mmprofile_cpu_ring.head) - 1) &
+		(mmprofile_cpu_ring_size - 1);
+	p_event = &p_ring->p_event[index];
+	p_event->id = 0;
 	system_time(&(p_event->time_low), &(p_event->time_high));
-	p_event->id = event;
 	p_event->flag = type;
 	p_event->data1 = (unsigned int)data1;
 	p_event->data2 = (unsigned int)data2;
 	p_event->meta_data_cookie = meta_data_cookie;
-	lock = atomic_dec_return((atomic_t *) &(p_event->lock));
-	if (unlikely(lock > 0)) {
-		/* Someone has marked this record as invalid.
-		 * Kill this record.
-		 */
-		p_event->id = 0;
-		p_event->lock = 0;
-	}
+	/* a non-zero id marks the record complete for the merge */
+	smp_wmb();
+	WRITE_ONCE(p_event->id, event);
+	put_cpu_ptr(&mmprofile_cpu_ring);
 
 	if ((mmprofile_globals.event_state[event] & MMP_EVENT_STATE_FTRACE)
 	    || (type & MMPROFILE_FLAG_SYSTRACE)) {
@@ -808,25 +974,17 @@ static void mmprofile_log_int(mmp_event event, enum mmp_log_type type,
 		if (in_interrupt())
 			return;
 
-		memset((void *)name, 0, 256);
-		name[0] = 'M';
-		name[1] = 'M';
-		name[2] = 'P';
-		name[3] = ':';
-		prefix_len = strlen(name);
-		size = sizeof(name) - prefix_len;
-
-		if (mmprofile_get_event_name(
-			event, &name[prefix_len], &size) > 0) {
-
-			if (type & MMPROFILE_FLAG_START) {
-				mmp_kernel_trace_begin(name);
-			} else if (type & MMPROFILE_FLAG_END) {
-				mmp_kernel_trace_end();
-			} else if (type & MMPROFILE_FLAG_PULSE) {
-				mmp_kernel_trace_counter(name, 1);
-				mmp_kernel_trace_counter(name, 0);
-			}
+		name = mmprofile_get_trace_name(event);
+		if (!name)
+			return;
+
+		if (type & MMPROFILE_FLAG_START) {
+			mmp_kernel_trace_begin(name);
+		} else if (type & MMPROFILE_FLAG_END) {
+			mmp_kernel_trace_end();
+		} else if (type & MMPROFILE_FLAG_PULSE) {
+			mmp_kernel_trace_counter(name, 1);
+			mmp_kernel_trace_counter(name, 0);
 		}
 	}
 }
@@ -1032,8 +1190,12 @@ void mmprofile_enable_ftrace_event(mmp_event event, long enable, long ftrace)
 	if ((event < 2) || (event >= MMPROFILE_MAX_EVENT_COUNT))
 		return;
 	state = enable ? MMP_EVENT_STATE_ENABLED : 0;
-	if (enable && ftrace)
+	if (enable && ftrace) {
 		state |= MMP_EVENT_STATE_FTRACE;
+		/* keep the name lookup off the logging path */
+		if (!in_interrupt())
+			mmprofile_get_trace_name(event);
+	}
 	mmprofile_globals.event_state[event] = state;
 }
 EXPORT_SYMBOL(mmprofile_enable_ftrace_event);
@@ -2186,6 +2348,9 @@ static int mmprofile_mmap(struct file *file, struct vm_area_struct *vma)
 		if (!bmmprofile_init_buffer)
 			return -EAGAIN;
 
+		/* the mapping is a snapshot of the per-CPU rings */
+		mmprofile_merge_cpu_rings();
+
 		pos = vma->vm_start;
 
 		for (i = 0; i < mmprofile_globals.buffer_size_bytes;
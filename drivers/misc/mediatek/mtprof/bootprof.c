@@ -117,6 +117,10 @@ void bootprof_initcall(initcall_t fn, unsigned long long ts)
 	unsigned long msec_rem;
 	char msgbuf[MSG_SIZE];
 
+	if (enabled)
+		bootprof_rec_add(BOOTPROF_REC_INITCALL, ts, (unsigned long)fn,
+				 NULL, NULL, NULL, 0);
+
 	if (ts > INITCALL_THRESHOLD) {
 		msec_rem = do_div(ts, NSEC_PER_MSEC);
 		snprintf(msgbuf, MSG_SIZE, "initcall: %pf %5llu.%06lums",
@@ -126,7 +130,7 @@ void bootprof_initcall(initcall_t fn, unsigned long long ts)
 }
 
 void bootprof_probe(unsigned long long ts, struct device *dev,
-			   struct device_driver *drv, unsigned long probe)
+		    struct device_driver *drv, unsigned long probe, int ret)
 {
 #define PROBE_THRESHOLD 15000000
 	/* log more than 15ms probes*/
@@ -134,6 +138,11 @@ void bootprof_probe(unsigned long long ts, struct device *dev,
 	char msgbuf[MSG_SIZE];
 	int pos = 0;
 
+	if (enabled)
+		bootprof_rec_add(BOOTPROF_REC_PROBE, ts, probe,
+				 drv ? drv->name : NULL, dev,
+				 dev ? dev_name(dev) : NULL, ret);
+
 	if (ts <= PROBE_THRESHOLD)
 		return;
 	msec_rem = do_div(ts, NSEC_PER_MSEC);
@@ -158,6 +167,10 @@ void bootprof_pdev_register(unsigned long long ts, struct platform_device *pdev)
 	unsigned long msec_rem;
 	char msgbuf[MSG_SIZE];
 
+	if (enabled && pdev)
+		bootprof_rec_add(BOOTPROF_REC_PDEV, ts, 0, NULL, pdev,
+				 pdev->name, 0);
+
 	if (ts <= PROBE_THRESHOLD || !pdev)
 		return;
 	msec_rem = do_div(ts, NSEC_PER_MSEC);
@@ -37,7 +37,8 @@ extern void log_boot(char *str);
 #include <linux/platform_device.h>
 void bootprof_initcall(initcall_t fn, unsigned long long ts);
 void bootprof_probe(unsigned long long ts, struct device *dev,
-		    struct device_driver *drv, unsigned long probe);
+		    struct device_driver *drv, unsigned long probe, int ret);
 void bootprof_pdev_register(unsigned long long ts,
 			    struct platform_device *pdev);
+bool bootprof_async_probe(struct device_driver *drv);
 #endif
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * bootprof boot graph
+ *
+ * Every initcall, probe and platform device registration longer than
+ * BOOTPROF_REC_THRESHOLD is kept as a binary record, with two kinds of
+ * edges:
+ *   parent: the record that ran it (probe inside a driver_register
+ *           initcall), found by time containment on the same task
+ *   dep:    for a probe that had deferred before, the successful probe
+ *           whose bind triggered the retry that finally worked
+ *
+ * /proc/bootprof_rec   struct bootprof_rec_out_t array, functions by
+ *                      name, no kernel addresses
+ * /proc/bootprof_graph critical path and async probe candidates
+ *
+ * bootprof.async_probe=drv1,drv2 (or CONFIG_MTK_BOOTPROF_ASYNC_PROBE)
+ * makes the listed drivers probe asynchronously.
+ */
+
+#include <linux/device.h>
+#include <linux/kallsyms.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "internal.h"
+
+#define BOOTPROF_REC_THRESHOLD	1000000	/* 1ms */
+#define REC_BUF_COUNT		8
+#define REC_PER_BUF		256
+#define REC_MAX			(REC_BUF_COUNT * REC_PER_BUF)
+#define REC_DEV_LEN		32
+#define REC_DRV_LEN		32
+#define REC_FN_LEN		48
+
+#define ASYNC_CAND_THRESHOLD	15000000	/* 15ms */
+#define ASYNC_LIST_LEN		256
+
+struct bootprof_rec_t {
+	u64 start;
+	u64 end;
+	unsigned long fn;
+	const void *key;	/* struct device *, deferral matching only */
+	char drv[REC_DRV_LEN];	/* copied, the driver may be a module */
+	char name[REC_DEV_LEN];
+	pid_t pid;
+	s16 parent;
+	s16 dep;
+	s16 ret;
+	u8 type;
+	u8 defer;		/* deferrals before this probe */
+};
+
+/* exported layout of /proc/bootprof_rec */
+struct bootprof_rec_out_t {
+	u64 start;
+	u64 end;
+	s32 pid;
+	s16 parent;
+	s16 dep;
+	s16 ret;
+	u8 type;
+	u8 defer;
+	char fn[REC_FN_LEN];
+	char drv[REC_DRV_LEN];
+	char name[REC_DEV_LEN];
+};
+
+static struct bootprof_rec_t *rec_buf[REC_BUF_COUNT];
+static unsigned int rec_count;
+static DEFINE_MUTEX(rec_lock);
+
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "bootprof."
+
+static char async_list[ASYNC_LIST_LEN] = CONFIG_MTK_BOOTPROF_ASYNC_PROBE;
+module_param_string(async_probe, async_list, ASYNC_LIST_LEN, 0444);
+
+static const char * const rec_type_str[] = {
+	[BOOTPROF_REC_INITCALL] = "initcall",
+	[BOOTPROF_REC_PROBE] = "probe",
+	[BOOTPROF_REC_PDEV] = "pdev",
+};
+
+static inline struct bootprof_rec_t *rec_get(unsigned int i)
+{
+	return &rec_buf[i / REC_PER_BUF][i % REC_PER_BUF];
+}
+
+static inline bool rec_deferred(const struct bootprof_rec_t *r)
+{
+	return r->type == BOOTPROF_REC_PROBE && r->ret == -EPROBE_DEFER;
+}
+
+/* children finished before the parent and are appended before it */
+static void rec_link_children(unsigned int idx)
+{
+	struct bootprof_rec_t *p = rec_get(idx);
+	struct bootprof_rec_t *r;
+	unsigned int i = idx;
+
+	while (i--) {
+		r = rec_get(i);
+		if (r->end < p->start)
+			break;
+		if (r->pid == p->pid && r->parent < 0 && r->start >= p->start)
+			r->parent = idx;
+	}
+}
+
+/*
+ * A probe that deferred before waits on whatever bound last before the
+ * retry: that bind is what moved it back to the active list.
+ */
+static void rec_link_deferral(unsigned int idx)
+{
+	struct bootprof_rec_t *p = rec_get(idx);
+	struct bootprof_rec_t *r;
+	u64 last_defer_end = 0;
+	unsigned int i;
+
+	for (i = 0; i < idx; i++) {
+		r = rec_get(i);
+		if (r->key == p->key && rec_deferred(r)) {
+			p->defer++;
+			last_defer_end = r->end;
+		}
+	}
+	if (!p->defer)
+		return;
+
+	i = idx;
+	while (i--) {
+		r = rec_get(i);
+		if (r->end < last_defer_end)
+			break;
+		if (r->type == BOOTPROF_REC_PROBE && !r->ret &&
+		    r->key != p->key && r->end <= p->start) {
+			p->dep = i;
+			break;
+		}
+	}
+}
+
+void bootprof_rec_add(u8 type, u64 dur, unsigned long fn, const char *drv,
+		      const void *key, const char *name, int ret)
+{
+	struct bootprof_rec_t *r;
+	u64 now = sched_clock();
+	unsigned int idx;
+
+	/* deferrals are kept whatever their length, they are graph edges */
+	if (dur < BOOTPROF_REC_THRESHOLD && ret != -EPROBE_DEFER)
+		return;
+
+	mutex_lock(&rec_lock);
+	if (rec_count >= REC_MAX)
+		goto out;
+	if (!rec_buf[rec_count / REC_PER_BUF]) {
+		rec_buf[rec_count / REC_PER_BUF] =
+			kcalloc(REC_PER_BUF, sizeof(struct bootprof_rec_t),
+				GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+		if (!rec_buf[rec_count / REC_PER_BUF])
+			goto out;
+	}
+
+	idx = rec_count;
+	r = rec_get(idx);
+	r->start = now - dur;
+	r->end = now;
+	r->fn = fn;
+	r->key = key;
+	strlcpy(r->drv, drv ? drv : "", REC_DRV_LEN);
+	strlcpy(r->name, name ? name : "", REC_DEV_LEN);
+	r->pid = current->pid;
+	r->parent = -1;
+	r->dep = -1;
+	r->ret = ret;
+	r->type = type;
+	r->defer = 0;
+
+	rec_link_children(idx);
+	if (type == BOOTPROF_REC_PROBE && !ret)
+		rec_link_deferral(idx);
+	rec_count++;
+out:
+	mutex_unlock(&rec_lock);
+}
+
+bool bootprof_async_probe(struct device_driver *drv)
+{
+	size_t len;
+	const char *p = async_list;
+
+	if (!drv->name || !async_list[0])
+		return false;
+
+	len = strlen(drv->name);
+	while (*p) {
+		if (!strncmp(p, drv->name, len) &&
+		    (p[len] == ',' || p[len] == '\0'))
+			return true;
+		p = strchrnul(p, ',');
+		if (*p)
+			p++;
+	}
+
+	return false;
+}
+
+static void rec_print(struct seq_file *m, unsigned int idx, const char *via)
+{
+	struct bootprof_rec_t *r = rec_get(idx);
+	struct bootprof_rec_t *c;
+	u64 dur = r->end - r->start;
+	u64 child = 0;
+	unsigned int i;
+
+	for (i = 0; i < idx; i++) {
+		c = rec_get(i);
+		if (c->parent == idx)
+			child += c->end - c->start;
+	}
+
+	SEQ_printf(m, "%10lld.%06ld %7llu %7llu %5d %-8s %-6s %pf %s%s%s\n",
+		   nsec_high(r->start), nsec_low(r->start),
+		   div_u64(dur, NSEC_PER_USEC),
+		   div_u64(dur > child ? dur - child : 0, NSEC_PER_USEC),
+		   r->pid, rec_type_str[r->type], via, (void *)r->fn,
+		   r->drv, r->drv[0] ? " " : "", r->name);
+}
+
+/*
+ * Walk back from the top level record that ended last. The predecessor
+ * is whichever finished later: the previous top level record of the same
+ * task (it ran serially before) or, for a retried probe, the bind that
+ * let it through.
+ */
+static void bootprof_critical_path(struct seq_file *m)
+{
+	struct bootprof_rec_t *r, *s;
+	int cur = -1, seq, dep;
+	const char *via = "last";
+	unsigned int i;
+
+	for (i = 0; i < rec_count; i++) {
+		r = rec_get(i);
+		if (r->parent < 0 &&
+		    (cur < 0 || r->end > rec_get(cur)->end))
+			cur = i;
+	}
+
+	SEQ_printf(m, "critical path, latest first (unit: usec)\n");
+	SEQ_printf(m, "%17s %7s %7s %5s %-8s %-6s %s\n",
+		   "start", "total", "self", "pid", "type", "via", "what");
+
+	while (cur >= 0) {
+		rec_print(m, cur, via);
+		r = rec_get(cur);
+
+		dep = r->dep;
+		seq = -1;
+		i = cur;
+		while (i--) {
+			s = rec_get(i);
+			if (s->pid == r->pid && s->parent == r->parent &&
+			    s->end <= r->start && !rec_deferred(s)) {
+				seq = i;
+				break;
+			}
+		}
+
+		if (dep >= 0 &&
+		    (seq < 0 || rec_get(dep)->end > rec_get(seq)->end)) {
+			cur = dep;
+			via = "defer";
+		} else if (seq >= 0) {
+			cur = seq;
+			via = "seq";
+		} else if (r->parent >= 0) {
+			/* first child reached: go on from the record running it */
+			cur = r->parent;
+			via = "parent";
+		} else {
+			cur = -1;
+		}
+	}
+}
+
+/*
+ * Probes worth trying asynchronously: long, run from the init task,
+ * bound first time and nothing retried on them.
+ */
+static void bootprof_async_candidates(struct seq_file *m)
+{
+	struct bootprof_rec_t *r;
+	unsigned int i, j;
+	bool first = true;
+	bool used;
+
+	SEQ_printf(m, "\nasync probe candidates:\nbootprof.async_probe=");
+	for (i = 0; i < rec_count; i++) {
+		r = rec_get(i);
+		if (r->type != BOOTPROF_REC_PROBE || r->ret || r->defer ||
+		    !r->drv[0] || r->pid != 1 ||
+		    r->end - r->start < ASYNC_CAND_THRESHOLD)
+			continue;
+
+		used = false;
+		for (j = i + 1; j < rec_count && !used; j++)
+			used = rec_get(j)->dep == i;
+		if (used)
+			continue;
+
+		SEQ_printf(m, "%s%s", first ? "" : ",", r->drv);
+		first = false;
+	}
+	SEQ_printf(m, "\ncurrent: %s\n", async_list[0] ? async_list : "-");
+}
+
+static int bootprof_graph_show(struct seq_file *m, void *v)
+{
+	mutex_lock(&rec_lock);
+	SEQ_printf(m, "%u records\n", rec_count);
+	bootprof_critical_path(m);
+	bootprof_async_candidates(m);
+	mutex_unlock(&rec_lock);
+
+	return 0;
+}
+
+static int bootprof_graph_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bootprof_graph_show, inode->i_private);
+}
+
+static const struct file_operations bootprof_graph_fops = {
+	.open = bootprof_graph_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int bootprof_rec_show(struct seq_file *m, void *v)
+{
+	char sym[KSYM_NAME_LEN];
+	struct bootprof_rec_out_t out;
+	struct bootprof_rec_t *r;
+	unsigned int i;
+
+	mutex_lock(&rec_lock);
+	for (i = 0; i < rec_count; i++) {
+		r = rec_get(i);
+		/* padding included, the whole struct goes out */
+		memset(&out, 0, sizeof(out));
+		out.start = r->start;
+		out.end = r->end;
+		out.pid = r->pid;
+		out.parent = r->parent;
+		out.dep = r->dep;
+		out.ret = r->ret;
+		out.type = r->type;
+		out.defer = r->defer;
+		/* left empty once the module that had it is gone */
+		if (kallsyms_lookup(r->fn, NULL, NULL, NULL, sym))
+			strlcpy(out.fn, sym, REC_FN_LEN);
+		memcpy(out.drv, r->drv, REC_DRV_LEN);
+		memcpy(out.name, r->name, REC_DEV_LEN);
+		seq_write(m, &out, sizeof(out));
+	}
+	mutex_unlock(&rec_lock);
+
+	return 0;
+}
+
+static int bootprof_rec_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, bootprof_rec_show, inode->i_private,
+				REC_MAX * sizeof(struct bootprof_rec_out_t));
+}
+
+static const struct file_operations bootprof_rec_fops = {
+	.open = bootprof_rec_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init init_bootprof_graph(void)
+{
+	if (!proc_create("bootprof_graph", 0444, NULL, &bootprof_graph_fops))
+		return -ENOMEM;
+	if (!proc_create("bootprof_rec", 0444, NULL, &bootprof_rec_fops))
+		return -ENOMEM;
+	return 0;
+}
+device_initcall(init_bootprof_graph);
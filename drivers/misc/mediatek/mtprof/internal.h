@@ -51,6 +51,15 @@ unsigned long nsec_low(unsigned long long nsec);
 /* for bootprof.c */
 unsigned int gpt_boot_time(void);
 
+/* for bootprof_graph.c */
+enum {
+	BOOTPROF_REC_INITCALL,
+	BOOTPROF_REC_PROBE,
+	BOOTPROF_REC_PDEV,
+};
+void bootprof_rec_add(u8 type, u64 dur, unsigned long fn, const char *drv,
+		      const void *key, const char *name, int ret);
+
 const char *isr_name(int irq);
 long long usec_high(unsigned long long usec);
 unsigned long usec_low(unsigned long long usec);
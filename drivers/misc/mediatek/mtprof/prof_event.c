@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Binary fork/exit/signal recorder
+ *
+ * The tracepoint probes only copy a fixed size record into a per-CPU
+ * ring; nothing is formatted until someone reads:
+ *   /proc/mtprof/proc_event       echo 1 to start (clears), 0 to stop;
+ *                                 reading prints the records by time
+ *   /proc/mtprof/proc_event_stat  fork rate per parent, process lifetime
+ *                                 histogram and signal storms
+ */
+
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/signal.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include <trace/events/sched.h>
+#include <trace/events/signal.h>
+
+#include "internal.h"
+
+#define PROC_EVENT_RING_SIZE	1024	/* records per CPU, power of two */
+#define PROC_EVENT_LIFE_BUCKETS	24	/* log2 msec, up to ~2.3 hours */
+#define PROC_EVENT_TOP		16
+#define PROC_EVENT_STORM	16	/* same signal to same target */
+
+enum {
+	PROC_EVENT_FORK,
+	PROC_EVENT_EXIT,
+	PROC_EVENT_SIG_GEN,
+	PROC_EVENT_SIG_DLV,
+};
+
+struct proc_event_t {
+	u64 ts;
+	pid_t pid;		/* parent, exiting task, sender, receiver */
+	pid_t tgid;
+	pid_t peer;		/* child or signal target */
+	u32 arg;		/* fork usec, lifetime msec, result */
+	u16 type;
+	s16 sig;
+	char comm[TASK_COMM_LEN];
+	char peer_comm[TASK_COMM_LEN];
+};
+
+struct proc_event_ring_t {
+	struct proc_event_t *rec;
+	unsigned long head;
+	unsigned long life[PROC_EVENT_LIFE_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct proc_event_ring_t, proc_event_ring);
+static DEFINE_MUTEX(proc_event_lock);
+static bool proc_event_on;
+static u64 proc_event_since;
+
+static const char * const proc_event_str[] = {
+	[PROC_EVENT_FORK] = "fork",
+	[PROC_EVENT_EXIT] = "exit",
+	[PROC_EVENT_SIG_GEN] = "sig_gen",
+	[PROC_EVENT_SIG_DLV] = "sig_dlv",
+};
+
+/*
+ * Signals are generated from interrupts too, so the slot is claimed and
+ * filled with local irqs off; the reader drops anything it may have
+ * raced with by checking head again after the copy.
+ */
+static struct proc_event_t *proc_event_get(struct proc_event_ring_t **ring,
+					   unsigned long *flags)
+{
+	struct proc_event_ring_t *r;
+
+	local_irq_save(*flags);
+	r = this_cpu_ptr(&proc_event_ring);
+	if (unlikely(!r->rec)) {
+		local_irq_restore(*flags);
+		return NULL;
+	}
+	*ring = r;
+	return &r->rec[r->head & (PROC_EVENT_RING_SIZE - 1)];
+}
+
+static void proc_event_put(struct proc_event_ring_t *r, unsigned long flags)
+{
+	smp_wmb();
+	WRITE_ONCE(r->head, r->head + 1);
+	local_irq_restore(flags);
+}
+
+static void probe_event_fork(void *ignore, struct task_struct *parent,
+			     struct task_struct *child, unsigned long long dur)
+{
+	struct proc_event_ring_t *r;
+	struct proc_event_t *e;
+	unsigned long flags;
+
+	e = proc_event_get(&r, &flags);
+	if (!e)
+		return;
+	e->ts = sched_clock();
+	e->type = PROC_EVENT_FORK;
+	e->pid = parent->pid;
+	e->tgid = parent->tgid;
+	e->peer = child->pid;
+	/* dur comes from sched_clock(), in ns */
+	e->arg = min_t(u64, div_u64(dur, NSEC_PER_USEC), U32_MAX);
+	e->sig = 0;
+	memcpy(e->comm, parent->comm, TASK_COMM_LEN);
+	memcpy(e->peer_comm, child->comm, TASK_COMM_LEN);
+	proc_event_put(r, flags);
+}
+
+static void probe_event_exit(void *ignore, struct task_struct *p)
+{
+	struct proc_event_ring_t *r;
+	struct proc_event_t *e;
+	unsigned long flags;
+	u64 life;
+
+	e = proc_event_get(&r, &flags);
+	if (!e)
+		return;
+	life = div_u64(ktime_get_ns() - p->start_time, NSEC_PER_MSEC);
+	e->ts = sched_clock();
+	e->type = PROC_EVENT_EXIT;
+	e->pid = p->pid;
+	e->tgid = p->tgid;
+	e->peer = 0;
+	e->arg = min_t(u64, life, U32_MAX);
+	e->sig = 0;
+	memcpy(e->comm, p->comm, TASK_COMM_LEN);
+	e->peer_comm[0] = '\0';
+	/* lifetime of processes only, not of every thread */
+	if (p == p->group_leader)
+		r->life[min_t(unsigned int, life ? ilog2(life) + 1 : 0,
+			      PROC_EVENT_LIFE_BUCKETS - 1)]++;
+	proc_event_put(r, flags);
+}
+
+static void probe_event_sig_gen(void *ignore, int sig, struct siginfo *info,
+				struct task_struct *task, int group,
+				int result)
+{
+	struct proc_event_ring_t *r;
+	struct proc_event_t *e;
+	unsigned long flags;
+
+	e = proc_event_get(&r, &flags);
+	if (!e)
+		return;
+	e->ts = sched_clock();
+	e->type = PROC_EVENT_SIG_GEN;
+	e->pid = current->pid;
+	e->tgid = current->tgid;
+	e->peer = task->pid;
+	e->arg = result;
+	e->sig = sig;
+	memcpy(e->comm, current->comm, TASK_COMM_LEN);
+	memcpy(e->peer_comm, task->comm, TASK_COMM_LEN);
+	proc_event_put(r, flags);
+}
+
+static void probe_event_sig_dlv(void *ignore, int sig, struct siginfo *info,
+				struct k_sigaction *ka)
+{
+	struct proc_event_ring_t *r;
+	struct proc_event_t *e;
+	unsigned long flags;
+
+	e = proc_event_get(&r, &flags);
+	if (!e)
+		return;
+	e->ts = sched_clock();
+	e->type = PROC_EVENT_SIG_DLV;
+	e->pid = current->pid;
+	e->tgid = current->tgid;
+	e->peer = 0;
+	e->arg = 0;
+	e->sig = sig;
+	memcpy(e->comm, current->comm, TASK_COMM_LEN);
+	e->peer_comm[0] = '\0';
+	proc_event_put(r, flags);
+}
+
+static void proc_event_register(bool on)
+{
+	if (on) {
+		register_trace_sched_fork_time(probe_event_fork, NULL);
+		register_trace_sched_process_exit(probe_event_exit, NULL);
+		register_trace_signal_generate(probe_event_sig_gen, NULL);
+		register_trace_signal_deliver(probe_event_sig_dlv, NULL);
+	} else {
+		unregister_trace_sched_fork_time(probe_event_fork, NULL);
+		unregister_trace_sched_process_exit(probe_event_exit, NULL);
+		unregister_trace_signal_generate(probe_event_sig_gen, NULL);
+		unregister_trace_signal_deliver(probe_event_sig_dlv, NULL);
+		tracepoint_synchronize_unregister();
+	}
+}
+
+/* rings stay allocated once used; starting again only clears them */
+static int proc_event_switch(bool on)
+{
+	struct proc_event_ring_t *r;
+	int cpu;
+
+	if (proc_event_on == on)
+		return 0;
+
+	if (on) {
+		for_each_possible_cpu(cpu) {
+			r = per_cpu_ptr(&proc_event_ring, cpu);
+			if (!r->rec)
+				r->rec = vzalloc(PROC_EVENT_RING_SIZE *
+						 sizeof(struct proc_event_t));
+			if (!r->rec)
+				return -ENOMEM;
+			r->head = 0;
+			memset(r->life, 0, sizeof(r->life));
+		}
+		proc_event_since = sched_clock();
+	}
+
+	proc_event_register(on);
+	proc_event_on = on;
+	return 0;
+}
+
+/* a time ordered copy of all rings, taken at open */
+struct proc_event_snap_t {
+	unsigned int n;
+	u64 span;
+	unsigned long life[PROC_EVENT_LIFE_BUCKETS];
+	struct proc_event_t rec[0];
+};
+
+static int proc_event_cmp(const void *a, const void *b)
+{
+	const struct proc_event_t *x = a, *y = b;
+
+	if (x->ts == y->ts)
+		return 0;
+	return x->ts < y->ts ? -1 : 1;
+}
+
+static struct proc_event_snap_t *proc_event_snapshot(void)
+{
+	struct proc_event_snap_t *s;
+	struct proc_event_ring_t *r;
+	unsigned long head, tail, i, j;
+	unsigned int n;
+	int cpu;
+
+	s = vzalloc(sizeof(*s) + num_possible_cpus() *
+		    PROC_EVENT_RING_SIZE * sizeof(struct proc_event_t));
+	if (!s)
+		return NULL;
+
+	mutex_lock(&proc_event_lock);
+	for_each_possible_cpu(cpu) {
+		r = per_cpu_ptr(&proc_event_ring, cpu);
+		if (!r->rec)
+			continue;
+		head = READ_ONCE(r->head);
+		smp_rmb();
+		tail = head > PROC_EVENT_RING_SIZE ?
+		       head - PROC_EVENT_RING_SIZE : 0;
+		n = s->n;
+		for (i = tail; i < head; i++)
+			s->rec[s->n++] =
+				r->rec[i & (PROC_EVENT_RING_SIZE - 1)];
+		smp_rmb();
+		/*
+		 * drop what the writer may have overwritten meanwhile,
+		 * including the slot it may be filling right now
+		 */
+		j = READ_ONCE(r->head);
+		if (j - tail >= PROC_EVENT_RING_SIZE) {
+			j = min_t(unsigned long, j - tail -
+				  PROC_EVENT_RING_SIZE + 1, s->n - n);
+			memmove(&s->rec[n], &s->rec[n + j],
+				(s->n - n - j) * sizeof(struct proc_event_t));
+			s->n -= j;
+		}
+		for (i = 0; i < PROC_EVENT_LIFE_BUCKETS; i++)
+			s->life[i] += READ_ONCE(r->life[i]);
+	}
+	s->span = sched_clock() - proc_event_since;
+	mutex_unlock(&proc_event_lock);
+
+	sort(s->rec, s->n, sizeof(struct proc_event_t), proc_event_cmp, NULL);
+	if (s->n)
+		s->span = s->rec[s->n - 1].ts - s->rec[0].ts;
+
+	return s;
+}
+
+static void *proc_event_start(struct seq_file *m, loff_t *pos)
+{
+	struct proc_event_snap_t *s = m->private;
+
+	return *pos < s->n ? &s->rec[*pos] : NULL;
+}
+
+static void *proc_event_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return proc_event_start(m, pos);
+}
+
+static void proc_event_stop(struct seq_file *m, void *v)
+{
+}
+
+static int proc_event_show(struct seq_file *m, void *v)
+{
+	struct proc_event_t *e = v;
+
+	SEQ_printf(m, "%5lld.%06ld %-7s %5d:%-16s",
+		   nsec_high(e->ts), nsec_low(e->ts),
+		   proc_event_str[e->type], e->pid, e->comm);
+
+	switch (e->type) {
+	case PROC_EVENT_FORK:
+		SEQ_printf(m, " -> %d:%s %uus\n",
+			   e->peer, e->peer_comm, e->arg);
+		break;
+	case PROC_EVENT_EXIT:
+		SEQ_printf(m, " tgid %d lived %ums\n", e->tgid, e->arg);
+		break;
+	case PROC_EVENT_SIG_GEN:
+		SEQ_printf(m, " sig %d -> %d:%s res %u\n",
+			   e->sig, e->peer, e->peer_comm, e->arg);
+		break;
+	default:
+		SEQ_printf(m, " sig %d\n", e->sig);
+		break;
+	}
+	return 0;
+}
+
+static const struct seq_operations proc_event_seq_ops = {
+	.start = proc_event_start,
+	.next = proc_event_next,
+	.stop = proc_event_stop,
+	.show = proc_event_show,
+};
+
+static int proc_event_open(struct inode *inode, struct file *file)
+{
+	struct proc_event_snap_t *s = NULL;
+	int ret;
+
+	/* echo 0/1 does not need a copy of the rings */
+	if (file->f_mode & FMODE_READ) {
+		s = proc_event_snapshot();
+		if (!s)
+			return -ENOMEM;
+	}
+	ret = seq_open(file, &proc_event_seq_ops);
+	if (ret) {
+		vfree(s);
+		return ret;
+	}
+	((struct seq_file *)file->private_data)->private = s;
+	return 0;
+}
+
+static int proc_event_release(struct inode *inode, struct file *file)
+{
+	vfree(((struct seq_file *)file->private_data)->private);
+	return seq_release(inode, file);
+}
+
+static ssize_t proc_event_write(struct file *filp, const char __user *ubuf,
+				size_t cnt, loff_t *data)
+{
+	bool on;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, cnt, &on);
+	if (ret)
+		return ret;
+
+	mutex_lock(&proc_event_lock);
+	ret = proc_event_switch(on);
+	mutex_unlock(&proc_event_lock);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations proc_event_fops = {
+	.open = proc_event_open,
+	.write = proc_event_write,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = proc_event_release,
+};
+
+struct proc_event_top_t {
+	pid_t pid;
+	int sig;
+	unsigned int count;
+	char comm[TASK_COMM_LEN];
+};
+
+/* count into a small table; keys seen once it is full are left out */
+static void proc_event_top_add(struct proc_event_top_t *top, pid_t pid,
+			       int sig, const char *comm)
+{
+	int i;
+
+	for (i = 0; i < PROC_EVENT_TOP && top[i].count; i++) {
+		if (top[i].pid == pid && top[i].sig == sig) {
+			top[i].count++;
+			return;
+		}
+	}
+	if (i == PROC_EVENT_TOP)
+		return;
+	top[i].pid = pid;
+	top[i].sig = sig;
+	top[i].count = 1;
+	memcpy(top[i].comm, comm, TASK_COMM_LEN);
+}
+
+static int proc_event_top_cmp(const void *a, const void *b)
+{
+	const struct proc_event_top_t *x = a, *y = b;
+
+	if (x->count == y->count)
+		return 0;
+	return x->count > y->count ? -1 : 1;
+}
+
+static int proc_event_stat_show(struct seq_file *m, void *v)
+{
+	struct proc_event_snap_t *s;
+	struct proc_event_top_t *fork, *sig;
+	u64 span_ms;
+	unsigned int i;
+
+	s = proc_event_snapshot();
+	fork = kcalloc(2 * PROC_EVENT_TOP, sizeof(*fork), GFP_KERNEL);
+	if (!s || !fork) {
+		vfree(s);
+		kfree(fork);
+		return -ENOMEM;
+	}
+	sig = fork + PROC_EVENT_TOP;
+
+	for (i = 0; i < s->n; i++) {
+		if (s->rec[i].type == PROC_EVENT_FORK)
+			proc_event_top_add(fork, s->rec[i].tgid, 0,
+					   s->rec[i].comm);
+		else if (s->rec[i].type == PROC_EVENT_SIG_GEN)
+			proc_event_top_add(sig, s->rec[i].peer, s->rec[i].sig,
+					   s->rec[i].peer_comm);
+	}
+	sort(fork, PROC_EVENT_TOP, sizeof(*fork), proc_event_top_cmp, NULL);
+	sort(sig, PROC_EVENT_TOP, sizeof(*sig), proc_event_top_cmp, NULL);
+	span_ms = max_t(u64, div_u64(s->span, NSEC_PER_MSEC), 1);
+
+	SEQ_printf(m, "%s, %u records over %llu ms\n",
+		   proc_event_on ? "on" : "off", s->n, span_ms);
+
+	SEQ_printf(m, "\nfork rate per parent (tgid, forks, forks/s)\n");
+	for (i = 0; i < PROC_EVENT_TOP && fork[i].count; i++)
+		SEQ_printf(m, "%5d:%-16s %6u %6llu\n",
+			   fork[i].pid, fork[i].comm, fork[i].count,
+			   div64_u64((u64)fork[i].count * MSEC_PER_SEC,
+				     span_ms));
+
+	SEQ_printf(m, "\nprocess lifetime (ms, processes since start)\n");
+	for (i = 0; i < PROC_EVENT_LIFE_BUCKETS; i++) {
+		if (!s->life[i])
+			continue;
+		SEQ_printf(m, "<%-10lu %lu\n", 1UL << i, s->life[i]);
+	}
+
+	SEQ_printf(m, "\nsignal storms (target, sig, count >= %d)\n",
+		   PROC_EVENT_STORM);
+	for (i = 0; i < PROC_EVENT_TOP &&
+	     sig[i].count >= PROC_EVENT_STORM; i++)
+		SEQ_printf(m, "%5d:%-16s %3d %6u\n",
+			   sig[i].pid, sig[i].comm, sig[i].sig, sig[i].count);
+
+	kfree(fork);
+	vfree(s);
+	return 0;
+}
+
+static int proc_event_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, proc_event_stat_show, inode->i_private);
+}
+
+static const struct file_operations proc_event_stat_fops = {
+	.open = proc_event_stat_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* after init_mtsched_prof(), which creates /proc/mtprof */
+static int __init init_proc_event(void)
+{
+	if (!proc_create("mtprof/proc_event", 0664, NULL, &proc_event_fops))
+		return -ENOMEM;
+	if (!proc_create("mtprof/proc_event_stat", 0444, NULL,
+			 &proc_event_stat_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(init_proc_event);
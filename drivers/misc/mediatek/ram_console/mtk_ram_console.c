@@ -287,6 +287,253 @@ unsigned int ram_console_size(void)
 	return ram_console_buffer->sz_console;
 }
 
+#ifdef CONFIG_MTK_RAM_CONSOLE_PLOG
+/*
+ * Persistent printk log
+ *
+ * The console area is split into one byte ring per CPU. printk() writes
+ * each line into the ring of the CPU it runs on with irqs off, so CPUs
+ * share nothing but the sequence counter used to merge the rings again
+ * after a warm reset. A record never wraps, the end of a ring is padded
+ * instead; a reader of an old ring resyncs on RC_PLOG_MAGIC after the
+ * last write position.
+ */
+#define RC_PLOG_SIG		0x474f4c50	/* "PLOG" */
+#define RC_PLOG_MAGIC		0x5043
+#define RC_PLOG_PAD		0xffff
+#define RC_PLOG_LINE_MAX	512
+
+struct rc_plog_header {
+	uint32_t sig;
+	uint32_t nr_ring;
+	uint32_t ring_size;	/* data bytes per ring, multiple of 8 */
+	uint32_t reserved;
+};
+
+struct rc_plog_ring {
+	uint32_t head;		/* next write offset in data */
+	uint32_t wrapped;
+	char data[0];
+};
+
+struct rc_plog_rec {
+	uint64_t ts;
+	uint32_t seq;
+	uint16_t magic;
+	uint16_t len;		/* text bytes, or RC_PLOG_PAD */
+	uint8_t level;
+	uint8_t cpu;
+	uint16_t reserved;
+};
+
+static struct rc_plog_header *rc_plog;
+static atomic_t rc_plog_seq = ATOMIC_INIT(0);
+
+/* lines at or above this level go to the plog only, not the consoles */
+static int plog_quiet_level = LOGLEVEL_DEBUG + 1;
+module_param(plog_quiet_level, int, 0644);
+
+#define RC_PLOG_REC_SIZE(len) \
+	ALIGN(sizeof(struct rc_plog_rec) + (len), 8)
+
+static struct rc_plog_ring *rc_plog_ring(struct rc_plog_header *h,
+		unsigned int i)
+{
+	return (void *)(h + 1) +
+		i * (sizeof(struct rc_plog_ring) + h->ring_size);
+}
+
+static void rc_plog_init(struct ram_console_buffer *buffer)
+{
+	struct rc_plog_header *h = (void *)buffer + buffer->off_console;
+	uint32_t per_ring;
+
+	if (buffer->sz_console < sizeof(*h))
+		return;
+	per_ring = (buffer->sz_console - sizeof(*h)) / nr_cpu_ids;
+	per_ring = round_down(per_ring, 8);
+	if (per_ring < sizeof(struct rc_plog_ring) +
+			RC_PLOG_REC_SIZE(RC_PLOG_LINE_MAX)) {
+		pr_notice("ram_console: plog too small, %u per cpu\n",
+				per_ring);
+		return;
+	}
+
+	h->nr_ring = nr_cpu_ids;
+	h->ring_size = per_ring - sizeof(struct rc_plog_ring);
+	h->sig = RC_PLOG_SIG;
+	rc_plog = h;
+}
+
+/* called with irqs off: printk(), or the FIQ/IRQ debugger */
+static void rc_plog_write(int level, const char *text, size_t len)
+{
+	struct rc_plog_ring *ring;
+	struct rc_plog_rec rec;
+	unsigned int cpu = raw_smp_processor_id();
+	uint32_t size, need;
+
+	if (!rc_plog || cpu >= rc_plog->nr_ring)
+		return;
+
+	len = min_t(size_t, len, RC_PLOG_LINE_MAX);
+	need = RC_PLOG_REC_SIZE(len);
+	size = rc_plog->ring_size;
+	ring = rc_plog_ring(rc_plog, cpu);
+
+	if (ring->head + need > size) {
+		if (ring->head + sizeof(rec) <= size) {
+			memset(&rec, 0, sizeof(rec));
+			rec.magic = RC_PLOG_MAGIC;
+			rec.len = RC_PLOG_PAD;
+			memcpy(ring->data + ring->head, &rec, sizeof(rec));
+		}
+		ring->head = 0;
+		ring->wrapped = 1;
+	}
+
+	rec.ts = local_clock();
+	rec.seq = atomic_inc_return(&rc_plog_seq);
+	rec.magic = RC_PLOG_MAGIC;
+	rec.len = len;
+	rec.level = level;
+	rec.cpu = cpu;
+	rec.reserved = 0;
+	memcpy(ring->data + ring->head, &rec, sizeof(rec));
+	memcpy(ring->data + ring->head + sizeof(rec), text, len);
+	ring->head += need;
+}
+
+static inline bool rc_plog_active(void)
+{
+	return rc_plog != NULL;
+}
+
+bool ram_console_plog_write(int level, const char *text, size_t len)
+{
+	if (!rc_plog || atomic_read(&rc_in_fiq))
+		return false;
+
+	rc_plog_write(level, text, len);
+	return level >= READ_ONCE(plog_quiet_level);
+}
+
+/* walks one ring of an old buffer, oldest record first */
+struct rc_plog_iter {
+	const char *data;
+	uint32_t size;
+	uint32_t head;
+	uint32_t off;
+	bool older;	/* still in [head, size) of a wrapped ring */
+	const struct rc_plog_rec *rec;
+};
+
+static bool rc_plog_valid(const struct rc_plog_iter *it, uint32_t off,
+		const struct rc_plog_rec **rec)
+{
+	*rec = (const void *)(it->data + off);
+	if (off + sizeof(**rec) > it->size || (*rec)->magic != RC_PLOG_MAGIC)
+		return false;
+	if ((*rec)->len == RC_PLOG_PAD)
+		return true;
+	return (*rec)->len <= RC_PLOG_LINE_MAX &&
+		off + RC_PLOG_REC_SIZE((*rec)->len) <= it->size;
+}
+
+static void rc_plog_next(struct rc_plog_iter *it)
+{
+	const struct rc_plog_rec *rec;
+
+	it->rec = NULL;
+	while (it->older) {
+		if (it->off >= it->size) {
+			it->older = false;
+			it->off = 0;
+			break;
+		}
+		if (!rc_plog_valid(it, it->off, &rec)) {
+			it->off += 8;	/* resync */
+			continue;
+		}
+		if (rec->len == RC_PLOG_PAD) {
+			it->older = false;
+			it->off = 0;
+			break;
+		}
+		it->off += RC_PLOG_REC_SIZE(rec->len);
+		it->rec = rec;
+		return;
+	}
+
+	if (it->off < it->head && rc_plog_valid(it, it->off, &rec) &&
+			rec->len != RC_PLOG_PAD) {
+		it->off += RC_PLOG_REC_SIZE(rec->len);
+		it->rec = rec;
+	}
+}
+
+static bool rc_plog_show(struct ram_console_buffer *buffer,
+		struct seq_file *m)
+{
+	struct rc_plog_header *h = (void *)buffer + buffer->off_console;
+	struct rc_plog_ring *ring;
+	struct rc_plog_iter *it;
+	const struct rc_plog_rec *rec;
+	unsigned long rem;
+	uint64_t ts;
+	unsigned int i, pick;
+
+	if (buffer->off_console + sizeof(*h) > buffer->sz_buffer ||
+			h->sig != RC_PLOG_SIG || !h->nr_ring ||
+			h->nr_ring > NR_CPUS ||
+			sizeof(*h) + (uint64_t)h->nr_ring * (sizeof(*ring) +
+			h->ring_size) > buffer->sz_buffer - buffer->off_console)
+		return false;
+
+	it = kcalloc(h->nr_ring, sizeof(*it), GFP_KERNEL);
+	if (!it)
+		return false;
+	for (i = 0; i < h->nr_ring; i++) {
+		ring = rc_plog_ring(h, i);
+		it[i].data = ring->data;
+		it[i].size = h->ring_size;
+		it[i].head = min_t(uint32_t, round_down(ring->head, 8),
+				h->ring_size);
+		it[i].older = ring->wrapped;
+		it[i].off = it[i].older ? it[i].head : 0;
+		rc_plog_next(&it[i]);
+	}
+
+	/* merge the rings by sequence number */
+	for (;;) {
+		pick = h->nr_ring;
+		for (i = 0; i < h->nr_ring; i++)
+			if (it[i].rec && (pick == h->nr_ring ||
+			    (int32_t)(it[i].rec->seq -
+				      it[pick].rec->seq) < 0))
+				pick = i;
+		if (pick == h->nr_ring)
+			break;
+
+		rec = it[pick].rec;
+		ts = rec->ts;
+		rem = do_div(ts, NSEC_PER_SEC);
+		seq_printf(m, "<%u>[%5llu.%06lu] C%u %.*s\n", rec->level,
+			   ts, rem / NSEC_PER_USEC, rec->cpu, rec->len,
+			   (const char *)(rec + 1));
+		rc_plog_next(&it[pick]);
+	}
+
+	kfree(it);
+	return true;
+}
+#else
+static inline bool rc_plog_active(void)
+{
+	return false;
+}
+#endif
+
 #ifdef CONFIG_PSTORE
 void __weak pstore_bconsole_write(struct console *con, const char *s,
 		unsigned int c)
@@ -342,6 +589,12 @@ void sram_log_save(const char *msg, int count)
 		pr_notice("ram console buffer is NULL!\n");
 		return;
 	}
+#ifdef CONFIG_MTK_RAM_CONSOLE_PLOG
+	if (rc_plog) {
+		rc_plog_write(LOGLEVEL_EMERG, msg, count);
+		return;
+	}
+#endif
 
 	buffer = ram_console_buffer;
 	rc_console = (char *)ram_console_buffer +
@@ -498,6 +751,14 @@ static int ram_console_lastk_show(struct ram_console_buffer *buffer,
 			ram_console_clear ?
 			"Clear" : "Not Clear", old_wdt_status);
 
+#ifdef CONFIG_MTK_RAM_CONSOLE_PLOG
+	if (rc_plog_show(buffer, m)) {
+#ifdef CONFIG_PSTORE_CONSOLE
+		pstore_console_show(PSTORE_TYPE_CONSOLE, m, v);
+#endif
+		return 0;
+	}
+#endif
 #ifdef CONFIG_PSTORE_CONSOLE
 	pstore_console_show(PSTORE_TYPE_CONSOLE, m, v);
 #else
@@ -586,8 +847,13 @@ static int __init ram_console_init(struct ram_console_buffer *buffer,
 	memset_io((void *)buffer + buffer->off_linux, 0,
 			buffer_size - buffer->off_linux);
 	ram_console_init_desc(buffer->off_linux);
+#ifdef CONFIG_MTK_RAM_CONSOLE_PLOG
+	rc_plog_init(buffer);
+#endif
 #ifndef CONFIG_PSTORE
-	register_console(&ram_console);
+	/* printk feeds the plog directly, no console needed then */
+	if (!rc_plog_active())
+		register_console(&ram_console);
 #endif
 	ram_console_init_val();
 	ram_console_init_done = 1;
@@ -32,6 +32,7 @@
 #include <linux/version.h>
 #include <mt-plat/aee.h>
 #include <mt-plat/sync_write.h>
+#include <mt-plat/mtk_wake_acct.h>
 #ifdef CONFIG_MTK_GPU_SUPPORT
 #include "mtk_gpufreq.h"
 #endif
@@ -350,6 +351,10 @@ static struct hrtimer ts_tempinfo_hrtimer;
 static struct timer_list normal_timer;
 static int hrtimer_flag = -1;
 static DEFINE_SPINLOCK(tempinfo_timer_lock);
+static struct mtk_wake_client tscpu_wake = {
+	.name = "thermal",
+	.slack_ms = 10,
+};
 
 
 #define tscpu_dprintk(fmt, args...)                      \
@@ -4020,8 +4025,9 @@ void start_tempinfo_update_timer(void)
 {
 
 	if (read_curr_temp > fast_polling_trip_temp) {
-		hrtimer_start(&ts_tempinfo_hrtimer,
-			ktime_set(0, 50 * 1000000), HRTIMER_MODE_REL);
+		hrtimer_start_range_ns(&ts_tempinfo_hrtimer,
+			ktime_set(0, 50 * 1000000),
+			mtk_wake_acct_slack_ns(&tscpu_wake), HRTIMER_MODE_REL);
 		hrtimer_flag = 4;
 	} else {
 		add_timer(&normal_timer);
@@ -4077,8 +4083,9 @@ static enum hrtimer_restart update_tempinfo_timer(void)
 			tscpu_dprintk(" %s: hrtimer_flag:%d, curr_temp:%d\n",
 				__func__, hrtimer_flag, read_curr_temp);
 		} else if (hrtimer_flag < 3) {
-			hrtimer_start(&ts_tempinfo_hrtimer,
+			hrtimer_start_range_ns(&ts_tempinfo_hrtimer,
 				ktime_set(0, temp_update_interval * 1000000),
+				mtk_wake_acct_slack_ns(&tscpu_wake),
 				HRTIMER_MODE_REL);
 			hrtimer_flag = 3;
 			tscpu_dprintk(" %s: hrtimer_flag:%d, curr_temp:%d\n",
@@ -4113,6 +4120,8 @@ static enum hrtimer_restart tscpu_update_tempinfo(struct hrtimer *timer)
 	static int resume_ok;
 	/* tscpu_printk("tscpu_update_tempinfo\n"); */
 
+	mtk_wake_acct_client_fire(&tscpu_wake);
+
 	if (g_tc_resume == 0) {
 		read_all_temperature();
 		if (resume_ok) {
@@ -4163,6 +4172,7 @@ void tempinfo_normal_timer_init(void)
 
 static void tscpu_update_temperature_timer_init(void)
 {
+	mtk_wake_acct_register(&tscpu_wake);
 	tempinfo_hrtimer_init();
 	tempinfo_normal_timer_init();
 	start_tempinfo_update_timer();
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2019 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * mt8512 actions for usb_boost
+ *
+ *   cpu_freq    arg1: policy min in kHz, -1 for the policy max
+ *   cpu_core    arg1: cpu_dma_latency bound in us. All four cores stay
+ *               online on mt8512, holding keeps them out of the deep
+ *               idle states instead.
+ *   dram_vcore  arg1: vcore opp, 0 is the highest
+ *
+ * Actions are called from the boost and sampling works, never from
+ * atomic context.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/pm_qos.h>
+
+#include "usb_boost.h"
+
+static int cpu_freq_para[] = {1, 3, 300, 0};
+static int cpu_core_para[] = {1, 3, 300, 0};
+static int dram_vcore_para[] = {1, 3, 300, 0};
+
+static struct act_arg_obj cpu_freq_arg = {-1, -1, -1};
+static struct act_arg_obj cpu_core_arg = {100, -1, -1};
+static struct act_arg_obj dram_vcore_arg = {0, -1, -1};
+
+static unsigned int boost_min_khz;
+static struct pm_qos_request cpu_core_req;
+static struct pm_qos_request dram_vcore_req;
+
+static int usb_boost_cpufreq_notifier(struct notifier_block *nb,
+				      unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	unsigned int khz = READ_ONCE(boost_min_khz);
+
+	if (event != CPUFREQ_ADJUST || !khz)
+		return NOTIFY_DONE;
+
+	/* thermal lowers policy->max, never go above it */
+	cpufreq_verify_within_limits(policy, min(khz, policy->max),
+				     policy->max);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block usb_boost_cpufreq_nb = {
+	.notifier_call = usb_boost_cpufreq_notifier,
+};
+
+static void cpu_freq_update(unsigned int khz)
+{
+	int cpu;
+
+	if (READ_ONCE(boost_min_khz) == khz)
+		return;
+
+	WRITE_ONCE(boost_min_khz, khz);
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		cpufreq_update_policy(cpu);
+	put_online_cpus();
+}
+
+static int cpu_freq_hold(struct act_arg_obj *arg)
+{
+	cpu_freq_update(arg->arg1 > 0 ? arg->arg1 : UINT_MAX);
+	return 0;
+}
+
+static int cpu_freq_release(struct act_arg_obj *arg)
+{
+	cpu_freq_update(0);
+	return 0;
+}
+
+static int cpu_core_hold(struct act_arg_obj *arg)
+{
+	pm_qos_update_request(&cpu_core_req,
+		arg->arg1 >= 0 ? arg->arg1 : 0);
+	return 0;
+}
+
+static int cpu_core_release(struct act_arg_obj *arg)
+{
+	pm_qos_update_request(&cpu_core_req,
+		PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE);
+	return 0;
+}
+
+static int dram_vcore_hold(struct act_arg_obj *arg)
+{
+	pm_qos_update_request(&dram_vcore_req,
+		arg->arg1 >= 0 ? arg->arg1 : 0);
+	return 0;
+}
+
+static int dram_vcore_release(struct act_arg_obj *arg)
+{
+	pm_qos_update_request(&dram_vcore_req,
+		PM_QOS_VCORE_OPP_DEFAULT_VALUE);
+	return 0;
+}
+
+static int __init usb_boost_plat_init(void)
+{
+	pm_qos_add_request(&cpu_core_req, PM_QOS_CPU_DMA_LATENCY,
+		PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE);
+	pm_qos_add_request(&dram_vcore_req, PM_QOS_VCORE_OPP,
+		PM_QOS_VCORE_OPP_DEFAULT_VALUE);
+	cpufreq_register_notifier(&usb_boost_cpufreq_nb,
+		CPUFREQ_POLICY_NOTIFIER);
+
+	register_usb_boost_act(TYPE_CPU_FREQ, ACT_HOLD, cpu_freq_hold);
+	register_usb_boost_act(TYPE_CPU_FREQ, ACT_RELEASE, cpu_freq_release);
+	register_usb_boost_act(TYPE_CPU_CORE, ACT_HOLD, cpu_core_hold);
+	register_usb_boost_act(TYPE_CPU_CORE, ACT_RELEASE, cpu_core_release);
+	register_usb_boost_act(TYPE_DRAM_VCORE, ACT_HOLD, dram_vcore_hold);
+	register_usb_boost_act(TYPE_DRAM_VCORE, ACT_RELEASE,
+		dram_vcore_release);
+
+	usb_boost_init();
+
+	/* after usb_boost_init(), which loads the generic defaults */
+	usb_boost_set_para_and_arg(TYPE_CPU_FREQ, cpu_freq_para,
+		ARRAY_SIZE(cpu_freq_para), &cpu_freq_arg);
+	usb_boost_set_para_and_arg(TYPE_CPU_CORE, cpu_core_para,
+		ARRAY_SIZE(cpu_core_para), &cpu_core_arg);
+	usb_boost_set_para_and_arg(TYPE_DRAM_VCORE, dram_vcore_para,
+		ARRAY_SIZE(dram_vcore_para), &dram_vcore_arg);
+
+	return 0;
+}
+late_initcall(usb_boost_plat_init);
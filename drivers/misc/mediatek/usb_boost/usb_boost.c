@@ -21,6 +21,10 @@
 #include <linux/version.h>
 #include <linux/workqueue.h>
 #include <linux/kdev_t.h>
+#include <linux/atomic.h>
+#include <linux/jiffies.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
 
 #include "usb_boost.h"
 #define USB_BOOST_CLASS_NAME "usb_boost"
@@ -113,6 +117,19 @@ static struct act_arg_obj dram_vcore_dft_arg = {-1, -1, -1};
 
 static int test_diff_sec, test_diff_usec;
 
+/* throughput policy, see tput_sample_work() */
+#define TPUT_LEVELS 3
+static bool tput_policy = true;
+static unsigned int tput_sample_ms = 100;
+static unsigned int tput_hyst_pct = 70;
+static unsigned int tput_bw_kbps[TPUT_LEVELS] = {4096, 16384, 65536};
+static unsigned int tput_irq_rate[TPUT_LEVELS] = {2000, 8000, 16000};
+static int tput_level;
+static unsigned int tput_held;
+/* serializes tput_apply() with the release at the end of boost_work() */
+static DEFINE_MUTEX(tput_lock);
+static bool tput_fed;
+
 struct control_ops {
 	int (*act[_ACT_MAXID]) (struct act_arg_obj *arg);
 };
@@ -201,6 +218,10 @@ static void __usb_boost(void)
 {
 	int id;
 
+	/* a controller reports throughput, leave it to the sampler */
+	if (tput_policy && tput_fed)
+		return;
+
 	USB_BOOST_DBG("\n");
 	for (id = 0; id < _TYPE_MAXID; id++)
 		usb_boost_by_id(id);
@@ -317,13 +338,161 @@ static void boost_work(struct work_struct *work_struct)
 	}
 
 	/* dump_info(id); */
-	__boost_act(id, ACT_RELEASE);
+	/* the throughput policy may have taken it over meanwhile */
+	mutex_lock(&tput_lock);
+	if (!(tput_held & BIT(id)))
+		__boost_act(id, ACT_RELEASE);
 	boost_inst[id].request_func = __request_it;
 	ptr_inst->is_running = false;
+	mutex_unlock(&tput_lock);
 	USB_BOOST_NOTICE("id:%d, end of work\n", id);
 	/* dump_info(id); */
 }
 
+/*
+ * Throughput policy
+ *
+ * mtu3 and xhci-mtk report completed bytes per endpoint and count their
+ * IRQs. Every tput_sample_ms the busiest endpoint's rate and the IRQ
+ * rate each map to a level through tput_bw_kbps[] and tput_irq_rate[],
+ * the higher one wins. A level is entered once its threshold is crossed
+ * and kept until the rate falls under tput_hyst_pct of it, then the
+ * level the rate still qualifies for is taken, so when traffic stops
+ * everything is released at the next sample. Sampling stops at level 0
+ * and restarts on the next report.
+ */
+static const unsigned int tput_level_types[TPUT_LEVELS + 1] = {
+	0,
+	BIT(TYPE_CPU_FREQ),
+	BIT(TYPE_CPU_FREQ) | BIT(TYPE_CPU_CORE),
+	BIT(TYPE_CPU_FREQ) | BIT(TYPE_CPU_CORE) | BIT(TYPE_DRAM_VCORE),
+};
+static atomic_t tput_bytes[2][USB_BOOST_EP_NUM];
+static atomic_t tput_irqs;
+static atomic_t tput_sampling;
+static unsigned long tput_last;
+static struct delayed_work tput_work;
+
+static void tput_kick(void)
+{
+	if (atomic_read(&tput_sampling) || atomic_xchg(&tput_sampling, 1))
+		return;
+
+	tput_last = jiffies;
+	queue_delayed_work(system_unbound_wq, &tput_work,
+		msecs_to_jiffies(tput_sample_ms));
+}
+
+void usb_boost_ep_bytes(int epnum, int is_in, unsigned int bytes)
+{
+	if (!inited || !tput_policy)
+		return;
+
+	tput_fed = true;
+	atomic_add(bytes, &tput_bytes[!!is_in][epnum % USB_BOOST_EP_NUM]);
+	tput_kick();
+}
+EXPORT_SYMBOL_GPL(usb_boost_ep_bytes);
+
+void usb_boost_irq(void)
+{
+	if (!inited || !tput_policy)
+		return;
+
+	atomic_inc(&tput_irqs);
+	tput_kick();
+}
+EXPORT_SYMBOL_GPL(usb_boost_irq);
+
+static bool tput_above(unsigned int kbps, unsigned int irq_rate, int level,
+	unsigned int pct)
+{
+	return (u64)kbps * 100 >= (u64)tput_bw_kbps[level - 1] * pct ||
+		(u64)irq_rate * 100 >= (u64)tput_irq_rate[level - 1] * pct;
+}
+
+static int tput_next_level(unsigned int kbps, unsigned int irq_rate)
+{
+	int level;
+
+	for (level = TPUT_LEVELS; level > 0; level--)
+		if (tput_above(kbps, irq_rate, level, 100))
+			break;
+
+	if (level < tput_level &&
+	    tput_above(kbps, irq_rate, tput_level, tput_hyst_pct))
+		level = tput_level;
+
+	return level;
+}
+
+static void tput_apply(int level)
+{
+	unsigned int want = tput_level_types[level];
+	int id;
+
+	for (id = 0; id < _TYPE_MAXID; id++) {
+		struct mtk_usb_boost *ptr_inst = &boost_inst[id];
+
+		if (!ptr_inst->para[ATTR_ENABLE])
+			want &= ~BIT(id);
+
+		if (want & ~tput_held & BIT(id)) {
+			ptr_inst->work_cnt++;
+			ptr_inst->is_running = true;
+			__boost_act(id, ACT_HOLD);
+		} else if (tput_held & ~want & BIT(id)) {
+			/* a running boost_work() releases it when done */
+			if (ptr_inst->request_func == __request_it) {
+				__boost_act(id, ACT_RELEASE);
+				ptr_inst->is_running = false;
+			}
+		} else if (want & BIT(id) && ptr_inst->para[ATTR_RAW]) {
+			__boost_act(id, ACT_HOLD);
+		}
+	}
+
+	if (level != tput_level)
+		USB_BOOST_DBG("level %d -> %d\n", tput_level, level);
+	tput_held = want;
+	tput_level = level;
+}
+
+static void tput_sample_work(struct work_struct *work)
+{
+	unsigned long now = jiffies;
+	unsigned int ms = jiffies_to_msecs(now - tput_last) ? : 1;
+	unsigned int bytes, max_bytes = 0, irqs;
+	unsigned int kbps, irq_rate;
+	int dir, ep, level = 0;
+
+	tput_last = now;
+	for (dir = 0; dir < 2; dir++) {
+		for (ep = 0; ep < USB_BOOST_EP_NUM; ep++) {
+			bytes = atomic_xchg(&tput_bytes[dir][ep], 0);
+			max_bytes = max(max_bytes, bytes);
+		}
+	}
+	irqs = atomic_xchg(&tput_irqs, 0);
+
+	kbps = div_u64((u64)max_bytes * MSEC_PER_SEC, ms * 1024);
+	irq_rate = div_u64((u64)irqs * MSEC_PER_SEC, ms);
+
+	if (tput_policy)
+		level = tput_next_level(kbps, irq_rate);
+	mutex_lock(&tput_lock);
+	tput_apply(level);
+	mutex_unlock(&tput_lock);
+
+	if (!level) {
+		atomic_set(&tput_sampling, 0);
+		return;
+	}
+
+	queue_delayed_work(system_unbound_wq, &tput_work,
+		msecs_to_jiffies(tput_sample_ms));
+}
+
 static void default_setting(void)
 {
 	usb_boost_set_para_and_arg(TYPE_CPU_FREQ, cpu_freq_dft_para,
@@ -591,6 +760,8 @@ int usb_boost_init(void)
 			id, boost_inst[id].wq, &(boost_inst[id].work));
 		boost_inst[id].request_func = __request_it;
 	}
+	INIT_DELAYED_WORK(&tput_work, tput_sample_work);
+
 	/* hook workable interface */
 	__the_boost_ops.boost = __usb_boost;
 	enabled = 1;
@@ -603,4 +774,10 @@ int usb_boost_init(void)
 }
 module_param(trigger_cnt_disabled, int, 0600);
 module_param(enabled, int, 0600);
-module_param(inited, int, 0600);
+module_param(inited, int, 0400);
+module_param(tput_policy, bool, 0600);
+module_param(tput_sample_ms, uint, 0600);
+module_param(tput_hyst_pct, uint, 0600);
+module_param_array(tput_bw_kbps, uint, NULL, 0600);
+module_param_array(tput_irq_rate, uint, NULL, 0600);
+module_param(tput_level, int, 0400);
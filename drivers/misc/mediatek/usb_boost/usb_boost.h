@@ -42,6 +42,11 @@ int usb_boost_init(void);
 void register_usb_boost_act(int type_id, int action_id,
 	int (*func)(struct act_arg_obj *arg));
 
+/* throughput feed from the UDC and host controller drivers */
+#define USB_BOOST_EP_NUM 16
+void usb_boost_ep_bytes(int epnum, int is_in, unsigned int bytes);
+void usb_boost_irq(void);
+
 /* #define USB_BOOST_DBG_ENABLE */
 #define USB_BOOST_NOTICE(fmt, args...) \
 	pr_notice("USB_BOOST, <%s(), %d> " fmt, __func__, __LINE__, ## args)
@@ -31,6 +31,8 @@
 
 #include <linux/aio.h>
 #include <linux/mmu_context.h>
+#include <linux/mm.h>
+#include <linux/kref.h>
 #include <linux/poll.h>
 #include <linux/eventfd.h>
 
@@ -206,6 +208,18 @@ struct ffs_buffer {
 	char storage[];
 };
 
+/*
+ * Buffer registered by mmap(2) on an endpoint file.  I/O whose user buffer
+ * lies inside such a mapping is queued straight on it, without the bounce
+ * buffer and the copy to or from user space.  One reference is held by
+ * every vma and every request in flight.
+ */
+struct ffs_epfile_mem {
+	struct kref ref;
+	void *mem;
+	size_t size;
+};
+
 /*  ffs_io_data structure ***************************************************/
 
 struct ffs_io_data {
@@ -222,6 +236,7 @@ struct ffs_io_data {
 
 	struct usb_ep *ep;
 	struct usb_request *req;
+	struct ffs_epfile_mem *mem;
 
 	struct ffs_data *ffs;
 };
@@ -762,6 +777,57 @@ static ssize_t ffs_copy_to_iter(void *data, int data_len, struct iov_iter *iter)
 	return ret;
 }
 
+static void ffs_epfile_mem_release(struct kref *ref)
+{
+	struct ffs_epfile_mem *m = container_of(ref, struct ffs_epfile_mem,
+						ref);
+
+	free_pages_exact(m->mem, m->size);
+	kfree(m);
+}
+
+static void ffs_epfile_mem_put(struct ffs_epfile_mem *m)
+{
+	kref_put(&m->ref, ffs_epfile_mem_release);
+}
+
+static const struct vm_operations_struct ffs_epfile_vm_ops;
+
+/*
+ * Look up the registered buffer backing the whole of io_data->data.  Only
+ * single segment iovecs are considered, and reads only when no rounding
+ * up to max packet size was needed so the host cannot overrun the user
+ * buffer.  On success *data points into the buffer and a reference is
+ * taken for the request.
+ */
+static struct ffs_epfile_mem *
+ffs_epfile_mem_get(struct ffs_io_data *io_data, size_t data_len, char **data)
+{
+	struct iov_iter *iter = &io_data->data;
+	struct ffs_epfile_mem *m = NULL;
+	struct vm_area_struct *vma;
+	unsigned long addr, off;
+
+	if (!iter_is_iovec(iter) || iter->nr_segs != 1 ||
+	    iov_iter_count(iter) != data_len || !data_len)
+		return NULL;
+
+	addr = (unsigned long)iter->iov->iov_base + iter->iov_offset;
+
+	down_read(&current->mm->mmap_sem);
+	vma = find_vma(current->mm, addr);
+	if (vma && vma->vm_ops == &ffs_epfile_vm_ops &&
+	    vma->vm_start <= addr && data_len <= vma->vm_end - addr) {
+		m = vma->vm_private_data;
+		off = addr - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT);
+		kref_get(&m->ref);
+		*data = m->mem + off;
+	}
+	up_read(&current->mm->mmap_sem);
+
+	return m;
+}
+
 static void ffs_user_copy_worker(struct work_struct *work)
 {
 	struct ffs_io_data *io_data = container_of(work, struct ffs_io_data,
@@ -770,7 +836,10 @@ static void ffs_user_copy_worker(struct work_struct *work)
 					 io_data->req->actual;
 	bool kiocb_has_eventfd = io_data->kiocb->ki_flags & IOCB_EVENTFD;
 
-	if (io_data->read && ret > 0) {
+	if (io_data->mem) {
+		/* data already is in the user mapping */
+		ffs_epfile_mem_put(io_data->mem);
+	} else if (io_data->read && ret > 0) {
 		use_mm(io_data->mm);
 		ret = ffs_copy_to_iter(io_data->buf, ret, &io_data->data);
 		unuse_mm(io_data->mm);
@@ -785,7 +854,8 @@ static void ffs_user_copy_worker(struct work_struct *work)
 
 	if (io_data->read)
 		kfree(io_data->to_free);
-	kfree(io_data->buf);
+	if (!io_data->mem)
+		kfree(io_data->buf);
 	kfree(io_data);
 }
 
@@ -887,6 +957,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 	struct ffs_epfile *epfile = file->private_data;
 	struct usb_request *req;
 	struct ffs_ep *ep;
+	struct ffs_epfile_mem *mem = NULL;
 	char *data = NULL;
 	ssize_t ret, data_len = -EINVAL;
 	int halt;
@@ -977,19 +1048,26 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 			data_len = usb_ep_align_maybe(gadget, ep->ep, data_len);
 		spin_unlock_irq(&epfile->ffs->eps_lock);
 
+		mem = ffs_epfile_mem_get(io_data, data_len, &data);
+		if (mem) {
+			if (!io_data->read)
+				iov_iter_advance(&io_data->data, data_len);
+		} else {
 #if defined(CONFIG_64BIT) && defined(CONFIG_MTK_LM_MODE)
-		data = kmalloc(data_len, GFP_KERNEL | GFP_DMA);
+			data = kmalloc(data_len, GFP_KERNEL | GFP_DMA);
 #else
-		data = kmalloc(data_len, GFP_KERNEL);
+			data = kmalloc(data_len, GFP_KERNEL);
 #endif
-		if (unlikely(!data)) {
-			ret = -ENOMEM;
-			goto error_mutex;
-		}
-		if (!io_data->read &&
-		    copy_from_iter(data, data_len, &io_data->data) != data_len) {
-			ret = -EFAULT;
-			goto error_mutex;
+			if (unlikely(!data)) {
+				ret = -ENOMEM;
+				goto error_mutex;
+			}
+			if (!io_data->read &&
+			    copy_from_iter(data, data_len,
+					   &io_data->data) != data_len) {
+				ret = -EFAULT;
+				goto error_mutex;
+			}
 		}
 	}
 
@@ -1075,7 +1153,9 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		if (epfile->ep == ep)
 			ret = ep->status;
 		spin_unlock_irq(&epfile->ffs->eps_lock);
-		if (io_data->read && ret > 0)
+		if (io_data->read && ret > 0 && mem)
+			iov_iter_advance(&io_data->data, ret);
+		else if (io_data->read && ret > 0)
 			ret = __ffs_epfile_read_data(epfile, data, ep->status,
 						     &io_data->data);
 		goto error_mutex;
@@ -1088,6 +1168,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		io_data->buf = data;
 		io_data->ep = ep->ep;
 		io_data->req = req;
+		io_data->mem = mem;
 		io_data->ffs = epfile->ffs;
 
 		req->context  = io_data;
@@ -1106,6 +1187,7 @@ static ssize_t ffs_epfile_io(struct file *file, struct ffs_io_data *io_data)
 		 * by ffs_user_copy_worker.
 		 */
 		data = NULL;
+		mem = NULL;
 	}
 
 error_lock:
@@ -1113,7 +1195,10 @@ error_lock:
 error_mutex:
 	mutex_unlock(&epfile->mutex);
 error:
-	kfree(data);
+	if (mem)
+		ffs_epfile_mem_put(mem);
+	else
+		kfree(data);
 	return ret;
 }
 
@@ -1263,6 +1348,69 @@ ffs_epfile_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static void ffs_epfile_vm_open(struct vm_area_struct *vma)
+{
+	struct ffs_epfile_mem *m = vma->vm_private_data;
+
+	kref_get(&m->ref);
+}
+
+static void ffs_epfile_vm_close(struct vm_area_struct *vma)
+{
+	ffs_epfile_mem_put(vma->vm_private_data);
+}
+
+static const struct vm_operations_struct ffs_epfile_vm_ops = {
+	.open =		ffs_epfile_vm_open,
+	.close =	ffs_epfile_vm_close,
+};
+
+/*
+ * Register an I/O buffer: the mapping is backed by physically contiguous
+ * kernel memory that requests are queued on directly.  It has to be a
+ * shared mapping at offset 0, and stays valid until the last munmap and
+ * the last request on it are gone.
+ */
+static int ffs_epfile_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	size_t size = vma->vm_end - vma->vm_start;
+	struct ffs_epfile_mem *m;
+	gfp_t gfp = GFP_USER | __GFP_NOWARN | __GFP_ZERO;
+
+	ENTER();
+
+	if (!(vma->vm_flags & VM_SHARED) || vma->vm_pgoff)
+		return -EINVAL;
+
+#if defined(CONFIG_64BIT) && defined(CONFIG_MTK_LM_MODE)
+	gfp |= GFP_DMA;
+#endif
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	m->mem = alloc_pages_exact(size, gfp);
+	if (!m->mem) {
+		kfree(m);
+		return -ENOMEM;
+	}
+	m->size = size;
+	kref_init(&m->ref);
+
+	if (remap_pfn_range(vma, vma->vm_start,
+			    virt_to_phys(m->mem) >> PAGE_SHIFT,
+			    size, vma->vm_page_prot) < 0) {
+		ffs_epfile_mem_put(m);
+		return -EAGAIN;
+	}
+
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP | VM_DONTCOPY;
+	vma->vm_ops = &ffs_epfile_vm_ops;
+	vma->vm_private_data = m;
+
+	return 0;
+}
+
 static long ffs_epfile_ioctl(struct file *file, unsigned code,
 			     unsigned long value)
 {
@@ -1331,6 +1479,7 @@ static const struct file_operations ffs_epfile_operations = {
 	.write_iter =	ffs_epfile_write_iter,
 	.read_iter =	ffs_epfile_read_iter,
 	.release =	ffs_epfile_release,
+	.mmap =		ffs_epfile_mmap,
 	.unlocked_ioctl =	ffs_epfile_ioctl,
 };
 
@@ -26,6 +26,9 @@
 #include <linux/err.h>
 #include <linux/interrupt.h>
 #include <linux/printk.h>
+#include <linux/pagemap.h>
+#include <linux/backing-dev.h>
+#include <linux/scatterlist.h>
 
 #include <linux/types.h>
 #include <linux/file.h>
@@ -46,6 +49,8 @@
 #endif
 
 #define MTP_BULK_BUFFER_SIZE       16384
+/* one mtu3 GPD (64K - 4), rounded down to whole max packets */
+#define MTP_RX_REQ_LEN_MAX         (63 * 1024)
 #define INTR_BUFFER_SIZE           28
 #define MAX_INST_NAME_LEN          40
 #define MTP_MAX_FILE_SIZE          0xFFFFFFFFL
@@ -60,9 +65,9 @@
 #define STATE_CANCELED              3   /* transaction canceled by host */
 #define STATE_ERROR                 4   /* error from completion routine */
 
-/* number of tx and rx requests to allocate */
-#define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+/* upper bounds of mtp_tx_req_num and mtp_rx_req_num */
+#define TX_REQ_MAX 16
+#define RX_REQ_MAX 16
 #define INTR_REQ_MAX 5
 
 /* ID for Microsoft MTP OS String */
@@ -211,6 +216,34 @@ static const char mtp_shortname[] = DRIVER_NAME "_usb";
 unsigned int mtp_rx_req_len = MTP_BULK_BUFFER_SIZE;
 unsigned int mtp_tx_req_len = MTP_BULK_BUFFER_SIZE;
 
+/*
+ * Bulk request pool, read at bind. Both directions fall back to
+ * MTP_BULK_BUFFER_SIZE if mtp_bulk_req_len can't be allocated. OUT
+ * requests are capped at MTP_RX_REQ_LEN_MAX, the UDC takes no more
+ * than one descriptor's worth per OUT request (mtu3: 64K - 4).
+ */
+static unsigned int mtp_tx_req_num = 8;
+static unsigned int mtp_rx_req_num = 4;
+static unsigned int mtp_bulk_req_len = MTP_BULK_BUFFER_SIZE * 3;
+module_param(mtp_tx_req_num, uint, 0644);
+module_param(mtp_rx_req_num, uint, 0644);
+module_param(mtp_bulk_req_len, uint, 0644);
+
+/*
+ * Send files straight out of the page cache when the UDC takes sg
+ * lists, instead of copying them into the request buffer.
+ */
+static bool mtp_tx_zero_copy = true;
+module_param(mtp_tx_zero_copy, bool, 0644);
+
+/* page cache pages lent to an IN request, see mtp_tx_map_file() */
+struct mtp_tx_pages {
+	unsigned int nr;
+	unsigned int max;
+	struct page **page;
+	struct scatterlist *sg;	/* max + 1, the first may be the header */
+};
+
 struct mtp_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -234,6 +267,7 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
+	int rx_req_num;
 	int rx_done;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
@@ -522,12 +556,54 @@ static struct usb_request *mtp_request_new(struct usb_ep *ep, int buffer_size)
 
 static void mtp_request_free(struct usb_request *req, struct usb_ep *ep)
 {
+	struct mtp_tx_pages *tp;
+
 	if (req) {
+		tp = req->context;
+		if (tp) {
+			kfree(tp->page);
+			kfree(tp->sg);
+			kfree(tp);
+		}
 		kfree(req->buf);
 		usb_ep_free_request(ep, req);
 	}
 }
 
+/* without it the request just falls back to copying */
+static void mtp_tx_pages_alloc(struct usb_request *req, unsigned int len)
+{
+	struct mtp_tx_pages *tp;
+	unsigned int max = DIV_ROUND_UP(len, PAGE_SIZE) + 1;
+
+	tp = kzalloc(sizeof(*tp), GFP_KERNEL);
+	if (!tp)
+		return;
+	tp->page = kcalloc(max, sizeof(*tp->page), GFP_KERNEL);
+	tp->sg = kcalloc(max + 1, sizeof(*tp->sg), GFP_KERNEL);
+	if (!tp->page || !tp->sg) {
+		kfree(tp->page);
+		kfree(tp->sg);
+		kfree(tp);
+		return;
+	}
+	tp->max = max;
+	req->context = tp;
+}
+
+static void mtp_tx_unmap_file(struct usb_request *req)
+{
+	struct mtp_tx_pages *tp = req->context;
+
+	if (!tp || !req->num_sgs)
+		return;
+
+	while (tp->nr)
+		put_page(tp->page[--tp->nr]);
+	req->sg = NULL;
+	req->num_sgs = 0;
+}
+
 static inline int mtp_lock(atomic_t *excl)
 {
 	if (atomic_inc_return(excl) == 1) {
@@ -581,26 +657,21 @@ static void mtp_complete_in(struct usb_ep *ep, struct usb_request *req)
 	if (req->status != 0)
 		dev->state = STATE_ERROR;
 
+	mtp_tx_unmap_file(req);
 	mtp_req_put(dev, &dev->tx_idle, req);
 
 	wake_up(&dev->write_wq);
 }
 
+/* OUT completions not consumed yet by receive_file_work */
 static atomic_t usb_rdone;
-static int64_t usb_rcnt;
-static int64_t vfs_wcnt;
-static bool rx_cont_abort;
-static bool mtp_rx_cont = true;
-module_param(mtp_rx_cont, bool, 0644);
 static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
 	dev->rx_done = 1;
-	if (req->status != 0) {
+	if (req->status != 0)
 		dev->state = STATE_ERROR;
-		rx_cont_abort = true;
-	}
 
 	wake_up(&dev->read_wq);
 	atomic_inc(&usb_rdone);
@@ -626,8 +697,13 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
 	struct usb_ep *ep;
-	const unsigned int mtp_req_len[2] = { (MTP_BULK_BUFFER_SIZE*3),
+	const unsigned int mtp_req_len[2] = {
+		max_t(unsigned int, mtp_bulk_req_len, MTP_BULK_BUFFER_SIZE),
 		MTP_BULK_BUFFER_SIZE};
+	const unsigned int mtp_rx_len[2] = {
+		min_t(unsigned int, mtp_req_len[0], MTP_RX_REQ_LEN_MAX),
+		MTP_BULK_BUFFER_SIZE};
+	int tx_req_num = clamp_t(unsigned int, mtp_tx_req_num, 1, TX_REQ_MAX);
 	int len_idx;
 	int i;
 
@@ -663,7 +739,7 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	len_idx = 0;
 retry_tx_alloc:
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
+	for (i = 0; i < tx_req_num; i++) {
 		req = mtp_request_new(dev->ep_in, mtp_req_len[len_idx]);
 		if (!req) {
 			if (len_idx >= (ARRAY_SIZE(mtp_req_len)-1))
@@ -680,24 +756,31 @@ retry_tx_alloc:
 	}
 	mtp_tx_req_len = mtp_req_len[len_idx];
 
+	if (cdev->gadget->sg_supported)
+		list_for_each_entry(req, &dev->tx_idle, list)
+			mtp_tx_pages_alloc(req, mtp_tx_req_len);
+
+	dev->rx_req_num = clamp_t(unsigned int, mtp_rx_req_num, 1, RX_REQ_MAX);
 	len_idx = 0;
 retry_rx_alloc:
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, mtp_req_len[len_idx]);
+	for (i = 0; i < dev->rx_req_num; i++) {
+		req = mtp_request_new(dev->ep_out, mtp_rx_len[len_idx]);
 		if (!req) {
-			if (len_idx >= (ARRAY_SIZE(mtp_req_len)-1))
+			if (len_idx >= (ARRAY_SIZE(mtp_rx_len)-1))
 				goto fail;
-			for (--i; i >= 0; i--)
+			for (--i; i >= 0; i--) {
 				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
 			len_idx++;
 			pr_info("allocate RX fail. try %d\n",
-				mtp_req_len[len_idx]);
+				mtp_rx_len[len_idx]);
 			goto retry_rx_alloc;
 		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
-	mtp_rx_req_len = mtp_req_len[len_idx];
+	mtp_rx_req_len = mtp_rx_len[len_idx];
 
 	for (i = 0; i < INTR_REQ_MAX; i++) {
 		req = mtp_request_new(dev->ep_intr, INTR_BUFFER_SIZE);
@@ -707,7 +790,8 @@ retry_rx_alloc:
 		mtp_req_put(dev, &dev->intr_idle, req);
 	}
 
-	pr_info("allocate RX=%d Tx=%d\n", mtp_rx_req_len, mtp_tx_req_len);
+	pr_info("allocate RX=%d*%d Tx=%d*%d\n", mtp_rx_req_len,
+		dev->rx_req_num, mtp_tx_req_len, tx_req_num);
 
 	return 0;
 
@@ -1004,6 +1088,70 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * Point req at up to len bytes of filp from *pos on, as page cache pages
+ * behind the header already in req->buf. The pages are held until the
+ * request completes. Returns the bytes of file data mapped.
+ */
+static int mtp_tx_map_file(struct file *filp, struct usb_request *req,
+		loff_t *pos, int len, int hdr_size, int64_t left)
+{
+	struct mtp_tx_pages *tp = req->context;
+	struct address_space *mapping = filp->f_mapping;
+	loff_t isize = i_size_read(mapping->host);
+	pgoff_t index = *pos >> PAGE_SHIFT;
+	unsigned int off = offset_in_page(*pos);
+	unsigned long ra_pages = DIV_ROUND_UP(left, PAGE_SIZE);
+	struct page *page;
+	int mapped = 0, seg, n = 0;
+
+	if (*pos >= isize)
+		len = 0;
+	else if (len > isize - *pos)
+		len = isize - *pos;
+
+	sg_init_table(tp->sg, tp->max + 1);
+	if (hdr_size)
+		sg_set_buf(&tp->sg[n++], req->buf, hdr_size);
+
+	while (mapped < len) {
+		page = find_get_page(mapping, index);
+		if (!page) {
+			page_cache_sync_readahead(mapping, &filp->f_ra, filp,
+					index, ra_pages);
+		} else {
+			if (PageReadahead(page))
+				page_cache_async_readahead(mapping, &filp->f_ra,
+						filp, page, index, ra_pages);
+			put_page(page);
+		}
+
+		page = read_mapping_page(mapping, index, filp);
+		if (IS_ERR(page)) {
+			req->num_sgs = n;
+			mtp_tx_unmap_file(req);
+			return PTR_ERR(page);
+		}
+
+		seg = min_t(int, PAGE_SIZE - off, len - mapped);
+		tp->page[tp->nr++] = page;
+		sg_set_page(&tp->sg[n++], page, seg, off);
+		mapped += seg;
+		off = 0;
+		index++;
+	}
+
+	if (n) {
+		sg_mark_end(&tp->sg[n - 1]);
+		req->sg = tp->sg;
+		req->num_sgs = n;
+	}
+	*pos += mapped;
+	file_accessed(filp);
+
+	return mapped;
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -1018,6 +1166,7 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	bool zero_copy;
 
 	/* read our parameters */
 	smp_rmb();
@@ -1032,6 +1181,17 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
 
+	/* read ahead as POSIX_FADV_SEQUENTIAL would */
+	spin_lock(&filp->f_lock);
+	filp->f_ra.ra_pages = inode_to_bdi(file_inode(filp))->ra_pages * 2;
+	spin_unlock(&filp->f_lock);
+
+	zero_copy = mtp_tx_zero_copy && !mtp_skip_vfs_read &&
+		cdev->gadget->sg_supported &&
+		S_ISREG(file_inode(filp)->i_mode) &&
+		!(filp->f_flags & O_DIRECT) &&
+		filp->f_mapping->a_ops->readpage;
+
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
 		count += hdr_size;
@@ -1092,7 +1252,11 @@ static void send_file_work(struct work_struct *data)
 		if (mtp_skip_vfs_read) {
 			ret = (xfer - hdr_size);
 			offset += ret;
-		} else
+		} else if (zero_copy && req->context)
+			ret = mtp_tx_map_file(filp, req, &offset,
+					xfer - hdr_size, hdr_size,
+					count - hdr_size);
+		else
 		ret = vfs_read(filp, req->buf + hdr_size, xfer - hdr_size,
 								&offset);
 		monitor_out(MTP_VFS_R);
@@ -1108,6 +1272,7 @@ static void send_file_work(struct work_struct *data)
 		ret = usb_ep_queue(dev->ep_in, req, GFP_KERNEL);
 		if (ret < 0) {
 			DBG(cdev, "send_file_work: xfer error %d\n", ret);
+			mtp_tx_unmap_file(req);
 			dev->state = STATE_ERROR;
 			r = -EIO;
 			break;
@@ -1128,20 +1293,28 @@ static void send_file_work(struct work_struct *data)
 	smp_wmb(); /* avoid context switch and race condiction */
 }
 
-/* read from USB and write to a local file */
+/*
+ * read from USB and write to a local file
+ *
+ * Up to rx_req_num reads stay queued while the oldest completed one is
+ * written out, so vfs_write overlaps the USB transfer instead of
+ * alternating with it. Without a length (0xFFFFFFFF, > 4G) the end is
+ * a short packet and only one read is queued at a time.
+ */
 static void receive_file_work(struct work_struct *data)
 {
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *req;
 	struct file *filp;
 	loff_t offset;
 	int64_t count;
-	int ret, cur_buf = 0;
+	int ret, head = 0, tail = 0, inflight = 0, depth;
 	int r = 0;
 	/* use this to avoid 4G copy issue */
 	int64_t total_size = 0;
+	bool until_short, got_short = false;
 
 	/* read our parameters */
 	smp_rmb();
@@ -1156,257 +1329,121 @@ static void receive_file_work(struct work_struct *data)
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
 
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
+	until_short = (count == 0xFFFFFFFF);
+	depth = until_short ? 1 : dev->rx_req_num;
+	atomic_set(&usb_rdone, 0);
 
-			read_req->length = (count > mtp_rx_req_len
+	while (count > 0 || inflight) {
+		/* keep the pipeline full */
+		while (count > 0 && inflight < depth) {
+			req = dev->rx_req[tail];
+			req->length = (count > mtp_rx_req_len
 					? mtp_rx_req_len : count);
 
 			if (total_size >= 0xFFFFFFFF)
-				read_req->short_not_ok = 0;
+				req->short_not_ok = 0;
 			else {
-				if (0 == (read_req->length %
+				if (0 == (req->length %
 						dev->ep_out->maxpacket))
-					read_req->short_not_ok = 1;
+					req->short_not_ok = 1;
 				else
-					read_req->short_not_ok = 0;
+					req->short_not_ok = 0;
 			}
 
-			dev->rx_done = 0;
-			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
+			ret = usb_ep_queue(dev->ep_out, req, GFP_KERNEL);
 			if (ret < 0) {
+				req->short_not_ok = 0;
 				r = -EIO;
 				dev->state = STATE_ERROR;
-				break;
-			}
-		}
-
-		if (write_req) {
-#ifdef CONFIG_MEDIATEK_SOLUTION
-			usb_boost();
-#endif
-			DBG(cdev, "rx %p %d\n", write_req, write_req->actual);
-			monitor_in(MTP_VFS_W);
-			if (mtp_skip_vfs_write) {
-				ret = write_req->actual;
-				offset += ret;
-			} else
-			ret = vfs_write(filp, write_req->buf, write_req->actual,
-				&offset);
-			monitor_out(MTP_VFS_W);
-			DBG(cdev, "vfs_write %d\n", ret);
-			if (ret != write_req->actual) {
-				r = -EIO;
-				dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
-			write_req = NULL;
-		}
+			tail = (tail + 1) % dev->rx_req_num;
+			inflight++;
 
-		if (read_req) {
-			/* wait for our last read to complete */
-			monitor_in(MTP_WAIT_EVENT);
-			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
-			monitor_out(MTP_WAIT_EVENT);
-			if (dev->state == STATE_CANCELED) {
-				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
-				break;
-			}
-			if (read_req->status) {
-				r = read_req->status;
-				break;
-			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
+			/* if xfer_file_length is 0xFFFFFFFF, then we read
+			 * until we get a zero length packet
 			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
-
-			total_size += read_req->actual;
-
-			if (read_req->actual < read_req->length) {
-				/*
-				 * short packet is used to signal EOF for
-				 * sizes > 4 gig
-				 */
-				DBG(cdev, "got short packet\n");
-				count = 0;
-			}
-
-			/* Add for RX mode 1 */
-			read_req->short_not_ok = 0;
-
-			write_req = read_req;
-			read_req = NULL;
+			if (!until_short)
+				count -= req->length;
+			else
+				break;
 		}
-	}
-
-	if (dev->state == STATE_ERROR || dev->state == STATE_OFFLINE) {
-		DBG(dev->cdev, "%s, line %d: read_req = %p\n", __func__,
-			 __LINE__, read_req);
-		if (read_req)
-			read_req->short_not_ok = 0;
-	}
-
-	DBG(cdev, "receive_file_work returning %d\n", r);
-	/* write the result */
-	dev->xfer_result = r;
-	smp_wmb(); /* avoid context switch and race condiction */
-}
 
-/* #define MTP_RX_DBG_ON */
-#ifdef MTP_RX_DBG_ON
-#define MTP_RX_DBG(fmt, args...) \
-pr_notice("MTP_RX_DBG, <%s(), %d> " fmt, __func__, __LINE__, ## args)
-#else
-#define MTP_RX_DBG(fmt, args...) do {} while (0)
-#endif
-static void vfs_write_work(struct work_struct *data)
-{
-	struct mtp_dev *dev = _mtp_dev;
-	struct usb_request *write_req;
-	struct file *filp = dev->xfer_file;
-	loff_t offset = dev->xfer_file_offset;
-	int64_t req_cnt = dev->xfer_file_length;
-	int index = 0;
-
-	MTP_RX_DBG("write_cnt<%lld>, read_cnt<%lld>, req_cnt<%lld>\n",
-			vfs_wcnt, usb_rcnt, req_cnt);
-
-	while (!rx_cont_abort && (vfs_wcnt != req_cnt)) {
-		if (dev->state != STATE_BUSY) {
-			rx_cont_abort = true;
-			MTP_RX_DBG("state<%d>\n", dev->state);
-			break;
+		/* wait for the oldest read to complete */
+		req = dev->rx_req[head];
+		monitor_in(MTP_WAIT_EVENT);
+		ret = wait_event_interruptible(dev->read_wq,
+			atomic_read(&usb_rdone) > 0 ||
+			dev->state != STATE_BUSY);
+		monitor_out(MTP_WAIT_EVENT);
+		if (dev->state == STATE_CANCELED) {
+			r = -ECANCELED;
+			goto out;
 		}
-		if (atomic_read(&usb_rdone) > 0) {
-			int rc;
-
-			write_req = dev->rx_req[index];
-			index = (index + 1) % RX_REQ_MAX;
-			atomic_dec(&usb_rdone);
-			MTP_RX_DBG("write_req<%p>, len<%d>, usb_rdone<%d>\n",
-					write_req, write_req->actual,
-					atomic_read(&usb_rdone));
-
-			usb_boost();
-			monitor_in(MTP_VFS_W);
-			if (mtp_skip_vfs_write) {
-				rc = write_req->actual;
-				offset += rc;
-			} else
-				rc = vfs_write(filp, write_req->buf,
-					write_req->actual, &offset);
-			monitor_out(MTP_VFS_W);
-
-			if (rc != write_req->actual)
-				MTP_RX_DBG("rc<%d> != actual<%d>\n",
-					rc, write_req->actual);
-			vfs_wcnt += write_req->actual;
-			MTP_RX_DBG("vfs_wcnt%lld,usb_rcnt%lld,req_cnt%lld\n",
-					vfs_wcnt, usb_rcnt,
-					req_cnt);
-
-
-			/* check next round existence */
-			if (usb_rcnt != req_cnt) {
-				int64_t count = (req_cnt - usb_rcnt);
-				struct usb_request *read_req = write_req;
-
-				read_req->length = (count > mtp_rx_req_len
-						? mtp_rx_req_len : count);
-				MTP_RX_DBG("read_req<%p>, len<%d>\n",
-					read_req, read_req->length);
-				rc = usb_ep_queue(dev->ep_out, read_req,
-					GFP_KERNEL);
-				if (unlikely(rc)) {
-					rx_cont_abort = true;
-					MTP_RX_DBG("rc<%d>\n", rc);
-					break;
-				}
-				usb_rcnt += read_req->length;
-				MTP_RX_DBG("v_wcnt%lld,u_rcnt%lld,req%lld\n",
-						vfs_wcnt, usb_rcnt,
-						req_cnt);
-			}
+		if (atomic_read(&usb_rdone) <= 0) {
+			r = ret < 0 ? ret : -EIO;
+			goto out;
 		}
-	};
-	MTP_RX_DBG("write_cnt<%lld>, read_cnt<%lld>, req_cnt<%lld>\n",
-			vfs_wcnt, usb_rcnt, req_cnt);
-}
-void trigger_rx_cont(void)
-{
-	int i;
-	struct usb_request *read_req;
-	struct mtp_dev *dev = _mtp_dev;
-	int64_t count = dev->xfer_file_length;
-	static struct work_struct work;
-	static int work_inited;
+		atomic_dec(&usb_rdone);
+		head = (head + 1) % dev->rx_req_num;
+		inflight--;
 
-	if (count <= 0) {
-		MTP_RX_DBG("count<%d> invalid\n", (int)count);
-		return;
-	}
-
-	/* reset condition */
-	atomic_set(&usb_rdone, 0);
-	usb_rcnt = vfs_wcnt = 0;
-	rx_cont_abort = false;
+		/* Add for RX mode 1 */
+		req->short_not_ok = 0;
 
-	mb(); /* make all related status reset and sync */
+		if (req->status) {
+			r = req->status;
+			goto out;
+		}
 
-	MTP_RX_DBG("count<%d>\n", (int)count);
+		total_size += req->actual;
 
-	/* USB related */
-	for (i = 0; i < RX_REQ_MAX; i++) {
-		int rc;
+		if (req->actual < req->length) {
+			/*
+			 * short packet is used to signal EOF for
+			 * sizes > 4 gig
+			 */
+			DBG(cdev, "got short packet\n");
+			count = 0;
+			got_short = true;
+		}
 
-		read_req = dev->rx_req[i];
-		read_req->length = (count > mtp_rx_req_len
-				? mtp_rx_req_len : count);
-		MTP_RX_DBG("i<%d>, read_req<%p>, len<%d>\n",
-			i, read_req, read_req->length);
-		rc = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
-		if (unlikely(rc)) {
-			rx_cont_abort = true;
-			MTP_RX_DBG("rc<%d>\n", rc);
-			break;
+#ifdef CONFIG_MEDIATEK_SOLUTION
+		usb_boost();
+#endif
+		DBG(cdev, "rx %p %d\n", req, req->actual);
+		monitor_in(MTP_VFS_W);
+		if (mtp_skip_vfs_write) {
+			ret = req->actual;
+			offset += ret;
+		} else
+		ret = vfs_write(filp, req->buf, req->actual, &offset);
+		monitor_out(MTP_VFS_W);
+		DBG(cdev, "vfs_write %d\n", ret);
+		if (ret != req->actual) {
+			r = -EIO;
+			dev->state = STATE_ERROR;
+			goto out;
 		}
 
-		usb_rcnt += read_req->length;
-		count -= read_req->length;
-		MTP_RX_DBG("count<%lld>, usb_rcnt<%lld>\n",
-			count, usb_rcnt);
-		if (!count)
+		/* the host is done, nothing more will land in the rest */
+		if (got_short)
 			break;
 	}
 
-	/* VFS related */
-	if (!work_inited) {
-		INIT_WORK(&work, vfs_write_work);
-		work_inited = 1;
+out:
+	/* take back whatever is still queued */
+	while (inflight--) {
+		req = dev->rx_req[head];
+		usb_ep_dequeue(dev->ep_out, req);
+		req->short_not_ok = 0;
+		head = (head + 1) % dev->rx_req_num;
 	}
-	queue_work(dev->wq, &work);
-	flush_workqueue(dev->wq);
 
-	/* check status */
-	if (unlikely(rx_cont_abort)) {
-		if (dev->state == STATE_CANCELED) {
-			dev->xfer_result = -ECANCELED;
-			/* recycle request */
-			for (i = 0; i < RX_REQ_MAX; i++)
-				usb_ep_dequeue(dev->ep_out,  dev->rx_req[i]);
-		} else
-			dev->xfer_result = -EIO;
-	} else
-		dev->xfer_result = 0;
-	MTP_RX_DBG("xfer_result<%d>\n", dev->xfer_result);
+	DBG(cdev, "receive_file_work returning %d\n", r);
+	/* write the result */
+	dev->xfer_result = r;
+	smp_wmb(); /* avoid context switch and race condiction */
 }
 
 static int mtp_send_event(struct mtp_dev *dev, struct mtp_event *event)
@@ -1536,26 +1573,9 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 		 * vfs_write to use our buffers in the kernel address space.
 		 */
 		monitor_in(MTP_IOCTL_WORK);
-		if (code != MTP_RECEIVE_FILE) {
-			queue_work(dev->wq, work);
-			/* wait for operation to complete */
-			flush_workqueue(dev->wq);
-		} else {
-			bool rx_cont = mtp_rx_cont;
-
-			/* deal with (512K + 1) ~ (0xFFFFFFFE) */
-			if (rx_cont && (dev->xfer_file_length <= 524288
-				|| dev->xfer_file_length == 0xFFFFFFFF))
-				rx_cont = false;
-
-			if (rx_cont)
-				trigger_rx_cont();
-			else {
-				queue_work(dev->wq, work);
-				/* wait for operation to complete */
-				flush_workqueue(dev->wq);
-			}
-		}
+		queue_work(dev->wq, work);
+		/* wait for operation to complete */
+		flush_workqueue(dev->wq);
 		monitor_out(MTP_IOCTL_WORK);
 		fput(filp);
 
@@ -2004,8 +2024,10 @@ mtp_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	mtp_string_defs[INTERFACE_STRING_INDEX].id = 0;
 	while ((req = mtp_req_get(dev, &dev->tx_idle)))
 		mtp_request_free(req, dev->ep_in);
-	for (i = 0; i < RX_REQ_MAX; i++)
+	for (i = 0; i < RX_REQ_MAX; i++) {
 		mtp_request_free(dev->rx_req[i], dev->ep_out);
+		dev->rx_req[i] = NULL;
+	}
 	while ((req = mtp_req_get(dev, &dev->intr_idle)))
 		mtp_request_free(req, dev->ep_intr);
 	dev->state = STATE_OFFLINE;
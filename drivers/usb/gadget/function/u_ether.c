@@ -61,9 +61,6 @@
  * blocks and still have efficient handling. */
 #define GETHER_MAX_ETH_FRAME_LEN 15412
 
-static struct workqueue_struct	*uether_wq;
-static struct workqueue_struct	*uether_wq1;
-
 /*-------------------------------------------------------------------------*/
 
 #define RX_EXTRA	20	/* bytes guarding against rx overflows */
@@ -78,6 +75,14 @@ MODULE_PARM_DESC(tx_wakeup_threshold, "tx wakeup threshold value");
 static unsigned int u_ether_rx_pending_thld = U_ETHER_RX_PENDING_TSHOLD;
 module_param(u_ether_rx_pending_thld, uint, 0644);
 
+/* RX requests per TX request, the host sends in bursts */
+static unsigned int u_ether_rx_qmult = 2;
+module_param(u_ether_rx_qmult, uint, 0644);
+
+/* latency bound (us) of a partly filled aggregated TX request, 0: none */
+static unsigned int u_ether_tx_aggr_us = 200;
+module_param(u_ether_tx_aggr_us, uint, 0644);
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget, unsigned qmult)
 {
@@ -88,6 +93,11 @@ static inline int qlen(struct usb_gadget *gadget, unsigned qmult)
 		return DEFAULT_QLEN;
 }
 
+static inline int rx_qlen(struct usb_gadget *gadget, unsigned qmult)
+{
+	return qlen(gadget, qmult) * max(u_ether_rx_qmult, 1U);
+}
+
 /*-------------------------------------------------------------------------*/
 
 /* REVISIT there must be a better way than having two sets
@@ -351,11 +361,8 @@ clean:
 	}
 
 
-	if (queue) {
-		queue_work(uether_wq, &dev->rx_work);
-		queue_work(uether_wq1, &dev->rx_work1);
-	}
-
+	if (queue)
+		napi_schedule(&dev->rx_napi);
 }
 
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
@@ -419,14 +426,6 @@ static bool tx_out_of_order_audit;
 module_param(tx_out_of_order_audit, bool, 0644);
 static bool tx_out_of_order;
 module_param(tx_out_of_order, bool, 0400);
-/* TX OUT OF ORDER FIX */
-static bool sending_aggregation;
-static int sending_aggregation_cnt;
-module_param(sending_aggregation_cnt, int, 0400);
-static long max_diff_ns;
-module_param(max_diff_ns, long, 0400);
-static long total_diff_ns;
-module_param(total_diff_ns, long, 0400);
 static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 {
 	int	status;
@@ -440,11 +439,12 @@ static int alloc_requests(struct eth_dev *dev, struct gether *link, unsigned n)
 }
 	tx_out_of_order = false;
 	chksum_windex = chksum_wvalue = chksum_rindex = chksum_rvalue = 0;
-	sending_aggregation_cnt = max_diff_ns = total_diff_ns = 0;
+	dev->tx_req_num = n;
 	spin_unlock(&dev->req_lock);
 
 	spin_lock(&dev->reqrx_lock);
-	status = prealloc(&dev->rx_reqs, link->out_ep, n);
+	status = prealloc(&dev->rx_reqs, link->out_ep,
+			n * max(u_ether_rx_qmult, 1U));
 	if (status < 0) {
 		spin_unlock(&dev->reqrx_lock);
 		U_ETHER_DBG("can't alloc rx requests\n");
@@ -480,7 +480,7 @@ void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 	spin_lock_irqsave(&dev->reqrx_lock, flags);
 	while (!list_empty(&dev->rx_reqs)) {
 		/* break the nexus of continuous completion and re-submission*/
-		if (++req_cnt > qlen(dev->gadget, dev->qmult))
+		if (++req_cnt > rx_qlen(dev->gadget, dev->qmult))
 			break;
 
 		req = container_of(dev->rx_reqs.next,
@@ -501,19 +501,19 @@ void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 	spin_unlock_irqrestore(&dev->reqrx_lock, flags);
 }
 
-static void process_rx_w(struct work_struct *work)
+/*
+ * NAPI poll: hand what rx_complete() queued to GRO, a budget at a time,
+ * then give the parked requests back to the UDC.
+ */
+static int eth_rx_poll(struct napi_struct *napi, int budget)
 {
-	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work);
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, rx_napi);
 	struct sk_buff	*skb;
-	int		status = 0;
-
-	if (!dev->port_usb)
-		return;
+	int		work_done = 0;
 
-	while ((skb = skb_dequeue(&dev->rx_frames))) {
-		if (status < 0
-				|| ETH_HLEN > skb->len
-				|| skb->len > ETH_FRAME_LEN) {
+	while (work_done < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work_done++;
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
 			dev->net->stats.rx_errors++;
 			dev->net->stats.rx_length_errors++;
 			rndis_test_rx_error++;
@@ -529,14 +529,20 @@ static void process_rx_w(struct work_struct *work)
 #endif
 
 		rndis_test_rx_net_out++;
-		status = netif_rx_ni(skb);
+		napi_gro_receive(napi, skb);
 	}
 
-    /* move to another workthread */
-#if 0
-	if (netif_running(dev->net))
-		rx_fill(dev, GFP_KERNEL);
-#endif
+	if (dev->port_usb && netif_running(dev->net))
+		rx_fill(dev, GFP_ATOMIC);
+
+	if (work_done < budget) {
+		napi_complete_done(napi, work_done);
+		/* rx_complete() may have queued more before we completed */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+
+	return work_done;
 }
 
 static void eth_work(struct work_struct *work)
@@ -552,27 +558,119 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
-static void process_rx_w1(struct work_struct *work)
+/* zlp framing, IRQ throttling and queueing of one TX request */
+static int eth_tx_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, int length, bool last)
 {
-	struct eth_dev	*dev = container_of(work, struct eth_dev, rx_work1);
+	int retval;
 
-	if (!dev->port_usb)
-		return;
+	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
+	if (dev->port_usb->is_fixed &&
+	    length == dev->port_usb->fixed_in_len &&
+	    (length % in->maxpacket) == 0)
+		req->zero = 0;
+	else
+		req->zero = 1;
+
+	/* use zlp framing on tx for strict CDC-Ether conformance,
+	 * though any robust network rx path ignores extra padding.
+	 * and some hardware doesn't like to write zlps.
+	 */
+	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
+		req->zero = 0;
+		length++;
+	}
+
+	req->length = length;
 
-	if (netif_running(dev->net))
-		rx_fill(dev, GFP_KERNEL);
+	/* throttle high/super speed IRQ rate back slightly */
+	if (gadget_is_dualspeed(dev->gadget))
+		req->no_interrupt = (((dev->gadget->speed == USB_SPEED_HIGH ||
+					dev->gadget->speed == USB_SPEED_SUPER))
+					&& !last && !list_empty(&dev->tx_reqs))
+			? ((atomic_read(&dev->tx_qlen) % dev->qmult) != 0)
+			: 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	switch (retval) {
+	default:
+		U_ETHER_DBG("tx queue err %d\n", retval);
+		break;
+	case 0:
+		rndis_test_tx_usb_out++;
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+	}
+
+	return retval;
 }
 
+/*
+ * Packets to gather in one TX request, from the backlog. With no more
+ * than TX_REQ_THRESHOLD requests on the wire a packet goes out at once;
+ * past that the batch grows with the requests in flight, up to what the
+ * host takes per transfer. Called with req_lock held.
+ */
+static unsigned int eth_tx_aggr_limit(struct eth_dev *dev)
+{
+	unsigned int used = dev->no_tx_req_used;
+	unsigned int span, limit;
+
+	if (used <= TX_REQ_THRESHOLD || dev->tx_req_num <= TX_REQ_THRESHOLD)
+		return 1;
+
+	span = dev->tx_req_num - TX_REQ_THRESHOLD;
+	limit = DIV_ROUND_UP(dev->dl_max_pkts_per_xfer *
+			(used - TX_REQ_THRESHOLD), span);
+
+	return clamp(limit, 2U, dev->dl_max_pkts_per_xfer);
+}
+
+/*
+ * Send the partly filled request at the head of tx_reqs, if any. It is
+ * queued under req_lock, so eth_start_xmit() can't get a newer request
+ * out ahead of it.
+ */
+static void eth_tx_flush_held(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned long		flags;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!dev->port_usb || list_empty(&dev->tx_reqs))
+		goto out;
+
+	req = list_first_entry(&dev->tx_reqs, struct usb_request, list);
+	if (!req->length)
+		goto out;
+
+	list_del(&req->list);
+	dev->tx_skb_hold_count = 0;
+	dev->no_tx_req_used++;
+	if (eth_tx_queue(dev, dev->port_usb->in_ep, req, req->length, true)) {
+		dev->no_tx_req_used--;
+		dev->net->stats.tx_dropped++;
+		req->length = 0;
+		list_add_tail(&req->list, &dev->tx_reqs);
+	}
+out:
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+}
+
+static enum hrtimer_restart eth_tx_aggr_timeout(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev,
+						tx_aggr_timer);
+
+	eth_tx_flush_held(dev);
+
+	return HRTIMER_NORESTART;
+}
 
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
 	struct sk_buff	*skb;
 	struct eth_dev	*dev;
-	struct net_device *net;
-	struct usb_request *new_req;
-	struct usb_ep *in;
-	int length;
-	int retval;
 
 	if (!ep->driver_data) {
 		usb_ep_free_request(ep, req);
@@ -580,7 +678,6 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	}
 
 	dev = ep->driver_data;
-	net = dev->net;
 
 	if (!dev->port_usb) {
 		usb_ep_free_request(ep, req);
@@ -619,73 +716,10 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	if (dev->port_usb->multi_pkt_xfer && !req->context) {
 		dev->no_tx_req_used--;
 		req->length = 0;
-		in = dev->port_usb->in_ep;
-
-		new_req = container_of(dev->tx_reqs.next,
-				struct usb_request, list);
-		list_del(&new_req->list);
-		if (new_req->length > 0) {
-			/* TX OUT OF ORDER FIX */
-			dev->tx_skb_hold_count = 0;
-			dev->no_tx_req_used++;
-			sending_aggregation = true;
-		} else {
-			/*
-			 * Put the idle request at the back of the
-			 * queue. The xmit function will put the
-			 * unfinished request at the beginning of the
-			 * queue.
-			 */
-			list_add_tail(&new_req->list, &dev->tx_reqs);
-		}
 		spin_unlock(&dev->req_lock);
-		if (sending_aggregation) {
-			length = new_req->length;
-
-			/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-			if (dev->port_usb->is_fixed &&
-					length == dev->port_usb->fixed_in_len &&
-					(length % in->maxpacket) == 0)
-				new_req->zero = 0;
-			else
-				new_req->zero = 1;
 
-			/* use zlp framing on tx for strict CDC-Ether
-			 * conformance, though any robust network rx
-			 * path ignores extra padding. and some hardware
-			 * doesn't like to write zlps.
-			 */
-			if (new_req->zero && !dev->zlp &&
-					(length % in->maxpacket) == 0) {
-				new_req->zero = 0;
-				length++;
-			}
-
-			new_req->length = length;
-			retval = usb_ep_queue(in, new_req, GFP_ATOMIC);
-			sending_aggregation = false;
-			switch (retval) {
-				default:
-					DBG(dev, "tx queue err %d\n", retval);
-					new_req->length = 0;
-					spin_lock(&dev->req_lock);
-					/* TX OUT OF ORDER FIX */
-					dev->no_tx_req_used--;
-					list_add_tail(&new_req->list,
-							&dev->tx_reqs);
-					spin_unlock(&dev->req_lock);
-					break;
-				case 0:
-
-					/* TX OUT OF ORDER FIX */
-					/*
-					spin_lock(&dev->req_lock);
-					dev->no_tx_req_used++;
-					spin_unlock(&dev->req_lock);
-					*/
-					net->trans_start = jiffies;
-			}
-		}
+		/* send what gathered while this one was on the wire */
+		eth_tx_flush_held(dev);
 	} else {
 					skb = req->context;
 		/* Is aggregation already enabled and buffers allocated ? */
@@ -936,91 +970,42 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 
 		spin_lock_irqsave(&dev->req_lock, flags);
 		dev->tx_skb_hold_count++;
-		/* if (dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer) { */
-		if ((dev->tx_skb_hold_count < dev->dl_max_pkts_per_xfer)
-				&& (length < (max_size - dev->net->mtu))) {
-			if (dev->no_tx_req_used > TX_REQ_THRESHOLD) {
-				list_add(&req->list, &dev->tx_reqs);
-				spin_unlock_irqrestore(&dev->req_lock, flags);
-				goto success;
+		if (dev->tx_skb_hold_count < eth_tx_aggr_limit(dev) &&
+				length < (max_size - dev->net->mtu)) {
+			list_add(&req->list, &dev->tx_reqs);
+			if (dev->tx_skb_hold_count == 1 && u_ether_tx_aggr_us)
+				hrtimer_start(&dev->tx_aggr_timer,
+					ns_to_ktime(u_ether_tx_aggr_us *
+						NSEC_PER_USEC),
+					HRTIMER_MODE_REL);
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			goto success;
 		}
-	}
 
 		dev->no_tx_req_used++;
 		dev->tx_skb_hold_count = 0;
 
-		/* TX OUT OF ORDER FIX */
-		if (unlikely(sending_aggregation)) {
-			struct timeval tv_before, tv_after;
-			u64 diff_ns = 0;
-
-			do_gettimeofday(&tv_before);
-			sending_aggregation_cnt++;
-			while (sending_aggregation) {
-				do_gettimeofday(&tv_after);
-				diff_ns = timeval_to_ns(&tv_after)
-					- timeval_to_ns(&tv_before);
-				/* 3us for timeout */
-				if (diff_ns >= (3000))
-					break;
-			}
-			total_diff_ns += diff_ns;
-			if (max_diff_ns < diff_ns)
-				max_diff_ns = diff_ns;
+		/* under req_lock, see eth_tx_flush_held() */
+		retval = eth_tx_queue(dev, in, req, length, false);
+		if (retval) {
+			dev->no_tx_req_used--;
+			req->length = 0;
+			dev->net->stats.tx_dropped++;
+			if (list_empty(&dev->tx_reqs))
+				netif_start_queue(net);
+			list_add_tail(&req->list, &dev->tx_reqs);
 		}
 		spin_unlock_irqrestore(&dev->req_lock, flags);
+		goto success;
+	}
 
-	} else {
 	length = skb->len;
 	req->buf = skb->data;
 	req->context = skb;
-	}
-
-
-	/* NCM requires no zlp if transfer is dwNtbInMaxSize */
-	if (dev->port_usb->is_fixed &&
-	    length == dev->port_usb->fixed_in_len &&
-	    (length % in->maxpacket) == 0)
-		req->zero = 0;
-	else
-		req->zero = 1;
-
-	/* use zlp framing on tx for strict CDC-Ether conformance,
-	 * though any robust network rx path ignores extra padding.
-	 * and some hardware doesn't like to write zlps.
-	 */
-	if (req->zero && !dev->zlp && (length % in->maxpacket) == 0) {
-		req->zero = 0;
-		length++;
-	}
-
-	req->length = length;
-
-	/* throttle high/super speed IRQ rate back slightly */
-	if (gadget_is_dualspeed(dev->gadget))
-		req->no_interrupt = (((dev->gadget->speed == USB_SPEED_HIGH ||
-					dev->gadget->speed == USB_SPEED_SUPER))
-					&& !list_empty(&dev->tx_reqs))
-			? ((atomic_read(&dev->tx_qlen) % dev->qmult) != 0)
-			: 0;
-
-	retval = usb_ep_queue(in, req, GFP_ATOMIC);
-	switch (retval) {
-	default:
-		U_ETHER_DBG("tx queue err %d\n", retval);
-		break;
-	case 0:
-		rndis_test_tx_usb_out++;
-		net->trans_start = jiffies;
-		atomic_inc(&dev->tx_qlen);
-	}
 
+	retval = eth_tx_queue(dev, in, req, length, false);
 	if (retval) {
-		if (!multi_pkt_xfer)
 		dev_kfree_skb_any(skb);
-	else
-			req->length = 0;
-
 		dev->net->stats.tx_dropped++;
 
 		spin_lock_irqsave(&dev->req_lock, flags);
@@ -1053,6 +1038,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	U_ETHER_DBG("\n");
+	napi_enable(&dev->rx_napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -1073,6 +1059,7 @@ static int eth_stop(struct net_device *net)
 	U_ETHER_DBG("\n");
 	pr_info("%s, START !!!!\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->rx_napi);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -1210,15 +1197,16 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g,
 	spin_lock_init(&dev->req_lock);
 	spin_lock_init(&dev->reqrx_lock);
 	INIT_WORK(&dev->work, eth_work);
-	INIT_WORK(&dev->rx_work, process_rx_w);
-	INIT_WORK(&dev->rx_work1, process_rx_w1);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_aggr_timer.function = eth_tx_aggr_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
 	/* network device setup */
 	dev->net = net;
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	dev->qmult = qmult;
 	snprintf(net->name, sizeof(net->name), "%s%%d", netname);
 
@@ -1286,15 +1274,16 @@ struct net_device *gether_setup_name_default(const char *netname)
 	spin_lock_init(&dev->req_lock);
 	spin_lock_init(&dev->reqrx_lock);
 	INIT_WORK(&dev->work, eth_work);
-	INIT_WORK(&dev->rx_work, process_rx_w);
-	INIT_WORK(&dev->rx_work1, process_rx_w1);
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
+	hrtimer_init(&dev->tx_aggr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_aggr_timer.function = eth_tx_aggr_timeout;
 
 	skb_queue_head_init(&dev->rx_frames);
 
 	/* network device setup */
 	dev->net = net;
+	netif_napi_add(net, &dev->rx_napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 	dev->qmult = QMULT_DEFAULT;
 	snprintf(net->name, sizeof(net->name), "%s%%d", netname);
 
@@ -1617,6 +1606,7 @@ void gether_disconnect(struct gether *link)
 
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
+	hrtimer_cancel(&dev->tx_aggr_timer);
 
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
@@ -1673,29 +1663,6 @@ void gether_disconnect(struct gether *link)
 }
 EXPORT_SYMBOL_GPL(gether_disconnect);
 
-static int __init gether_init(void)
-{
-	uether_wq  = create_singlethread_workqueue("uether");
-	if (!uether_wq) {
-		pr_info("%s: Unable to create workqueue: uether\n", __func__);
-		return -ENOMEM;
-	}
-	uether_wq1  = create_singlethread_workqueue("uether_rx1");
-	if (!uether_wq1) {
-		destroy_workqueue(uether_wq);
-		pr_info("%s: Unable to create workqueue: uether\n", __func__);
-		return -ENOMEM;
-	}
-	return 0;
-}
-module_init(gether_init);
-
-static void __exit gether_exit(void)
-{
-	destroy_workqueue(uether_wq);
-	destroy_workqueue(uether_wq1);
-}
-module_exit(gether_exit);
 MODULE_AUTHOR("David Brownell");
 MODULE_DESCRIPTION("ethernet over USB driver");
 MODULE_LICENSE("GPL v2");
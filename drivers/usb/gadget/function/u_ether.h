@@ -19,6 +19,7 @@
 #include <linux/usb/composite.h>
 #include <linux/usb/cdc.h>
 #include <linux/netdevice.h>
+#include <linux/hrtimer.h>
 
 #define QMULT_DEFAULT 10
 
@@ -58,6 +59,11 @@ struct eth_dev {
 	int			no_tx_req_used;
 	int			tx_skb_hold_count;
 	u32			tx_req_bufsize;
+	unsigned int		tx_req_num;
+	/* flushes a partly filled aggregated request */
+	struct hrtimer		tx_aggr_timer;
+
+	struct napi_struct	rx_napi;
 
 	struct sk_buff_head	rx_frames;
 
@@ -75,8 +81,6 @@ struct eth_dev {
 						struct sk_buff_head *list);
 
 	struct work_struct	work;
-	struct work_struct	rx_work;
-	struct work_struct	rx_work1;
 	unsigned long		todo;
 #define	WORK_RX_MEMORY		0
 
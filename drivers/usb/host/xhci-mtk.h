@@ -162,4 +162,30 @@ static inline void xhci_mtk_drop_ep_quirk(struct usb_hcd *hcd,
 
 #endif
 
+#if IS_ENABLED(CONFIG_USB_XHCI_MTK) && defined(CONFIG_MEDIATEK_SOLUTION)
+#include "usb_boost.h"
+
+/* feed the usb_boost throughput policy */
+static inline void xhci_mtk_boost_irq(struct xhci_hcd *xhci)
+{
+	if (xhci->quirks & XHCI_MTK_HOST)
+		usb_boost_irq();
+}
+
+static inline void xhci_mtk_boost_urb(struct xhci_hcd *xhci, struct urb *urb)
+{
+	if (xhci->quirks & XHCI_MTK_HOST)
+		usb_boost_ep_bytes(usb_pipeendpoint(urb->pipe),
+			usb_pipein(urb->pipe), urb->actual_length);
+}
+#else
+static inline void xhci_mtk_boost_irq(struct xhci_hcd *xhci)
+{
+}
+
+static inline void xhci_mtk_boost_urb(struct xhci_hcd *xhci, struct urb *urb)
+{
+}
+#endif
+
 #endif		/* _XHCI_MTK_H_ */
@@ -2642,6 +2642,7 @@ cleanup:
 			 */
 			if (usb_pipetype(urb->pipe) == PIPE_ISOCHRONOUS)
 				status = 0;
+			xhci_mtk_boost_urb(xhci, urb);
 			usb_hcd_giveback_urb(bus_to_hcd(urb->dev->bus), urb, status);
 			spin_lock(&xhci->lock);
 		}
@@ -2755,6 +2756,7 @@ irqreturn_t xhci_irq(struct usb_hcd *hcd)
 		spin_unlock(&xhci->lock);
 		return IRQ_NONE;
 	}
+	xhci_mtk_boost_irq(xhci);
 	if (status & STS_FATAL) {
 		xhci_warn(xhci, "WARNING: Host System Error\n");
 		xhci_halt(xhci);
@@ -180,7 +180,7 @@ struct mtu3_fifo_info {
  *
  * @flag:
  *	bit0: Hardware Own (HWO)
- *	bit1: Buffer Descriptor Present (BDP), always 0, BD is not supported
+ *	bit1: Buffer Descriptor Present (BDP), @buffer points to a BD list
  *	bit2: Bypass (BPS), 1: HW skips this GPD if HWO = 1
  *	bit7: Interrupt On Completion (IOC)
  * @chksum: This is used to validate the contents of this GPD;
@@ -209,6 +209,32 @@ struct qmu_gpd {
 	__u8 ext_flag;
 } __packed;
 
+/**
+ * Buffer Descriptor (BD):
+ *	Hangs off a GPD with BDP set, the BDs of a GPD gather (TX) or
+ *	scatter (RX) its data as one transfer. Also 16 bytes.
+ *
+ * @flag:
+ *	bit0: End Of List (EOL), the last BD of the GPD
+ * @chksum: the same as GPD's, but there is no HWO bit to count in
+ * @data_buf_len (RX ONLY): the length of the assigned data buffer
+ * @next_bd: Physical address of the next BD
+ * @buffer: Physical address of the data buffer
+ * @buf_len:
+ *	(TX): the length of the assigned data buffer
+ *	(RX): the length of data received into it
+ */
+struct qmu_bd {
+	__u8 flag;
+	__u8 chksum;
+	__le16 data_buf_len;
+	__le32 next_bd;
+	__le32 buffer;
+	__le16 buf_len;
+	__u8 ext_len;
+	__u8 reserved;
+} __packed;
+
 /**
  * dma: physical base address of GPD segment
  * start: virtual base address of GPD segment
@@ -225,6 +251,18 @@ struct mtu3_gpd_ring {
 	struct qmu_gpd *dequeue;
 };
 
+/**
+ * BDs are used and retired in request order, so only the enqueue side
+ * and the number of free ones are tracked
+ */
+struct mtu3_bd_ring {
+	dma_addr_t dma;
+	struct qmu_bd *start;
+	struct qmu_bd *end;
+	struct qmu_bd *enqueue;
+	u32 num_free;
+};
+
 /**
  * @vbus: vbus 5V used by host mode
  * @edev: external connector used to detect vbus and iddig changes
@@ -330,6 +368,7 @@ struct mtu3_ep {
 
 	struct list_head req_list;
 	struct mtu3_gpd_ring gpd_ring;
+	struct mtu3_bd_ring bd_ring;
 	const struct usb_ss_ep_comp_descriptor *comp_desc;
 	const struct usb_endpoint_descriptor *desc;
 
@@ -343,7 +382,9 @@ struct mtu3_request {
 	struct list_head list;
 	struct mtu3_ep *mep;
 	struct mtu3 *mtu;
-	struct qmu_gpd *gpd;
+	struct qmu_gpd *gpd;	/* the next of its GPDs to complete */
+	struct qmu_gpd *gpd_last;
+	u32 num_bds;
 	int epnum;
 };
 
@@ -382,6 +423,7 @@ struct mtu3 {
 	int active_ep;
 
 	struct dma_pool	*qmu_gpd_pool;
+	struct dma_pool	*qmu_bd_pool;
 	enum mtu3_g_ep0_state ep0_state;
 	struct usb_gadget g;	/* the gadget */
 	struct usb_gadget_driver *gadget_driver;
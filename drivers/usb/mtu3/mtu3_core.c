@@ -26,6 +26,9 @@
 
 #include "mtu3.h"
 #include "mtu3_dr.h"
+#ifdef CONFIG_MEDIATEK_SOLUTION
+#include "usb_boost.h"
+#endif
 
 static int ep_fifo_alloc(struct mtu3_ep *mep, u32 seg_size)
 {
@@ -789,6 +792,11 @@ static irqreturn_t mtu3_irq(int irq, void *data)
 	level1 = mtu3_readl(mtu->mac_base, U3D_LV1ISR);
 	level1 &= mtu3_readl(mtu->mac_base, U3D_LV1IER);
 
+#ifdef CONFIG_MEDIATEK_SOLUTION
+	if (level1)
+		usb_boost_irq();
+#endif
+
 	if (level1 & EP_CTRL_INTR)
 		mtu3_link_isr(mtu);
 
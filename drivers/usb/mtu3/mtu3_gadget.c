@@ -271,7 +271,7 @@ static int mtu3_gadget_queue(struct usb_ep *ep,
 	if (!ep || !req)
 		return -EINVAL;
 
-	if (!req->buf)
+	if (!req->buf && !req->num_sgs)
 		return -ENODATA;
 
 	mep = to_mtu3_ep(ep);
@@ -286,13 +286,6 @@ static int mtu3_gadget_queue(struct usb_ep *ep,
 		__func__, mep->is_in ? "TX" : "RX", mreq->epnum, ep->name,
 		mreq, ep->maxpacket, mreq->request.length);
 
-	if (req->length > GPD_BUF_SIZE) {
-		dev_warn(mtu->dev,
-			"req length > supported MAX:%d requested:%d\n",
-			GPD_BUF_SIZE, req->length);
-		return -EOPNOTSUPP;
-	}
-
 	/* don't queue if the ep is down */
 	if (!mep->desc) {
 		dev_dbg(mtu->dev, "req=%p queued to %s while it's disabled\n",
@@ -311,10 +304,9 @@ static int mtu3_gadget_queue(struct usb_ep *ep,
 
 	spin_lock_irqsave(&mtu->lock, flags);
 
-	if (mtu3_prepare_transfer(mep)) {
-		ret = -EAGAIN;
+	ret = mtu3_prepare_transfer(mep, mreq);
+	if (ret)
 		goto error;
-	}
 
 	list_add_tail(&mreq->list, &mep->req_list);
 	mtu3_insert_gpd(mep, mreq);
@@ -323,6 +315,12 @@ static int mtu3_gadget_queue(struct usb_ep *ep,
 error:
 	spin_unlock_irqrestore(&mtu->lock, flags);
 
+	if (ret == -EOPNOTSUPP)
+		dev_warn(mtu->dev, "%s req too large: len %d, %d sgs\n",
+			ep->name, req->length, req->num_mapped_sgs);
+	if (ret)
+		usb_gadget_unmap_request(&mtu->g, req, mep->is_in);
+
 	return ret;
 }
 
@@ -683,7 +681,8 @@ int mtu3_gadget_setup(struct mtu3 *mtu)
 	mtu->g.ops = &mtu3_gadget_ops;
 	mtu->g.max_speed = mtu->max_speed;
 	mtu->g.speed = USB_SPEED_UNKNOWN;
-	mtu->g.sg_supported = 0;
+	/* BDs have no room for the high address bits */
+	mtu->g.sg_supported = !mtu->is_36bit;
 	mtu->g.name = MTU3_DRIVER_NAME;
 	mtu->is_active = 0;
 
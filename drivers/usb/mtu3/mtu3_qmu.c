@@ -22,15 +22,20 @@
  * By preparing General Purpose Descriptor (GPD) and Buffer Descriptor (BD),
  * SW links data buffers and triggers QMU to send / receive data to
  * host / from device at a time.
- * And now only GPD is supported.
+ * A scatter-gather request is described by BDs hung off its GPDs, and an
+ * IN request longer than one GPD can hold spans several GPDs.
  *
  * For more detailed information, please refer to QMU Programming Guide
  */
 
 #include <linux/dmapool.h>
 #include <linux/iopoll.h>
+#include <linux/scatterlist.h>
 
 #include "mtu3.h"
+#ifdef CONFIG_MEDIATEK_SOLUTION
+#include "usb_boost.h"
+#endif
 
 #define QMU_CHECKSUM_LEN	16
 
@@ -41,6 +46,16 @@
 
 #define GPD_EXT_FLAG_ZLP	BIT(5)
 
+#define BD_FLAGS_EOL	BIT(0)
+
+/* a segment of the request's dma buffer, or of its sg list */
+struct qmu_buf_walk {
+	struct scatterlist *sg;
+	u32 nents;	/* segments left, the current one included */
+	dma_addr_t dma;
+	u32 left;	/* bytes left in the current segment */
+};
+
 
 static struct qmu_gpd *gpd_dma_to_virt(struct mtu3_gpd_ring *ring,
 		dma_addr_t dma_addr)
@@ -77,6 +92,31 @@ static void gpd_ring_init(struct mtu3_gpd_ring *ring, struct qmu_gpd *gpd)
 	ring->end = gpd + MAX_GPD_NUM - 1;
 }
 
+static void bd_ring_init(struct mtu3_bd_ring *ring, struct qmu_bd *bd)
+{
+	ring->start = bd;
+	ring->enqueue = bd;
+	ring->end = bd + MAX_BD_NUM - 1;
+	ring->num_free = MAX_BD_NUM;
+}
+
+static dma_addr_t bd_virt_to_dma(struct mtu3_bd_ring *ring,
+		struct qmu_bd *bd)
+{
+	return ring->dma + (bd - ring->start) * sizeof(*bd);
+}
+
+static struct qmu_bd *bd_dma_to_virt(struct mtu3_bd_ring *ring,
+		dma_addr_t dma_addr)
+{
+	u32 offset = (dma_addr - ring->dma) / sizeof(*ring->start);
+
+	if (offset >= MAX_BD_NUM)
+		return NULL;
+
+	return ring->start + offset;
+}
+
 static void reset_gpd_list(struct mtu3_ep *mep)
 {
 	struct mtu3_gpd_ring *ring = &mep->gpd_ring;
@@ -86,12 +126,17 @@ static void reset_gpd_list(struct mtu3_ep *mep)
 		gpd->flag &= ~GPD_FLAGS_HWO;
 		gpd_ring_init(ring, gpd);
 	}
+
+	if (mep->bd_ring.start)
+		bd_ring_init(&mep->bd_ring, mep->bd_ring.start);
 }
 
 int mtu3_gpd_ring_alloc(struct mtu3_ep *mep)
 {
 	struct qmu_gpd *gpd;
+	struct qmu_bd *bd;
 	struct mtu3_gpd_ring *ring = &mep->gpd_ring;
+	struct mtu3_bd_ring *bd_ring = &mep->bd_ring;
 
 	/* software own all gpds as default */
 	gpd = dma_pool_zalloc(mep->mtu->qmu_gpd_pool, GFP_ATOMIC, &ring->dma);
@@ -100,16 +145,34 @@ int mtu3_gpd_ring_alloc(struct mtu3_ep *mep)
 
 	gpd_ring_init(ring, gpd);
 
+	if (!mep->mtu->g.sg_supported)
+		return 0;
+
+	bd = dma_pool_zalloc(mep->mtu->qmu_bd_pool, GFP_ATOMIC,
+			&bd_ring->dma);
+	if (bd == NULL) {
+		mtu3_gpd_ring_free(mep);
+		return -ENOMEM;
+	}
+
+	bd_ring_init(bd_ring, bd);
+
 	return 0;
 }
 
 void mtu3_gpd_ring_free(struct mtu3_ep *mep)
 {
 	struct mtu3_gpd_ring *ring = &mep->gpd_ring;
+	struct mtu3_bd_ring *bd_ring = &mep->bd_ring;
 
 	dma_pool_free(mep->mtu->qmu_gpd_pool,
 			ring->start, ring->dma);
 	memset(ring, 0, sizeof(*ring));
+
+	if (bd_ring->start)
+		dma_pool_free(mep->mtu->qmu_bd_pool,
+				bd_ring->start, bd_ring->dma);
+	memset(bd_ring, 0, sizeof(*bd_ring));
 }
 
 /*
@@ -133,6 +196,12 @@ static noinline u8 qmu_calc_checksum(u8 *data)
 	return 0xFF - chksum;
 }
 
+/* a BD has no HWO bit set after the checksum */
+static u8 qmu_calc_bd_checksum(struct qmu_bd *bd)
+{
+	return qmu_calc_checksum((u8 *)bd) + 1;
+}
+
 void mtu3_qmu_resume(struct mtu3_ep *mep)
 {
 	struct mtu3 *mtu = mep->mtu;
@@ -167,39 +236,187 @@ static struct qmu_gpd *advance_deq_gpd(struct mtu3_gpd_ring *ring)
 	return ring->dequeue;
 }
 
-/* check if a ring is emtpy */
-static int gpd_ring_empty(struct mtu3_gpd_ring *ring)
+/* number of gpds that can still be queued, one is always kept unused */
+static u32 gpd_ring_free(struct mtu3_gpd_ring *ring)
 {
-	struct qmu_gpd *enq = ring->enqueue;
-	struct qmu_gpd *next;
+	int used = ring->enqueue - ring->dequeue;
 
-	if (ring->enqueue < ring->end)
-		next = enq + 1;
-	else
-		next = ring->start;
+	if (used < 0)
+		used += MAX_GPD_NUM;
 
-	/* one gpd is reserved to simplify gpd preparation */
-	return next == ring->dequeue;
+	return MAX_GPD_NUM - 1 - used;
 }
 
-int mtu3_prepare_transfer(struct mtu3_ep *mep)
+/*
+ * An IN request is cut into GPDs on a maxp boundary, so only its last GPD
+ * can end with a short packet. A short packet ends an OUT GPD with the
+ * rest of the request still queued behind it, so OUT requests keep to a
+ * single GPD and only scatter through BDs.
+ */
+static u32 qmu_gpd_chunk(struct mtu3_ep *mep)
+{
+	if (!mep->is_in)
+		return GPD_BUF_SIZE;
+
+	return rounddown(GPD_BUF_SIZE, mep->maxp);
+}
+
+static void qmu_buf_walk_init(struct qmu_buf_walk *w, struct usb_request *req)
+{
+	if (req->num_mapped_sgs) {
+		w->sg = req->sg;
+		w->nents = req->num_mapped_sgs;
+		w->dma = sg_dma_address(w->sg);
+		w->left = sg_dma_len(w->sg);
+	} else {
+		w->sg = NULL;
+		w->nents = 1;
+		w->dma = req->dma;
+		w->left = req->length;
+	}
+}
+
+static void qmu_buf_walk_skip_empty(struct qmu_buf_walk *w)
+{
+	while (!w->left && w->nents > 1) {
+		w->sg = sg_next(w->sg);
+		w->nents--;
+		w->dma = sg_dma_address(w->sg);
+		w->left = sg_dma_len(w->sg);
+	}
+}
+
+static void qmu_buf_walk_advance(struct qmu_buf_walk *w, u32 len)
 {
-	return gpd_ring_empty(&mep->gpd_ring);
+	w->dma += len;
+	w->left -= len;
+	qmu_buf_walk_skip_empty(w);
 }
 
-static int mtu3_prepare_tx_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
+/*
+ * Describe the next @len bytes of the walk for one GPD: returns the
+ * number of BDs needed, 0 if it all lies in one segment, or -EINVAL if
+ * the sg list runs out first. With @gpd the BDs are also filled in and
+ * the GPD pointed at the data.
+ */
+static int qmu_fill_gpd_buf(struct mtu3_ep *mep, struct qmu_gpd *gpd,
+		struct qmu_buf_walk *w, u32 len)
+{
+	struct mtu3_bd_ring *ring = &mep->bd_ring;
+	struct qmu_bd *bd;
+	struct qmu_bd *next;
+	u32 num_bds = 0;
+	u32 piece;
+
+	qmu_buf_walk_skip_empty(w);
+
+	if (w->left >= len) {
+		if (gpd)
+			gpd->buffer = cpu_to_le32((u32)w->dma);
+		qmu_buf_walk_advance(w, len);
+		return 0;
+	}
+
+	if (gpd) {
+		gpd->buffer = cpu_to_le32((u32)bd_virt_to_dma(ring,
+				ring->enqueue));
+		gpd->flag |= GPD_FLAGS_BDP;
+	}
+
+	while (len) {
+		piece = min(w->left, len);
+		if (!piece)	/* sg list shorter than the request */
+			return -EINVAL;
+
+		len -= piece;
+		num_bds++;
+
+		if (gpd) {
+			bd = ring->enqueue;
+			next = (bd < ring->end) ? bd + 1 : ring->start;
+
+			memset(bd, 0, sizeof(*bd));
+			bd->buffer = cpu_to_le32((u32)w->dma);
+			if (mep->is_in)
+				bd->buf_len = cpu_to_le16(piece);
+			else
+				bd->data_buf_len = cpu_to_le16(piece);
+			bd->next_bd = cpu_to_le32((u32)bd_virt_to_dma(ring,
+					next));
+			if (!len)
+				bd->flag |= BD_FLAGS_EOL;
+			bd->chksum = qmu_calc_bd_checksum(bd);
+
+			ring->enqueue = next;
+		}
+
+		qmu_buf_walk_advance(w, piece);
+	}
+
+	if (gpd)
+		ring->num_free -= num_bds;
+
+	return num_bds;
+}
+
+/*
+ * Check the rings can take the whole request now: -EAGAIN if they
+ * have to drain first, -EOPNOTSUPP if it would never fit, -EINVAL if
+ * the sg list does not cover req->length.
+ */
+int mtu3_prepare_transfer(struct mtu3_ep *mep, struct mtu3_request *mreq)
+{
+	struct usb_request *req = &mreq->request;
+	u32 chunk = qmu_gpd_chunk(mep);
+	u32 left = req->length;
+	struct qmu_buf_walk w;
+	u32 num_gpds = 0;
+	u32 num_bds = 0;
+	u32 len;
+	int ret;
+
+	if (req->num_mapped_sgs && !mep->bd_ring.start)
+		return -EOPNOTSUPP;
+
+	qmu_buf_walk_init(&w, req);
+	do {
+		len = min(left, chunk);
+		ret = qmu_fill_gpd_buf(mep, NULL, &w, len);
+		if (ret < 0)
+			return ret;
+
+		num_bds += ret;
+		num_gpds++;
+		left -= len;
+	} while (left);
+
+	if ((!mep->is_in && num_gpds > 1) || num_gpds > MAX_GPD_NUM - 1 ||
+	    num_bds > MAX_BD_NUM)
+		return -EOPNOTSUPP;
+
+	if (num_gpds > gpd_ring_free(&mep->gpd_ring) ||
+	    num_bds > mep->bd_ring.num_free)
+		return -EAGAIN;
+
+	return 0;
+}
+
+static struct qmu_gpd *mtu3_prepare_tx_gpd(struct mtu3_ep *mep,
+		struct usb_request *req, struct qmu_buf_walk *w,
+		u32 len, bool last)
 {
 	struct qmu_gpd *enq;
 	struct mtu3_gpd_ring *ring = &mep->gpd_ring;
 	struct qmu_gpd *gpd = ring->enqueue;
-	struct usb_request *req = &mreq->request;
+	dma_addr_t buf;
 
 	/* set all fields to zero as default value */
 	memset(gpd, 0, sizeof(*gpd));
 
-	gpd->buffer = cpu_to_le32((u32)req->dma);
-	gpd->buf_len = cpu_to_le16(req->length);
-	gpd->flag |= GPD_FLAGS_IOC;
+	buf = w->dma;
+	gpd->buf_len = cpu_to_le16(len);
+	if (last && !req->no_interrupt)
+		gpd->flag |= GPD_FLAGS_IOC;
 
 	/* get the next GPD */
 	enq = advance_enq_gpd(ring);
@@ -208,42 +425,45 @@ static int mtu3_prepare_tx_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
 
 	enq->flag &= ~GPD_FLAGS_HWO;
 
+	qmu_fill_gpd_buf(mep, gpd, w, len);
+
 	if (mep->mtu->is_36bit) {
 		u32 hiaddr;
 		/* next GPD high addr */
 		hiaddr = upper_32_bits(gpd_virt_to_dma(ring, enq));
 		gpd->data_buf_len |= QMU_GPD_NEXT_HI(hiaddr);
-		/* buffer high addr */
-		hiaddr = upper_32_bits(req->dma);
+		/* buffer high addr, sg is off on 36bit, never a BD here */
+		hiaddr = upper_32_bits(buf);
 		gpd->data_buf_len |= QMU_GPD_BUF_HI(hiaddr);
 	}
 
 	gpd->next_gpd = cpu_to_le32((u32)gpd_virt_to_dma(ring, enq));
 
-	if (req->zero)
+	if (last && req->zero)
 		gpd->ext_flag |= GPD_EXT_FLAG_ZLP;
 
 	gpd->chksum = qmu_calc_checksum((u8 *)gpd);
 	gpd->flag |= GPD_FLAGS_HWO;
 
-	mreq->gpd = gpd;
-
-	return 0;
+	return gpd;
 }
 
-static int mtu3_prepare_rx_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
+static struct qmu_gpd *mtu3_prepare_rx_gpd(struct mtu3_ep *mep,
+		struct usb_request *req, struct qmu_buf_walk *w,
+		u32 len, bool last)
 {
 	struct qmu_gpd *enq;
 	struct mtu3_gpd_ring *ring = &mep->gpd_ring;
 	struct qmu_gpd *gpd = ring->enqueue;
-	struct usb_request *req = &mreq->request;
+	dma_addr_t buf;
 
 	/* set all fields to zero as default value */
 	memset(gpd, 0, sizeof(*gpd));
 
-	gpd->buffer = cpu_to_le32((u32)req->dma);
-	gpd->data_buf_len = cpu_to_le16(req->length);
-	gpd->flag |= GPD_FLAGS_IOC;
+	buf = w->dma;
+	gpd->data_buf_len = cpu_to_le16(len);
+	if (last && !req->no_interrupt)
+		gpd->flag |= GPD_FLAGS_IOC;
 
 	/* get the next GPD */
 	enq = advance_enq_gpd(ring);
@@ -251,13 +471,16 @@ static int mtu3_prepare_rx_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
 		mep->epnum, gpd, enq);
 
 	enq->flag &= ~GPD_FLAGS_HWO;
+
+	qmu_fill_gpd_buf(mep, gpd, w, len);
+
 	if (mep->mtu->is_36bit) {
 		u32 hiaddr;
 		/* next GPD high addr */
 		hiaddr = upper_32_bits(gpd_virt_to_dma(ring, enq));
 		gpd->ext_len |= QMU_GPD_NEXT_HI(hiaddr);
 		/* buffer high addr */
-		hiaddr = upper_32_bits(req->dma);
+		hiaddr = upper_32_bits(buf);
 		gpd->ext_len |= QMU_GPD_BUF_HI(hiaddr);
 	}
 
@@ -265,18 +488,41 @@ static int mtu3_prepare_rx_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
 	gpd->chksum = qmu_calc_checksum((u8 *)gpd);
 	gpd->flag |= GPD_FLAGS_HWO;
 
-	mreq->gpd = gpd;
-
-	return 0;
+	return gpd;
 }
 
+/*
+ * Only the last GPD of a request interrupts, and not even that one if
+ * the gadget driver set no_interrupt; its completion is then picked up
+ * with a later one's. mtu3_prepare_transfer() checked the rings first.
+ */
 void mtu3_insert_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq)
 {
+	struct usb_request *req = &mreq->request;
+	u32 chunk = qmu_gpd_chunk(mep);
+	u32 left = req->length;
+	u32 bds_free = mep->bd_ring.num_free;
+	struct qmu_buf_walk w;
+	struct qmu_gpd *gpd;
+	u32 len;
 
-	if (mep->is_in)
-		mtu3_prepare_tx_gpd(mep, mreq);
-	else
-		mtu3_prepare_rx_gpd(mep, mreq);
+	qmu_buf_walk_init(&w, req);
+	mreq->gpd = NULL;
+	do {
+		len = min(left, chunk);
+		left -= len;
+
+		if (mep->is_in)
+			gpd = mtu3_prepare_tx_gpd(mep, req, &w, len, !left);
+		else
+			gpd = mtu3_prepare_rx_gpd(mep, req, &w, len, !left);
+
+		if (!mreq->gpd)
+			mreq->gpd = gpd;
+	} while (left);
+
+	mreq->gpd_last = gpd;
+	mreq->num_bds = bds_free - mep->bd_ring.num_free;
 }
 
 int mtu3_qmu_start(struct mtu3_ep *mep)
@@ -432,6 +678,7 @@ static void qmu_done_tx(struct mtu3 *mtu, u8 epnum)
 	dma_addr_t gpd_dma = mtu3_readl(mbase, USB_QMU_TQCPR(epnum));
 	struct usb_request *request = NULL;
 	struct mtu3_request *mreq;
+	bool last;
 
 	/*transfer phy address got from QMU register to virtual address */
 	gpd_current = gpd_dma_to_virt(ring, gpd_dma);
@@ -449,10 +696,20 @@ static void qmu_done_tx(struct mtu3 *mtu, u8 epnum)
 		}
 
 		request = &mreq->request;
-		request->actual = le16_to_cpu(gpd->buf_len);
-		mtu3_req_complete(mep, request, 0);
-
+		request->actual += le16_to_cpu(gpd->buf_len);
+		last = (gpd == mreq->gpd_last);
 		gpd = advance_deq_gpd(ring);
+
+		if (!last) {
+			mreq->gpd = gpd;
+			continue;
+		}
+
+		mep->bd_ring.num_free += mreq->num_bds;
+#ifdef CONFIG_MEDIATEK_SOLUTION
+		usb_boost_ep_bytes(epnum, 1, request->actual);
+#endif
+		mtu3_req_complete(mep, request, 0);
 	}
 
 	dev_dbg(mtu->dev, "%s EP%d, deq=%p, enq=%p, complete\n",
@@ -460,6 +717,25 @@ static void qmu_done_tx(struct mtu3 *mtu, u8 epnum)
 
 }
 
+/* bytes received into a BDP GPD: its BDs up to the EOL one */
+static u32 qmu_rx_bd_actual(struct mtu3_ep *mep, struct qmu_gpd *gpd,
+		u32 num_bds)
+{
+	struct mtu3_bd_ring *ring = &mep->bd_ring;
+	struct qmu_bd *bd = bd_dma_to_virt(ring, le32_to_cpu(gpd->buffer));
+	u32 actual = 0;
+
+	while (bd && num_bds--) {
+		actual += le16_to_cpu(bd->buf_len);
+		if (bd->flag & BD_FLAGS_EOL)
+			break;
+
+		bd = bd_dma_to_virt(ring, le32_to_cpu(bd->next_bd));
+	}
+
+	return actual;
+}
+
 static void qmu_done_rx(struct mtu3 *mtu, u8 epnum)
 {
 	struct mtu3_ep *mep = mtu->out_eps + epnum;
@@ -486,10 +762,18 @@ static void qmu_done_rx(struct mtu3 *mtu, u8 epnum)
 		}
 		req = &mreq->request;
 
-		req->actual = le16_to_cpu(gpd->buf_len);
-		mtu3_req_complete(mep, req, 0);
-
+		if (gpd->flag & GPD_FLAGS_BDP)
+			req->actual = qmu_rx_bd_actual(mep, gpd,
+					mreq->num_bds);
+		else
+			req->actual = le16_to_cpu(gpd->buf_len);
 		gpd = advance_deq_gpd(ring);
+
+		mep->bd_ring.num_free += mreq->num_bds;
+#ifdef CONFIG_MEDIATEK_SOLUTION
+		usb_boost_ep_bytes(epnum, 0, req->actual);
+#endif
+		mtu3_req_complete(mep, req, 0);
 	}
 
 	dev_dbg(mtu->dev, "%s EP%d, deq=%p, enq=%p, complete\n",
@@ -578,6 +862,7 @@ int mtu3_qmu_init(struct mtu3 *mtu)
 {
 
 	compiletime_assert(QMU_GPD_SIZE == 16, "QMU_GPD size SHOULD be 16B");
+	compiletime_assert(QMU_BD_SIZE == 16, "QMU_BD size SHOULD be 16B");
 
 	mtu->qmu_gpd_pool = dma_pool_create("QMU_GPD", mtu->dev,
 			QMU_GPD_RING_SIZE, QMU_GPD_SIZE, 0);
@@ -585,10 +870,19 @@ int mtu3_qmu_init(struct mtu3 *mtu)
 	if (!mtu->qmu_gpd_pool)
 		return -ENOMEM;
 
+	mtu->qmu_bd_pool = dma_pool_create("QMU_BD", mtu->dev,
+			QMU_BD_RING_SIZE, QMU_BD_SIZE, 0);
+
+	if (!mtu->qmu_bd_pool) {
+		dma_pool_destroy(mtu->qmu_gpd_pool);
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
 void mtu3_qmu_exit(struct mtu3 *mtu)
 {
+	dma_pool_destroy(mtu->qmu_bd_pool);
 	dma_pool_destroy(mtu->qmu_gpd_pool);
 }
@@ -23,6 +23,10 @@
 #define QMU_GPD_SIZE		(sizeof(struct qmu_gpd))
 #define QMU_GPD_RING_SIZE	(MAX_GPD_NUM * QMU_GPD_SIZE)
 
+#define MAX_BD_NUM		256
+#define QMU_BD_SIZE		(sizeof(struct qmu_bd))
+#define QMU_BD_RING_SIZE	(MAX_BD_NUM * QMU_BD_SIZE)
+
 #define GPD_BUF_SIZE		65532
 
 void mtu3_qmu_stop(struct mtu3_ep *mep);
@@ -31,7 +35,7 @@ void mtu3_qmu_resume(struct mtu3_ep *mep);
 void mtu3_qmu_flush(struct mtu3_ep *mep);
 
 void mtu3_insert_gpd(struct mtu3_ep *mep, struct mtu3_request *mreq);
-int mtu3_prepare_transfer(struct mtu3_ep *mep);
+int mtu3_prepare_transfer(struct mtu3_ep *mep, struct mtu3_request *mreq);
 
 int mtu3_gpd_ring_alloc(struct mtu3_ep *mep);
 void mtu3_gpd_ring_free(struct mtu3_ep *mep);
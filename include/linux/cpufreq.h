@@ -129,6 +129,7 @@ struct cpufreq_policy {
 	spinlock_t		transition_lock;
 	wait_queue_head_t	transition_wait;
 	struct task_struct	*transition_task; /* Task which is doing the transition */
+	u64			transition_start; /* ktime_get_ns() at transition begin */
 
 	/* cpufreq-stats */
 	struct cpufreq_stats	*stats;
@@ -202,11 +203,16 @@ void cpufreq_stats_create_table(struct cpufreq_policy *policy);
 void cpufreq_stats_free_table(struct cpufreq_policy *policy);
 void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 				     unsigned int new_freq);
+void cpufreq_stats_record_latency(struct cpufreq_policy *policy,
+				  unsigned int new_freq, u64 latency_ns);
 #else
 static inline void cpufreq_stats_create_table(struct cpufreq_policy *policy) { }
 static inline void cpufreq_stats_free_table(struct cpufreq_policy *policy) { }
 static inline void cpufreq_stats_record_transition(struct cpufreq_policy *policy,
 						   unsigned int new_freq) { }
+static inline void cpufreq_stats_record_latency(struct cpufreq_policy *policy,
+						unsigned int new_freq,
+						u64 latency_ns) { }
 #endif /* CONFIG_CPU_FREQ_STAT */
 
 /*********************************************************************
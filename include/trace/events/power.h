@@ -172,6 +172,41 @@ TRACE_EVENT(cpu_frequency_limits,
 		  (unsigned long)__entry->cpu_id)
 );
 
+TRACE_EVENT(cpu_frequency_transition,
+
+	TP_PROTO(unsigned int cpu_id, unsigned int old_freq,
+		 unsigned int new_freq, u64 volt_up_ns, u64 clk_ns,
+		 u64 volt_down_ns),
+
+	TP_ARGS(cpu_id, old_freq, new_freq, volt_up_ns, clk_ns, volt_down_ns),
+
+	TP_STRUCT__entry(
+		__field(	u32,		cpu_id		)
+		__field(	u32,		old_freq	)
+		__field(	u32,		new_freq	)
+		__field(	u64,		volt_up_ns	)
+		__field(	u64,		clk_ns		)
+		__field(	u64,		volt_down_ns	)
+	),
+
+	TP_fast_assign(
+		__entry->cpu_id = cpu_id;
+		__entry->old_freq = old_freq;
+		__entry->new_freq = new_freq;
+		__entry->volt_up_ns = volt_up_ns;
+		__entry->clk_ns = clk_ns;
+		__entry->volt_down_ns = volt_down_ns;
+	),
+
+	TP_printk("cpu_id=%lu old=%lu new=%lu volt_up=%llu clk=%llu volt_down=%llu total=%llu",
+		  (unsigned long)__entry->cpu_id,
+		  (unsigned long)__entry->old_freq,
+		  (unsigned long)__entry->new_freq,
+		  __entry->volt_up_ns, __entry->clk_ns, __entry->volt_down_ns,
+		  __entry->volt_up_ns + __entry->clk_ns +
+		  __entry->volt_down_ns)
+);
+
 DEFINE_EVENT(cpu, cpu_capacity,
 
 	TP_PROTO(unsigned int capacity, unsigned int cpu_id),
@@ -1923,6 +1923,34 @@ TRACE_EVENT(sched_dvfs,
 );
 
 
+/*
+ * Tracepoint for dvfs request latency: time from irq_work queueing to the
+ * kschedfreq thread running, and time spent in the cpufreq driver.
+ */
+TRACE_EVENT(sched_dvfs_latency,
+		TP_PROTO(int cid, unsigned int freq, long long queue_ns,
+			long long target_ns),
+		TP_ARGS(cid, freq, queue_ns, target_ns),
+		TP_STRUCT__entry(
+			__field(int, cid)
+			__field(unsigned int, freq)
+			__field(long long, queue_ns)
+			__field(long long, target_ns)
+			),
+		TP_fast_assign(
+			__entry->cid		= cid;
+			__entry->freq		= freq;
+			__entry->queue_ns	= queue_ns;
+			__entry->target_ns	= target_ns;
+			),
+		TP_printk("cid=%d freq=%u queue_ns=%lld target_ns=%lld",
+			__entry->cid,
+			__entry->freq,
+			__entry->queue_ns,
+			__entry->target_ns
+			)
+);
+
 /*
  * Tracepoint for walt debug info.
  */
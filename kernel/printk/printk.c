@@ -46,6 +46,7 @@
 #include <linux/ctype.h>
 #include <linux/uio.h>
 #include <mt-plat/aee.h>
+#include <mt-plat/mtk_ram_console.h>
 #include <linux/proc_fs.h>
 
 #include <asm/uaccess.h>
@@ -2265,6 +2266,11 @@ asmlinkage int vprintk_emit(int facility, int level,
 		this_cpu_write(printk_state, ' ');
 #endif
 
+	/* quiet levels of complete lines stay off the consoles */
+	if (ram_console_plog_write(level, text, text_len) &&
+	    (lflags & LOG_NEWLINE) && !(lflags & LOG_CONT))
+		lflags |= LOG_NOCONS;
+
 	printed_len += log_output(facility, level, lflags, dict, dictlen, text, text_len);
 
 	logbuf_cpu = UINT_MAX;
@@ -162,6 +162,7 @@ int dbg_id = DEBUG_FREQ_DISABLED;
  * @task: worker thread for dvfs transition that may block/sleep
  * @irq_work: callback used to wake up worker thread
  * @requested_freq: last frequency requested by the sched governor
+ * @queued_time: time the last request was handed to the worker thread
  *
  * struct gov_data is the per-policy cpufreq_sched-specific data structure. A
  * per-policy instance of it is created when the cpufreq_sched governor receives
@@ -188,6 +189,7 @@ struct gov_data {
 	int cid;
 	enum throttle_type thro_type; /* throttle up or down */
 	u64 last_freq_update_time;
+	ktime_t queued_time; /* when irq_work was last queued */
 };
 
 static inline bool is_sched_assist(void)
@@ -339,6 +341,30 @@ static void cpufreq_sched_try_driver_target(
 	gd->throttle      = ktime_add_ns(cur_time, gd->throttle_nsec);
 }
 
+static inline bool is_cur(int new_freq, int cur_freq, int cid)
+{
+	if (is_sched_assist())
+		return false;
+
+	if (new_freq == cur_freq) {
+		if (!cpufreq_driver_slow) {
+			if (new_freq == mt_cpufreq_get_cur_freq(cid))
+				return true;
+		} else {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Immediate request from the schedtune boost path (update_freq_fastpath).
+ * This is not a cpufreq fast switch: mt8512-cpufreq has no ->fast_switch
+ * since the armpll relock goes through the clock framework, so the request
+ * is applied synchronously through the sleeping driver and callers must be
+ * in process context.
+ */
 void update_cpu_freq_quick(int cpu, int freq)
 {
 	int cid = arch_get_cluster_id(cpu);
@@ -347,6 +373,8 @@ void update_cpu_freq_quick(int cpu, int freq)
 	int max_clus_nr = arch_get_nr_clusters();
 	unsigned int cur_freq;
 
+	might_sleep();
+
 	if (cid >= max_clus_nr || cid < 0)
 		return;
 
@@ -355,14 +383,20 @@ void update_cpu_freq_quick(int cpu, int freq)
 
 	freq_new = mt_cpufreq_find_close_freq(cid, freq);
 
-#if 0
-	if (freq_new == cur_freq)
+	/*
+	 * The platform driver tracks its current OPP (and voltages) itself,
+	 * so a request for the frequency already in effect needs no driver
+	 * round trip at all.
+	 */
+	if (is_cur(freq_new, cur_freq, cid))
 		return;
-#endif
 
 	gd->thro_type = freq_new < cur_freq ?
 			DVFS_THROTTLE_DOWN : DVFS_THROTTLE_UP;
 
+	/* keep the governor thread in sync with this request */
+	gd->requested_freq = freq_new;
+
 	cpufreq_sched_try_driver_target(cpu, NULL, freq_new, -1);
 }
 EXPORT_SYMBOL(update_cpu_freq_quick);
@@ -413,6 +447,19 @@ static int cpufreq_sched_thread(void *data)
 		if (kthread_should_stop())
 			break;
 
+		if (trace_sched_dvfs_latency_enabled()) {
+			unsigned int freq = g_gd[gd->cid]->requested_freq;
+			ktime_t start = ktime_get();
+
+			cpufreq_sched_try_driver_target(cpu, policy,
+				freq, SCHE_INVALID);
+
+			trace_sched_dvfs_latency(gd->cid, freq,
+				ktime_to_ns(ktime_sub(start, gd->queued_time)),
+				ktime_to_ns(ktime_sub(ktime_get(), start)));
+			continue;
+		}
+
 		cpufreq_sched_try_driver_target(cpu, policy,
 			g_gd[gd->cid]->requested_freq, SCHE_INVALID);
 #if 0
@@ -449,23 +496,6 @@ static void cpufreq_sched_irq_work(struct irq_work *irq_work)
 	wake_up_process(gd->task);
 }
 
-static inline bool is_cur(int new_freq, int cur_freq, int cid)
-{
-	if (is_sched_assist())
-		return false;
-
-	if (new_freq == cur_freq) {
-		if (!cpufreq_driver_slow) {
-			if (new_freq == mt_cpufreq_get_cur_freq(cid))
-				return true;
-		} else {
-			return true;
-		}
-	}
-
-	return false;
-}
-
 static void update_fdomain_capacity_request(int cpu, int type)
 {
 	unsigned int freq_new, cpu_tmp;
@@ -658,9 +688,10 @@ static void update_fdomain_capacity_request(int cpu, int type)
 	 * Throttling is not yet supported on platforms with fast cpufreq
 	 * drivers.
 	 */
-	if (cpufreq_driver_slow)
+	if (cpufreq_driver_slow) {
+		gd->queued_time = now;
 		irq_work_queue_on(&gd->irq_work, cpu);
-	else
+	} else
 		cpufreq_sched_try_driver_target(cpu, policy, freq_new, type);
 
 out:
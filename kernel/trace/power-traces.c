@@ -16,5 +16,6 @@
 EXPORT_TRACEPOINT_SYMBOL_GPL(suspend_resume);
 EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_idle);
 EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_frequency);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_frequency_transition);
 EXPORT_TRACEPOINT_SYMBOL_GPL(powernv_throttle);
 
@@ -229,7 +229,7 @@ int mtk_afe_fe_trigger(struct snd_pcm_substream *substream, int cmd,
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
-		if (memif->data->enable_shift >= 0)
+		if (memif->data->enable_shift >= 0 && !memif->link_start)
 			mtk_regmap_update_bits(afe->regmap,
 					       memif->data->enable_reg,
 					       1 << memif->data->enable_shift,
@@ -256,6 +256,10 @@ int mtk_afe_fe_trigger(struct snd_pcm_substream *substream, int cmd,
 				<< irq_data->irq_fs_shift,
 				fs << irq_data->irq_fs_shift);
 
+		/* no period wakeup: userspace polls the pointer on its own */
+		if (runtime->no_period_wakeup)
+			return 0;
+
 		/* enable interrupt */
 		mtk_regmap_update_bits(afe->regmap, irq_data->irq_en_reg,
 				       1 << irq_data->irq_en_shift,
@@ -30,9 +30,10 @@ static snd_pcm_uframes_t mtk_afe_pcm_pointer
 	const struct mtk_base_memif_data *memif_data = memif->data;
 	struct regmap *regmap = afe->regmap;
 	struct device *dev = afe->dev;
-	int reg_ofs_base = memif_data->reg_ofs_base;
 	int reg_ofs_cur = memif_data->reg_ofs_cur;
-	unsigned int hw_ptr = 0, hw_base = 0;
+	/* same value hw_params programmed into reg_ofs_base */
+	unsigned int hw_base = memif->phys_buf_addr;
+	unsigned int hw_ptr = 0;
 	int ret, pcm_ptr_bytes;
 
 	ret = regmap_read(regmap, reg_ofs_cur, &hw_ptr);
@@ -42,8 +43,7 @@ static snd_pcm_uframes_t mtk_afe_pcm_pointer
 		goto POINTER_RETURN_FRAMES;
 	}
 
-	ret = regmap_read(regmap, reg_ofs_base, &hw_base);
-	if (ret || hw_base == 0) {
+	if (hw_base == 0) {
 		dev_err(dev, "%s hw_ptr err\n", __func__);
 		pcm_ptr_bytes = 0;
 		goto POINTER_RETURN_FRAMES;
@@ -55,9 +55,103 @@ POINTER_RETURN_FRAMES:
 	return bytes_to_frames(substream->runtime, pcm_ptr_bytes);
 }
 
+/*
+ * Frames the memif has moved since start, from its current address. The
+ * core may not have folded a buffer wrap in yet, so the position is
+ * unwrapped against its last hw_ptr.
+ */
+int mtk_afe_pcm_hw_frames(struct mtk_base_afe *afe,
+			  struct mtk_base_afe_memif *memif, u64 *frames)
+{
+	struct snd_pcm_runtime *runtime = memif->substream->runtime;
+	snd_pcm_uframes_t hw_ptr;
+	unsigned int cur = 0;
+	int ret;
+
+	if (!memif->phys_buf_addr)
+		return -EINVAL;
+
+	ret = regmap_read(afe->regmap, memif->data->reg_ofs_cur, &cur);
+	if (ret)
+		return ret;
+	if (cur < memif->phys_buf_addr)
+		return -EINVAL;
+
+	hw_ptr = runtime->hw_ptr_base +
+		 bytes_to_frames(runtime, cur - memif->phys_buf_addr);
+	if (hw_ptr < runtime->status->hw_ptr)
+		hw_ptr += runtime->buffer_size;
+
+	*frames = runtime->hw_ptr_wrap + hw_ptr;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mtk_afe_pcm_hw_frames);
+
+/*
+ * Link time estimated from the memif current address: the register is
+ * read with interrupts off between two system timestamps, so the audio
+ * time is pinned to the midpoint of a window of a few microseconds.
+ */
+static int mtk_afe_pcm_get_time_info(struct snd_pcm_substream *substream,
+	struct timespec *system_ts, struct timespec *audio_ts,
+	struct snd_pcm_audio_tstamp_config *audio_tstamp_config,
+	struct snd_pcm_audio_tstamp_report *audio_tstamp_report)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(rtd->platform);
+	struct mtk_base_afe_memif *memif = &afe->memif[rtd->cpu_dai->id];
+	struct timespec ts0, ts1;
+	unsigned long flags;
+	u64 frames, window;
+	int ret;
+
+	if (audio_tstamp_config->type_requested !=
+	    SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED) {
+		audio_tstamp_report->actual_type =
+			SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
+
+	local_irq_save(flags);
+	snd_pcm_gettime(runtime, &ts0);
+	ret = mtk_afe_pcm_hw_frames(afe, memif, &frames);
+	snd_pcm_gettime(runtime, &ts1);
+	local_irq_restore(flags);
+
+	if (ret) {
+		audio_tstamp_report->actual_type =
+			SNDRV_PCM_AUDIO_TSTAMP_TYPE_DEFAULT;
+		return 0;
+	}
+
+	if (audio_tstamp_config->report_delay) {
+		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			frames -= runtime->delay;
+		else
+			frames += runtime->delay;
+	}
+	*audio_ts = ns_to_timespec(div_u64(frames * NSEC_PER_SEC,
+					   runtime->rate));
+
+	window = timespec_to_ns(&ts1) - timespec_to_ns(&ts0);
+	*system_ts = ns_to_timespec(timespec_to_ns(&ts0) + window / 2);
+
+	audio_tstamp_report->actual_type =
+		SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK_ESTIMATED;
+	audio_tstamp_report->accuracy_report = 1;
+	/* half the read window plus one frame of DMA granularity */
+	audio_tstamp_report->accuracy = window / 2 +
+					div_u64(NSEC_PER_SEC, runtime->rate);
+
+	return 0;
+}
+
 const struct snd_pcm_ops mtk_afe_pcm_ops = {
 	.ioctl = snd_pcm_lib_ioctl,
 	.pointer = mtk_afe_pcm_pointer,
+	.get_time_info = mtk_afe_pcm_get_time_info,
 };
 EXPORT_SYMBOL_GPL(mtk_afe_pcm_ops);
 
@@ -20,8 +20,13 @@
 extern const struct snd_soc_platform_driver mtk_afe_pcm_platform;
 extern const struct snd_pcm_ops mtk_afe_pcm_ops;
 
+struct mtk_base_afe;
+struct mtk_base_afe_memif;
+
 int mtk_afe_pcm_new(struct snd_soc_pcm_runtime *rtd);
 void mtk_afe_pcm_free(struct snd_pcm *pcm);
+int mtk_afe_pcm_hw_frames(struct mtk_base_afe *afe,
+			  struct mtk_base_afe_memif *memif, u64 *frames);
 
 #endif
 
@@ -110,6 +110,7 @@ struct mtk_base_afe_memif {
 	const struct mtk_base_memif_data *data;
 	int irq_usage;
 	int const_irq;
+	bool link_start;	/* platform sets the enable bit with its group */
 };
 
 struct mtk_base_afe_irq {
@@ -22,6 +22,7 @@
 #include <sound/pcm_params.h>
 #include <linux/pm_runtime.h>
 #include "mach/mtk_hifixdsp_common.h"
+#include "audio_ringcopy.h"
 
 #include "mt8512-adsp-utils.h"
 #include "mt8512-afe-common.h"
@@ -503,10 +504,11 @@ static int mt8512_adsp_pcm_be_hw_params(struct snd_pcm_substream *substream,
 	memif->buffer_size = params_buffer_bytes(params);
 	ipc_hw_param.adsp_dma.dma_paddr = 0;
 	if (adsp_be->mem_type == AFE_MEM_TYPE_AFE_SRAM) {
-		unsigned int paddr, size;
+		unsigned int paddr;
 
-		afe_adsp->get_afe_memif_sram(afe, memif_id, &paddr, &size);
-		if (paddr != 0 && memif->buffer_size < size) {
+		if (!afe_adsp->alloc_afe_memif_sram(afe, memif_id,
+						    memif->buffer_size,
+						    &paddr)) {
 			ipc_hw_param.adsp_dma.dma_paddr = paddr;
 			ipc_hw_param.adsp_dma.mem_type = AFE_MEM_TYPE_AFE_SRAM;
 		} else {
@@ -540,11 +542,15 @@ static int mt8512_adsp_pcm_be_hw_params(struct snd_pcm_substream *substream,
 		return -ENOMEM;
 
 	/* Notice: for AFE & DTCM do not need address convert */
-	if (ack_hw_param.adsp_dma.mem_type != AFE_MEM_TYPE_AFE_SRAM)
+	if (ack_hw_param.adsp_dma.mem_type != AFE_MEM_TYPE_AFE_SRAM) {
 		memif->phys_buf_addr =
 		    adsp_hal_phys_addr_dsp2cpu(ack_hw_param.adsp_dma.dma_paddr);
-	else
+		/* DSP placed it elsewhere, give the AFE SRAM back */
+		if (ipc_hw_param.adsp_dma.mem_type == AFE_MEM_TYPE_AFE_SRAM)
+			afe_adsp->free_afe_memif_sram(afe, memif_id);
+	} else {
 		memif->phys_buf_addr = ack_hw_param.adsp_dma.dma_paddr;
+	}
 
 	ret = afe_adsp->set_afe_memif(afe,
 				       memif_id,
@@ -563,6 +569,12 @@ static int mt8512_adsp_pcm_be_hw_free(struct snd_pcm_substream *substream,
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	int id = rtd->cpu_dai->id;
 	int scene = mt8512_adsp_get_scene_by_dai_id(id);
+	int memif_id = mt8512_adsp_get_afe_memif_id(id);
+	struct mt8512_adsp_pcm_priv *priv =
+		snd_soc_platform_get_drvdata(rtd->platform);
+	struct mtk_base_afe *afe = priv->afe;
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_adsp_data *afe_adsp = &(afe_priv->adsp_data);
 	uint32_t dai_id;
 
 	if (!IS_ADSP_READY())
@@ -581,6 +593,9 @@ static int mt8512_adsp_pcm_be_hw_free(struct snd_pcm_substream *substream,
 				 0,
 				 (char *)&dai_id);
 
+	if (memif_id >= 0)
+		afe_adsp->free_afe_memif_sram(afe, memif_id);
+
 	return 0;
 }
 
@@ -1504,6 +1519,8 @@ static void mt8512_adsp_pcm_data_copy(struct snd_pcm_substream *substream,
 	uint32_t avail_bytes;
 	uint32_t cpu_dma_free_bytes;
 	uint32_t copy_bytes;
+	struct audio_ring_pos_t adsp_pos;
+	struct audio_ring_pos_t cpu_pos;
 
 	adsp_dma_hw_off =
 		dai_mem->adsp_dma_control->ptr_to_hw_offset_bytes;
@@ -1527,38 +1544,17 @@ static void mt8512_adsp_pcm_data_copy(struct snd_pcm_substream *substream,
 
 	copy_bytes = (avail_bytes / period_size_bytes) * period_size_bytes;
 
-	while (copy_bytes > 0) {
-		uint32_t from_bytes = 0;
-
-		if (adsp_dma_hw_off >= adsp_dma_appl_off)
-			from_bytes = adsp_dma_hw_off - adsp_dma_appl_off;
-		else
-			from_bytes = adsp_dma_buf_size - adsp_dma_appl_off;
-
-		if (from_bytes > copy_bytes)
-			from_bytes = copy_bytes;
-
-		while (from_bytes > 0) {
-			uint32_t to_bytes = 0;
-
-			if (cpu_dma_offset + from_bytes < cpu_dma_buf_size)
-				to_bytes = from_bytes;
-			else
-				to_bytes = cpu_dma_buf_size - cpu_dma_offset;
+	adsp_pos.base = (char *)adsp_dma_buf_vaddr;
+	adsp_pos.size = adsp_dma_buf_size;
+	adsp_pos.off = adsp_dma_appl_off;
+	cpu_pos.base = (char *)cpu_dma_buf_vaddr;
+	cpu_pos.size = cpu_dma_buf_size;
+	cpu_pos.off = cpu_dma_offset;
 
-			memcpy(cpu_dma_buf_vaddr + cpu_dma_offset,
-				adsp_dma_buf_vaddr + adsp_dma_appl_off,
-				to_bytes);
+	audio_ring_copy(&cpu_pos, &adsp_pos, copy_bytes);
 
-			from_bytes -= to_bytes;
-			copy_bytes -= to_bytes;
-
-			cpu_dma_offset = (cpu_dma_offset + to_bytes) %
-				cpu_dma_buf_size;
-			adsp_dma_appl_off = (adsp_dma_appl_off + to_bytes) %
-				adsp_dma_buf_size;
-		}
-	}
+	adsp_dma_appl_off = adsp_pos.off;
+	cpu_dma_offset = cpu_pos.off;
 
 	dai_mem->adsp_dma_control->ptr_to_appl_offset_bytes =
 		adsp_dma_appl_off;
@@ -1584,6 +1580,8 @@ static void mt8512_adsp_pcm_data_write(struct snd_pcm_substream *substream,
 	uint32_t avail_bytes;
 	uint32_t cpu_dma_queued_bytes;
 	uint32_t copy_bytes;
+	struct audio_ring_pos_t adsp_pos;
+	struct audio_ring_pos_t cpu_pos;
 
 	/* hw read_ptr */
 	adsp_dma_hw_off =
@@ -1615,48 +1613,18 @@ static void mt8512_adsp_pcm_data_write(struct snd_pcm_substream *substream,
 	} else
 		copy_bytes = period_size_bytes;
 
-	while (copy_bytes > 0) {
-		uint32_t from_bytes = 0;
+	/* copy_bytes never exceeds avail_bytes, so hw_off is not crossed */
+	adsp_pos.base = (char *)adsp_dma_buf_vaddr;
+	adsp_pos.size = adsp_dma_buf_size;
+	adsp_pos.off = adsp_dma_appl_off;
+	cpu_pos.base = (char *)cpu_dma_buf_vaddr;
+	cpu_pos.size = cpu_dma_buf_size;
+	cpu_pos.off = cpu_dma_offset;
 
-		if (cpu_dma_offset + copy_bytes < cpu_dma_buf_size)
-			from_bytes = copy_bytes;
-		else
-			from_bytes = cpu_dma_buf_size - cpu_dma_offset;
-
-		while (from_bytes > 0) {
-			uint32_t to_bytes = 0;
-
-			if (adsp_dma_hw_off >= adsp_dma_appl_off) {
-				if (adsp_dma_appl_off + from_bytes
-					<= adsp_dma_hw_off)
-					to_bytes = from_bytes;
-				else
-					to_bytes =
-						adsp_dma_hw_off
-						- adsp_dma_appl_off;
-			} else {
-				if (adsp_dma_appl_off + from_bytes
-					< adsp_dma_buf_size)
-					to_bytes = from_bytes;
-				else
-					to_bytes =
-						adsp_dma_buf_size
-						- adsp_dma_appl_off;
-			}
-
-			memcpy(adsp_dma_buf_vaddr + adsp_dma_appl_off,
-				cpu_dma_buf_vaddr + cpu_dma_offset,
-				to_bytes);
+	audio_ring_copy(&adsp_pos, &cpu_pos, copy_bytes);
 
-			from_bytes -= to_bytes;
-			copy_bytes -= to_bytes;
-
-			cpu_dma_offset = (cpu_dma_offset + to_bytes) %
-				cpu_dma_buf_size;
-			adsp_dma_appl_off = (adsp_dma_appl_off + to_bytes) %
-				adsp_dma_buf_size;
-		}
-	}
+	adsp_dma_appl_off = adsp_pos.off;
+	cpu_dma_offset = cpu_pos.off;
 
 	dai_mem->adsp_dma_control->ptr_to_appl_offset_bytes =
 		adsp_dma_appl_off;
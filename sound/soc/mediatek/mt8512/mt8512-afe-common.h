@@ -21,6 +21,7 @@
 /* #define DEBUG_AFE_REGISTER_RW */
 
 #include <linux/clk.h>
+#include <linux/genalloc.h>
 #include <linux/regmap.h>
 #include <sound/asound.h>
 #include "../common/mtk-base-afe.h"
@@ -258,6 +259,7 @@ enum {
 	MT8512_AFE_DEBUGFS_GASRC,
 	MT8512_AFE_DEBUGFS_SPDIF,
 	MT8512_AFE_DEBUGFS_DBG,
+	MT8512_AFE_DEBUGFS_SRAM,
 	MT8512_AFE_DEBUGFS_NUM,
 };
 
@@ -267,14 +269,41 @@ enum {
 	MT8512_AFE_IRQ_DIR_BOTH,
 };
 
+/*
+ * AFE SRAM placement priority of a FE, higher wins. While a FE of a
+ * higher class is idle its sram budget is kept free for it.
+ */
+enum mt8512_afe_sram_class {
+	MT8512_SRAM_CLASS_NONE = 0,		/* always DRAM */
+	MT8512_SRAM_CLASS_BULK,			/* music, what is left over */
+	MT8512_SRAM_CLASS_LOW_LATENCY,
+	MT8512_SRAM_CLASS_WAKE_WORD,		/* always-on capture */
+	MT8512_SRAM_CLASS_NUM,
+};
+
 struct mt8512_fe_dai_data {
 	bool slave_mode;
 	bool use_sram;
+	unsigned int sram_class;
+	unsigned int sram_budget;
 	unsigned int sram_phy_addr;
 	void __iomem *sram_vir_addr;
 	unsigned int sram_size;
 };
 
+/*
+ * Memifs in mask are armed by their trigger and enabled together by a
+ * single AFE_DAC_CON0 write once every prepared member is armed, so
+ * their first samples sit on the same LRCK edge.
+ */
+struct mt8512_link_start_data {
+	unsigned int mask;
+	unsigned int prepared;
+	unsigned int armed;
+	unsigned int started;
+	spinlock_t lock;
+};
+
 struct mt8512_be_dai_data {
 	bool prepared[SNDRV_PCM_STREAM_LAST + 1];
 	unsigned int fmt_mode;
@@ -392,6 +421,11 @@ struct mt8512_gasrc_data {
 	unsigned int cali_cycles;
 	bool re_enable[SNDRV_PCM_STREAM_LAST + 1];
 	atomic_t ref_cnt;
+	/* stop leaves the gasrc running for a retune on next prepare */
+	bool seamless;
+	bool parked;
+	int stream;
+	int iir_table_id;	/* resident in the coefficient sram, -1 none */
 };
 
 enum mt8512_afe_gasrc_mux {
@@ -432,10 +466,12 @@ struct mt8512_adsp_data {
 				       unsigned int rate,
 				       unsigned int period_size,
 				       int enable);
-	void (*get_afe_memif_sram)(struct mtk_base_afe *afe,
+	int (*alloc_afe_memif_sram)(struct mtk_base_afe *afe,
 				       int memif_id,
-				       unsigned int *paddr,
-				       unsigned int *size);
+				       unsigned int size,
+				       unsigned int *paddr);
+	void (*free_afe_memif_sram)(struct mtk_base_afe *afe,
+				       int memif_id);
 	void (*set_afe_init)(struct mtk_base_afe *afe);
 	void (*set_afe_uninit)(struct mtk_base_afe *afe);
 	void (*set_afe_interconn)(struct mtk_base_afe *afe, int enable);
@@ -453,6 +489,7 @@ struct mt8512_afe_private {
 	struct mt8512_control_data ctrl_data;
 	struct mt8512_dmic_data dmic_data;
 	struct mt8512_gasrc_data gasrc_data[MT8512_GASRC_NUM];
+	struct mt8512_link_start_data link_start;
 #ifdef CONFIG_MTK_HIFIXDSP_SUPPORT
 	struct mt8512_adsp_data adsp_data;
 #endif
@@ -469,6 +506,8 @@ struct mt8512_afe_private {
 	struct regmap *scpsys;
 	int block_dpidle_ref_cnt;
 	struct mutex block_dpidle_mutex;
+	struct gen_pool *sram_pool;
+	struct mutex sram_mutex;
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debugfs_dentry[MT8512_AFE_DEBUGFS_NUM];
 #endif
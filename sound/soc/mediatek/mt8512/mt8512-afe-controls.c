@@ -1381,6 +1381,64 @@ static int mt8512_afe_dl2_force_interconn_put(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
+static int mt8512_afe_link_start_mask_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_platform *plat = snd_soc_kcontrol_platform(kcontrol);
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(plat);
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+
+	ucontrol->value.integer.value[0] = afe_priv->link_start.mask;
+
+	return 0;
+}
+
+static int mt8512_afe_link_start_mask_put(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_platform *plat = snd_soc_kcontrol_platform(kcontrol);
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(plat);
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	unsigned int mask = ucontrol->value.integer.value[0];
+	unsigned long flags;
+	int ret = 0;
+
+	if (mask & ~(BIT(MT8512_AFE_MEMIF_NUM) - 1))
+		return -EINVAL;
+
+	spin_lock_irqsave(&link->lock, flags);
+	/* the group can not change under a pending or running start */
+	if ((link->armed | link->started) && mask != link->mask)
+		ret = -EBUSY;
+	else
+		link->mask = mask;
+	spin_unlock_irqrestore(&link->lock, flags);
+
+	return ret;
+}
+
+static int mt8512_afe_link_start_offset_info(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = MT8512_AFE_MEMIF_NUM;
+	uinfo->value.integer.min = INT_MIN;
+	uinfo->value.integer.max = INT_MAX;
+	return 0;
+}
+
+static int mt8512_afe_link_start_offset_get(struct snd_kcontrol *kcontrol,
+	struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_platform *plat = snd_soc_kcontrol_platform(kcontrol);
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(plat);
+
+	mt8512_afe_link_start_offsets(afe, ucontrol->value.integer.value);
+
+	return 0;
+}
+
 
 #define SND_SOC_CTL_RO(xname, xhandler_info, xhandler_get) \
 {	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
@@ -1508,6 +1566,13 @@ static const struct snd_kcontrol_new mt8512_afe_controls[] = {
 			    0,
 			    mt8512_afe_dl2_force_interconn_get,
 			    mt8512_afe_dl2_force_interconn_put),
+	SOC_SINGLE_EXT("AFE_Linked_Start_Mask",
+		       SND_SOC_NOPM, 0, BIT(MT8512_AFE_MEMIF_NUM) - 1, 0,
+		       mt8512_afe_link_start_mask_get,
+		       mt8512_afe_link_start_mask_put),
+	SND_SOC_CTL_RO("AFE_Linked_Start_Offset",
+		       mt8512_afe_link_start_offset_info,
+		       mt8512_afe_link_start_offset_get),
 };
 
 int mt8512_afe_add_controls(struct snd_soc_platform *platform)
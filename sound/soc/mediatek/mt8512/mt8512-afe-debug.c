@@ -640,6 +640,55 @@ static ssize_t mt8512_afe_dbg_read_file(struct file *file,
 	return ret;
 }
 
+static ssize_t mt8512_afe_sram_read_file(struct file *file,
+					 char __user *user_buf,
+					 size_t count,
+					 loff_t *pos)
+{
+	struct mtk_base_afe *afe = file->private_data;
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_fe_dai_data *fe_data;
+	ssize_t ret;
+	char *buf;
+	int i, n = 0;
+
+	if (*pos < 0 || !count)
+		return -EINVAL;
+
+	buf = kmalloc(count, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	if (afe_priv->sram_pool)
+		n += scnprintf(buf + n, count - n,
+			       "sram 0x%x size %u avail %zu\n",
+			       afe_priv->afe_sram_phy_addr,
+			       afe_priv->afe_sram_size,
+			       gen_pool_avail(afe_priv->sram_pool));
+	else
+		n += scnprintf(buf + n, count - n, "sram N/A\n");
+
+	mutex_lock(&afe_priv->sram_mutex);
+	for (i = 0; i < MT8512_AFE_MEMIF_NUM; i++) {
+		fe_data = &afe_priv->fe_data[i];
+		if (fe_data->sram_class == MT8512_SRAM_CLASS_NONE)
+			continue;
+
+		n += scnprintf(buf + n, count - n,
+			       "%s class %u budget %u %s 0x%x size %u\n",
+			       afe->memif[i].data->name,
+			       fe_data->sram_class, fe_data->sram_budget,
+			       fe_data->use_sram ? "sram" : "idle",
+			       fe_data->sram_phy_addr, fe_data->sram_size);
+	}
+	mutex_unlock(&afe_priv->sram_mutex);
+
+	ret = simple_read_from_buffer(user_buf, count, pos, buf, n);
+	kfree(buf);
+
+	return ret;
+}
+
 static const struct file_operations mt8512_afe_etdm_fops = {
 	.open = simple_open,
 	.read = mt8512_afe_etdm_read_file,
@@ -696,6 +745,12 @@ static const struct file_operations mt8512_afe_dbg_fops = {
 	.llseek = default_llseek,
 };
 
+static const struct file_operations mt8512_afe_sram_fops = {
+	.open = simple_open,
+	.read = mt8512_afe_sram_read_file,
+	.llseek = default_llseek,
+};
+
 static const
 struct mt8512_afe_debug_fs afe_debug_fs[MT8512_AFE_DEBUGFS_NUM] = {
 	{"mtksocaudioetdm", &mt8512_afe_etdm_fops},
@@ -706,6 +761,7 @@ struct mt8512_afe_debug_fs afe_debug_fs[MT8512_AFE_DEBUGFS_NUM] = {
 	{"mtksocaudiogasrc", &mt8512_afe_gasrc_fops},
 	{"mtksocaudiospdif", &mt8512_afe_spdif_fops},
 	{"mtksocaudiodbg", &mt8512_afe_dbg_fops},
+	{"mtksocaudiosram", &mt8512_afe_sram_fops},
 };
 
 #endif
@@ -44,156 +44,12 @@
 #define PCM_STREAM_STR(x) \
 	(((x) == SNDRV_PCM_STREAM_CAPTURE) ? "capture" : "playback")
 
-// TODO: revise registers to backup
-static const unsigned int mt8512_afe_backup_list[] = {
-	AUDIO_TOP_CON0,
-	AUDIO_TOP_CON2,
-	AUDIO_TOP_CON4,
-	AUDIO_TOP_CON5,
-	AFE_CONN1,
-	AFE_CONN2,
-	AFE_CONN3,
-	AFE_CONN4,
-	AFE_CONN5,
-	AFE_CONN6,
-	AFE_CONN7,
-	AFE_CONN8,
-	AFE_CONN9,
-	AFE_CONN10,
-	AFE_CONN11,
-	AFE_CONN12,
-	AFE_CONN13,
-	AFE_CONN14,
-	AFE_CONN15,
-	AFE_CONN16,
-	AFE_CONN17,
-	AFE_CONN18,
-	AFE_CONN19,
-	AFE_CONN20,
-	AFE_CONN21,
-	AFE_CONN26,
-	AFE_CONN27,
-	AFE_CONN28,
-	AFE_CONN29,
-	AFE_CONN30,
-	AFE_CONN31,
-	AFE_CONN32,
-	AFE_CONN33,
-	AFE_CONN34,
-	AFE_CONN35,
-	AFE_CONN36,
-	AFE_CONN37,
-	AFE_CONN38,
-	AFE_CONN39,
-	AFE_CONN40,
-	AFE_CONN41,
-	AFE_CONN42,
-	AFE_CONN43,
-	AFE_CONN44,
-	AFE_CONN45,
-	AFE_CONN46,
-	AFE_CONN47,
-	AFE_CONN48,
-	AFE_CONN49,
-	AFE_CONN53,
-	AFE_CONN54,
-	AFE_CONN55,
-	AFE_CONN56,
-	AFE_CONN57,
-	AFE_CONN58,
-	AFE_CONN59,
-	AFE_CONN60,
-	AFE_CONN61,
-	AFE_CONN64,
-	AFE_CONN0_1,
-	AFE_CONN1_1,
-	AFE_CONN2_1,
-	AFE_CONN3_1,
-	AFE_CONN4_1,
-	AFE_CONN5_1,
-	AFE_CONN6_1,
-	AFE_CONN7_1,
-	AFE_CONN8_1,
-	AFE_CONN9_1,
-	AFE_CONN10_1,
-	AFE_CONN11_1,
-	AFE_CONN12_1,
-	AFE_CONN13_1,
-	AFE_CONN14_1,
-	AFE_CONN15_1,
-	AFE_CONN16_1,
-	AFE_CONN17_1,
-	AFE_CONN18_1,
-	AFE_CONN19_1,
-	AFE_CONN20_1,
-	AFE_CONN21_1,
-	AFE_CONN22_1,
-	AFE_CONN23_1,
-	AFE_CONN24_1,
-	AFE_CONN25_1,
-	AFE_CONN26_1,
-	AFE_CONN27_1,
-	AFE_CONN28_1,
-	AFE_CONN29_1,
-	AFE_CONN30_1,
-	AFE_CONN31_1,
-	AFE_CONN32_1,
-	AFE_CONN33_1,
-	AFE_CONN34_1,
-	AFE_CONN35_1,
-	AFE_CONN36_1,
-	AFE_CONN37_1,
-	AFE_CONN38_1,
-	AFE_CONN39_1,
-	AFE_CONN40_1,
-	AFE_CONN41_1,
-	AFE_CONN42_1,
-	AFE_CONN43_1,
-	AFE_CONN44_1,
-	AFE_CONN45_1,
-	AFE_CONN46_1,
-	AFE_CONN47_1,
-	AFE_CONN48_1,
-	AFE_CONN49_1,
-	AFE_CONN_RS,
-	AFE_CONN_RS_1,
-	AFE_CONN_16BIT,
-	AFE_CONN_24BIT,
-	AFE_CONN_16BIT_1,
-	AFE_CONN_24BIT_1,
-	AFE_DL2_BASE,
-	AFE_DL2_END,
-	AFE_DL3_BASE,
-	AFE_DL3_END,
-	AFE_DL6_BASE,
-	AFE_DL6_END,
-	AFE_DL10_BASE,
-	AFE_DL10_END,
-	AFE_UL1_BASE,
-	AFE_UL1_END,
-	AFE_UL2_BASE,
-	AFE_UL2_END,
-	AFE_UL3_BASE,
-	AFE_UL3_END,
-	AFE_UL4_BASE,
-	AFE_UL4_END,
-	AFE_UL5_BASE,
-	AFE_UL5_END,
-	AFE_UL8_BASE,
-	AFE_UL8_END,
-	AFE_UL9_BASE,
-	AFE_UL9_END,
-	AFE_UL10_BASE,
-	AFE_UL10_END,
-	AFE_DAC_CON0,
-	AFE_IRQ_MASK,
-	ETDM_IN2_CON0,
-};
-
 static const struct snd_pcm_hardware mt8512_afe_hardware = {
 	.info = (SNDRV_PCM_INFO_MMAP |
 		 SNDRV_PCM_INFO_INTERLEAVED |
-		 SNDRV_PCM_INFO_MMAP_VALID),
+		 SNDRV_PCM_INFO_MMAP_VALID |
+		 SNDRV_PCM_INFO_NO_PERIOD_WAKEUP |
+		 SNDRV_PCM_INFO_HAS_LINK_ESTIMATED_ATIME),
 	.buffer_bytes_max = 256 * 1024,
 	.period_bytes_min = 64,
 	.period_bytes_max = 128 * 1024,
@@ -1555,9 +1411,15 @@ static int mt8512_alloc_dmabuf(struct snd_pcm_substream *substream,
 	const struct mtk_base_memif_data *data = memif->data;
 	struct mt8512_fe_dai_data *fe_data = &afe_priv->fe_data[dai_id];
 	const size_t request_size = params_buffer_bytes(params);
+	const bool had_sram = fe_data->use_sram;
+	const bool had_dram = !had_sram && substream->runtime->dma_area;
 	int ret;
 
-	if (request_size > fe_data->sram_size) {
+	/* a DRAM buffer from an earlier hw_params is kept */
+	if (had_dram || mt8512_afe_alloc_sram(afe, dai_id, request_size)) {
+		if (had_sram)
+			snd_pcm_set_runtime_buffer(substream, NULL);
+
 		ret = snd_pcm_lib_malloc_pages(substream, request_size);
 		if (ret < 0) {
 			dev_info(afe->dev,
@@ -1566,9 +1428,8 @@ static int mt8512_alloc_dmabuf(struct snd_pcm_substream *substream,
 			return ret;
 		}
 
-		fe_data->use_sram = false;
-
-		mt8512_afe_block_dpidle(afe);
+		if (!had_dram)
+			mt8512_afe_block_dpidle(afe);
 	} else {
 		struct snd_dma_buffer *dma_buf = &substream->dma_buffer;
 
@@ -1578,8 +1439,6 @@ static int mt8512_alloc_dmabuf(struct snd_pcm_substream *substream,
 		dma_buf->addr = fe_data->sram_phy_addr;
 		dma_buf->bytes = request_size;
 		snd_pcm_set_runtime_buffer(substream, dma_buf);
-
-		fe_data->use_sram = true;
 	}
 
 	return 0;
@@ -1597,6 +1456,7 @@ static int mt8512_free_dmabuf(struct snd_pcm_substream *substream,
 
 	if (fe_data->use_sram) {
 		snd_pcm_set_runtime_buffer(substream, NULL);
+		mt8512_afe_free_sram(afe, dai_id);
 	} else {
 		ret = snd_pcm_lib_free_pages(substream);
 
@@ -1660,6 +1520,8 @@ static void mt8512_afe_fe_shutdown(struct snd_pcm_substream *substream,
 
 	dev_dbg(dai->dev, "%s %d\n", __func__, dai->id);
 
+	mt8512_afe_link_start_release(afe, rtd->cpu_dai->id);
+
 	mtk_afe_fe_shutdown(substream, dai);
 
 	mt8512_afe_disable_main_clk(afe);
@@ -1737,12 +1599,33 @@ static int mt8512_afe_fe_hw_params(struct snd_pcm_substream *substream,
 	return mtk_afe_fe_hw_params(substream, params, dai);
 }
 
+static int mt8512_afe_fe_hw_free(struct snd_pcm_substream *substream,
+				 struct snd_soc_dai *dai)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(rtd->platform);
+
+	mt8512_afe_link_start_release(afe, rtd->cpu_dai->id);
+
+	return mtk_afe_fe_hw_free(substream, dai);
+}
+
 static int mt8512_afe_fe_prepare(struct snd_pcm_substream *substream,
 				 struct snd_soc_dai *dai)
 {
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(rtd->platform);
+	int ret;
+
 	dev_dbg(dai->dev, "%s %d\n", __func__, dai->id);
 
-	return mtk_afe_fe_prepare(substream, dai);
+	ret = mtk_afe_fe_prepare(substream, dai);
+	if (ret)
+		return ret;
+
+	mt8512_afe_link_start_prepare(afe, rtd->cpu_dai->id);
+
+	return 0;
 }
 
 int mt8512_afe_fe_trigger(struct snd_pcm_substream *substream, int cmd,
@@ -1750,7 +1633,11 @@ int mt8512_afe_fe_trigger(struct snd_pcm_substream *substream, int cmd,
 {
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct mtk_base_afe *afe = snd_soc_platform_get_drvdata(rtd->platform);
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mtk_base_afe_memif *memif = &afe->memif[rtd->cpu_dai->id];
 	const int dai_id = rtd->cpu_dai->id;
+	bool linked = afe_priv->link_start.mask & BIT(dai_id);
+	int ret;
 
 	dev_info(dai->dev, "%s %d cmd %d\n", __func__, dai->id, cmd);
 
@@ -1767,9 +1654,23 @@ int mt8512_afe_fe_trigger(struct snd_pcm_substream *substream, int cmd,
 				AFE_I2S_UL9_REORDER,
 				UL_REORDER_EN, UL_REORDER_EN);
 		}
-		break;
+
+		if (!linked)
+			break;
+
+		/* irq and fs only, the enable bit goes with the group */
+		memif->link_start = true;
+		ret = mtk_afe_fe_trigger(substream, cmd, dai);
+		memif->link_start = false;
+		if (ret)
+			return ret;
+
+		mt8512_afe_link_start_arm(afe, dai_id);
+		return 0;
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
+		mt8512_afe_link_start_disarm(afe, dai_id);
+
 		/* disable channel merge */
 		if (dai_id == MT8512_AFE_MEMIF_UL2) {
 			regmap_update_bits(afe->regmap,
@@ -2609,6 +2510,7 @@ static int mt8512_dai_num_to_gasrc(int num)
 static void mt8512_afe_reset_gasrc(struct mtk_base_afe *afe,
 	struct snd_soc_dai *dai)
 {
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
 	const int gasrc_id = mt8512_dai_num_to_gasrc(dai->id);
 	unsigned int val = 0;
 
@@ -2632,6 +2534,9 @@ static void mt8512_afe_reset_gasrc(struct mtk_base_afe *afe,
 	regmap_update_bits(afe->regmap, GASRC_CFG0, val, val);
 	regmap_update_bits(afe->regmap, GASRC_CFG0, val, 0);
 
+	/* not known to survive the reset, reload on the next configure */
+	afe_priv->gasrc_data[gasrc_id].iir_table_id = -1;
+	afe_priv->gasrc_data[gasrc_id].iir_on = false;
 }
 
 static void mt8512_afe_clear_gasrc(struct mtk_base_afe *afe,
@@ -4517,18 +4422,38 @@ static bool mt8512_afe_gasrc_fill_iir_coeff_table(struct mtk_base_afe *afe,
 	return true;
 }
 
+/*
+ * The coefficient sram is only skipped while the gasrc keeps running
+ * from a parked stop, where nothing reset it. A soft reset and an AFE
+ * power down both forget the resident table.
+ */
 static bool mt8512_afe_load_gasrc_iir_coeff_table(struct mtk_base_afe *afe,
 	int gasrc_id, int input_rate, int output_rate)
 {
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_gasrc_data *gasrc_data = &afe_priv->gasrc_data[gasrc_id];
 	int table_id;
 
-	if (mt8512_afe_gasrc_found_iir_coeff_table_id(input_rate,
-			output_rate, &table_id)) {
-		return mt8512_afe_gasrc_fill_iir_coeff_table(afe,
-			gasrc_id, table_id);
+	if (!mt8512_afe_gasrc_found_iir_coeff_table_id(input_rate,
+			output_rate, &table_id))
+		return false;
+
+	if (gasrc_data->iir_table_id == table_id)
+		return true;
+
+	/* the iir must not run on a half written table */
+	if (gasrc_data->iir_on) {
+		mt8512_afe_gasrc_disable_iir(afe, gasrc_id);
+		gasrc_data->iir_on = false;
 	}
 
-	return false;
+	gasrc_data->iir_table_id = -1;
+	if (!mt8512_afe_gasrc_fill_iir_coeff_table(afe, gasrc_id, table_id))
+		return false;
+
+	gasrc_data->iir_table_id = table_id;
+
+	return true;
 }
 
 static void mt8512_afe_adjust_gasrc_cali_cycles(struct mtk_base_afe *afe,
@@ -4567,7 +4492,7 @@ static void mt8512_afe_adjust_gasrc_cali_cycles(struct mtk_base_afe *afe,
 
 static int mt8512_afe_configure_gasrc(struct mtk_base_afe *afe,
 	struct snd_pcm_substream *substream,
-	struct snd_soc_dai *dai)
+	struct snd_soc_dai *dai, bool retune)
 {
 	struct mt8512_afe_private *afe_priv = afe->platform_priv;
 	struct snd_pcm_runtime * const runtime = substream->runtime;
@@ -4682,7 +4607,9 @@ static int mt8512_afe_configure_gasrc(struct mtk_base_afe *afe,
 
 	if (mt8512_afe_load_gasrc_iir_coeff_table(afe, gasrc_id,
 			input_rate, output_rate)) {
-		mt8512_afe_gasrc_enable_iir(afe, gasrc_id);
+		/* a running iir on the same table keeps its history */
+		if (!retune || !gasrc_data->iir_on)
+			mt8512_afe_gasrc_enable_iir(afe, gasrc_id);
 		gasrc_data->iir_on = true;
 	} else {
 		mt8512_afe_gasrc_disable_iir(afe, gasrc_id);
@@ -4780,6 +4707,33 @@ static int mt8512_afe_configure_gasrc(struct mtk_base_afe *afe,
 	return 0;
 }
 
+static void mt8512_afe_gasrc_enable_cali(struct mtk_base_afe *afe,
+	int gasrc_id, bool enable)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_gasrc_data *gasrc_data = &afe_priv->gasrc_data[gasrc_id];
+	unsigned int ctrl_reg;
+	unsigned int val;
+
+	if (gasrc_data->one_heart)
+		ctrl_reg = gasrc_ctrl_reg[MT8512_GASRC0].con6;
+	else
+		ctrl_reg = gasrc_ctrl_reg[gasrc_id].con6;
+
+	if (!enable) {
+		regmap_update_bits(afe->regmap, ctrl_reg,
+			GASRC_NEW_CON6_CALI_EN, 0);
+		return;
+	}
+
+	val = GASRC_NEW_CON6_CALI_EN;
+	regmap_update_bits(afe->regmap, ctrl_reg, val, val);
+
+	val = GASRC_NEW_CON6_AUTO_TUNE_FREQ2 |
+			GASRC_NEW_CON6_AUTO_TUNE_FREQ3;
+	regmap_update_bits(afe->regmap, ctrl_reg, val, val);
+}
+
 static int mt8512_afe_enable_gasrc(struct snd_soc_dai *dai, int stream)
 {
 	struct mtk_base_afe *afe = snd_soc_dai_get_drvdata(dai);
@@ -4805,22 +4759,22 @@ static int mt8512_afe_enable_gasrc(struct snd_soc_dai *dai, int stream)
 	if (counter != 1 && !re_enable)
 		return 0;
 
+	/*
+	 * Still running from before the stop, the retune may have turned
+	 * tracking on or off.
+	 */
+	if (gasrc_data->parked && !re_enable) {
+		gasrc_data->parked = false;
+		mt8512_afe_gasrc_enable_cali(afe, gasrc_id,
+			gasrc_data->cali_tx || gasrc_data->cali_rx);
+		return 0;
+	}
+
 	dev_dbg(dai->dev, "%s [%d] one_heart %d re_enable %d\n",
 		__func__, gasrc_id, gasrc_data->one_heart, re_enable);
 
-	if (gasrc_data->cali_tx || gasrc_data->cali_rx) {
-		if (gasrc_data->one_heart)
-			ctrl_reg = gasrc_ctrl_reg[MT8512_GASRC0].con6;
-		else
-			ctrl_reg = gasrc_ctrl_reg[gasrc_id].con6;
-
-		val = GASRC_NEW_CON6_CALI_EN;
-		regmap_update_bits(afe->regmap, ctrl_reg, val, val);
-
-		val = GASRC_NEW_CON6_AUTO_TUNE_FREQ2 |
-				GASRC_NEW_CON6_AUTO_TUNE_FREQ3;
-		regmap_update_bits(afe->regmap, ctrl_reg, val, val);
-	}
+	if (gasrc_data->cali_tx || gasrc_data->cali_rx)
+		mt8512_afe_gasrc_enable_cali(afe, gasrc_id, true);
 
 	if (gasrc_data->one_heart)
 		ctrl_reg = gasrc_ctrl_reg[MT8512_GASRC0].con0;
@@ -4860,6 +4814,14 @@ static int mt8512_afe_disable_gasrc(struct snd_soc_dai *dai, bool directly)
 	dev_dbg(dai->dev, "%s [%d] one_heart %d directly %d\n",
 		__func__, gasrc_id, gasrc_data->one_heart, directly);
 
+	/* keep converting, the next prepare only retunes the rates */
+	if (gasrc_data->seamless && !directly) {
+		gasrc_data->parked = true;
+		return 0;
+	}
+
+	gasrc_data->parked = false;
+
 	if (gasrc_data->one_heart)
 		ctrl_reg = gasrc_ctrl_reg[MT8512_GASRC0].con0;
 	else
@@ -4868,15 +4830,8 @@ static int mt8512_afe_disable_gasrc(struct snd_soc_dai *dai, bool directly)
 	val = GASRC_NEW_CON0_ASM_ON;
 	regmap_update_bits(afe->regmap, ctrl_reg, val, 0);
 
-	if (gasrc_data->cali_tx || gasrc_data->cali_rx) {
-		if (gasrc_data->one_heart)
-			ctrl_reg = gasrc_ctrl_reg[MT8512_GASRC0].con6;
-		else
-			ctrl_reg = gasrc_ctrl_reg[gasrc_id].con6;
-
-		val = GASRC_NEW_CON6_CALI_EN;
-		regmap_update_bits(afe->regmap, ctrl_reg, val, 0);
-	}
+	/* a retune may have left it on with tracking off since */
+	mt8512_afe_gasrc_enable_cali(afe, gasrc_id, false);
 
 	if (gasrc_data->iir_on)
 		mt8512_afe_gasrc_disable_iir(afe, gasrc_id);
@@ -4938,6 +4893,9 @@ static void mt8512_afe_gasrc_shutdown(struct snd_pcm_substream *substream,
 
 	gasrc_data->re_enable[substream->stream] = false;
 
+	if (gasrc_data->parked)
+		mt8512_afe_disable_gasrc(dai, true);
+
 	switch (gasrc_id) {
 	case MT8512_GASRC0:
 		mt8512_afe_disable_top_cg(afe, MT8512_TOP_CG_GASRC0);
@@ -4970,6 +4928,7 @@ static int mt8512_afe_gasrc_prepare(struct snd_pcm_substream *substream,
 	struct mt8512_afe_private *afe_priv = afe->platform_priv;
 	const int gasrc_id = mt8512_dai_num_to_gasrc(dai->id);
 	struct mt8512_gasrc_data *gasrc_data;
+	bool retune;
 	int counter;
 
 	if (gasrc_id < 0)
@@ -4996,10 +4955,25 @@ static int mt8512_afe_gasrc_prepare(struct snd_pcm_substream *substream,
 		gasrc_data->re_enable[substream->stream] = true;
 	}
 
-	mt8512_afe_reset_gasrc(afe, dai);
-	mt8512_afe_clear_gasrc(afe, dai);
-	mt8512_afe_gasrc_use_sel(afe, dai, true);
-	mt8512_afe_configure_gasrc(afe, substream, dai);
+	/*
+	 * A parked gasrc still runs with its channel set and calibration,
+	 * the new rates are written over it without reset.
+	 */
+	retune = gasrc_data->parked;
+	if (retune && gasrc_data->stream != substream->stream) {
+		mt8512_afe_disable_gasrc(dai, true);
+		retune = false;
+	}
+
+	dev_dbg(dai->dev, "%s [%d] retune %d\n", __func__, gasrc_id, retune);
+
+	if (!retune) {
+		mt8512_afe_reset_gasrc(afe, dai);
+		mt8512_afe_clear_gasrc(afe, dai);
+		mt8512_afe_gasrc_use_sel(afe, dai, true);
+	}
+	mt8512_afe_configure_gasrc(afe, substream, dai, retune);
+	gasrc_data->stream = substream->stream;
 
 	return 0;
 }
@@ -5464,7 +5438,7 @@ static const struct snd_soc_dai_ops mt8512_afe_fe_dai_ops = {
 	.startup	= mt8512_afe_fe_startup,
 	.shutdown	= mt8512_afe_fe_shutdown,
 	.hw_params	= mt8512_afe_fe_hw_params,
-	.hw_free	= mtk_afe_fe_hw_free,
+	.hw_free	= mt8512_afe_fe_hw_free,
 	.prepare	= mt8512_afe_fe_prepare,
 	.trigger	= mt8512_afe_fe_trigger,
 	.set_fmt	= mt8512_afe_fe_set_fmt,
@@ -6520,15 +6494,28 @@ static int mt8512_afe_gasrc_sink_mux_put(struct snd_kcontrol *kcontrol,
 }
 
 #ifdef CONFIG_MTK_HIFIXDSP_SUPPORT
-static void mt8512_adsp_get_afe_memif_sram(struct mtk_base_afe *afe,
+static int mt8512_adsp_alloc_afe_memif_sram(struct mtk_base_afe *afe,
 				       int memif_id,
-				       unsigned int *paddr,
-				       unsigned int *size)
+				       unsigned int size,
+				       unsigned int *paddr)
 {
 	struct mt8512_afe_private *afe_priv = afe->platform_priv;
 	struct mt8512_fe_dai_data *fe_data = &afe_priv->fe_data[memif_id];
+	int ret;
+
+	ret = mt8512_afe_alloc_sram(afe, memif_id, size);
+	if (ret)
+		return ret;
+
 	*paddr = fe_data->sram_phy_addr;
-	*size = fe_data->sram_size;
+
+	return 0;
+}
+
+static void mt8512_adsp_free_afe_memif_sram(struct mtk_base_afe *afe,
+				       int memif_id)
+{
+	mt8512_afe_free_sram(afe, memif_id);
 }
 
 static int mt8512_adsp_set_afe_memif(struct mtk_base_afe *afe,
@@ -8488,12 +8475,218 @@ static const struct regmap_bus mt8512_afe_regmap_bus = {
 };
 #endif
 
+static const struct regmap_range mt8512_afe_reg_ranges[] = {
+	regmap_reg_range(AUDIO_TOP_CON0, AUDIO_TOP_CON5),
+	regmap_reg_range(ASMO_TIMING_CON0, ASMO_TIMING_CON0),
+	regmap_reg_range(PWR1_ASM_CON1, PWR1_ASM_CON1),
+	regmap_reg_range(ASYS_IRQ_CONFIG, AFE_IRQ_MCU_MON2),
+	regmap_reg_range(AFE_SINEGEN_CON0, AFE_SINEGEN_CON3),
+	regmap_reg_range(AFE_SPDIF_OUT_CON0, AFE_SPDIF_OUT_CON0),
+	regmap_reg_range(AFE_TDMOUT_CONN0, AFE_TDMOUT_CONN0),
+	regmap_reg_range(AFE_TDMOUT_CONN1, AFE_TDMOUT_CONN2),
+	regmap_reg_range(AFE_APLL_TUNER_CFG, AFE_APLL_TUNER_CFG1),
+	regmap_reg_range(AFE_GAIN1_CON0, AFE_GAIN1_CON3),
+	regmap_reg_range(AFE_GAIN1_CUR, AFE_PCM_SRC_FS_CON0),
+	regmap_reg_range(AFE_IEC_CFG, AFE_IEC_NSADR),
+	regmap_reg_range(AFE_IEC_CHL_STAT0, AFE_IEC_CHR_STAT1),
+	regmap_reg_range(AFE_SPDIFIN_CFG0, AFE_SPDIFIN_CKLOCK_CFG),
+	regmap_reg_range(AFE_SPDIFIN_BR, SPDIFIN_USERCODE12),
+	regmap_reg_range(AFE_SPDIFIN_APLL_TUNER_CFG, AFE_SPDIFIN_APLL_TUNER_CFG1),
+	regmap_reg_range(ASYS_TOP_CON, ASYS_TOP_CON),
+	regmap_reg_range(PWR2_TOP_CON0, PCM_INTF_CON2),
+	regmap_reg_range(AFE_I2S_UL9_REORDER, AFE_I2S_UL2_REORDER),
+	regmap_reg_range(AFE_MPHONE_MULTI_CON0, AFE_MPHONE_MULTI_CON1),
+	regmap_reg_range(AFE_MPHONE_MULTI_MON, AFE_MPHONE_MULTI_MON),
+	regmap_reg_range(AFE_CONN_24BIT, AFE_CONN23),
+	regmap_reg_range(AFE_CONN26, AFE_CONN49_1),
+	regmap_reg_range(AFE_CONN_RS, AFE_CONN_24BIT_1),
+	regmap_reg_range(AFE_GASRC0_NEW_CON0, AFE_GASRC0_NEW_CON4),
+	regmap_reg_range(AFE_GASRC0_NEW_CON6, AFE_GASRC0_NEW_CON11),
+	regmap_reg_range(AFE_GASRC0_NEW_CON13, AFE_GASRC0_NEW_CON14),
+	regmap_reg_range(AFE_GASRC1_NEW_CON0, AFE_GASRC1_NEW_CON4),
+	regmap_reg_range(AFE_GASRC1_NEW_CON6, AFE_GASRC1_NEW_CON11),
+	regmap_reg_range(AFE_GASRC1_NEW_CON13, AFE_GASRC1_NEW_CON14),
+	regmap_reg_range(AFE_GASRC2_NEW_CON0, AFE_GASRC2_NEW_CON4),
+	regmap_reg_range(AFE_GASRC2_NEW_CON6, AFE_GASRC2_NEW_CON11),
+	regmap_reg_range(AFE_GASRC2_NEW_CON13, AFE_GASRC2_NEW_CON14),
+	regmap_reg_range(AFE_GASRC3_NEW_CON0, AFE_GASRC3_NEW_CON4),
+	regmap_reg_range(AFE_GASRC3_NEW_CON6, AFE_GASRC3_NEW_CON11),
+	regmap_reg_range(AFE_GASRC3_NEW_CON13, AFE_GASRC3_NEW_CON14),
+	regmap_reg_range(AFE_ASRC11_NEW_CON0, AFE_ASRC11_NEW_CON11),
+	regmap_reg_range(AFE_ASRC11_NEW_CON13, AFE_ASRC11_NEW_CON14),
+	regmap_reg_range(AFE_ASRC12_NEW_CON0, AFE_ASRC12_NEW_CON11),
+	regmap_reg_range(AFE_ASRC12_NEW_CON13, AFE_ASRC12_NEW_CON14),
+	regmap_reg_range(AFE_LRCK_CNT, AFE_LRCK_CNT),
+	regmap_reg_range(AFE_DAC_CON0, AFE_DAC_CON1),
+	regmap_reg_range(AFE_DAC_MON0, AFE_DAC_MON0),
+	regmap_reg_range(AFE_DL2_BASE, AFE_DL3_CON0),
+	regmap_reg_range(AFE_DL6_BASE, AFE_DL6_CON0),
+	regmap_reg_range(AFE_DL10_BASE, AFE_DL10_CON0),
+	regmap_reg_range(AFE_UL1_BASE, AFE_UL5_CON0),
+	regmap_reg_range(AFE_UL8_BASE, AFE_UL9_CON0),
+	regmap_reg_range(AFE_UL10_BASE, AFE_UL10_CON0),
+	regmap_reg_range(AFE_BUS_MON1, AFE_BUS_MON1),
+	regmap_reg_range(AFE_MEMIF_AGENT_FS_CON0, AFE_MEMIF_AGENT_FS_CON3),
+	regmap_reg_range(AFE_MEMIF_BURST_CFG, AFE_MEMIF_BURST_CFG),
+	regmap_reg_range(AFE_MEMIF_BUF_MON1, AFE_MEMIF_BUF_MON1),
+	regmap_reg_range(AFE_MEMIF_BUF_MON3, AFE_MEMIF_BUF_MON10),
+	regmap_reg_range(AFE_NORMAL_BASE_ADR_MSB, AFE_NORMAL_END_ADR_MSB),
+	regmap_reg_range(AFE_LOOPBACK_CFG0, AFE_LOOPBACK_CFG1),
+	regmap_reg_range(AFE_DMIC0_UL_SRC_CON0, AFE_DMIC0_IIR_COEF_10_09),
+	regmap_reg_range(AFE_DMIC1_UL_SRC_CON0, AFE_DMIC1_IIR_COEF_10_09),
+	regmap_reg_range(AFE_DMIC2_UL_SRC_CON0, AFE_DMIC2_IIR_COEF_10_09),
+	regmap_reg_range(AFE_DMIC3_UL_SRC_CON0, AFE_DMIC3_IIR_COEF_10_09),
+	regmap_reg_range(ETDM_IN1_MONITOR, ETDM_IN2_MONITOR),
+	regmap_reg_range(ETDM_OUT2_MONITOR, ETDM_OUT2_MONITOR),
+	regmap_reg_range(ETDM_COWORK_CON0, ETDM_COWORK_CON1),
+	regmap_reg_range(ETDM_COWORK_CON3, ETDM_IN1_CON4),
+	regmap_reg_range(ETDM_IN2_CON0, ETDM_IN2_CON4),
+	regmap_reg_range(ETDM_OUT2_CON0, ETDM_OUT2_CON4),
+	regmap_reg_range(GASRC_CFG0, GASRC_CFG0),
+	regmap_reg_range(GASRC_TIMING_CON0, GASRC_TIMING_CON1),
+	regmap_reg_range(AFE_ADDA_DL_SRC2_CON0, AFE_ADDA_DL_SRC2_CON1),
+	regmap_reg_range(AFE_ADDA_TOP_CON0, AFE_ADDA_UL_DL_CON0),
+	regmap_reg_range(AFE_ADDA_PREDIS_CON0, AFE_ADDA_PREDIS_CON1),
+	regmap_reg_range(AFE_NLE_CFG, AFE_NLE_GAIN_IMP_LCH_CFG2),
+	regmap_reg_range(AFE_NLE_PWR_DET_RCH_CFG, AFE_NLE_GAIN_IMP_RCH_CFG2),
+	regmap_reg_range(ABB_AFE_CON0, ABB_AFE_CON7),
+	regmap_reg_range(ABB_AFE_CON10, ABB_AFE_STA2),
+	regmap_reg_range(ABB_AFE_SDM_TEST, AMIC_GAIN_CUR),
+	regmap_reg_range(AFE_AD_UL_DL_CON0, ABB_ULAFE_CON1),
+};
+
+static const struct regmap_access_table mt8512_afe_reg_table = {
+	.yes_ranges = mt8512_afe_reg_ranges,
+	.n_yes_ranges = ARRAY_SIZE(mt8512_afe_reg_ranges),
+};
+
+/*
+ * Status, monitor and current pointer registers change under the hardware,
+ * IRQ_CLR and SPDIFIN_EC are write 1 to clear. Everything else only
+ * changes through the regmap and is served from the cache.
+ */
+static bool mt8512_afe_volatile_reg(struct device *dev, unsigned int reg)
+{
+	/*
+	 * GASRC_CFG0 soft reset puts a whole GASRC block back to its
+	 * defaults behind the cache, and CON0 carries write-1 pulse bits
+	 * (CHSET_STR_CLR, CLR_IIR_HISTORY). The blocks are only touched
+	 * when a stream is set up, so keep them uncached.
+	 */
+	if (reg >= AFE_GASRC0_NEW_CON0 && reg <= AFE_GASRC3_NEW_CON14)
+		return true;
+
+	switch (reg) {
+	case ASYS_IRQ_CLR:
+	case ASYS_IRQ_STATUS:
+	case ASYS_IRQ_MON1:
+	case ASYS_IRQ_MON2:
+	case AFE_IRQ_MCU_CLR:
+	case AFE_IRQ_STATUS:
+	case AFE_IRQ_ACC1_CNT_MON1:
+	case AFE_IRQ_ACC1_CNT_MON2:
+	case AFE_TSF_MON:
+	case AFE_IRQ_ACC2_CNT_MON:
+	case AFE_IRQ3_CON_MON:
+	case AFE_IRQ_MCU_MON2:
+	case AFE_GAIN1_CUR:
+	case AFE_IEC_CHL_STAT0:
+	case AFE_IEC_CHL_STAT1:
+	case AFE_IEC_CHR_STAT0:
+	case AFE_IEC_CHR_STAT1:
+	case AFE_SPDIFIN_CHSTS1:
+	case AFE_SPDIFIN_CHSTS2:
+	case AFE_SPDIFIN_CHSTS3:
+	case AFE_SPDIFIN_CHSTS4:
+	case AFE_SPDIFIN_CHSTS5:
+	case AFE_SPDIFIN_CHSTS6:
+	case AFE_SPDIFIN_DEBUG1:
+	case AFE_SPDIFIN_DEBUG2:
+	case AFE_SPDIFIN_DEBUG3:
+	case AFE_SPDIFIN_DEBUG4:
+	case AFE_SPDIFIN_EC:
+	case AFE_SPDIFIN_BR_DBG1:
+	case AFE_SPDIFIN_INT_EXT2:
+	case SPDIFIN_FREQ_STATUS:
+	case SPDIFIN_USERCODE1:
+	case SPDIFIN_USERCODE2:
+	case SPDIFIN_USERCODE3:
+	case SPDIFIN_USERCODE4:
+	case SPDIFIN_USERCODE5:
+	case SPDIFIN_USERCODE6:
+	case SPDIFIN_USERCODE7:
+	case SPDIFIN_USERCODE8:
+	case SPDIFIN_USERCODE9:
+	case SPDIFIN_USERCODE10:
+	case SPDIFIN_USERCODE11:
+	case SPDIFIN_USERCODE12:
+	case AFE_MPHONE_MULTI_MON:
+	case AFE_LRCK_CNT:
+	case AFE_DAC_MON0:
+	case AFE_DL2_CUR:
+	case AFE_DL3_CUR:
+	case AFE_DL6_CUR:
+	case AFE_DL10_CUR:
+	case AFE_UL1_CUR:
+	case AFE_UL2_CUR:
+	case AFE_UL3_CUR:
+	case AFE_UL4_CUR:
+	case AFE_UL5_CUR:
+	case AFE_UL8_CUR:
+	case AFE_UL9_CUR:
+	case AFE_UL10_CUR:
+	case AFE_BUS_MON1:
+	case AFE_MEMIF_BUF_MON1:
+	case AFE_MEMIF_BUF_MON3:
+	case AFE_MEMIF_BUF_MON4:
+	case AFE_MEMIF_BUF_MON5:
+	case AFE_MEMIF_BUF_MON6:
+	case AFE_MEMIF_BUF_MON7:
+	case AFE_MEMIF_BUF_MON8:
+	case AFE_MEMIF_BUF_MON9:
+	case AFE_MEMIF_BUF_MON10:
+	case AFE_DMIC0_SRC_DEBUG:
+	case AFE_DMIC0_SRC_DEBUG_MON0:
+	case AFE_DMIC0_UL_SRC_MON0:
+	case AFE_DMIC0_UL_SRC_MON1:
+	case AFE_DMIC1_SRC_DEBUG:
+	case AFE_DMIC1_SRC_DEBUG_MON0:
+	case AFE_DMIC1_UL_SRC_MON0:
+	case AFE_DMIC1_UL_SRC_MON1:
+	case AFE_DMIC2_SRC_DEBUG:
+	case AFE_DMIC2_SRC_DEBUG_MON0:
+	case AFE_DMIC2_UL_SRC_MON0:
+	case AFE_DMIC2_UL_SRC_MON1:
+	case AFE_DMIC3_SRC_DEBUG:
+	case AFE_DMIC3_SRC_DEBUG_MON0:
+	case AFE_DMIC3_UL_SRC_MON0:
+	case AFE_DMIC3_UL_SRC_MON1:
+	case ETDM_IN1_MONITOR:
+	case ETDM_IN2_MONITOR:
+	case ETDM_OUT2_MONITOR:
+	case ABB_AFE_STA0:
+	case ABB_AFE_STA1:
+	case ABB_AFE_STA2:
+	case AMIC_GAIN_CUR:
+	case AFE_AD_SRC_DEBUG:
+	/* write-1 pulse bits, same layout as the GASRC CON0 */
+	case AFE_ASRC11_NEW_CON0:
+	case AFE_ASRC12_NEW_CON0:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static const struct regmap_config mt8512_afe_regmap_config = {
 	.reg_bits = 32,
 	.reg_stride = 4,
 	.val_bits = 32,
 	.max_register = MAX_REGISTER,
-	.cache_type = REGCACHE_NONE,
+	.rd_table = &mt8512_afe_reg_table,
+	.wr_table = &mt8512_afe_reg_table,
+	.volatile_reg = mt8512_afe_volatile_reg,
+	.cache_type = REGCACHE_FLAT,
 };
 
 static irqreturn_t mt8512_afe_irq_handler(int irq, void *dev_id)
@@ -8762,14 +8955,65 @@ static int mt8512_afe_handle_etdm_force_off(struct mtk_base_afe *afe)
 	return 0;
 }
 
+/*
+ * Register content may be lost once the audio clocks and power are gone,
+ * the regmap cache is the backup and is written back on resume.
+ */
 static int mt8512_afe_runtime_suspend(struct device *dev)
 {
+	struct mtk_base_afe *afe = dev_get_drvdata(dev);
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	int i;
+
+	regcache_mark_dirty(afe->regmap);
+
+	/* the gasrc coefficient sram is not in the cache */
+	for (i = 0; i < MT8512_GASRC_NUM; i++)
+		afe_priv->gasrc_data[i].iir_table_id = -1;
+
 	return 0;
 }
 
 static int mt8512_afe_runtime_resume(struct device *dev)
 {
-	return 0;
+	struct mtk_base_afe *afe = dev_get_drvdata(dev);
+	int ret;
+
+	ret = regcache_sync(afe->regmap);
+	if (ret)
+		dev_info(afe->dev, "%s regcache sync fail %d\n",
+			 __func__, ret);
+
+	return ret;
+}
+
+/*
+ * The cache starts out zeroed and there are no known reset values, fill
+ * it from the hardware before anything does a read-modify-write on it.
+ */
+static void mt8512_afe_init_regcache(struct mtk_base_afe *afe)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	unsigned int i, reg;
+
+	mt8512_afe_enable_clk(afe, afe_priv->clocks[MT8512_CLK_TOP_AUD_26M]);
+
+	regcache_cache_only(afe->regmap, true);
+
+	for (i = 0; i < ARRAY_SIZE(mt8512_afe_reg_ranges); i++) {
+		for (reg = mt8512_afe_reg_ranges[i].range_min;
+		     reg <= mt8512_afe_reg_ranges[i].range_max; reg += 4) {
+			if (mt8512_afe_volatile_reg(afe->dev, reg))
+				continue;
+
+			regmap_write(afe->regmap, reg,
+				     readl(afe->base_addr + reg));
+		}
+	}
+
+	regcache_cache_only(afe->regmap, false);
+
+	mt8512_afe_disable_clk(afe, afe_priv->clocks[MT8512_CLK_TOP_AUD_26M]);
 }
 
 static int mt8512_afe_dev_runtime_suspend(struct device *dev)
@@ -8856,20 +9100,6 @@ static bool mt8512_afe_validate_sram(struct mtk_base_afe *afe,
 	return false;
 }
 
-static void __iomem *mt8512_afe_sram_pa_to_va(struct mtk_base_afe *afe,
-	u32 phy_addr)
-{
-	struct mt8512_afe_private *afe_priv = afe->platform_priv;
-	u32 off = phy_addr - afe_priv->afe_sram_phy_addr;
-
-	if (afe_priv->afe_sram_phy_addr &&
-	    (off >= 0) && (off < afe_priv->afe_sram_size)) {
-		return ((unsigned char *)afe_priv->afe_sram_vir_addr + off);
-	}
-
-	return NULL;
-}
-
 static void mt8512_afe_parse_of(struct mtk_base_afe *afe,
 				struct device_node *np)
 {
@@ -9123,12 +9353,29 @@ static void mt8512_afe_parse_of(struct mtk_base_afe *afe,
 			continue;
 		}
 
+		/* placement is dynamic now, the size becomes the budget */
 		fe_data = &afe_priv->fe_data[of_fe_table[i].val];
+		fe_data->sram_class = MT8512_SRAM_CLASS_LOW_LATENCY;
+		fe_data->sram_budget = val[1];
+	}
 
-		fe_data->sram_phy_addr = val[0];
-		fe_data->sram_size = val[1];
-		fe_data->sram_vir_addr = mt8512_afe_sram_pa_to_va(afe,
-			fe_data->sram_phy_addr);
+	for (i = 0; i < ARRAY_SIZE(of_fe_table); i++) {
+		struct mt8512_fe_dai_data *fe_data =
+			&afe_priv->fe_data[of_fe_table[i].val];
+
+		snprintf(prop, sizeof(prop), "mediatek,%s-sram-class",
+			 of_fe_table[i].name);
+		if (!of_property_read_u32(np, prop, &val[0])) {
+			if (val[0] < MT8512_SRAM_CLASS_NUM)
+				fe_data->sram_class = val[0];
+			else
+				dev_info(afe->dev, "%s %s invalid class %u\n",
+					 __func__, of_fe_table[i].name, val[0]);
+		}
+
+		snprintf(prop, sizeof(prop), "mediatek,%s-sram-budget",
+			 of_fe_table[i].name);
+		of_property_read_u32(np, prop, &fe_data->sram_budget);
 	}
 
 	afe_priv->use_bypass_afe_pinmux = of_property_read_bool(np,
@@ -9149,6 +9396,11 @@ static void mt8512_afe_parse_of(struct mtk_base_afe *afe,
 	for (i = 0; i < ARRAY_SIZE(of_afe_gasrcs); i++) {
 		memset(val, 0, sizeof(val));
 		gasrc_data = &afe_priv->gasrc_data[of_afe_gasrcs[i].set];
+		gasrc_data->iir_table_id = -1;
+
+		snprintf(prop, sizeof(prop), "mediatek,%s-seamless-switch",
+				 of_afe_gasrcs[i].name);
+		gasrc_data->seamless = of_property_read_bool(np, prop);
 
 		snprintf(prop, sizeof(prop), "mediatek,%s-fix-rate",
 				 of_afe_gasrcs[i].name);
@@ -9208,6 +9460,8 @@ static int mt8512_afe_pcm_dev_probe(struct platform_device *pdev)
 
 	spin_lock_init(&afe_priv->afe_ctrl_lock);
 
+	spin_lock_init(&afe_priv->link_start.lock);
+
 	mutex_init(&afe_priv->afe_clk_mutex);
 
 	mutex_init(&afe_priv->block_dpidle_mutex);
@@ -9241,6 +9495,10 @@ static int mt8512_afe_pcm_dev_probe(struct platform_device *pdev)
 		}
 	}
 
+	ret = mt8512_afe_init_sram_pool(afe);
+	if (ret)
+		return ret;
+
 	/* initial audio related clock */
 	ret = mt8512_afe_init_audio_clk(afe);
 	if (ret) {
@@ -9308,13 +9566,13 @@ static int mt8512_afe_pcm_dev_probe(struct platform_device *pdev)
 
 	pm_runtime_get_sync(&pdev->dev);
 
-	afe->reg_back_up_list = mt8512_afe_backup_list;
-	afe->reg_back_up_list_num = ARRAY_SIZE(mt8512_afe_backup_list);
 	afe->runtime_resume = mt8512_afe_runtime_resume;
 	afe->runtime_suspend = mt8512_afe_runtime_suspend;
 #ifdef CONFIG_MTK_HIFIXDSP_SUPPORT
-	afe_priv->adsp_data.get_afe_memif_sram =
-		mt8512_adsp_get_afe_memif_sram;
+	afe_priv->adsp_data.alloc_afe_memif_sram =
+		mt8512_adsp_alloc_afe_memif_sram;
+	afe_priv->adsp_data.free_afe_memif_sram =
+		mt8512_adsp_free_afe_memif_sram;
 	afe_priv->adsp_data.set_afe_memif =
 		mt8512_adsp_set_afe_memif;
 	afe_priv->adsp_data.set_afe_memif_enable =
@@ -9331,6 +9589,9 @@ static int mt8512_afe_pcm_dev_probe(struct platform_device *pdev)
 	mt8512_afe_enable_clk(afe, afe_priv->clocks[MT8512_CLK_AUDIO_CG]);
 	mt8512_afe_enable_clk(afe, afe_priv->clocks[MT8512_CLK_AUD_26M_CG]);
 	mt8512_afe_enable_clk(afe, afe_priv->clocks[MT8512_CLK_TOP_AUD_BUS]);
+
+	mt8512_afe_init_regcache(afe);
+
 	mt8512_afe_enable_top_cg(afe, MT8512_TOP_CG_A1SYS);
 	mt8512_afe_enable_top_cg(afe, MT8512_TOP_CG_A1SYS_HOPPING);
 	mt8512_afe_enable_top_cg(afe, MT8512_TOP_CG_AFE);
@@ -18,6 +18,7 @@
 #include "mt8512-afe-common.h"
 #include "mt8512-reg.h"
 #include "../common/mtk-base-afe.h"
+#include "../common/mtk-afe-platform-driver.h"
 #include <linux/device.h>
 #include <linux/pm_qos.h>
 static struct pm_qos_request qos_request = { {0} };
@@ -762,6 +763,263 @@ int mt8512_afe_unblock_dpidle(struct mtk_base_afe *afe)
 	return 0;
 }
 
+#define MT8512_AFE_SRAM_ORDER	6	/* memif base/end need 64 byte units */
+
+int mt8512_afe_init_sram_pool(struct mtk_base_afe *afe)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct gen_pool *pool;
+	int ret;
+
+	mutex_init(&afe_priv->sram_mutex);
+
+	if (!afe_priv->afe_sram_phy_addr || !afe_priv->afe_sram_size)
+		return 0;
+
+	pool = devm_gen_pool_create(afe->dev, MT8512_AFE_SRAM_ORDER, -1,
+				    "afe-sram");
+	if (IS_ERR(pool))
+		return PTR_ERR(pool);
+
+	ret = gen_pool_add_virt(pool,
+				(unsigned long)afe_priv->afe_sram_vir_addr,
+				afe_priv->afe_sram_phy_addr,
+				afe_priv->afe_sram_size, -1);
+	if (ret)
+		return ret;
+
+	afe_priv->sram_pool = pool;
+
+	return 0;
+}
+
+/* budget of idle FEs that outrank class, kept out of reach of class */
+static unsigned int mt8512_afe_sram_reserved(struct mtk_base_afe *afe,
+	unsigned int class)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_fe_dai_data *fe_data;
+	unsigned int reserved = 0;
+	int i;
+
+	for (i = 0; i < MT8512_AFE_MEMIF_NUM; i++) {
+		fe_data = &afe_priv->fe_data[i];
+		if (!fe_data->use_sram && fe_data->sram_class > class)
+			reserved += fe_data->sram_budget;
+	}
+
+	return reserved;
+}
+
+int mt8512_afe_alloc_sram(struct mtk_base_afe *afe, int memif_id,
+	unsigned int size)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_fe_dai_data *fe_data = &afe_priv->fe_data[memif_id];
+	struct gen_pool *pool = afe_priv->sram_pool;
+	unsigned long addr;
+	size_t avail;
+	int ret = -ENOMEM;
+
+	if (!pool || fe_data->sram_class == MT8512_SRAM_CLASS_NONE)
+		return -ENOMEM;
+
+	mutex_lock(&afe_priv->sram_mutex);
+
+	/* hw_params again with a buffer that still fits */
+	if (fe_data->use_sram && size <= fe_data->sram_size) {
+		ret = 0;
+		goto out;
+	}
+
+	if (fe_data->use_sram) {
+		gen_pool_free(pool, (unsigned long)fe_data->sram_vir_addr,
+			      fe_data->sram_size);
+		fe_data->use_sram = false;
+	}
+
+	avail = gen_pool_avail(pool);
+	if (avail < size +
+	    mt8512_afe_sram_reserved(afe, fe_data->sram_class))
+		goto out;
+
+	addr = gen_pool_alloc(pool, size);
+	if (!addr)
+		goto out;
+
+	fe_data->sram_vir_addr = (void __iomem *)addr;
+	fe_data->sram_phy_addr = gen_pool_virt_to_phys(pool, addr);
+	fe_data->sram_size = size;
+	fe_data->use_sram = true;
+	ret = 0;
+
+out:
+	mutex_unlock(&afe_priv->sram_mutex);
+
+	dev_dbg(afe->dev, "%s memif %d class %u size %u %s\n", __func__,
+		memif_id, fe_data->sram_class, size, ret ? "dram" : "sram");
+
+	return ret;
+}
+
+void mt8512_afe_free_sram(struct mtk_base_afe *afe, int memif_id)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_fe_dai_data *fe_data = &afe_priv->fe_data[memif_id];
+
+	mutex_lock(&afe_priv->sram_mutex);
+
+	if (fe_data->use_sram) {
+		gen_pool_free(afe_priv->sram_pool,
+			      (unsigned long)fe_data->sram_vir_addr,
+			      fe_data->sram_size);
+		fe_data->use_sram = false;
+		fe_data->sram_vir_addr = NULL;
+		fe_data->sram_phy_addr = 0;
+		fe_data->sram_size = 0;
+	}
+
+	mutex_unlock(&afe_priv->sram_mutex);
+}
+
+/*
+ * Only members that are prepared count as pending, one that is merely
+ * open may never be triggered. Enable what is armed once nothing is
+ * pending any more. Called with link->lock held.
+ */
+static void mt8512_afe_link_start_check(struct mtk_base_afe *afe,
+	struct mt8512_link_start_data *link, int memif_id)
+{
+	const struct mtk_base_memif_data *data;
+	unsigned int pending;
+	unsigned int bits = 0;
+	int i;
+
+	pending = link->mask & link->prepared & ~(link->armed | link->started);
+
+	if (!pending && link->armed) {
+		for (i = 0; i < MT8512_AFE_MEMIF_NUM; i++) {
+			data = afe->memif[i].data;
+			if ((link->armed & BIT(i)) && data->enable_shift >= 0)
+				bits |= 1 << data->enable_shift;
+		}
+
+		/* every memif enable lives in AFE_DAC_CON0 */
+		regmap_update_bits(afe->regmap, AFE_DAC_CON0, bits, bits);
+
+		link->started |= link->armed;
+		link->armed = 0;
+	}
+
+	dev_dbg(afe->dev, "%s memif %d pending 0x%x started 0x%x\n",
+		__func__, memif_id, pending, link->started);
+}
+
+void mt8512_afe_link_start_prepare(struct mtk_base_afe *afe, int memif_id)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	unsigned long flags;
+
+	spin_lock_irqsave(&link->lock, flags);
+	link->prepared |= BIT(memif_id);
+	spin_unlock_irqrestore(&link->lock, flags);
+}
+
+/*
+ * Called from hw_free and close. A member leaving the group may be the
+ * last one the armed members were waiting for.
+ */
+void mt8512_afe_link_start_release(struct mtk_base_afe *afe, int memif_id)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	unsigned long flags;
+
+	spin_lock_irqsave(&link->lock, flags);
+	if (link->prepared & BIT(memif_id)) {
+		link->prepared &= ~BIT(memif_id);
+		link->armed &= ~BIT(memif_id);
+		link->started &= ~BIT(memif_id);
+		mt8512_afe_link_start_check(afe, link, memif_id);
+	}
+	spin_unlock_irqrestore(&link->lock, flags);
+}
+
+/*
+ * Called from the trigger of a memif in the link mask once its irq and
+ * fs are set up. The last prepared member to arm enables the whole
+ * group. A member that joins while others already run starts alone.
+ */
+void mt8512_afe_link_start_arm(struct mtk_base_afe *afe, int memif_id)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	unsigned long flags;
+
+	spin_lock_irqsave(&link->lock, flags);
+	link->armed |= BIT(memif_id);
+	mt8512_afe_link_start_check(afe, link, memif_id);
+	spin_unlock_irqrestore(&link->lock, flags);
+}
+
+void mt8512_afe_link_start_disarm(struct mtk_base_afe *afe, int memif_id)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	unsigned long flags;
+
+	spin_lock_irqsave(&link->lock, flags);
+	link->armed &= ~BIT(memif_id);
+	link->started &= ~BIT(memif_id);
+	spin_unlock_irqrestore(&link->lock, flags);
+}
+
+/*
+ * Position of every started member against the first started capture
+ * member (or the first member), in microseconds, from one snapshot of
+ * the current address registers. Playback runs ahead by what the memif
+ * prefetched, capture by the pipeline delay of its source. These stay
+ * fixed for as long as the group runs.
+ */
+void mt8512_afe_link_start_offsets(struct mtk_base_afe *afe, long *offset_us)
+{
+	struct mt8512_afe_private *afe_priv = afe->platform_priv;
+	struct mt8512_link_start_data *link = &afe_priv->link_start;
+	struct mtk_base_afe_memif *memif;
+	s64 pos_us[MT8512_AFE_MEMIF_NUM];
+	unsigned int valid = 0;
+	unsigned long flags;
+	int ref = -1;
+	u64 frames;
+	int i;
+
+	spin_lock_irqsave(&link->lock, flags);
+
+	for (i = 0; i < MT8512_AFE_MEMIF_NUM; i++) {
+		memif = &afe->memif[i];
+		if (!(link->started & BIT(i)) || !memif->substream)
+			continue;
+		if (mtk_afe_pcm_hw_frames(afe, memif, &frames))
+			continue;
+
+		pos_us[i] = div_u64(frames * USEC_PER_SEC,
+				    memif->substream->runtime->rate);
+		valid |= BIT(i);
+
+		if (ref < 0 || (memif->substream->stream ==
+				SNDRV_PCM_STREAM_CAPTURE &&
+				afe->memif[ref].substream->stream !=
+				SNDRV_PCM_STREAM_CAPTURE))
+			ref = i;
+	}
+
+	spin_unlock_irqrestore(&link->lock, flags);
+
+	for (i = 0; i < MT8512_AFE_MEMIF_NUM; i++)
+		offset_us[i] = (valid & BIT(i)) ? pos_us[i] - pos_us[ref] : 0;
+}
+
 int mt8512_afe_enable_apll_tuner_cfg(struct mtk_base_afe *afe,
 	unsigned int apll)
 {
@@ -63,6 +63,23 @@ int mt8512_afe_block_dpidle(struct mtk_base_afe *afe);
 
 int mt8512_afe_unblock_dpidle(struct mtk_base_afe *afe);
 
+int mt8512_afe_init_sram_pool(struct mtk_base_afe *afe);
+
+int mt8512_afe_alloc_sram(struct mtk_base_afe *afe, int memif_id,
+	unsigned int size);
+
+void mt8512_afe_free_sram(struct mtk_base_afe *afe, int memif_id);
+
+void mt8512_afe_link_start_prepare(struct mtk_base_afe *afe, int memif_id);
+
+void mt8512_afe_link_start_release(struct mtk_base_afe *afe, int memif_id);
+
+void mt8512_afe_link_start_arm(struct mtk_base_afe *afe, int memif_id);
+
+void mt8512_afe_link_start_disarm(struct mtk_base_afe *afe, int memif_id);
+
+void mt8512_afe_link_start_offsets(struct mtk_base_afe *afe, long *offset_us);
+
 int mt8512_afe_enable_apll_tuner_cfg(struct mtk_base_afe *afe,
 	unsigned int apll);
 